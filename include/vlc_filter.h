@@ -240,6 +240,69 @@ VLC_API int filter_Blend( filter_t *, picture_t *p_dst, int i_dst_x, int i_dst_y
  */
 VLC_API void filter_DeleteBlend( filter_t * );
 
+/**
+ * Slice callback of a video filter.
+ *
+ * It processes the slice i_slice out of i_slices. The callbacks of the
+ * different slices of a same call to filter_RunSlices() may run concurrently.
+ */
+typedef void (*filter_slice_cb)( filter_t *, void *opaque,
+                                 unsigned i_slice, unsigned i_slices );
+
+/**
+ * It returns the number of slices a video filter can be split into to use
+ * all the threads of the slice worker pool (1 if there is none).
+ */
+VLC_API unsigned filter_GetSliceCount( filter_t * ) VLC_USED;
+
+/**
+ * It runs the i_slices slices of a video filter on the slice worker pool,
+ * the calling thread included, and returns once all of them are done.
+ */
+VLC_API void filter_RunSlices( filter_t *, filter_slice_cb, void *opaque,
+                               unsigned i_slices );
+
+/**
+ * It gives the lines [*pi_start, *pi_end[ of the band i_slice out of
+ * i_slices of a plane of i_lines lines.
+ *
+ * The bands start on multiples of i_align lines.
+ */
+static inline void filter_SliceLines( int i_lines, int i_align,
+                                      unsigned i_slice, unsigned i_slices,
+                                      int *pi_start, int *pi_end )
+{
+    const int i_units = (i_lines + i_align - 1) / i_align;
+
+    *pi_start = __MIN( i_lines, (int)(i_units * i_slice / i_slices) * i_align );
+    *pi_end = __MIN( i_lines, (int)(i_units * (i_slice + 1) / i_slices) * i_align );
+}
+
+/**
+ * It makes p_view a view of the horizontal band i_slice out of i_slices of
+ * each plane of p_pic.
+ *
+ * Only the planes of the view are valid, it must not be held nor released.
+ * It is meant for the filters processing each line (of each plane)
+ * independently.
+ */
+static inline void filter_SlicePicture( picture_t *p_view,
+                                        const picture_t *p_pic,
+                                        unsigned i_slice, unsigned i_slices )
+{
+    *p_view = *p_pic;
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        plane_t *p = &p_view->p[i];
+        int i_start, i_end;
+
+        filter_SliceLines( p->i_visible_lines, 1, i_slice, i_slices,
+                           &i_start, &i_end );
+        p->p_pixels += i_start * p->i_pitch;
+        p->i_lines = p->i_visible_lines = i_end - i_start;
+    }
+}
+
 /**
  * Create a picture_t *(*)( filter_t *, picture_t * ) compatible wrapper
  * using a void (*)( filter_t *, picture_t *, picture_t * ) function
@@ -145,6 +145,15 @@ VLC_API int httpd_StreamHeader( httpd_stream_t *, uint8_t *p_data, int i_data );
 VLC_API int httpd_StreamSend( httpd_stream_t *, const block_t *p_block );
 VLC_API int httpd_StreamSetHTTPHeaders(httpd_stream_t *, httpd_header *, size_t);
 
+/* What to do with a client that cannot keep up with the stream */
+enum httpd_stream_slow
+{
+    HTTPD_STREAM_SLOW_SKIP,  /* skip to the latest keyframe or block */
+    HTTPD_STREAM_SLOW_CLOSE, /* close the connection */
+};
+/* Sets how much of the stream (in bytes) is kept for lagging clients */
+VLC_API void httpd_StreamSetBuffer(httpd_stream_t *, size_t i_size, enum httpd_stream_slow);
+
 /* Msg functions facilities */
 VLC_API void httpd_MsgAdd( httpd_message_t *, const char *psz_name, const char *psz_value, ... ) VLC_FORMAT( 3, 4 );
 /* return "" if not found. The string is not allocated */
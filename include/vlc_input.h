@@ -494,6 +494,10 @@ enum input_query_e
     /* External clock managments */
     INPUT_GET_PCR_SYSTEM,   /* arg1=mtime_t *, arg2=mtime_t *       res=can fail */
     INPUT_MODIFY_PCR_SYSTEM,/* arg1=int absolute, arg2=mtime_t      res=can fail */
+
+    /* Timeshift of live streams */
+    INPUT_GET_TIMESHIFT,    /* arg1=mtime_t *window, arg2=mtime_t *delay res=can fail */
+    INPUT_SET_TIMESHIFT,    /* arg1=mtime_t delay behind live       res=can fail */
 };
 
 /** @}*/
@@ -651,6 +655,23 @@ static inline int input_ModifyPcrSystem( input_thread_t *p_input, bool b_absolut
     return input_Control( p_input, INPUT_MODIFY_PCR_SYSTEM, b_absolute, i_system );
 }
 
+/**
+ * Get the duration of live stream buffered by the timeshift (window) and how
+ * far behind the live stream the playback is (delay), 0 when not timeshifted.
+ */
+static inline int input_GetTimeshift( input_thread_t *p_input, mtime_t *pi_window, mtime_t *pi_delay )
+{
+    return input_Control( p_input, INPUT_GET_TIMESHIFT, pi_window, pi_delay );
+}
+/**
+ * Move the playback to i_delay behind the live stream, within the timeshift
+ * window (see the "input-timeshift-size" option).
+ */
+static inline int input_SetTimeshift( input_thread_t *p_input, mtime_t i_delay )
+{
+    return input_Control( p_input, INPUT_SET_TIMESHIFT, i_delay );
+}
+
 /* */
 VLC_API decoder_t * input_DecoderCreate( vlc_object_t *, const es_format_t *, input_resource_t * ) VLC_USED;
 VLC_API void input_DecoderDelete( decoder_t * );
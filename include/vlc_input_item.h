@@ -435,6 +435,8 @@ struct input_stats_t
     /* Vout */
     int64_t i_displayed_pictures;
     int64_t i_lost_pictures;
+    int64_t i_cached_subpictures;   /**< subpicture renderings reused */
+    int64_t i_rendered_subpictures; /**< subpicture renderings done */
 
     /* Sout */
     int64_t i_sent_packets;
@@ -444,6 +446,11 @@ struct input_stats_t
     /* Aout */
     int64_t i_played_abuffers;
     int64_t i_lost_abuffers;
+
+    /* Block allocator (process-wide) */
+    int64_t i_block_cache_hits;
+    int64_t i_block_cache_misses;
+    int64_t i_block_cache_retained;
 };
 
 #endif
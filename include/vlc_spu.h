@@ -95,6 +95,13 @@ VLC_API void spu_ChangeSources( spu_t *, const char * );
  */
 VLC_API void spu_ChangeFilters( spu_t *, const char * );
 
+/**
+ * It returns how many spu_Render() calls reused the previous rendering
+ * (hits) or rendered the subpictures (misses) since the last call, and
+ * resets both counts.
+ */
+VLC_API void spu_GetResetCacheStatistic( spu_t *, unsigned *hits, unsigned *misses );
+
 /** @}*/
 
 #ifdef __cplusplus
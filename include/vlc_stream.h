@@ -57,6 +57,11 @@ struct stream_t
 
     /* */
     ssize_t     (*pf_read)(stream_t *, void *, size_t);
+    /* Optional: lends up to len bytes at the current offset without copying.
+     * Returns the number of contiguous bytes available, which may be short
+     * even before the end of the stream. The data must remain valid until the
+     * next read, peek, seek or control on the stream. */
+    ssize_t     (*pf_peek)(stream_t *, const uint8_t **, size_t);
     int         (*pf_readdir)( stream_t *, input_item_node_t * );
     int         (*pf_seek)(stream_t *, uint64_t);
     int         (*pf_control)( stream_t *, int i_query, va_list );
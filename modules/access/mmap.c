@@ -0,0 +1,357 @@
+/*****************************************************************************
+ * mmap.c: memory-mapped file input
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_access.h>
+#include <vlc_block.h>
+#include <vlc_dialog.h>
+#include <vlc_fs.h>
+
+#define FILE_MMAP_TEXT N_("Use file memory mapping")
+#define FILE_MMAP_LONGTEXT N_( \
+    "Try to use memory mapping to read regular files. " \
+    "This avoids copying the data, but VLC will crash if another program " \
+    "truncates a file while it is being played. Only enable this for " \
+    "files that are not modified during playback.")
+
+static int Open (vlc_object_t *);
+static void Close (vlc_object_t *);
+
+vlc_module_begin ()
+    set_shortname (N_("MMap"))
+    set_description (N_("Memory-mapped file input"))
+    set_category (CAT_INPUT)
+    set_subcategory (SUBCAT_INPUT_ACCESS)
+    set_capability ("access", 52)
+    add_shortcut ("file")
+    set_callbacks (Open, Close)
+
+    add_bool ("file-mmap", false, FILE_MMAP_TEXT, FILE_MMAP_LONGTEXT, true)
+vlc_module_end ()
+
+static block_t *Block (access_t *);
+static int Seek (access_t *, uint64_t);
+static int Control (access_t *, int, va_list);
+
+/* Largest mapping, used once the demuxer reads sequentially */
+#define MMAP_SIZE (1 << 22)
+/* Mapping size right after opening or seeking (e.g. index parsing) */
+#define MMAP_SIZE_RANDOM (1 << 16)
+/* End of the file which is read instead of mapped, as a file being written
+ * to is most likely rewritten near its end. This does NOT make truncation
+ * safe: the blocks may live long after they are returned (caches, decoder
+ * queues), and still raise SIGBUS if the file shrinks below them. */
+#define MMAP_TAIL_SIZE (1 << 22)
+
+struct access_sys_t
+{
+    size_t   page_size;
+    size_t   mtu;       /* Size of the next mapping */
+    uint64_t offset;    /* Current read offset */
+    uint64_t size;      /* Last known file size */
+    int      fd;
+    bool     sequential;
+    bool     fallback;  /* File shrank: read() instead of mapping */
+};
+
+static int Open (vlc_object_t *p_this)
+{
+    access_t *p_access = (access_t *)p_this;
+    access_sys_t *p_sys;
+    const char *path = p_access->psz_filepath;
+
+    if (!var_InheritBool (p_this, "file-mmap"))
+        return VLC_EGENERIC; /* disabled */
+    if (path == NULL)
+        return VLC_EGENERIC;
+
+    int fd = vlc_open (path, O_RDONLY | O_NONBLOCK);
+    if (fd == -1)
+    {
+        msg_Warn (p_access, "cannot open %s: %s", path, vlc_strerror_c(errno));
+        return VLC_EGENERIC;
+    }
+
+    /* mmap() is only safe for regular files (block devices do not report
+     * their size with fstat()). For other types, it may be some
+     * idiosyncrasic interface (e.g. packet sockets), if it works at all. */
+    struct stat st;
+
+    if (fstat (fd, &st))
+    {
+        msg_Err (p_access, "cannot stat %s: %s", path, vlc_strerror_c(errno));
+        goto error;
+    }
+
+    if (!S_ISREG (st.st_mode))
+    {
+        msg_Dbg (p_access, "skipping non regular file %s", path);
+        goto error;
+    }
+
+#if O_NONBLOCK
+    /* Force blocking mode back */
+    fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) & ~O_NONBLOCK);
+#endif
+    /* We'd rather use any available memory for reading ahead
+     * than for caching what we've already mmap'ed */
+#ifdef F_RDAHEAD
+    fcntl (fd, F_RDAHEAD, 1);
+#endif
+#ifdef F_NOCACHE
+    fcntl (fd, F_NOCACHE, 0);
+#endif
+
+    /* Autodetect mmap() support */
+    if (st.st_size > 0)
+    {
+        void *addr = mmap (NULL, 1, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            msg_Dbg (p_access, "cannot map %s: %s", path,
+                     vlc_strerror_c(errno));
+            goto error;
+        }
+        munmap (addr, 1);
+    }
+
+    p_sys = malloc (sizeof (*p_sys));
+    if (unlikely(p_sys == NULL))
+        goto error;
+
+    p_sys->page_size = sysconf (_SC_PAGE_SIZE);
+    p_sys->mtu = MMAP_SIZE_RANDOM;
+    if (p_sys->mtu < p_sys->page_size)
+        p_sys->mtu = p_sys->page_size;
+    p_sys->offset = 0;
+    p_sys->size = st.st_size;
+    p_sys->fd = fd;
+    p_sys->sequential = false;
+    p_sys->fallback = false;
+
+    access_InitFields (p_access);
+    ACCESS_SET_CALLBACKS (NULL, Block, Control, Seek);
+    p_access->p_sys = p_sys;
+
+    /* Demuxers will need the beginning of the file for probing. */
+#ifdef HAVE_POSIX_FADVISE
+    posix_fadvise (fd, 0, p_sys->mtu, POSIX_FADV_WILLNEED);
+#endif
+    return VLC_SUCCESS;
+
+error:
+    vlc_close (fd);
+    return VLC_EGENERIC;
+}
+
+static void Close (vlc_object_t *p_this)
+{
+    access_t *p_access = (access_t *)p_this;
+    access_sys_t *p_sys = p_access->p_sys;
+
+    vlc_close (p_sys->fd); /* don't care about error when only reading */
+    free (p_sys);
+}
+
+/**
+ * Reads the next block with pread() once mapping is no longer safe.
+ */
+static block_t *ReadBlock (access_t *p_access, size_t length)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    block_t *block = block_Alloc (length);
+    if (unlikely(block == NULL))
+        return NULL;
+
+    ssize_t val = pread (p_sys->fd, block->p_buffer, length, p_sys->offset);
+    if (val <= 0)
+    {
+        if (val < 0)
+            msg_Err (p_access, "read error: %s", vlc_strerror_c(errno));
+        block_Release (block);
+        p_access->info.b_eof = true;
+        return NULL;
+    }
+
+    block->i_buffer = val;
+    p_sys->offset += val;
+    return block;
+}
+
+static block_t *Block (access_t *p_access)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    /* Check if file size changed... */
+    struct stat st;
+
+    if (fstat (p_sys->fd, &st) == 0 && (uint64_t)st.st_size != p_sys->size)
+    {
+        if ((uint64_t)st.st_size < p_sys->size && !p_sys->fallback)
+        {
+            /* Accessing a page past the end of the file raises SIGBUS. */
+            msg_Warn (p_access, "file shrank, reading instead of mapping");
+            p_sys->fallback = true;
+        }
+        p_sys->size = st.st_size;
+    }
+
+    if (p_sys->offset >= p_sys->size)
+    {
+        /* We are at end of file */
+        p_access->info.b_eof = true;
+        msg_Dbg (p_access, "at end of memory mapped file");
+        return NULL;
+    }
+
+    if (p_sys->fallback || p_sys->size - p_sys->offset <= MMAP_TAIL_SIZE)
+        return ReadBlock (p_access, MMAP_SIZE_RANDOM);
+
+    const uintptr_t page_mask = p_sys->page_size - 1;
+    /* Start the mapping on a page boundary: */
+    uint64_t outer_offset = p_sys->offset & ~(uint64_t)page_mask;
+    /* Skip useless bytes at the beginning of the first page: */
+    size_t inner_offset = p_sys->offset & page_mask;
+    /* Map no more bytes than remain before the tail: */
+    const uint64_t end = p_sys->size - MMAP_TAIL_SIZE;
+    size_t length = p_sys->mtu;
+    if (outer_offset + length > end)
+        length = end - outer_offset;
+
+    assert (outer_offset <= p_sys->offset);    /* and */
+    assert (p_sys->offset < end);              /* imply */
+    assert (outer_offset < end);               /* imply */
+    assert (length > inner_offset);
+
+    /* NOTE: We use PROT_WRITE and MAP_PRIVATE so that the block can be
+     * modified down the chain, without messing up with the underlying
+     * original file. This does NOT create any instantaneous copy. */
+    void *addr = mmap (NULL, length, PROT_READ|PROT_WRITE, MAP_PRIVATE,
+                       p_sys->fd, outer_offset);
+    if (addr == MAP_FAILED)
+    {
+        msg_Err (p_access, "memory mapping failed: %s",
+                 vlc_strerror_c(errno));
+        vlc_dialog_display_error (p_access, _("File reading failed"), "%s",
+                                  _("VLC could not read the file."));
+        goto fatal;
+    }
+
+    /* Follow the demuxer access pattern: after a seek, only map a small
+     * window and let the kernel fault pages in on demand. Once the demuxer
+     * reads linearly, grow the window and prefetch the next one. */
+#ifdef HAVE_POSIX_MADVISE
+    posix_madvise (addr, length, p_sys->sequential ? POSIX_MADV_SEQUENTIAL
+                                                   : POSIX_MADV_RANDOM);
+#endif
+
+    block_t *block = block_mmap_Alloc (addr, length);
+    if (block == NULL)
+        goto fatal;
+
+    block->p_buffer += inner_offset;
+    block->i_buffer -= inner_offset;
+
+    p_sys->offset += block->i_buffer;
+
+    if (p_sys->sequential)
+    {
+        if (p_sys->mtu < MMAP_SIZE)
+            p_sys->mtu *= 2;
+#ifdef HAVE_POSIX_FADVISE
+        posix_fadvise (p_sys->fd, outer_offset + length, p_sys->mtu,
+                       POSIX_FADV_WILLNEED);
+#endif
+    }
+    p_sys->sequential = true;
+    return block;
+
+fatal:
+    p_access->info.b_eof = true;
+    return NULL;
+}
+
+static int Seek (access_t *p_access, uint64_t pos)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    if (pos != p_sys->offset)
+    {   /* Random access: shrink the window back */
+        p_sys->sequential = false;
+        p_sys->mtu = MMAP_SIZE_RANDOM;
+        if (p_sys->mtu < p_sys->page_size)
+            p_sys->mtu = p_sys->page_size;
+    }
+
+    p_sys->offset = pos;
+    p_access->info.b_eof = false;
+    return VLC_SUCCESS;
+}
+
+static int Control (access_t *p_access, int query, va_list args)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    switch (query)
+    {
+        case ACCESS_CAN_SEEK:
+        case ACCESS_CAN_FASTSEEK:
+        case ACCESS_CAN_PAUSE:
+        case ACCESS_CAN_CONTROL_PACE:
+            *va_arg(args, bool *) = true;
+            break;
+
+        case ACCESS_GET_SIZE:
+        {
+            struct stat st;
+
+            if (fstat (p_sys->fd, &st) || !S_ISREG(st.st_mode))
+                return VLC_EGENERIC;
+            *va_arg(args, uint64_t *) = st.st_size;
+            break;
+        }
+
+        case ACCESS_GET_PTS_DELAY:
+            *va_arg(args, int64_t *) = INT64_C(1000)
+                * var_InheritInteger (p_access, "file-caching");
+            break;
+
+        case ACCESS_SET_PAUSE_STATE:
+            /* Nothing to do */
+            break;
+
+        default:
+            return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
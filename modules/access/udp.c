@@ -37,6 +37,7 @@
 #endif
 
 #include <errno.h>
+#include <time.h>
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_access.h>
@@ -57,6 +58,12 @@ static void Close( vlc_object_t * );
 #define BUFFER_TEXT N_("Receive buffer")
 #define BUFFER_LONGTEXT N_("UDP receive buffer size (bytes)" )
 #define TIMEOUT_TEXT N_("UDP Source timeout (sec)")
+#define BATCH_TEXT N_("Receive batch size")
+#define BATCH_LONGTEXT N_("Maximum number of datagrams received " \
+    "with a single system call.")
+#define TIMESTAMPS_TEXT N_("Measure receive jitter")
+#define TIMESTAMPS_LONGTEXT N_("Use kernel receive timestamps to measure " \
+    "the arrival jitter of datagrams and their queueing delay.")
 
 vlc_module_begin ()
     set_shortname( N_("UDP" ) )
@@ -67,6 +74,14 @@ vlc_module_begin ()
     add_obsolete_integer( "server-port" ) /* since 2.0.0 */
     add_integer( "udp-buffer", 0x400000, BUFFER_TEXT, BUFFER_LONGTEXT, true )
     add_integer( "udp-timeout", -1, TIMEOUT_TEXT, NULL, true )
+#ifdef HAVE_RECVMMSG
+    add_integer_with_range( "udp-batch", 64, 1, 1024,
+                            BATCH_TEXT, BATCH_LONGTEXT, true )
+# ifdef SO_TIMESTAMPNS
+    add_bool( "udp-timestamps", false, TIMESTAMPS_TEXT, TIMESTAMPS_LONGTEXT,
+              true )
+# endif
+#endif
 
     set_capability( "access", 0 )
     add_shortcut( "udp", "udpstream", "udp4", "udp6" )
@@ -84,6 +99,23 @@ struct access_sys_t
     vlc_sem_t semaphore;
     vlc_thread_t thread;
     bool timeout_reached;
+#ifdef HAVE_RECVMMSG
+    unsigned batch;
+    block_t **pkts; /* pre-allocated receive blocks */
+# ifdef SO_TIMESTAMPNS
+    bool timestamps;
+    struct
+    {
+        mtime_t last; /* last arrival (kernel time) */
+        mtime_t interval; /* smoothed inter-arrival time */
+        mtime_t jitter; /* smoothed inter-arrival deviation */
+        mtime_t max_delay; /* highest socket queueing delay */
+        unsigned calls;
+        unsigned datagrams;
+        mtime_t next_report;
+    } stats;
+# endif
+#endif
 };
 
 /*****************************************************************************
@@ -198,9 +230,36 @@ static int Open( vlc_object_t *p_this )
     if( sys->timeout > 0)
         sys->timeout *= 1000;
 
+#ifdef HAVE_RECVMMSG
+    sys->batch = var_InheritInteger( p_access, "udp-batch" );
+    sys->pkts = calloc( sys->batch, sizeof( *sys->pkts ) );
+    if( unlikely( sys->pkts == NULL ) )
+    {
+        vlc_sem_destroy( &sys->semaphore );
+        block_FifoRelease( sys->fifo );
+        net_Close( sys->fd );
+        goto error;
+    }
+# ifdef SO_TIMESTAMPNS
+    sys->timestamps = var_InheritBool( p_access, "udp-timestamps" );
+    if( sys->timestamps
+     && setsockopt( sys->fd, SOL_SOCKET, SO_TIMESTAMPNS, &(int){ 1 },
+                    sizeof (int) ) )
+    {
+        msg_Warn( p_access, "cannot enable receive timestamps: %s",
+                  vlc_strerror_c(errno) );
+        sys->timestamps = false;
+    }
+    memset( &sys->stats, 0, sizeof( sys->stats ) );
+# endif
+#endif
+
     if( vlc_clone( &sys->thread, ThreadRead, p_access,
                    VLC_THREAD_PRIORITY_INPUT ) )
     {
+#ifdef HAVE_RECVMMSG
+        free( sys->pkts );
+#endif
         vlc_sem_destroy( &sys->semaphore );
         block_FifoRelease( sys->fifo );
         net_Close( sys->fd );
@@ -222,6 +281,12 @@ static void Close( vlc_object_t *p_this )
 
     vlc_cancel( sys->thread );
     vlc_join( sys->thread, NULL );
+#ifdef HAVE_RECVMMSG
+    for( unsigned i = 0; i < sys->batch; i++ )
+        if( sys->pkts[i] != NULL )
+            block_Release( sys->pkts[i] );
+    free( sys->pkts );
+#endif
     vlc_sem_destroy( &sys->semaphore );
     block_FifoRelease( sys->fifo );
     net_Close( sys->fd );
@@ -282,83 +347,280 @@ static block_t *BlockUDP( access_t *p_access )
     return block;
 }
 
+#ifdef HAVE_RECVMMSG
+# ifdef SO_TIMESTAMPNS
 /*****************************************************************************
- * ThreadRead: Pull packets from socket as soon as possible.
+ * UpdateJitter: account the kernel receive timestamp of a datagram
  *****************************************************************************/
-static void* ThreadRead( void *data )
+static void UpdateJitter( access_t *access, const struct msghdr *msg,
+                          mtime_t now )
 {
-    access_t *access = data;
     access_sys_t *sys = access->p_sys;
 
-    for(;;)
+    for( struct cmsghdr *cmsg = CMSG_FIRSTHDR( msg );
+         cmsg != NULL;
+         cmsg = CMSG_NXTHDR( (struct msghdr *)msg, cmsg ) )
     {
-        block_t *pkt = block_Alloc(sys->mtu);
-        if (unlikely(pkt == NULL))
-        {   /* OOM - dequeue and discard one packet */
-            char dummy;
-            recv(sys->fd, &dummy, 1, 0);
+        if( cmsg->cmsg_level != SOL_SOCKET
+         || cmsg->cmsg_type != SCM_TIMESTAMPNS )
             continue;
+
+        struct timespec ts;
+        memcpy( &ts, CMSG_DATA( cmsg ), sizeof( ts ) );
+
+        mtime_t arrival = INT64_C(1000000) * ts.tv_sec + ts.tv_nsec / 1000;
+
+        if( sys->stats.last != 0 )
+        {   /* Exponential smoothing with a 1/16 gain, as in RFC 3550 */
+            mtime_t delta = arrival - sys->stats.last;
+
+            sys->stats.interval += (delta - sys->stats.interval) / 16;
+            sys->stats.jitter += (llabs( delta - sys->stats.interval )
+                                  - sys->stats.jitter) / 16;
         }
+        sys->stats.last = arrival;
 
-        struct iovec iov = {
-            .iov_base = pkt->p_buffer,
-            .iov_len = sys->mtu,
-        };
-        struct msghdr msg = {
-            .msg_iov = &iov,
-            .msg_iovlen = 1,
-#ifdef __linux__
-            .msg_flags = MSG_TRUNC,
-#endif
-        };
-        ssize_t len;
+        if( now - arrival > sys->stats.max_delay )
+            sys->stats.max_delay = now - arrival;
+    }
+}
 
-        block_cleanup_push(pkt);
-        do
-        {
-            int poll_return=0;
-            struct pollfd ufd[1];
-            ufd[0].fd = sys->fd;
-            ufd[0].events = POLLIN;
+static void ReportJitter( access_t *access )
+{
+    access_sys_t *sys = access->p_sys;
+    mtime_t now = mdate();
+
+    if( now < sys->stats.next_report )
+        return;
+
+    if( sys->stats.calls > 0 )
+        msg_Dbg( access, "receive jitter: %"PRId64" us (interval %"PRId64
+                 " us), max queueing delay: %"PRId64" us, "
+                 "%.1f datagrams per call", sys->stats.jitter,
+                 sys->stats.interval, sys->stats.max_delay,
+                 (float)sys->stats.datagrams / sys->stats.calls );
+    sys->stats.max_delay = 0;
+    sys->stats.calls = sys->stats.datagrams = 0;
+    sys->stats.next_report = now + CLOCK_FREQ * 10;
+}
+# endif
+
+/*****************************************************************************
+ * Receive: receive a batch of datagrams with a single system call
+ *****************************************************************************/
+static block_t *Receive( access_t *access )
+{
+    access_sys_t *sys = access->p_sys;
+    unsigned n = sys->batch;
+    struct mmsghdr msgs[n];
+    struct iovec iovecs[n];
+# ifdef SO_TIMESTAMPNS
+    char control[sys->timestamps ? n : 1][CMSG_SPACE(sizeof (struct timespec))];
+# endif
+
+    for( unsigned i = 0; i < n; i++ )
+    {
+        block_t *pkt = sys->pkts[i];
 
-            while ((poll_return = poll(ufd, 1, sys->timeout)) < 0); /* cancellation point */
-            if (unlikely( poll_return == 0))
+        if( pkt != NULL && pkt->i_buffer < sys->mtu )
+        {   /* The MTU grew since the block was allocated */
+            block_Release( pkt );
+            pkt = NULL;
+        }
+        if( pkt == NULL )
+        {
+            pkt = block_Alloc( sys->mtu );
+            sys->pkts[i] = pkt;
+            if( unlikely(pkt == NULL) )
             {
-                msg_Err( access, "Timeout on receiving, timeout %d seconds", sys->timeout/1000 );
-                vlc_fifo_Lock(sys->fifo);
-                sys->timeout_reached=true;
-                vlc_fifo_Unlock(sys->fifo);
-                vlc_sem_post(&sys->semaphore);
-                len=0;
+                n = i;
                 break;
             }
-            len = recvmsg(sys->fd, &msg, 0);
         }
-        while (len == -1);
-        vlc_cleanup_pop();
 
-#ifdef MSG_TRUNC
-        if (msg.msg_flags & MSG_TRUNC)
+        iovecs[i].iov_base = pkt->p_buffer;
+        iovecs[i].iov_len = sys->mtu;
+        memset( &msgs[i], 0, sizeof( msgs[i] ) );
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+# ifdef SO_TIMESTAMPNS
+        if( sys->timestamps )
+        {
+            msgs[i].msg_hdr.msg_control = control[i];
+            msgs[i].msg_hdr.msg_controllen = sizeof( control[i] );
+        }
+# endif
+    }
+
+    if( unlikely(n == 0) )
+    {   /* OOM - dequeue and discard one packet */
+        char dummy;
+        recv( sys->fd, &dummy, 1, 0 );
+        return NULL;
+    }
+
+    int count = recvmmsg( sys->fd, msgs, n, MSG_DONTWAIT | MSG_TRUNC, NULL );
+    if( count <= 0 )
+        return NULL;
+
+    /* The blocks move from sys->pkts to the chain: no cancellation (in the
+     * log messages) until it is returned */
+    int canc = vlc_savecancel();
+
+# ifdef SO_TIMESTAMPNS
+    mtime_t now = 0;
+
+    if( sys->timestamps )
+    {
+        struct timespec ts;
+
+        clock_gettime( CLOCK_REALTIME, &ts );
+        now = INT64_C(1000000) * ts.tv_sec + ts.tv_nsec / 1000;
+        sys->stats.calls++;
+        sys->stats.datagrams += count;
+    }
+# endif
+
+    block_t *chain = NULL, **pp_last = &chain;
+
+    for( int i = 0; i < count; i++ )
+    {
+        block_t *pkt = sys->pkts[i];
+        size_t len = msgs[i].msg_len;
+
+        sys->pkts[i] = NULL;
+
+        if( len > sys->mtu )
         {
-            msg_Err(access, "%zd bytes packet truncated (MTU was %zu)",
-                    len, sys->mtu);
+            msg_Err( access, "%zu bytes packet truncated (MTU was %zu)",
+                     len, sys->mtu );
             pkt->i_flags |= BLOCK_FLAG_CORRUPTED;
+            pkt->i_buffer = sys->mtu;
             sys->mtu = len;
         }
         else
-#endif
             pkt->i_buffer = len;
 
+# ifdef SO_TIMESTAMPNS
+        if( sys->timestamps )
+            UpdateJitter( access, &msgs[i].msg_hdr, now );
+# endif
+        *pp_last = pkt;
+        pp_last = &pkt->p_next;
+    }
+
+    /* Move the unused blocks to the front for the next call */
+    for( unsigned i = count, j = 0; i < sys->batch; i++, j++ )
+    {
+        sys->pkts[j] = sys->pkts[i];
+        sys->pkts[i] = NULL;
+    }
+
+# ifdef SO_TIMESTAMPNS
+    if( sys->timestamps )
+        ReportJitter( access );
+# endif
+    vlc_restorecancel( canc );
+    return chain;
+}
+#else
+/*****************************************************************************
+ * Receive: receive one datagram
+ *****************************************************************************/
+static block_t *Receive( access_t *access )
+{
+    access_sys_t *sys = access->p_sys;
+    block_t *pkt = block_Alloc(sys->mtu);
+    if (unlikely(pkt == NULL))
+    {   /* OOM - dequeue and discard one packet */
+        char dummy;
+        recv(sys->fd, &dummy, 1, 0);
+        return NULL;
+    }
+
+    struct iovec iov = {
+        .iov_base = pkt->p_buffer,
+        .iov_len = sys->mtu,
+    };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+#ifdef __linux__
+        .msg_flags = MSG_TRUNC,
+#endif
+    };
+    ssize_t len;
+
+    block_cleanup_push(pkt);
+    len = recvmsg(sys->fd, &msg, 0);
+    vlc_cleanup_pop();
+
+    if (len == -1)
+    {
+        block_Release(pkt);
+        return NULL;
+    }
+
+#ifdef MSG_TRUNC
+    if (msg.msg_flags & MSG_TRUNC)
+    {
+        msg_Err(access, "%zd bytes packet truncated (MTU was %zu)",
+                len, sys->mtu);
+        pkt->i_flags |= BLOCK_FLAG_CORRUPTED;
+        sys->mtu = len;
+    }
+    else
+#endif
+        pkt->i_buffer = len;
+
+    return pkt;
+}
+#endif
+
+/*****************************************************************************
+ * ThreadRead: Pull packets from socket as soon as possible.
+ *****************************************************************************/
+static void* ThreadRead( void *data )
+{
+    access_t *access = data;
+    access_sys_t *sys = access->p_sys;
+
+    for(;;)
+    {
+        int poll_return=0;
+        struct pollfd ufd[1];
+        ufd[0].fd = sys->fd;
+        ufd[0].events = POLLIN;
+
+        while ((poll_return = poll(ufd, 1, sys->timeout)) < 0); /* cancellation point */
+        if (unlikely( poll_return == 0))
+        {
+            msg_Err( access, "Timeout on receiving, timeout %d seconds", sys->timeout/1000 );
+            vlc_fifo_Lock(sys->fifo);
+            sys->timeout_reached=true;
+            vlc_fifo_Unlock(sys->fifo);
+            vlc_sem_post(&sys->semaphore);
+            continue;
+        }
+
+        block_t *pkts = Receive(access);
+        if (pkts == NULL)
+            continue;
+
+        size_t len;
+        block_ChainProperties(pkts, NULL, &len, NULL);
+
         vlc_fifo_Lock(sys->fifo);
         /* Discard old buffers on overflow */
-        while (vlc_fifo_GetBytes(sys->fifo) + len > sys->fifo_size)
+        while (vlc_fifo_GetBytes(sys->fifo) + len > sys->fifo_size
+            && !vlc_fifo_IsEmpty(sys->fifo))
         {
             int canc = vlc_savecancel();
             block_Release(vlc_fifo_DequeueUnlocked(sys->fifo));
             vlc_restorecancel(canc);
         }
 
-        vlc_fifo_QueueUnlocked(sys->fifo, pkt);
+        vlc_fifo_QueueUnlocked(sys->fifo, pkts);
         vlc_fifo_Unlock(sys->fifo);
         vlc_sem_post(&sys->semaphore);
     }
@@ -37,6 +37,9 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
 #ifdef __OS2__
 #   include <io.h>      /* setmode() */
 #endif
@@ -73,6 +76,49 @@ static ssize_t Read( sout_access_out_t *p_access, block_t *p_buffer )
     return val;
 }
 
+#define FILE_IOV_MAX 64 /* Blocks written at once */
+
+/**
+ * Writes the head of a block chain with a single system call, then releases
+ * the blocks that were fully written, and advances *pp_block past them.
+ */
+static ssize_t WriteChain(int fd, block_t **pp_block)
+{
+    struct iovec iov[FILE_IOV_MAX];
+    int count = 0;
+
+    for (block_t *b = *pp_block; b != NULL && count < FILE_IOV_MAX; b = b->p_next)
+        if (b->i_buffer > 0)
+        {
+            iov[count].iov_base = b->p_buffer;
+            iov[count].iov_len = b->i_buffer;
+            count++;
+        }
+
+    ssize_t val = (count > 0) ? vlc_writev(fd, iov, count) : 0;
+    if (val < 0)
+        return val;
+
+    size_t done = val;
+    block_t *block = *pp_block;
+
+    while (block != NULL && done >= block->i_buffer)
+    {
+        block_t *next = block->p_next;
+
+        done -= block->i_buffer;
+        block_Release(block);
+        block = next;
+    }
+    if (block != NULL)
+    {
+        block->p_buffer += done;
+        block->i_buffer -= done;
+    }
+    *pp_block = block;
+    return val;
+}
+
 /*****************************************************************************
  * Write: standard write on a file descriptor.
  *****************************************************************************/
@@ -82,28 +128,16 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
 
     while( p_buffer )
     {
-        ssize_t val = write ((intptr_t)p_access->p_sys,
-                             p_buffer->p_buffer, p_buffer->i_buffer);
-        if (val <= 0)
+        ssize_t val = WriteChain ((intptr_t)p_access->p_sys, &p_buffer);
+        if (val < 0 || (val == 0 && p_buffer != NULL))
         {
             if (errno == EINTR)
                 continue;
-            block_ChainRelease (p_buffer);
+            if (p_buffer != NULL)
+                block_ChainRelease (p_buffer);
             msg_Err( p_access, "cannot write: %s", vlc_strerror_c(errno) );
             return -1;
         }
-
-        if ((size_t)val >= p_buffer->i_buffer)
-        {
-            block_t *p_next = p_buffer->p_next;
-            block_Release (p_buffer);
-            p_buffer = p_next;
-        }
-        else
-        {
-            p_buffer->p_buffer += val;
-            p_buffer->i_buffer -= val;
-        }
         i_write += val;
     }
     return i_write;
@@ -116,16 +150,7 @@ static ssize_t WritePipe(sout_access_out_t *access, block_t *block)
 
     while (block != NULL)
     {
-        if (block->i_buffer == 0)
-        {
-            block_t *next = block->p_next;
-            block_Release(block);
-            block = next;
-            continue;
-        }
-
-        /* TODO: vectorized I/O with writev() */
-        ssize_t val = vlc_write(fd, block->p_buffer, block->i_buffer);
+        ssize_t val = WriteChain(fd, &block);
         if (val < 0)
         {
             if (errno == EINTR)
@@ -138,10 +163,6 @@ static ssize_t WritePipe(sout_access_out_t *access, block_t *block)
         }
 
         total += val;
-
-        assert((size_t)val <= block->i_buffer);
-        block->p_buffer += val;
-        block->i_buffer -= val;
     }
 
     return total;
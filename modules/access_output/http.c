@@ -61,6 +61,16 @@ static void Close( vlc_object_t * );
 #define METACUBE_TEXT N_("Metacube")
 #define METACUBE_LONGTEXT N_("Use the Metacube protocol. Needed for streaming " \
                              "to the Cubemap reflector.")
+#define BUFFER_TEXT N_("Buffer size (kB)")
+#define BUFFER_LONGTEXT N_("Amount of the stream kept for clients that " \
+                           "fall behind.")
+#define SLOW_TEXT N_("Slow clients")
+#define SLOW_LONGTEXT N_("What to do with clients that fall behind by more " \
+                         "than the buffer size.")
+
+static const char *const slow_values[] = { "skip", "close" };
+static const char *const slow_texts[] = {
+    N_("Skip to the latest data"), N_("Disconnect") };
 
 
 vlc_module_begin ()
@@ -78,6 +88,12 @@ vlc_module_begin ()
                 MIME_TEXT, MIME_LONGTEXT, true )
     add_bool( SOUT_CFG_PREFIX "metacube", false,
               METACUBE_TEXT, METACUBE_LONGTEXT, true )
+    add_integer( SOUT_CFG_PREFIX "buffer", 5000,
+                 BUFFER_TEXT, BUFFER_LONGTEXT, true )
+        change_integer_range( 64, 1000000 )
+    add_string( SOUT_CFG_PREFIX "slow", "skip",
+                SLOW_TEXT, SLOW_LONGTEXT, true )
+        change_string_list( slow_values, slow_texts )
     set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -86,7 +102,7 @@ vlc_module_end ()
  * Exported prototypes
  *****************************************************************************/
 static const char *const ppsz_sout_options[] = {
-    "user", "pwd", "mime", "metacube", NULL
+    "user", "pwd", "mime", "metacube", "buffer", "slow", NULL
 };
 
 static ssize_t Write( sout_access_out_t *, block_t * );
@@ -275,6 +291,13 @@ static int Open( vlc_object_t *p_this )
         return VLC_EGENERIC;
     }
 
+    char *psz_slow = var_GetNonEmptyString( p_access, SOUT_CFG_PREFIX "slow" );
+    httpd_StreamSetBuffer( p_sys->p_httpd_stream,
+                           var_GetInteger( p_access, SOUT_CFG_PREFIX "buffer" ) * 1000,
+                           ( psz_slow != NULL && !strcmp( psz_slow, "close" ) )
+                               ? HTTPD_STREAM_SLOW_CLOSE : HTTPD_STREAM_SLOW_SKIP );
+    free( psz_slow );
+
     if( p_sys->b_metacube )
     {
         httpd_header headers[] = {{ "Content-encoding", "metacube" }};
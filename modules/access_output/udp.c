@@ -36,6 +36,7 @@
 #include <unistd.h>
 #include <assert.h>
 #include <errno.h>
+#include <time.h>
 
 #include <vlc_sout.h>
 #include <vlc_block.h>
@@ -46,11 +47,19 @@
 #else
 #   include <sys/socket.h>
 #endif
+#ifdef HAVE_LINUX_NET_TSTAMP_H
+#   include <linux/net_tstamp.h>
+#endif
 
 #include <vlc_network.h>
 
 #define MAX_EMPTY_BLOCKS 200
 
+#if defined(HAVE_SENDMMSG) && defined(SO_TXTIME) && defined(HAVE_LINUX_NET_TSTAMP_H) \
+ && defined(CLOCK_TAI)
+#   define HAVE_TXTIME 1
+#endif
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -71,6 +80,18 @@ static void Close( vlc_object_t * );
                           "helps reducing the scheduling load on " \
                           "heavily-loaded systems." )
 
+#define BATCH_TEXT N_("Send batch size")
+#define BATCH_LONGTEXT N_("Maximum number of packets sent with a single " \
+                          "system call. Packets due within the same " \
+                          "millisecond are sent together." )
+
+#define TXTIME_TEXT N_("Kernel pacing")
+#define TXTIME_LONGTEXT N_("Hand packets over to the kernel ahead of time, " \
+                           "with their transmission time (SO_TXTIME). This " \
+                           "requires the ETF queuing discipline on the " \
+                           "network interface (transmission times are given " \
+                           "in TAI)." )
+
 vlc_module_begin ()
     set_description( N_("UDP stream output") )
     set_shortname( "UDP" )
@@ -79,6 +100,14 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "caching", DEFAULT_PTS_DELAY / 1000, CACHING_TEXT, CACHING_LONGTEXT, true )
     add_integer( SOUT_CFG_PREFIX "group", 1, GROUP_TEXT, GROUP_LONGTEXT,
                                  true )
+#ifdef HAVE_SENDMMSG
+    add_integer_with_range( SOUT_CFG_PREFIX "batch", 16, 1, 256,
+                            BATCH_TEXT, BATCH_LONGTEXT, true )
+#endif
+#ifdef HAVE_TXTIME
+    add_bool( SOUT_CFG_PREFIX "txtime", false, TXTIME_TEXT, TXTIME_LONGTEXT,
+              true )
+#endif
 
     set_capability( "sout access", 0 )
     add_shortcut( "udp" )
@@ -92,6 +121,12 @@ vlc_module_end ()
 static const char *const ppsz_sout_options[] = {
     "caching",
     "group",
+#ifdef HAVE_SENDMMSG
+    "batch",
+#endif
+#ifdef HAVE_TXTIME
+    "txtime",
+#endif
     NULL
 };
 
@@ -122,6 +157,11 @@ struct sout_access_out_sys_t
     block_t      *p_buffer;
 
     vlc_thread_t  thread;
+#ifdef HAVE_SENDMMSG
+    unsigned      i_batch;
+    bool          b_txtime;
+    block_t      *p_pending; /* dequeued but not yet due */
+#endif
 };
 
 #define DEFAULT_PORT 1234
@@ -213,6 +253,26 @@ static int Open( vlc_object_t *p_this )
     p_sys->p_fifo = block_FifoNew();
     p_sys->p_empty_blocks = block_FifoNew();
     p_sys->p_buffer = NULL;
+#ifdef HAVE_SENDMMSG
+    p_sys->i_batch = var_GetInteger( p_access, SOUT_CFG_PREFIX "batch" );
+    p_sys->b_txtime = false;
+    p_sys->p_pending = NULL;
+# ifdef HAVE_TXTIME
+    if( var_GetBool( p_access, SOUT_CFG_PREFIX "txtime" ) )
+    {
+        struct sock_txtime cfg = {
+            .clockid = CLOCK_TAI, /* the only clock ETF accepts */
+            .flags = 0,
+        };
+
+        if( setsockopt( i_handle, SOL_SOCKET, SO_TXTIME, &cfg, sizeof (cfg) ) )
+            msg_Warn( p_access, "cannot enable kernel pacing: %s",
+                      vlc_strerror_c(errno) );
+        else
+            p_sys->b_txtime = true;
+    }
+# endif
+#endif
 
     if( vlc_clone( &p_sys->thread, ThreadWrite, p_access,
                            VLC_THREAD_PRIORITY_HIGHEST ) )
@@ -246,6 +306,9 @@ static void Close( vlc_object_t * p_this )
     block_FifoRelease( p_sys->p_empty_blocks );
 
     if( p_sys->p_buffer ) block_Release( p_sys->p_buffer );
+#ifdef HAVE_SENDMMSG
+    if( p_sys->p_pending ) block_Release( p_sys->p_pending );
+#endif
 
     net_Close( p_sys->i_handle );
     free( p_sys );
@@ -392,6 +455,250 @@ static block_t *NewUDPPacket( sout_access_out_t *p_access, mtime_t i_dts)
     return p_buffer;
 }
 
+#ifdef HAVE_SENDMMSG
+/* Packets due within that delay of the first one are sent in the same batch */
+#define PACING_BURST  (CLOCK_FREQ / 1000)
+/* With kernel pacing, packets are handed over that long ahead of time */
+#define TXTIME_LEAD   (CLOCK_FREQ / 500)
+
+typedef struct
+{
+    mtime_t  start;      /* first send in the reporting period */
+    mtime_t  first_date; /* first due date in the reporting period */
+    mtime_t  last_date;  /* last due date in the reporting period */
+    uint64_t bytes;
+    unsigned packets;
+    unsigned calls;
+    mtime_t  jitter;     /* smoothed deviation from the due date */
+    mtime_t  max_late;
+    mtime_t  next_report;
+} udp_pacing_stats_t;
+
+static void PacingAccount( udp_pacing_stats_t *st, const block_t *p_pk,
+                           mtime_t i_date, mtime_t i_sent )
+{
+    mtime_t i_late = i_sent - i_date;
+
+    if( st->packets == 0 )
+    {
+        st->start = i_sent;
+        st->first_date = i_date;
+    }
+    st->last_date = i_date;
+    st->bytes += p_pk->i_buffer;
+    st->packets++;
+
+    /* Exponential smoothing with a 1/16 gain, as in RFC 3550 */
+    st->jitter += (llabs( i_late ) - st->jitter) / 16;
+    if( i_late > st->max_late )
+        st->max_late = i_late;
+}
+
+static void PacingReport( sout_access_out_t *p_access, udp_pacing_stats_t *st,
+                          mtime_t now )
+{
+    if( now < st->next_report )
+        return;
+
+    if( st->packets > 1 && st->last_date > st->first_date
+     && now > st->start )
+        msg_Dbg( p_access, "bitrate: %"PRIu64" kb/s (target %"PRIu64" kb/s), "
+                 "jitter: %"PRId64" us, max late: %"PRId64" us, "
+                 "%.1f packets per call",
+                 st->bytes * 8 * 1000 / (now - st->start),
+                 st->bytes * 8 * 1000 / (st->last_date - st->first_date),
+                 st->jitter, st->max_late, (float)st->packets / st->calls );
+
+    mtime_t jitter = st->jitter;
+    memset( st, 0, sizeof( *st ) );
+    st->jitter = jitter;
+    st->next_report = now + 10 * CLOCK_FREQ;
+}
+
+#ifdef HAVE_TXTIME
+/* Offset from the mdate() clock (monotonic) to TAI, in nanoseconds */
+static int64_t TaiOffset( void )
+{
+    struct timespec tai, mono;
+
+    clock_gettime( CLOCK_TAI, &tai );
+    clock_gettime( CLOCK_MONOTONIC, &mono );
+    return (tai.tv_sec - mono.tv_sec) * INT64_C(1000000000)
+           + (tai.tv_nsec - mono.tv_nsec);
+}
+#endif
+
+/*****************************************************************************
+ * SendBatch: send a list of packets with as few system calls as possible
+ *****************************************************************************/
+static void SendBatch( sout_access_out_t *p_access, block_t **pp_pk,
+                       unsigned i_count, udp_pacing_stats_t *st )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    struct mmsghdr msgs[i_count];
+    struct iovec iov[i_count];
+#ifdef HAVE_TXTIME
+    char control[p_sys->b_txtime ? i_count : 1][CMSG_SPACE(sizeof (uint64_t))];
+    /* Follows clock adjustments since the previous batch */
+    const int64_t i_tai_offset = p_sys->b_txtime ? TaiOffset() : 0;
+#endif
+
+    memset( msgs, 0, sizeof( msgs ) );
+    for( unsigned i = 0; i < i_count; i++ )
+    {
+        iov[i].iov_base = pp_pk[i]->p_buffer;
+        iov[i].iov_len = pp_pk[i]->i_buffer;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+#ifdef HAVE_TXTIME
+        if( p_sys->b_txtime )
+        {
+            uint64_t txtime = (p_sys->i_caching + pp_pk[i]->i_dts)
+                            * (1000000000 / CLOCK_FREQ) + i_tai_offset;
+            struct cmsghdr *cmsg;
+
+            msgs[i].msg_hdr.msg_control = control[i];
+            msgs[i].msg_hdr.msg_controllen = sizeof( control[i] );
+            cmsg = CMSG_FIRSTHDR( &msgs[i].msg_hdr );
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_TXTIME;
+            cmsg->cmsg_len = CMSG_LEN( sizeof( txtime ) );
+            memcpy( CMSG_DATA( cmsg ), &txtime, sizeof( txtime ) );
+        }
+#endif
+    }
+
+    for( unsigned i = 0; i < i_count; )
+    {
+        int val = sendmmsg( p_sys->i_handle, msgs + i, i_count - i, 0 );
+        if( val <= 0 )
+        {   /* Skip the failed packet */
+            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+            i++;
+            continue;
+        }
+
+        mtime_t i_sent = mdate();
+
+        for( int j = 0; j < val; j++, i++ )
+            PacingAccount( st, pp_pk[i], p_sys->i_caching + pp_pk[i]->i_dts,
+                           i_sent );
+        st->calls++;
+    }
+}
+
+/*****************************************************************************
+ * ThreadWrite: Write packets on the network at the good time.
+ *****************************************************************************
+ * Each packet may be sent once its due date (DTS plus caching) is reached,
+ * plus a small burst allowance: all the packets due within PACING_BURST of
+ * the first one are gathered and sent with a single sendmmsg() call. With
+ * kernel pacing, packets are handed over TXTIME_LEAD ahead of time along
+ * with their due date, and the kernel queuing discipline does the pacing.
+ *****************************************************************************/
+static void* ThreadWrite( void *data )
+{
+    sout_access_out_t *p_access = data;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    mtime_t i_date_last = -1;
+    const unsigned i_group = var_GetInteger( p_access,
+                                             SOUT_CFG_PREFIX "group" );
+    const mtime_t i_lead = p_sys->b_txtime ? TXTIME_LEAD : 0;
+    unsigned i_dropped_packets = 0;
+    udp_pacing_stats_t stats;
+    block_t *pkts[p_sys->i_batch];
+
+    memset( &stats, 0, sizeof( stats ) );
+
+    for (;;)
+    {
+        block_t *p_pk = p_sys->p_pending;
+        mtime_t i_date;
+
+        if( p_pk != NULL )
+            p_sys->p_pending = NULL;
+        else
+            p_pk = block_FifoGet( p_sys->p_fifo );
+
+        i_date = p_sys->i_caching + p_pk->i_dts;
+        if( i_date_last > 0 )
+        {
+            if( i_date - i_date_last > 2000000 )
+            {
+                if( !i_dropped_packets )
+                    msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
+                             i_date - i_date_last );
+
+                block_FifoPut( p_sys->p_empty_blocks, p_pk );
+
+                i_date_last = i_date;
+                i_dropped_packets++;
+                continue;
+            }
+            else if( i_date - i_date_last < -1000 )
+            {
+                if( !i_dropped_packets )
+                    msg_Dbg( p_access, "mmh, packets in the past (%"PRId64")",
+                             i_date_last - i_date );
+            }
+        }
+        i_date_last = i_date;
+
+        block_cleanup_push( p_pk );
+        mwait( i_date - i_lead );
+        vlc_cleanup_pop();
+
+        /* Gather the packets that are due soon enough */
+        unsigned i_count = 0;
+        mtime_t i_deadline = mdate() + i_lead + PACING_BURST;
+
+        pkts[i_count++] = p_pk;
+
+        vlc_fifo_Lock( p_sys->p_fifo );
+        while( i_count < p_sys->i_batch )
+        {
+            block_t *p_next = vlc_fifo_DequeueUnlocked( p_sys->p_fifo );
+            if( p_next == NULL )
+                break;
+
+            mtime_t i_next_date = p_sys->i_caching + p_next->i_dts;
+
+            if( i_next_date - i_date_last > 2000000
+             || (i_next_date > i_deadline
+              && (i_count >= i_group || (p_next->i_flags & BLOCK_FLAG_CLOCK))) )
+            {   /* Not due yet: keep it for the next round */
+                p_sys->p_pending = p_next;
+                break;
+            }
+            pkts[i_count++] = p_next;
+            i_date_last = i_next_date;
+        }
+        vlc_fifo_Unlock( p_sys->p_fifo );
+
+        int canc = vlc_savecancel();
+        SendBatch( p_access, pkts, i_count, &stats );
+
+        if( i_dropped_packets )
+        {
+            msg_Dbg( p_access, "dropped %i packets", i_dropped_packets );
+            i_dropped_packets = 0;
+        }
+
+        mtime_t i_sent = mdate();
+        if ( i_sent > i_date + 20000 )
+        {
+            msg_Dbg( p_access, "packet has been sent too late (%"PRId64 ")",
+                     i_sent - i_date );
+        }
+        PacingReport( p_access, &stats, i_sent );
+
+        for( unsigned i = 0; i < i_count; i++ )
+            block_FifoPut( p_sys->p_empty_blocks, pkts[i] );
+        vlc_restorecancel( canc );
+    }
+    return NULL;
+}
+#else
 /*****************************************************************************
  * ThreadWrite: Write a packet on the network at the good time.
  *****************************************************************************/
@@ -465,3 +772,4 @@ static void* ThreadWrite( void *data )
     }
     return NULL;
 }
+#endif
@@ -1746,6 +1746,10 @@ static int updateStatistics( intf_thread_t *p_intf, input_item_t *p_item )
             p_item->p_stats->i_displayed_pictures );
     msg_rc(_("| frames lost      :    %5"PRIi64),
             p_item->p_stats->i_lost_pictures );
+    msg_rc(_("| subtitles reused :    %5"PRIi64),
+            p_item->p_stats->i_cached_subpictures );
+    msg_rc(_("| subtitles drawn  :    %5"PRIi64),
+            p_item->p_stats->i_rendered_subpictures );
     msg_rc("|");
     /* Audio*/
     msg_rc("%s", _("+-[Audio Decoding]"));
@@ -1765,6 +1769,15 @@ static int updateStatistics( intf_thread_t *p_intf, input_item_t *p_item )
     msg_rc(_("| sending bitrate  :   %6.0f kb/s"),
             (float)(p_item->p_stats->f_send_bitrate*8)*1000 );
     msg_rc("|");
+    /* Block allocator */
+    msg_rc("%s", _("+-[Block Allocator]"));
+    msg_rc(_("| recycled blocks  :    %5"PRIi64),
+           p_item->p_stats->i_block_cache_hits );
+    msg_rc(_("| allocated blocks :    %5"PRIi64),
+           p_item->p_stats->i_block_cache_misses );
+    msg_rc(_("| retained memory  : %8.0f KiB"),
+            (float)(p_item->p_stats->i_block_cache_retained)/1024 );
+    msg_rc("|");
     msg_rc( "+----[ end of statistical info ]" );
     vlc_mutex_unlock( &p_item->p_stats->lock );
     vlc_mutex_unlock( &p_item->lock );
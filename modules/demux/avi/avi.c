@@ -42,6 +42,7 @@
 #include <vlc_codecs.h>
 #include <vlc_charset.h>
 #include <vlc_memory.h>
+#include <vlc_interrupt.h>
 
 #include "libavi.h"
 #include "../rawdv.h"
@@ -140,6 +141,16 @@ static void avi_index_Init( avi_index_t * );
 static void avi_index_Clean( avi_index_t * );
 static void avi_index_Append( avi_index_t *, off_t *, avi_entry_t * );
 
+/* OpenDML standard index, read by the indexer thread */
+typedef struct
+{
+    off_t           i_offset;   /* of the ix## chunk */
+    uint32_t        i_duration; /* in stream ticks, from the super index */
+    bool            b_loaded;
+    avi_index_t     idx;
+
+} avi_subindex_t;
+
 typedef struct
 {
     bool            b_activated;
@@ -166,6 +177,13 @@ typedef struct
     unsigned int    i_idxposc;  /* numero of chunk */
     unsigned int    i_idxposb;  /* byte in the current chunk */
 
+    /* Standard indexes of the super index loaded in background, they are
+     * merged into idx when needed (i_subindex_read is the indexer's) */
+    avi_subindex_t  *p_subindex;
+    unsigned int    i_subindex_count;
+    unsigned int    i_subindex_merged;
+    unsigned int    i_subindex_read;
+
     /* For VBR audio only */
     unsigned int    i_blockno;
     unsigned int    i_blocksize;
@@ -190,6 +208,20 @@ struct demux_sys_t
     off_t   i_movi_begin;
     off_t   i_movi_lastchunk_pos;   /* XXX position of last valid chunk */
 
+    /* OpenDML indexes loading */
+    struct
+    {
+        vlc_thread_t thread;
+        bool         b_thread;
+        stream_t     *s;
+        vlc_mutex_t  lock;
+        vlc_cond_t   wait;
+        bool         b_exit;
+        bool         b_done;
+        bool         b_interrupted; /* the waiting demuxer was interrupted */
+        bool         b_late;        /* a wait timed out: don't wait anymore */
+    } indexer;
+
     /* number of streams and information */
     unsigned int i_track;
     avi_track_t  **track;
@@ -228,6 +260,15 @@ static int AVI_PacketSearch   ( demux_t * );
 static void AVI_IndexLoad    ( demux_t * );
 static void AVI_IndexCreate  ( demux_t * );
 
+static void AVI_IndexFixKeyFlag( demux_t *, unsigned int i_stream );
+static void AVI_IndexerStart   ( demux_t * );
+static void AVI_IndexerStop    ( demux_t * );
+static bool AVI_IndexMergeNext ( demux_t *, unsigned int i_stream );
+static void AVI_IndexWaitChunk ( demux_t *, unsigned int i_stream, unsigned int i_ck );
+static void AVI_IndexWaitAll   ( demux_t * );
+static bool AVI_IndexIsComplete( demux_t *, const avi_chunk_avih_t * );
+static int64_t AVI_IndexGetCount( const avi_track_t * );
+
 static void AVI_ExtractSubtitle( demux_t *, unsigned int i_stream, avi_chunk_list_t *, avi_chunk_STRING_t * );
 
 static void AVI_DvHandleAudio( demux_t *, avi_track_t *, block_t * );
@@ -296,6 +337,8 @@ static int Open( vlc_object_t * p_this )
     p_sys->track    = NULL;
     p_sys->meta     = NULL;
     TAB_INIT(p_sys->i_attachment, p_sys->attachment);
+    vlc_mutex_init( &p_sys->indexer.lock );
+    vlc_cond_init( &p_sys->indexer.wait );
 
     stream_Control( p_demux->s, STREAM_CAN_FASTSEEK, &p_sys->b_fastseekable );
     stream_Control( p_demux->s, STREAM_CAN_SEEK, &p_sys->b_seekable );
@@ -313,6 +356,8 @@ static int Open( vlc_object_t * p_this )
     if( AVI_ChunkReadRoot( p_demux->s, &p_sys->ck_root ) )
     {
         msg_Err( p_demux, "avi module discarded (invalid file)" );
+        vlc_cond_destroy( &p_sys->indexer.wait );
+        vlc_mutex_destroy( &p_sys->indexer.lock );
         free(p_sys);
         return VLC_EGENERIC;
     }
@@ -730,17 +775,7 @@ aviindex:
     p_sys->i_length = AVI_MovieGetLength( p_demux );
 
     /* Check the index completeness */
-    unsigned int i_idx_totalframes = 0;
-    for( unsigned int i = 0; i < p_sys->i_track; i++ )
-    {
-        const avi_track_t *tk = p_sys->track[i];
-        if( tk->i_cat == VIDEO_ES && tk->idx.p_entry )
-            i_idx_totalframes = __MAX(i_idx_totalframes, tk->idx.i_size);
-    }
-    if( i_idx_totalframes != p_avih->i_totalframes &&
-        p_sys->i_length < (mtime_t)p_avih->i_totalframes *
-                          (mtime_t)p_avih->i_microsecperframe /
-                          CLOCK_FREQ )
+    if( !AVI_IndexIsComplete( p_demux, p_avih ) )
     {
         msg_Warn( p_demux, "broken or missing index, 'seek' will be "
                            "approximative or will exhibit strange behavior" );
@@ -796,7 +831,7 @@ aviindex:
         {
             continue;
         }
-        if( tk->idx.i_size < 1 ||
+        if( ( tk->idx.i_size < 1 && !tk->i_subindex_count ) ||
             tk->i_scale != 1 ||
             tk->i_samplesize != 0 )
         {
@@ -808,6 +843,11 @@ aviindex:
         if( p_auds->p_wf->wFormatTag != WAVE_FORMAT_PCM &&
             tk->i_rate == p_auds->p_wf->nSamplesPerSec )
         {
+            /* the whole index of the track is needed */
+            while( AVI_IndexMergeNext( p_demux, i ) );
+            if( tk->idx.i_size < 1 )
+                continue;
+
             int64_t i_track_length =
                 tk->idx.p_entry[tk->idx.i_size-1].i_length +
                 tk->idx.p_entry[tk->idx.i_size-1].i_lengthtotal;
@@ -837,6 +877,10 @@ aviindex:
     return VLC_SUCCESS;
 
 error:
+    AVI_IndexerStop( p_demux );
+    vlc_cond_destroy( &p_sys->indexer.wait );
+    vlc_mutex_destroy( &p_sys->indexer.lock );
+
     for( unsigned i = 0; i < p_sys->i_attachment; i++)
         vlc_input_attachment_Delete(p_sys->attachment[i]);
     free(p_sys->attachment);
@@ -857,6 +901,10 @@ static void Close ( vlc_object_t * p_this )
     demux_t *    p_demux = (demux_t *)p_this;
     demux_sys_t *p_sys = p_demux->p_sys  ;
 
+    AVI_IndexerStop( p_demux );
+    vlc_cond_destroy( &p_sys->indexer.wait );
+    vlc_mutex_destroy( &p_sys->indexer.lock );
+
     for( unsigned int i = 0; i < p_sys->i_track; i++ )
     {
         if( p_sys->track[i] )
@@ -1037,6 +1085,8 @@ static int Demux_Seekable( demux_t *p_demux )
         avi_track_t *tk = p_sys->track[i_track];
 
         toread[i_track].b_ok = tk->b_activated && !tk->b_eof;
+        if( toread[i_track].b_ok )
+            AVI_IndexWaitChunk( p_demux, i_track, tk->i_idxposc );
         if( tk->i_idxposc < tk->idx.i_size )
         {
             toread[i_track].i_posf = tk->idx.p_entry[tk->i_idxposc].i_pos;
@@ -1114,6 +1164,7 @@ static int Demux_Seekable( demux_t *p_demux )
 
             /* no valid index, we will parse directly the stream
              * in case we fail we will disable all finished stream */
+            AVI_IndexWaitAll( p_demux );
             if( p_sys->b_seekable && p_sys->i_movi_lastchunk_pos >= p_sys->i_movi_begin + 12 )
             {
                 stream_Seek( p_demux->s, p_sys->i_movi_lastchunk_pos );
@@ -1285,6 +1336,7 @@ static int Demux_Seekable( demux_t *p_demux )
             toread[i_track].i_toread--;
         }
 
+        AVI_IndexWaitChunk( p_demux, i_track, tk->i_idxposc );
         if( tk->i_idxposc < tk->idx.i_size)
         {
             toread[i_track].i_posf =
@@ -1805,6 +1857,7 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
     int i_loop_count = 0;
 
     /* find first chunk of i_stream that isn't in index */
+    AVI_IndexWaitAll( p_demux );
 
     if( p_sys->i_movi_lastchunk_pos >= p_sys->i_movi_begin + 12 )
     {
@@ -1878,6 +1931,8 @@ static int AVI_StreamChunkSet( demux_t *p_demux, unsigned int i_stream,
     demux_sys_t *p_sys = p_demux->p_sys;
     avi_track_t *p_stream = p_sys->track[i_stream];
 
+    AVI_IndexWaitChunk( p_demux, i_stream, i_ck );
+
     p_stream->i_idxposc = i_ck;
     p_stream->i_idxposb = 0;
 
@@ -1906,6 +1961,11 @@ static int AVI_StreamBytesSet( demux_t    *p_demux,
     demux_sys_t *p_sys = p_demux->p_sys;
     avi_track_t *p_stream = p_sys->track[i_stream];
 
+    while( ( p_stream->idx.i_size == 0 ||
+             i_byte >= p_stream->idx.p_entry[p_stream->idx.i_size - 1].i_lengthtotal +
+                       p_stream->idx.p_entry[p_stream->idx.i_size - 1].i_length ) &&
+           AVI_IndexMergeNext( p_demux, i_stream ) );
+
     if( ( p_stream->idx.i_size > 0 )
         &&( i_byte < p_stream->idx.p_entry[p_stream->idx.i_size - 1].i_lengthtotal +
                 p_stream->idx.p_entry[p_stream->idx.i_size - 1].i_length ) )
@@ -2429,8 +2489,6 @@ static void __Parse_indx( demux_t *p_demux, avi_index_t *p_index, off_t *pi_max_
 {
     avi_entry_t index;
 
-    p_demux->p_sys->b_indexloaded = true;
-
     msg_Dbg( p_demux, "loading subindex(0x%x) %d entries", p_indx->i_indextype, p_indx->i_entriesinuse );
     if( p_indx->i_indexsubtype == 0 )
     {
@@ -2494,12 +2552,32 @@ static void AVI_IndexLoad_indx( demux_t *p_demux,
 
         if( p_indx->i_indextype == AVI_INDEX_OF_CHUNKS )
         {
+            p_sys->b_indexloaded = true;
             __Parse_indx( p_demux, &p_index[i_stream], pi_last_offset, p_indx );
         }
         else if( p_indx->i_indextype == AVI_INDEX_OF_INDEXES )
         {
             if ( !p_sys->b_seekable )
                 return;
+            p_sys->b_indexloaded = true;
+
+            /* The standard indexes are spread over the whole file, they
+             * are read by the indexer, and only the needed ones waited for */
+            if( p_sys->b_odml && p_indx->i_entriesinuse > 0 &&
+                ( p_stream->p_subindex = calloc( p_indx->i_entriesinuse,
+                                                 sizeof(avi_subindex_t) ) ) )
+            {
+                for( unsigned i = 0; i < p_indx->i_entriesinuse; i++ )
+                {
+                    avi_subindex_t *p_sub = &p_stream->p_subindex[i];
+                    p_sub->i_offset   = p_indx->idx.super[i].i_offset;
+                    p_sub->i_duration = p_indx->idx.super[i].i_duration;
+                    avi_index_Init( &p_sub->idx );
+                }
+                p_stream->i_subindex_count = p_indx->i_entriesinuse;
+                continue;
+            }
+
             avi_chunk_t    ck_sub;
             for( unsigned i = 0; i < p_indx->i_entriesinuse; i++ )
             {
@@ -2525,6 +2603,8 @@ static void AVI_IndexLoad( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    AVI_IndexerStop( p_demux );
+
     /* Load indexes */
     assert( p_sys->i_track <= 100 );
     avi_index_t p_idx_indx[p_sys->i_track];
@@ -2561,23 +2641,387 @@ static void AVI_IndexLoad( demux_t *p_demux )
 
     for( unsigned i = 0; i < p_sys->i_track; i++ )
     {
-        avi_index_t *p_index = &p_sys->track[i]->idx;
+        /* done once all the standard indexes are merged */
+        if( p_sys->track[i]->i_subindex_count > 0 )
+            continue;
+
+        AVI_IndexFixKeyFlag( p_demux, i );
+    }
+
+    AVI_IndexerStart( p_demux );
+}
+
+static void AVI_IndexFixKeyFlag( demux_t *p_demux, unsigned int i_stream )
+{
+    avi_index_t *p_index = &p_demux->p_sys->track[i_stream]->idx;
+
+    /* Fix key flag */
+    bool b_key = false;
+    for( unsigned j = 0; !b_key && j < p_index->i_size; j++ )
+        b_key = p_index->p_entry[j].i_flags & AVIIF_KEYFRAME;
+    if( !b_key )
+    {
+        msg_Err( p_demux, "no key frame set for track %u", i_stream );
+        for( unsigned j = 0; j < p_index->i_size; j++ )
+            p_index->p_entry[j].i_flags |= AVIIF_KEYFRAME;
+    }
+
+    /* */
+    msg_Dbg( p_demux, "stream[%d] created %d index entries",
+             i_stream, p_index->i_size );
+}
+
+/*****************************************************************************
+ * Indexer: reads the OpenDML standard indexes in the background
+ *****************************************************************************
+ * The super index of each stream only gives the position of its standard
+ * indexes, which are spread over the whole file. Reading all of them before
+ * starting is slow on big files (and on network shares in particular), so
+ * they are read in file order by a thread using its own stream, and merged
+ * into the index of their track by the demuxer when it needs their entries.
+ *****************************************************************************/
+/* longest time the demuxer waits for the indexer to read an index */
+#define AVI_INDEXER_WAIT (2 * CLOCK_FREQ)
+
+/* Reads the standard index at p_sub->i_offset into idx */
+static int AVI_SubIndexRead( demux_t *p_demux, stream_t *s,
+                             const avi_subindex_t *p_sub, avi_index_t *idx )
+{
+    avi_chunk_t ck_sub;
+    off_t       i_last_pos = 0;
 
-        /* Fix key flag */
-        bool b_key = false;
-        for( unsigned j = 0; !b_key && j < p_index->i_size; j++ )
-            b_key = p_index->p_entry[j].i_flags & AVIIF_KEYFRAME;
-        if( !b_key )
+    avi_index_Init( idx );
+    if( stream_Seek( s, p_sub->i_offset ) ||
+        AVI_ChunkRead( s, &ck_sub, NULL ) )
+    {
+        msg_Warn( p_demux, "cannot read standard index at %"PRId64,
+                  (int64_t)p_sub->i_offset );
+        return VLC_EGENERIC;
+    }
+    if( ck_sub.indx.i_indextype == AVI_INDEX_OF_CHUNKS )
+        __Parse_indx( p_demux, idx, &i_last_pos, &ck_sub.indx );
+    AVI_ChunkFree( s, &ck_sub );
+
+    /* it is kept until merged, don't waste the growing margin */
+    if( idx->i_size > 0 && idx->i_size < idx->i_max )
+    {
+        avi_entry_t *p_entry = realloc( idx->p_entry,
+                                        idx->i_size * sizeof(*p_entry) );
+        if( p_entry )
         {
-            msg_Err( p_demux, "no key frame set for track %u", i );
-            for( unsigned j = 0; j < p_index->i_size; j++ )
-                p_index->p_entry[j].i_flags |= AVIIF_KEYFRAME;
+            idx->p_entry = p_entry;
+            idx->i_max   = idx->i_size;
         }
+    }
+    return VLC_SUCCESS;
+}
 
-        /* */
-        msg_Dbg( p_demux, "stream[%d] created %d index entries",
-                 i, p_index->i_size );
+/* Hands a read standard index over, unless the other side (indexer or
+ * demuxer) already did. Must be called with the indexer lock held. */
+static void AVI_SubIndexStore( demux_sys_t *p_sys, avi_subindex_t *p_sub,
+                               avi_index_t *idx )
+{
+    if( p_sub->b_loaded )
+    {
+        avi_index_Clean( idx );
+        return;
     }
+    p_sub->idx = *idx;
+    p_sub->b_loaded = true;
+    vlc_cond_broadcast( &p_sys->indexer.wait );
+}
+
+static void AVI_IndexerRead( demux_t *p_demux, stream_t *s )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for( ;; )
+    {
+        /* next standard index in the file, whatever its stream */
+        avi_track_t    *tk = NULL;
+        avi_subindex_t *p_sub = NULL;
+        for( unsigned i = 0; i < p_sys->i_track; i++ )
+        {
+            avi_track_t *tk_i = p_sys->track[i];
+            if( tk_i->i_subindex_read < tk_i->i_subindex_count &&
+                ( !p_sub || tk_i->p_subindex[tk_i->i_subindex_read].i_offset < p_sub->i_offset ) )
+            {
+                tk = tk_i;
+                p_sub = &tk_i->p_subindex[tk_i->i_subindex_read];
+            }
+        }
+        if( !p_sub )
+            break;
+
+        vlc_mutex_lock( &p_sys->indexer.lock );
+        bool b_exit = p_sys->indexer.b_exit;
+        vlc_mutex_unlock( &p_sys->indexer.lock );
+        if( b_exit )
+            break;
+
+        avi_index_t idx;
+        if( AVI_SubIndexRead( p_demux, s, p_sub, &idx ) )
+        {
+            /* skip the remaining ones of the stream */
+            tk->i_subindex_read = tk->i_subindex_count;
+            continue;
+        }
+
+        tk->i_subindex_read++;
+
+        vlc_mutex_lock( &p_sys->indexer.lock );
+        AVI_SubIndexStore( p_sys, p_sub, &idx );
+        vlc_mutex_unlock( &p_sys->indexer.lock );
+    }
+
+    vlc_mutex_lock( &p_sys->indexer.lock );
+    p_sys->indexer.b_done = true;
+    vlc_cond_broadcast( &p_sys->indexer.wait );
+    vlc_mutex_unlock( &p_sys->indexer.lock );
+}
+
+static void *AVI_IndexerRun( void *data )
+{
+    demux_t *p_demux = data;
+
+    AVI_IndexerRead( p_demux, p_demux->p_sys->indexer.s );
+    return NULL;
+}
+
+static void AVI_IndexerStart( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    bool b_pending = false;
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+        b_pending |= p_sys->track[i]->i_subindex_count > 0;
+    if( !b_pending )
+        return;
+
+    p_sys->indexer.b_exit = false;
+    p_sys->indexer.b_done = false;
+    p_sys->indexer.b_late = false;
+
+    /* read with our own stream, not to move the one of the demuxer */
+    char *psz_url;
+    if( p_demux->psz_access && p_demux->psz_location &&
+        asprintf( &psz_url, "%s://%s", p_demux->psz_access,
+                  p_demux->psz_location ) != -1 )
+    {
+        p_sys->indexer.s = stream_UrlNew( p_demux, psz_url );
+        free( psz_url );
+    }
+
+    if( p_sys->indexer.s &&
+        !vlc_clone( &p_sys->indexer.thread, AVI_IndexerRun, p_demux,
+                    VLC_THREAD_PRIORITY_LOW ) )
+    {
+        p_sys->indexer.b_thread = true;
+        msg_Dbg( p_demux, "loading OpenDML indexes in background" );
+        return;
+    }
+
+    if( p_sys->indexer.s )
+    {
+        stream_Delete( p_sys->indexer.s );
+        p_sys->indexer.s = NULL;
+    }
+
+    /* load them all now then */
+    msg_Warn( p_demux, "cannot load OpenDML indexes in background" );
+    AVI_IndexerRead( p_demux, p_demux->s );
+    AVI_IndexWaitAll( p_demux );
+}
+
+static void AVI_IndexerStop( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( p_sys->indexer.b_thread )
+    {
+        vlc_mutex_lock( &p_sys->indexer.lock );
+        p_sys->indexer.b_exit = true;
+        vlc_mutex_unlock( &p_sys->indexer.lock );
+        vlc_join( p_sys->indexer.thread, NULL );
+        stream_Delete( p_sys->indexer.s );
+        p_sys->indexer.s = NULL;
+        p_sys->indexer.b_thread = false;
+    }
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        avi_track_t *tk = p_sys->track[i];
+
+        for( unsigned j = 0; j < tk->i_subindex_count; j++ )
+            avi_index_Clean( &tk->p_subindex[j].idx );
+        free( tk->p_subindex );
+        tk->p_subindex = NULL;
+        tk->i_subindex_count  = 0;
+        tk->i_subindex_merged = 0;
+        tk->i_subindex_read   = 0;
+    }
+}
+
+/* The durations of the super index are only an estimate (some muxers don't
+ * even set them), the standard indexes are waited for if they don't make
+ * the index complete */
+static bool AVI_IndexIsComplete( demux_t *p_demux,
+                                 const avi_chunk_avih_t *p_avih )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for( ;; )
+    {
+        unsigned int i_idx_totalframes = 0;
+        bool b_pending = false;
+        for( unsigned int i = 0; i < p_sys->i_track; i++ )
+        {
+            const avi_track_t *tk = p_sys->track[i];
+            if( tk->i_cat == VIDEO_ES && ( tk->idx.p_entry || tk->i_subindex_count ) )
+                i_idx_totalframes = __MAX(i_idx_totalframes, AVI_IndexGetCount( tk ));
+            b_pending |= tk->i_subindex_merged < tk->i_subindex_count;
+        }
+        if( i_idx_totalframes == p_avih->i_totalframes ||
+            p_sys->i_length >= (mtime_t)p_avih->i_totalframes *
+                               (mtime_t)p_avih->i_microsecperframe /
+                               CLOCK_FREQ )
+            return true;
+        if( !b_pending || vlc_killed() )
+            return false;
+
+        AVI_IndexWaitAll( p_demux );
+    }
+}
+
+static void AVI_IndexerInterrupt( void *data )
+{
+    demux_sys_t *p_sys = data;
+
+    vlc_mutex_lock( &p_sys->indexer.lock );
+    p_sys->indexer.b_interrupted = true;
+    vlc_cond_broadcast( &p_sys->indexer.wait );
+    vlc_mutex_unlock( &p_sys->indexer.lock );
+}
+
+/* Merges the next standard index of the stream into its index, waiting
+ * for the indexer to read it for a while (until a wait times out once),
+ * then reading it with the demuxer stream. Returns false if there is none
+ * left, or if the input is killed */
+static bool AVI_IndexMergeNext( demux_t *p_demux, unsigned int i_stream )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    avi_track_t *tk = p_sys->track[i_stream];
+
+    if( tk->i_subindex_merged >= tk->i_subindex_count )
+        return false;
+
+    avi_subindex_t *p_sub = &tk->p_subindex[tk->i_subindex_merged];
+    const mtime_t i_deadline = mdate() + AVI_INDEXER_WAIT;
+
+    vlc_mutex_lock( &p_sys->indexer.lock );
+    p_sys->indexer.b_interrupted = false;
+    vlc_mutex_unlock( &p_sys->indexer.lock );
+
+    vlc_interrupt_register( AVI_IndexerInterrupt, p_sys );
+    vlc_mutex_lock( &p_sys->indexer.lock );
+    while( !p_sub->b_loaded && !p_sys->indexer.b_done &&
+           !p_sys->indexer.b_interrupted && !p_sys->indexer.b_late )
+    {
+        /* once the indexer is that late, the demuxer reads the remaining
+         * needed indexes itself rather than waiting for each of them */
+        if( vlc_cond_timedwait( &p_sys->indexer.wait, &p_sys->indexer.lock,
+                                i_deadline ) )
+            p_sys->indexer.b_late = true;
+    }
+    bool b_loaded = p_sub->b_loaded;
+    bool b_late = !b_loaded && !p_sys->indexer.b_done;
+    vlc_mutex_unlock( &p_sys->indexer.lock );
+    vlc_interrupt_unregister();
+
+    if( b_late )
+    {
+        if( vlc_killed() )
+            return false;
+
+        /* the indexer is late: read that one ourselves */
+        msg_Dbg( p_demux, "reading standard index at %"PRId64,
+                 (int64_t)p_sub->i_offset );
+        const uint64_t i_pos = stream_Tell( p_demux->s );
+        avi_index_t idx;
+        if( !AVI_SubIndexRead( p_demux, p_demux->s, p_sub, &idx ) )
+        {
+            vlc_mutex_lock( &p_sys->indexer.lock );
+            AVI_SubIndexStore( p_sys, p_sub, &idx );
+            vlc_mutex_unlock( &p_sys->indexer.lock );
+        }
+        if( stream_Seek( p_demux->s, i_pos ) )
+            msg_Err( p_demux, "cannot seek back to %"PRIu64, i_pos );
+
+        vlc_mutex_lock( &p_sys->indexer.lock );
+        b_loaded = p_sub->b_loaded;
+        vlc_mutex_unlock( &p_sys->indexer.lock );
+    }
+
+    if( b_loaded )
+    {
+        for( unsigned i = 0; i < p_sub->idx.i_size; i++ )
+            avi_index_Append( &tk->idx, &p_sys->i_movi_lastchunk_pos,
+                              &p_sub->idx.p_entry[i] );
+        avi_index_Clean( &p_sub->idx );
+        avi_index_Init( &p_sub->idx );
+        tk->i_subindex_merged++;
+    }
+    else
+    {
+        /* the remaining ones could not be read */
+        tk->i_subindex_merged = tk->i_subindex_count;
+    }
+
+    if( tk->i_subindex_merged >= tk->i_subindex_count )
+    {
+        AVI_IndexFixKeyFlag( p_demux, i_stream );
+        p_sys->i_length = AVI_MovieGetLength( p_demux );
+    }
+    return b_loaded;
+}
+
+/* be sure that i_ck is in the index if the standard indexes have it */
+static void AVI_IndexWaitChunk( demux_t *p_demux, unsigned int i_stream,
+                                unsigned int i_ck )
+{
+    avi_track_t *tk = p_demux->p_sys->track[i_stream];
+
+    while( i_ck >= tk->idx.i_size && AVI_IndexMergeNext( p_demux, i_stream ) );
+}
+
+/* needed before parsing the movi, not to index chunks twice */
+static void AVI_IndexWaitAll( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+        while( AVI_IndexMergeNext( p_demux, i ) );
+}
+
+/* Number of chunks, or of bytes for the streams with a sample size, of the
+ * index, including the ones of the standard indexes not merged yet (from
+ * the durations of the super index) */
+static int64_t AVI_IndexGetCount( const avi_track_t *tk )
+{
+    const avi_index_t *p_index = &tk->idx;
+    int64_t i_count;
+
+    if( tk->i_samplesize )
+        i_count = p_index->i_size > 0 ?
+                  p_index->p_entry[p_index->i_size-1].i_lengthtotal +
+                  p_index->p_entry[p_index->i_size-1].i_length : 0;
+    else
+        i_count = p_index->i_size;
+
+    for( unsigned i = tk->i_subindex_merged; i < tk->i_subindex_count; i++ )
+        i_count += (int64_t)tk->p_subindex[i].i_duration *
+                   ( tk->i_samplesize ? tk->i_samplesize : 1 );
+    return i_count;
 }
 
 static void AVI_IndexCreate( demux_t *p_demux )
@@ -2593,6 +3037,8 @@ static void AVI_IndexCreate( demux_t *p_demux )
     mtime_t i_dialog_update;
     vlc_dialog_id *p_dialog_id = NULL;
 
+    AVI_IndexerStop( p_demux );
+
     p_riff = AVI_ChunkFind( &p_sys->ck_root, AVIFOURCC_RIFF, 0);
     p_movi = AVI_ChunkFind( p_riff, AVIFOURCC_movi, 0);
 
@@ -2989,21 +3435,13 @@ static mtime_t  AVI_MovieGetLength( demux_t *p_demux )
         mtime_t i_length;
 
         /* fix length for each stream */
-        if( tk->idx.i_size < 1 || !tk->idx.p_entry )
+        if( ( tk->idx.i_size < 1 || !tk->idx.p_entry ) &&
+            tk->i_subindex_merged >= tk->i_subindex_count )
         {
             continue;
         }
 
-        if( tk->i_samplesize )
-        {
-            i_length = AVI_GetDPTS( tk,
-                                    tk->idx.p_entry[tk->idx.i_size-1].i_lengthtotal +
-                                        tk->idx.p_entry[tk->idx.i_size-1].i_length );
-        }
-        else
-        {
-            i_length = AVI_GetDPTS( tk, tk->idx.i_size );
-        }
+        i_length = AVI_GetDPTS( tk, AVI_IndexGetCount( tk ) );
         i_length /= CLOCK_FREQ;    /* in seconds */
 
         msg_Dbg( p_demux,
@@ -0,0 +1,155 @@
+/*****************************************************************************
+ * index_file.c : index files stored next to the media files
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_fs.h>
+
+#include "index_file.h"
+
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define INDEX_FILE_HEADER 32
+
+int64_t index_file_GetMTime( const char *psz_file )
+{
+    struct stat st;
+
+    if( vlc_stat( psz_file, &st ) )
+        return -1;
+    return st.st_mtime;
+}
+
+#undef index_file_Load
+int index_file_Load( vlc_object_t *p_obj, const index_file_format_t *p_fmt,
+                     const char *psz_path, uint64_t i_size, int64_t i_mtime,
+                     uint8_t *p_header, uint8_t **pp_entries,
+                     size_t *pi_entries )
+{
+    /* A file rewritten in place with the same size must not reuse the
+     * index, so an unknown modification time never matches */
+    if( i_mtime == -1 )
+        return VLC_EGENERIC;
+
+    FILE *p_file = vlc_fopen( psz_path, "rb" );
+    if( p_file == NULL )
+        return VLC_EGENERIC;
+
+    uint8_t header[INDEX_FILE_HEADER];
+    if( fread( header, 1, sizeof(header), p_file ) != sizeof(header) ||
+        memcmp( header, p_fmt->psz_magic, 8 ) ||
+        GetDWBE( &header[8] ) != p_fmt->i_version ||
+        GetQWBE( &header[12] ) != i_size ||
+        (int64_t)GetQWBE( &header[20] ) != i_mtime )
+    {
+        msg_Dbg( p_obj, "ignoring stale index %s", psz_path );
+        fclose( p_file );
+        return VLC_EGENERIC;
+    }
+
+    /* Do not trust the entry count of a corrupted file */
+    const size_t i_entries = GetDWBE( &header[28] );
+    struct stat st;
+    if( fstat( fileno( p_file ), &st ) ||
+        (uint64_t)st.st_size != INDEX_FILE_HEADER + p_fmt->i_header +
+                                (uint64_t)i_entries * p_fmt->i_entry ||
+        fread( p_header, 1, p_fmt->i_header, p_file ) != p_fmt->i_header )
+    {
+        msg_Warn( p_obj, "invalid index %s", psz_path );
+        fclose( p_file );
+        return VLC_EGENERIC;
+    }
+
+    uint8_t *p_entries = NULL;
+    const size_t i_data = i_entries * p_fmt->i_entry;
+    if( i_data > 0 )
+    {
+        p_entries = malloc( i_data );
+        if( unlikely(p_entries == NULL) )
+        {
+            fclose( p_file );
+            return VLC_ENOMEM;
+        }
+        if( fread( p_entries, 1, i_data, p_file ) != i_data )
+        {
+            msg_Warn( p_obj, "truncated index %s", psz_path );
+            free( p_entries );
+            fclose( p_file );
+            return VLC_EGENERIC;
+        }
+    }
+    fclose( p_file );
+
+    *pp_entries = p_entries;
+    *pi_entries = i_entries;
+    return VLC_SUCCESS;
+}
+
+#undef index_file_Save
+int index_file_Save( vlc_object_t *p_obj, const index_file_format_t *p_fmt,
+                     const char *psz_path, uint64_t i_size, int64_t i_mtime,
+                     const uint8_t *p_header, const uint8_t *p_entries,
+                     size_t i_entries )
+{
+    if( i_mtime == -1 || i_entries > UINT32_MAX )
+        return VLC_EGENERIC;
+
+    char *psz_tmp;
+    if( asprintf( &psz_tmp, "%s.part", psz_path ) == -1 )
+        return VLC_ENOMEM;
+
+    FILE *p_file = vlc_fopen( psz_tmp, "wb" );
+    if( p_file == NULL )
+    {
+        msg_Dbg( p_obj, "cannot write index %s: %s", psz_tmp,
+                 vlc_strerror_c(errno) );
+        free( psz_tmp );
+        return VLC_EGENERIC;
+    }
+
+    uint8_t header[INDEX_FILE_HEADER];
+    memcpy( header, p_fmt->psz_magic, 8 );
+    SetDWBE( &header[8], p_fmt->i_version );
+    SetQWBE( &header[12], i_size );
+    SetQWBE( &header[20], i_mtime );
+    SetDWBE( &header[28], i_entries );
+
+    const size_t i_data = i_entries * p_fmt->i_entry;
+    bool b_error = fwrite( header, 1, sizeof(header), p_file ) != sizeof(header) ||
+                   fwrite( p_header, 1, p_fmt->i_header, p_file ) != p_fmt->i_header ||
+                   ( i_data > 0 &&
+                     fwrite( p_entries, 1, i_data, p_file ) != i_data );
+
+    if( fclose( p_file ) || b_error || vlc_rename( psz_tmp, psz_path ) )
+    {
+        msg_Warn( p_obj, "cannot write index %s", psz_path );
+        vlc_unlink( psz_tmp );
+        free( psz_tmp );
+        return VLC_EGENERIC;
+    }
+
+    msg_Dbg( p_obj, "saved index %s: %zu entries", psz_path, i_entries );
+    free( psz_tmp );
+    return VLC_SUCCESS;
+}
@@ -0,0 +1,62 @@
+/*****************************************************************************
+ * index_file.h : index files stored next to the media files
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_DEMUX_INDEX_FILE_H_
+#define VLC_DEMUX_INDEX_FILE_H_
+
+#include <vlc_common.h>
+
+/*
+ * File layout, all values big endian:
+ *  header: magic (8), version (4), media file size (8), media file
+ *          modification time (8), entry count (4), then the header
+ *          specific to the index type
+ *  entries: fixed size, specific to the index type
+ * An index file is only loaded if the media file did not change since it
+ * was written, and if its size matches its entry count.
+ */
+typedef struct
+{
+    const char *psz_magic;  /* 8 characters */
+    uint32_t    i_version;
+    size_t      i_header;   /* size of the specific header */
+    size_t      i_entry;    /* size of an entry */
+} index_file_format_t;
+
+/* modification time of the media file, -1 if unknown */
+int64_t index_file_GetMTime( const char *psz_file );
+
+/* reads the index file of a media file of that size and modification time,
+ * into the specific header and the entries (to be freed) */
+int index_file_Load( vlc_object_t *, const index_file_format_t *,
+                     const char *psz_path, uint64_t i_size, int64_t i_mtime,
+                     uint8_t *p_header, uint8_t **pp_entries,
+                     size_t *pi_entries );
+#define index_file_Load(o, f, p, s, m, h, e, n) \
+        index_file_Load(VLC_OBJECT(o), f, p, s, m, h, e, n)
+
+/* writes the index file through a temporary file */
+int index_file_Save( vlc_object_t *, const index_file_format_t *,
+                     const char *psz_path, uint64_t i_size, int64_t i_mtime,
+                     const uint8_t *p_header, const uint8_t *p_entries,
+                     size_t i_entries );
+#define index_file_Save(o, f, p, s, m, h, e, n) \
+        index_file_Save(VLC_OBJECT(o), f, p, s, m, h, e, n)
+
+#endif
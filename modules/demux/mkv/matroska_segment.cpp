@@ -60,11 +60,14 @@ matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estr
     ,ep(NULL)
     ,b_preloaded(false)
     ,b_ref_external_segments(false)
+    ,p_indexer(NULL)
 {
 }
 
 matroska_segment_c::~matroska_segment_c()
 {
+    delete p_indexer;
+
     for( tracks_map_t::iterator it = tracks.begin(); it != tracks.end(); ++it)
     {
         tracks_map_t::mapped_type& track = it->second;
@@ -690,6 +693,49 @@ bool matroska_segment_c::Preload( )
     return true;
 }
 
+/* Without Cues, find the clusters and keyframes in the background, with our
+ * own stream, so that seeking doesn't have to scan the file */
+void matroska_segment_c::StartClusterIndexer( const char *psz_url )
+{
+    bool b_seekable;
+
+    if( b_cues || cluster == NULL || p_indexer != NULL )
+        return;
+
+    stream_Control( sys.demuxer.s, STREAM_CAN_FASTSEEK, &b_seekable );
+    if( !b_seekable )
+        return;
+
+    SegmentIndexer::tracks_t indexer_tracks;
+
+    for( tracks_map_t::const_iterator it = tracks.begin(); it != tracks.end(); ++it )
+    {
+        SegmentIndexer::Track track = {
+            /* b_all_keyframes */ it->second.fmt.i_cat == VIDEO_ES,
+            /* b_theora        */ it->second.fmt.i_codec == VLC_CODEC_THEORA
+        };
+        indexer_tracks[ it->first ] = track;
+    }
+
+    p_indexer = new (std::nothrow) SegmentIndexer( sys.demuxer, indexer_tracks, i_timescale );
+    if( p_indexer == NULL )
+        return;
+
+    SegmentIndexer::fptr_t i_end = segment->IsFiniteSize() ? segment->GetEndPosition()
+                                 : std::numeric_limits<SegmentIndexer::fptr_t>::max();
+
+    if( !p_indexer->start( psz_url, cluster->GetElementPosition(), i_end ) )
+    {
+        msg_Warn( &sys.demuxer, "cannot index the clusters in background" );
+        delete p_indexer;
+        p_indexer = NULL;
+        return;
+    }
+
+    msg_Dbg( &sys.demuxer, "no Cues, indexing clusters from %" PRIu64 " in background",
+             cluster->GetElementPosition() );
+}
+
 /* Here we try to load elements that were found in Seek Heads, but not yet parsed */
 bool matroska_segment_c::LoadSeekHeadItem( const EbmlCallbacks & ClassInfos, int64_t i_element_position )
 {
@@ -817,6 +863,13 @@ void matroska_segment_c::Seek( mtime_t i_absolute_mk_date, mtime_t i_mk_time_off
 
     // find appropriate seekpoints //
 
+    if( p_indexer )
+    {
+        if( !p_indexer->wait_for( i_mk_date ) )
+            msg_Dbg( &sys.demuxer, "clusters not indexed up to %" PRId64 " yet", i_mk_date );
+        p_indexer->feed( _seeker );
+    }
+
     try {
         seekpoints = _seeker.get_seekpoints( *this, i_mk_date, priority_tracks );
     }
@@ -27,6 +27,7 @@
 
 #include "mkv.hpp"
 #include "matroska_segment_seeker.hpp"
+#include "matroska_segment_indexer.hpp"
 #include <vector>
 #include <string>
 
@@ -137,6 +138,7 @@ public:
     bool Preload();
     bool PreloadFamily( const matroska_segment_c & segment );
     bool PreloadClusters( uint64 i_cluster_position );
+    void StartClusterIndexer( const char *psz_url );
     void InformationCreate();
 
     void FastSeek( mtime_t i_mk_date, mtime_t i_mk_time_offset );
@@ -172,6 +174,7 @@ private:
     void EnsureDuration();
 
     SegmentSeeker _seeker;
+    SegmentIndexer *p_indexer;
 
     friend SegmentSeeker;
 };
@@ -0,0 +1,445 @@
+/*****************************************************************************
+ * matroska_segment_indexer.cpp : matroska demuxer
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "matroska_segment_indexer.hpp"
+
+#include <vlc_stream.h>
+#include <vlc_interrupt.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+    // raw EBML ids, including their length marker
+    enum {
+        ID_EBML             = 0x1A45DFA3,
+        ID_SEGMENT          = 0x18538067,
+        ID_SEEKHEAD         = 0x114D9B74,
+        ID_INFO             = 0x1549A966,
+        ID_TRACKS           = 0x1654AE6B,
+        ID_CUES             = 0x1C53BB6B,
+        ID_CHAPTERS         = 0x1043A770,
+        ID_ATTACHMENTS      = 0x1941A469,
+        ID_TAGS             = 0x1254C367,
+        ID_CLUSTER          = 0x1F43B675,
+        ID_CLUSTER_TIMECODE = 0xE7,
+        ID_SIMPLEBLOCK      = 0xA3,
+        ID_BLOCKGROUP       = 0xA0,
+        ID_BLOCK            = 0xA1,
+        ID_REFERENCEBLOCK   = 0xFB,
+    };
+
+    // elements ending an unknown-size cluster
+    bool is_level1( uint32_t id )
+    {
+        switch( id )
+        {
+            case ID_EBML: case ID_SEGMENT: case ID_SEEKHEAD: case ID_INFO:
+            case ID_TRACKS: case ID_CUES: case ID_CHAPTERS: case ID_ATTACHMENTS:
+            case ID_TAGS: case ID_CLUSTER:
+                return true;
+        }
+        return false;
+    }
+
+    // longest time a seek waits for the indexer
+    const mtime_t WAIT_MAX = 2 * CLOCK_FREQ;
+
+    // number of bytes of an EBML variable size integer, 0 if invalid
+    unsigned vint_length( uint8_t first_byte, unsigned max_length )
+    {
+        unsigned length = 1;
+        for( uint8_t mask = 0x80; mask && !( first_byte & mask ); mask >>= 1 )
+            ++length;
+        return length <= max_length ? length : 0;
+    }
+}
+
+SegmentIndexer::SegmentIndexer( demux_t& demuxer, tracks_t const& tracks, uint64_t timescale )
+    : _demuxer( demuxer )
+    , _tracks( tracks )
+    , _timescale( timescale )
+    , _s( NULL )
+    , _start_fpos( 0 )
+    , _end_fpos( 0 )
+    , _is_running( false )
+    , _b_abort( false )
+    , _b_done( true )
+    , _b_interrupted( false )
+    , _indexed_fpos( 0 )
+    , _indexed_pts( std::numeric_limits<mtime_t>::min() )
+{
+    vlc_mutex_init( &_lock );
+    vlc_cond_init( &_wait );
+}
+
+SegmentIndexer::~SegmentIndexer()
+{
+    if( _is_running )
+    {
+        vlc_mutex_lock( &_lock );
+        _b_abort = true;
+        vlc_mutex_unlock( &_lock );
+
+        vlc_join( _thread, NULL );
+    }
+
+    if( _s )
+        stream_Delete( _s );
+
+    vlc_cond_destroy( &_wait );
+    vlc_mutex_destroy( &_lock );
+}
+
+bool
+SegmentIndexer::start( char const* psz_url, fptr_t start_fpos, fptr_t end_fpos )
+{
+    _s = stream_UrlNew( &_demuxer, psz_url );
+    if( _s == NULL )
+        return false;
+
+    int64_t i_size = stream_Size( _s );
+    if( i_size > 0 )
+        end_fpos = std::min( end_fpos, fptr_t( i_size ) );
+
+    _start_fpos   = start_fpos;
+    _end_fpos     = end_fpos;
+    _indexed_fpos = start_fpos;
+    _b_done       = false;
+
+    if( vlc_clone( &_thread, run, this, VLC_THREAD_PRIORITY_LOW ) )
+    {
+        _b_done = true;
+        return false;
+    }
+
+    _is_running = true;
+    return true;
+}
+
+void
+SegmentIndexer::interrupt( void *data )
+{
+    SegmentIndexer* p_this = static_cast<SegmentIndexer*>( data );
+
+    vlc_mutex_locker l( &p_this->_lock );
+    p_this->_b_interrupted = true;
+    vlc_cond_broadcast( &p_this->_wait );
+}
+
+bool
+SegmentIndexer::wait_for( mtime_t pts )
+{
+    mtime_t const deadline = mdate() + WAIT_MAX;
+    bool b_indexed = true;
+
+    vlc_mutex_lock( &_lock );
+    _b_interrupted = false;
+    vlc_mutex_unlock( &_lock );
+
+    vlc_interrupt_register( interrupt, this );
+    {
+        vlc_mutex_locker l( &_lock );
+
+        while( !_b_done && _indexed_pts <= pts )
+        {
+            if( _b_interrupted || vlc_cond_timedwait( &_wait, &_lock, deadline ) )
+            {
+                b_indexed = false;
+                break;
+            }
+        }
+    }
+    vlc_interrupt_unregister();
+
+    return b_indexed;
+}
+
+void
+SegmentIndexer::feed( SegmentSeeker& seeker )
+{
+    vlc_mutex_locker l( &_lock );
+
+    for( size_t i = 0; i < _clusters.size(); ++i )
+        seeker.add_cluster( _clusters[i] );
+
+    for( size_t i = 0; i < _keyframes.size(); ++i )
+        seeker.add_seekpoint( _keyframes[i].track_id, SegmentSeeker::Seekpoint::TRUSTED,
+                              _keyframes[i].fpos, _keyframes[i].pts );
+
+    if( _indexed_fpos > _start_fpos )
+        seeker.mark_range_as_searched( SegmentSeeker::Range( _start_fpos, _indexed_fpos ) );
+
+    _clusters.clear();
+    _keyframes.clear();
+}
+
+void*
+SegmentIndexer::run( void *data )
+{
+    static_cast<SegmentIndexer*>( data )->run();
+    return NULL;
+}
+
+void
+SegmentIndexer::run()
+{
+    fptr_t fpos   = _start_fpos;
+    size_t count  = 0;
+
+    while( fpos < _end_fpos )
+    {
+        {
+            vlc_mutex_locker l( &_lock );
+
+            if( _b_abort )
+                break;
+        }
+
+        Element el;
+
+        if( !read_element( fpos, _end_fpos, el ) )
+            break;
+
+        if( el.id == ID_CLUSTER )
+        {
+            fpos = index_cluster( el );
+            ++count;
+        }
+        else if( el.b_unknown_size )
+            break;
+        else
+            fpos = el.end_fpos;
+    }
+
+    msg_Dbg( &_demuxer, "indexed %zu clusters up to %" PRIu64, count, fpos );
+
+    vlc_mutex_locker l( &_lock );
+
+    _b_done = true;
+    vlc_cond_broadcast( &_wait );
+}
+
+bool
+SegmentIndexer::read_element( fptr_t fpos, fptr_t end_fpos, Element& el )
+{
+    uint8_t const* p_peek;
+
+    if( fpos >= end_fpos )
+        return false;
+
+    if( stream_Tell( _s ) != fpos && stream_Seek( _s, fpos ) )
+        return false;
+
+    ssize_t i_peek = stream_Peek( _s, &p_peek, 12 );
+    if( i_peek < 2 )
+        return false;
+
+    unsigned id_length = vint_length( p_peek[0], 4 );
+    if( id_length == 0 || i_peek < ssize_t( id_length + 1 ) )
+        return false;
+
+    unsigned size_length = vint_length( p_peek[id_length], 8 );
+    if( size_length == 0 || i_peek < ssize_t( id_length + size_length ) )
+        return false;
+
+    el.id = 0;
+    for( unsigned i = 0; i < id_length; ++i )
+        el.id = ( el.id << 8 ) | p_peek[i];
+
+    uint8_t const* p_size = p_peek + id_length;
+    uint64_t size    = p_size[0] & ( 0xFF >> size_length );
+    bool     unknown = size == uint64_t( 0xFF >> size_length );
+
+    for( unsigned i = 1; i < size_length; ++i )
+    {
+        size = ( size << 8 ) | p_size[i];
+        unknown &= p_size[i] == 0xFF;
+    }
+
+    el.fpos           = fpos;
+    el.data_fpos      = fpos + id_length + size_length;
+    el.b_unknown_size = unknown;
+    el.end_fpos       = unknown ? end_fpos : el.data_fpos + size;
+
+    return true;
+}
+
+bool
+SegmentIndexer::read_block_header( Element const& el, track_id_t& track_id, int16_t& timecode,
+                                   uint8_t& flags, uint8_t& first_byte )
+{
+    uint8_t const* p_peek;
+
+    if( stream_Seek( _s, el.data_fpos ) )
+        return false;
+
+    ssize_t i_peek = stream_Peek( _s, &p_peek, 12 );
+    if( i_peek > 0 && fptr_t( i_peek ) > el.end_fpos - el.data_fpos )
+        i_peek = el.end_fpos - el.data_fpos;
+
+    unsigned length = i_peek > 0 ? vint_length( p_peek[0], 8 ) : 0;
+    if( length == 0 || i_peek < ssize_t( length + 3 ) )
+        return false;
+
+    track_id = p_peek[0] & ( 0xFF >> length );
+    for( unsigned i = 1; i < length; ++i )
+        track_id = ( track_id << 8 ) | p_peek[i];
+
+    timecode   = int16_t( ( p_peek[length] << 8 ) | p_peek[length + 1] );
+    flags      = p_peek[length + 2];
+    first_byte = i_peek > ssize_t( length + 3 ) ? p_peek[length + 3] : 0;
+
+    return true;
+}
+
+SegmentIndexer::fptr_t
+SegmentIndexer::index_cluster( Element const& cluster )
+{
+    std::vector<Keyframe>   keyframes;
+    std::vector<track_id_t> keyed_tracks;
+
+    bool     b_timecode = false;
+    uint64_t timecode   = 0;
+
+    fptr_t fpos = cluster.data_fpos;
+
+    while( fpos < cluster.end_fpos )
+    {
+        Element el;
+
+        if( !read_element( fpos, cluster.end_fpos, el ) )
+            break;
+
+        if( cluster.b_unknown_size && is_level1( el.id ) )
+            break;
+
+        bool       b_block = false;
+        bool       b_key   = false;
+        fptr_t     block_fpos = 0;
+        track_id_t track_id;
+        int16_t    block_timecode;
+        uint8_t    flags, first_byte;
+
+        switch( el.id )
+        {
+            case ID_CLUSTER_TIMECODE:
+            {
+                uint8_t const* p_peek;
+                size_t size = el.end_fpos - el.data_fpos;
+
+                if( size > 8 || stream_Seek( _s, el.data_fpos ) ||
+                    stream_Peek( _s, &p_peek, size ) < ssize_t( size ) )
+                    break;
+
+                timecode = 0;
+                for( size_t i = 0; i < size; ++i )
+                    timecode = ( timecode << 8 ) | p_peek[i];
+                b_timecode = true;
+                break;
+            }
+
+            case ID_SIMPLEBLOCK:
+                if( b_timecode && read_block_header( el, track_id, block_timecode, flags, first_byte ) )
+                {
+                    b_block    = true;
+                    b_key      = flags & 0x80;
+                    block_fpos = el.fpos;
+                }
+                break;
+
+            case ID_BLOCKGROUP:
+            {
+                if( !b_timecode || el.b_unknown_size )
+                    break;
+
+                b_key = true;
+
+                for( fptr_t child_fpos = el.data_fpos; child_fpos < el.end_fpos; )
+                {
+                    Element child;
+
+                    if( !read_element( child_fpos, el.end_fpos, child ) || child.b_unknown_size )
+                        break;
+
+                    if( child.id == ID_BLOCK )
+                    {
+                        b_block = read_block_header( child, track_id, block_timecode, flags, first_byte );
+                        block_fpos = child.fpos;
+                    }
+                    else if( child.id == ID_REFERENCEBLOCK )
+                        b_key = false;
+
+                    child_fpos = child.end_fpos;
+                }
+                break;
+            }
+        }
+
+        if( b_block && b_key )
+        {
+            tracks_t::const_iterator it = _tracks.find( track_id );
+
+            /* if the second bit of a Theora frame is 1 it's not a keyframe */
+            if( it != _tracks.end() && el.id == ID_BLOCKGROUP && it->second.b_theora )
+                b_key = !( first_byte & 0x40 );
+
+            if( it != _tracks.end() && b_key &&
+                ( it->second.b_all_keyframes ||
+                  std::find( keyed_tracks.begin(), keyed_tracks.end(), track_id ) == keyed_tracks.end() ) )
+            {
+                Keyframe keyframe = {
+                    /* track_id */ track_id,
+                    /* fpos     */ block_fpos,
+                    /* pts      */ mtime_t( ( int64_t( timecode ) + block_timecode ) * int64_t( _timescale ) / 1000 )
+                };
+
+                keyframes.push_back( keyframe );
+                keyed_tracks.push_back( track_id );
+            }
+        }
+
+        if( el.b_unknown_size )
+            break;
+
+        fpos = el.end_fpos;
+    }
+
+    if( !b_timecode )
+        return fpos;
+
+    SegmentSeeker::Cluster cinfo = {
+        /* fpos     */ cluster.fpos,
+        /* pts      */ mtime_t( timecode * _timescale / 1000 ),
+        /* duration */ mtime_t( -1 ),
+        /* size     */ fpos - cluster.fpos
+    };
+
+    vlc_mutex_locker l( &_lock );
+
+    _clusters.push_back( cinfo );
+    _keyframes.insert( _keyframes.end(), keyframes.begin(), keyframes.end() );
+    _indexed_fpos = fpos;
+    _indexed_pts  = cinfo.pts;
+
+    vlc_cond_broadcast( &_wait );
+
+    return fpos;
+}
@@ -0,0 +1,109 @@
+/*****************************************************************************
+ * matroska_segment_indexer.hpp : matroska demuxer
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef MKV_MATROSKA_SEGMENT_INDEXER_HPP_
+#define MKV_MATROSKA_SEGMENT_INDEXER_HPP_
+
+#include "mkv.hpp"
+#include "matroska_segment_seeker.hpp"
+
+#include <vector>
+#include <map>
+
+/* Walks the clusters of a segment without Cues in a background thread, with
+ * its own stream, reading only the element headers and the block headers, and
+ * collects the clusters and keyframes positions for the SegmentSeeker. */
+class SegmentIndexer
+{
+    public:
+        typedef SegmentSeeker::fptr_t     fptr_t;
+        typedef SegmentSeeker::track_id_t track_id_t;
+
+        struct Track
+        {
+            bool b_all_keyframes; /* or only the first one of each cluster */
+            bool b_theora;
+        };
+
+        typedef std::map<track_id_t, Track> tracks_t;
+
+        SegmentIndexer( demux_t& demuxer, tracks_t const& tracks, uint64_t timescale );
+        ~SegmentIndexer();
+
+        bool start( char const* psz_url, fptr_t start_fpos, fptr_t end_fpos );
+
+        /* blocks until the clusters following pts are indexed, or indexing
+         * is over. Gives up after a while or when interrupted, returning
+         * false: the seeker then searches the remaining clusters itself */
+        bool wait_for( mtime_t pts );
+
+        /* hands what was indexed since the last call over to the seeker */
+        void feed( SegmentSeeker& seeker );
+
+    private:
+        struct Keyframe
+        {
+            track_id_t track_id;
+            fptr_t     fpos;
+            mtime_t    pts;
+        };
+
+        struct Element
+        {
+            fptr_t   fpos;
+            uint32_t id;
+            fptr_t   data_fpos;
+            fptr_t   end_fpos;   /* unknown size elements end at end_fpos */
+            bool     b_unknown_size;
+        };
+
+        static void* run( void * );
+        static void interrupt( void * );
+        void run();
+
+        bool read_element( fptr_t fpos, fptr_t end_fpos, Element& );
+        fptr_t index_cluster( Element const& cluster );
+        bool read_block_header( Element const&, track_id_t&, int16_t&, uint8_t& flags, uint8_t& first_byte );
+
+        demux_t&     _demuxer;
+        tracks_t     _tracks;
+        uint64_t     _timescale;
+        stream_t    *_s;
+        fptr_t       _start_fpos;
+        fptr_t       _end_fpos;
+
+        vlc_thread_t _thread;
+        bool         _is_running;
+
+        vlc_mutex_t  _lock;
+        vlc_cond_t   _wait;
+        bool         _b_abort;
+        bool         _b_done;
+        bool         _b_interrupted; /* the waiting seek was interrupted */
+
+        /* collected, not yet fed to the seeker */
+        std::vector<SegmentSeeker::Cluster> _clusters;
+        std::vector<Keyframe>               _keyframes;
+
+        fptr_t       _indexed_fpos; /* everything before is indexed */
+        mtime_t      _indexed_pts;  /* pts of the last indexed cluster */
+};
+
+#endif /* include-guard */
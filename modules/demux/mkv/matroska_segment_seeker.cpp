@@ -58,10 +58,13 @@ SegmentSeeker::add_cluster_position( fptr_t fpos )
       fpos
     );
 
+    if( insertion_point != _cluster_positions.begin() && *prev_( insertion_point ) == fpos )
+        return prev_( insertion_point ); // position already known
+
     return _cluster_positions.insert( insertion_point, fpos );
 }
 
-SegmentSeeker::cluster_map_t::iterator
+SegmentSeeker::clusters_t::iterator
 SegmentSeeker::add_cluster( KaxCluster * const p_cluster )
 {
     Cluster cinfo = {
@@ -71,17 +74,23 @@ SegmentSeeker::add_cluster( KaxCluster * const p_cluster )
         /* size     */ p_cluster->GetEndPosition() - p_cluster->GetElementPosition()
     };
 
+    return add_cluster( cinfo );
+}
+
+SegmentSeeker::clusters_t::iterator
+SegmentSeeker::add_cluster( Cluster const& cinfo )
+{
     add_cluster_position( cinfo.fpos );
 
-    cluster_map_t::iterator it = _clusters.lower_bound( cinfo.pts );
+    clusters_t::iterator it = std::lower_bound( _clusters.begin(), _clusters.end(), cinfo );
 
-    if( it != _clusters.end() && it->second.pts == cinfo.pts )
+    if( it != _clusters.end() && it->pts == cinfo.pts )
     {
         // cluster already known
     }
     else
     {
-        it = _clusters.insert( cluster_map_t::value_type( cinfo.pts, cinfo ) ).first;
+        it = _clusters.insert( it, cinfo );
     }
 
     // ------------------------------------------------------------------
@@ -98,12 +107,12 @@ SegmentSeeker::add_cluster( KaxCluster * const p_cluster )
 
     if( it != _clusters.begin() )
     {
-        Duration::fix( prev_( it )->second, it->second );
+        Duration::fix( *prev_( it ), *it );
     }
 
     if( it != _clusters.end() && next_( it ) != _clusters.end() )
     {
-        Duration::fix( it->second, next_( it )->second );
+        Duration::fix( *it, *next_( it ) );
     }
 
     return it;
@@ -220,11 +229,13 @@ SegmentSeeker::get_seekpoints_around( mtime_t target_pts, track_ids_t const& pri
 
     { // check if we got a cluster which is closer to target_pts than the found cues //
 
-        cluster_map_t::iterator it = _clusters.lower_bound( target_pts );
+        Cluster const needle = { 0, target_pts, -1, 0 };
+
+        clusters_t::const_iterator it = std::lower_bound( _clusters.begin(), _clusters.end(), needle );
 
         if( it != _clusters.begin() && --it != _clusters.end() )
         {
-            Cluster const& cluster = it->second;
+            Cluster const& cluster = *it;
 
             if( cluster.fpos > points.first.fpos )
             {
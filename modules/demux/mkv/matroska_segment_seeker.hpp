@@ -83,6 +83,11 @@ class SegmentSeeker
             mtime_t pts;
             mtime_t duration;
             fptr_t  size;
+
+            bool operator<( Cluster const& rhs ) const
+            {
+                return pts < rhs.pts;
+            }
         };
 
     public:
@@ -93,7 +98,7 @@ class SegmentSeeker
 
         typedef std::map<track_id_t, Seekpoint> tracks_seekpoint_t;
         typedef std::map<track_id_t, seekpoints_t> tracks_seekpoints_t;
-        typedef std::map<mtime_t, Cluster> cluster_map_t;
+        typedef std::vector<Cluster> clusters_t; /* sorted by pts */
 
         typedef std::pair<Seekpoint, Seekpoint> seekpoint_pair_t;
 
@@ -106,7 +111,8 @@ class SegmentSeeker
         tracks_seekpoint_t find_greatest_seekpoints_in_range( fptr_t , mtime_t );
 
         cluster_positions_t::iterator add_cluster_position( fptr_t pos );
-        cluster_map_t      ::iterator add_cluster( KaxCluster * const );
+        clusters_t         ::iterator add_cluster( KaxCluster * const );
+        clusters_t         ::iterator add_cluster( Cluster const& );
 
         void mkv_jump_to( matroska_segment_c&, fptr_t );
 
@@ -120,7 +126,7 @@ class SegmentSeeker
         ranges_t            _ranges_searched;
         tracks_seekpoints_t _tracks_seekpoints;
         cluster_positions_t _cluster_positions;
-        cluster_map_t       _clusters;
+        clusters_t          _clusters;
 };
 
 #endif /* include-guard */
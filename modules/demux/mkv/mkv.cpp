@@ -80,6 +80,10 @@ vlc_module_begin ()
             N_("Preload clusters"),
             N_("Find all cluster positions by jumping cluster-to-cluster before playback"), true );
 
+    add_bool( "mkv-index-clusters", false,
+            N_("Index clusters in background"),
+            N_("Find the cluster and keyframe positions of local files without Cues in background during playback, so that seeking does not have to scan the file."), true );
+
     add_shortcut( "mka", "mkv" )
 vlc_module_end ()
 
@@ -148,6 +152,18 @@ static int Open( vlc_object_t * p_this )
             b_need_preload = true;
     }
 
+    if( p_demux->psz_file && !strcmp( p_demux->psz_access, "file" ) &&
+        var_InheritBool( p_demux, "mkv-index-clusters" ) )
+    {
+        char *psz_url = vlc_path2uri( p_demux->psz_file, "file" );
+        if( psz_url != NULL )
+        {
+            for (size_t i=0; i<p_stream->segments.size(); i++)
+                p_stream->segments[i]->StartClusterIndexer( psz_url );
+            free( psz_url );
+        }
+    }
+
     p_segment = p_stream->segments[0];
     if( p_segment->cluster == NULL && p_segment->stored_editions.size() == 0 )
     {
@@ -0,0 +1,493 @@
+/*****************************************************************************
+ * fragindex.c : MP4 fragments time/position index
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_stream.h>
+#include <vlc_url.h>
+#include <vlc_interrupt.h>
+
+#include "fragindex.h"
+#include "../index_file.h"
+
+#include <assert.h>
+
+/* Index file (see index_file.h), all values big endian:
+ *  header: duration (8), end time (8)
+ *  entries: time (8), moof position (8)
+ * Only complete indexes are written.
+ */
+#define MP4_FRAGINDEX_HEADER    16
+#define MP4_FRAGINDEX_ENTRY     16
+
+/* longest time a seek waits for the index to get past its target */
+#define MP4_FRAGINDEX_WAIT      (2 * CLOCK_FREQ)
+
+typedef struct
+{
+    mtime_t  i_time;
+    uint64_t i_pos;
+} mp4_fragindex_entry_t;
+
+typedef struct
+{
+    uint32_t i_track_ID;
+    uint32_t i_timescale;
+    uint32_t i_default_duration;    /* from trex */
+    stime_t  i_duration;            /* of the fragments read so far */
+} mp4_fragindex_track_t;
+
+struct mp4_fragindex_t
+{
+    demux_t    *p_demux;
+    char       *psz_path;
+    uint64_t    i_size;             /* of the indexed file */
+    int64_t     i_mtime;            /* of the indexed file */
+    bool        b_store;
+
+    /* indexing thread */
+    vlc_thread_t thread;
+    bool        b_thread;
+    stream_t   *s;
+    mp4_fragindex_track_t *p_tracks;
+    unsigned    i_tracks;
+    unsigned    i_ref_track;        /* track the times are the ones of */
+
+    vlc_mutex_t lock;
+    vlc_cond_t  wait;
+    mp4_fragindex_entry_t *p_entries;
+    size_t      i_entries;
+    size_t      i_alloc;
+    mtime_t     i_end;              /* time the indexed fragments end at */
+    mtime_t     i_duration;         /* longest track of the indexed fragments */
+    bool        b_done;             /* not indexing anymore */
+    bool        b_complete;         /* indexed up to the end of the file */
+    bool        b_exit;
+    bool        b_interrupted;      /* the waiting seek was interrupted */
+};
+
+static const index_file_format_t mp4_fragindex_format =
+{
+    .psz_magic = "VLCMP4IX",
+    .i_version = 2,
+    .i_header = MP4_FRAGINDEX_HEADER,
+    .i_entry = MP4_FRAGINDEX_ENTRY,
+};
+
+static int Load( mp4_fragindex_t *p_index )
+{
+    demux_t *p_demux = p_index->p_demux;
+    uint8_t header[MP4_FRAGINDEX_HEADER], *p_data;
+    size_t i_entries;
+
+    if( index_file_Load( p_demux, &mp4_fragindex_format, p_index->psz_path,
+                         p_index->i_size, p_index->i_mtime, header,
+                         &p_data, &i_entries ) )
+        return VLC_EGENERIC;
+
+    mp4_fragindex_entry_t *p_entries = NULL;
+    if( i_entries > 0 && ( i_entries > SIZE_MAX / sizeof(*p_entries) ||
+        (p_entries = malloc( i_entries * sizeof(*p_entries) )) == NULL ) )
+    {
+        free( p_data );
+        return VLC_ENOMEM;
+    }
+
+    for( size_t i = 0; i < i_entries; i++ )
+    {
+        const uint8_t *p_entry = &p_data[i * MP4_FRAGINDEX_ENTRY];
+        p_entries[i].i_time = GetQWBE( &p_entry[0] );
+        p_entries[i].i_pos = GetQWBE( &p_entry[8] );
+    }
+    free( p_data );
+
+    p_index->i_duration = GetQWBE( &header[0] );
+    p_index->i_end = GetQWBE( &header[8] );
+    p_index->p_entries = p_entries;
+    p_index->i_entries = p_index->i_alloc = i_entries;
+    p_index->b_done = p_index->b_complete = true;
+
+    msg_Dbg( p_demux, "loaded index %s: %zu fragments", p_index->psz_path,
+             i_entries );
+    return VLC_SUCCESS;
+}
+
+static void Save( const mp4_fragindex_t *p_index )
+{
+    uint8_t header[MP4_FRAGINDEX_HEADER];
+    SetQWBE( &header[0], p_index->i_duration );
+    SetQWBE( &header[8], p_index->i_end );
+
+    if( p_index->i_entries > SIZE_MAX / MP4_FRAGINDEX_ENTRY )
+        return;
+    uint8_t *p_data = malloc( p_index->i_entries * MP4_FRAGINDEX_ENTRY );
+    if( unlikely(p_data == NULL) )
+        return;
+    for( size_t i = 0; i < p_index->i_entries; i++ )
+    {
+        uint8_t *p_entry = &p_data[i * MP4_FRAGINDEX_ENTRY];
+        SetQWBE( &p_entry[0], p_index->p_entries[i].i_time );
+        SetQWBE( &p_entry[8], p_index->p_entries[i].i_pos );
+    }
+
+    index_file_Save( p_index->p_demux, &mp4_fragindex_format,
+                     p_index->psz_path, p_index->i_size, p_index->i_mtime,
+                     header, p_data, p_index->i_entries );
+    free( p_data );
+}
+
+static mp4_fragindex_track_t * GetTrack( mp4_fragindex_t *p_index,
+                                         uint32_t i_track_ID )
+{
+    for( unsigned i = 0; i < p_index->i_tracks; i++ )
+    {
+        if( p_index->p_tracks[i].i_track_ID == i_track_ID )
+            return &p_index->p_tracks[i];
+    }
+    return NULL;
+}
+
+/* Adds the durations of the moof runs to their tracks, the same way the
+ * demuxer does, and indexes the moof at the time the reference track had
+ * before it */
+static void AddMoof( mp4_fragindex_t *p_index, const MP4_Box_t *p_moof )
+{
+    mp4_fragindex_track_t *p_ref = &p_index->p_tracks[p_index->i_ref_track];
+    const stime_t i_ref_start = p_ref->i_duration;
+    bool b_ref = false;
+
+    for( const MP4_Box_t *p_traf = p_moof->p_first; p_traf; p_traf = p_traf->p_next )
+    {
+        if( p_traf->i_type != ATOM_traf )
+            continue;
+
+        const MP4_Box_t *p_tfhd = MP4_BoxGet( p_traf, "tfhd" );
+        const MP4_Box_t *p_trun = MP4_BoxGet( p_traf, "trun" );
+        if( !p_tfhd || !BOXDATA(p_tfhd) || !p_trun )
+            continue;
+
+        mp4_fragindex_track_t *p_track = GetTrack( p_index, BOXDATA(p_tfhd)->i_track_ID );
+        if( !p_track )
+            continue;
+
+        uint32_t i_default_duration = p_track->i_default_duration;
+        if( BOXDATA(p_tfhd)->i_flags & MP4_TFHD_DFLT_SAMPLE_DURATION )
+            i_default_duration = BOXDATA(p_tfhd)->i_default_sample_duration;
+
+        for( ; p_trun; p_trun = p_trun->p_next )
+        {
+            const MP4_Box_data_trun_t *p_trundata = p_trun->data.p_trun;
+            if( p_trun->i_type != ATOM_trun || !p_trundata )
+                continue;
+
+            if( p_trundata->i_flags & MP4_TRUN_SAMPLE_DURATION )
+            {
+                for( uint32_t i = 0; i < p_trundata->i_sample_count; i++ )
+                    p_track->i_duration += p_trundata->p_samples[i].i_duration;
+            }
+            else
+                p_track->i_duration += (stime_t) p_trundata->i_sample_count *
+                                       i_default_duration;
+        }
+
+        b_ref |= p_track == p_ref;
+    }
+
+    if( !b_ref )
+        return;
+
+    mtime_t i_duration = 0;
+    for( unsigned i = 0; i < p_index->i_tracks; i++ )
+    {
+        const mp4_fragindex_track_t *p_track = &p_index->p_tracks[i];
+        i_duration = __MAX( i_duration, CLOCK_FREQ * p_track->i_duration /
+                                        p_track->i_timescale );
+    }
+
+    vlc_mutex_lock( &p_index->lock );
+    if( p_index->i_entries == p_index->i_alloc )
+    {
+        size_t i_alloc = p_index->i_alloc ? p_index->i_alloc * 2 : 256;
+        mp4_fragindex_entry_t *p_realloc = realloc( p_index->p_entries,
+                                                    i_alloc * sizeof(*p_realloc) );
+        if( unlikely(p_realloc == NULL) )
+        {
+            vlc_mutex_unlock( &p_index->lock );
+            return;
+        }
+        p_index->p_entries = p_realloc;
+        p_index->i_alloc = i_alloc;
+    }
+
+    p_index->p_entries[p_index->i_entries].i_time =
+            CLOCK_FREQ * i_ref_start / p_ref->i_timescale;
+    p_index->p_entries[p_index->i_entries].i_pos = p_moof->i_pos;
+    p_index->i_entries++;
+    p_index->i_end = CLOCK_FREQ * p_ref->i_duration / p_ref->i_timescale;
+    p_index->i_duration = i_duration;
+    vlc_cond_broadcast( &p_index->wait );
+    vlc_mutex_unlock( &p_index->lock );
+}
+
+static void *Run( void *data )
+{
+    mp4_fragindex_t *p_index = data;
+    stream_t *s = p_index->s;
+    bool b_complete = false;
+
+    for( ;; )
+    {
+        vlc_mutex_lock( &p_index->lock );
+        bool b_exit = p_index->b_exit;
+        vlc_mutex_unlock( &p_index->lock );
+        if( b_exit )
+            break;
+
+        /* reads up to the next moof, skipping the mdat */
+        MP4_Box_t *p_chunk = MP4_BoxGetNextChunk( s );
+        if( p_chunk == NULL )
+            break;
+
+        bool b_moof = false;
+        for( const MP4_Box_t *p_box = p_chunk->p_first; p_box; p_box = p_box->p_next )
+        {
+            if( p_box->i_type == ATOM_moof )
+            {
+                AddMoof( p_index, p_box );
+                b_moof = true;
+            }
+        }
+        MP4_BoxFree( p_chunk );
+
+        if( !b_moof )
+        {
+            b_complete = stream_Tell( s ) >= p_index->i_size;
+            break;
+        }
+    }
+
+    vlc_mutex_lock( &p_index->lock );
+    msg_Dbg( p_index->p_demux, "indexed %zu fragments%s", p_index->i_entries,
+             b_complete ? " (complete)" : "" );
+    p_index->b_complete = b_complete;
+    p_index->b_done = true;
+    vlc_cond_broadcast( &p_index->wait );
+    vlc_mutex_unlock( &p_index->lock );
+
+    return NULL;
+}
+
+mp4_fragindex_t * MP4_FragIndex_New( demux_t *p_demux, const char *psz_file,
+                                     uint64_t i_size, bool b_store )
+{
+    mp4_fragindex_t *p_index = calloc( 1, sizeof(*p_index) );
+    if( unlikely(p_index == NULL) )
+        return NULL;
+
+    if( asprintf( &p_index->psz_path, "%s"MP4_FRAGINDEX_EXT, psz_file ) == -1 )
+    {
+        free( p_index );
+        return NULL;
+    }
+    p_index->p_demux = p_demux;
+    p_index->i_size = i_size;
+    p_index->i_mtime = index_file_GetMTime( psz_file );
+    p_index->b_store = b_store;
+    vlc_mutex_init( &p_index->lock );
+    vlc_cond_init( &p_index->wait );
+
+    if( b_store )
+        Load( p_index );
+    return p_index;
+}
+
+void MP4_FragIndex_Delete( mp4_fragindex_t *p_index )
+{
+    if( p_index->b_thread )
+    {
+        vlc_mutex_lock( &p_index->lock );
+        p_index->b_exit = true;
+        vlc_mutex_unlock( &p_index->lock );
+        vlc_join( p_index->thread, NULL );
+        stream_Delete( p_index->s );
+
+        if( p_index->b_store && p_index->b_complete && p_index->i_entries > 0 )
+            Save( p_index );
+    }
+
+    vlc_cond_destroy( &p_index->wait );
+    vlc_mutex_destroy( &p_index->lock );
+    free( p_index->p_tracks );
+    free( p_index->p_entries );
+    free( p_index->psz_path );
+    free( p_index );
+}
+
+int MP4_FragIndex_Start( mp4_fragindex_t *p_index, const MP4_Box_t *p_moov,
+                         uint64_t i_pos )
+{
+    demux_t *p_demux = p_index->p_demux;
+
+    if( p_index->b_done )
+        return VLC_SUCCESS; /* loaded */
+
+    unsigned i_traks = MP4_BoxCount( p_moov, "trak" );
+    p_index->p_tracks = calloc( i_traks, sizeof(*p_index->p_tracks) );
+    if( i_traks == 0 || p_index->p_tracks == NULL )
+        return VLC_EGENERIC;
+
+    /* the times are the ones of the first video, or else audio, track */
+    int i_ref_rank = 3;
+    for( const MP4_Box_t *p_trak = MP4_BoxGet( p_moov, "trak" ); p_trak;
+         p_trak = p_trak->p_next )
+    {
+        const MP4_Box_t *p_tkhd = MP4_BoxGet( p_trak, "tkhd" );
+        const MP4_Box_t *p_mdhd = MP4_BoxGet( p_trak, "mdia/mdhd" );
+        const MP4_Box_t *p_hdlr = MP4_BoxGet( p_trak, "mdia/hdlr" );
+        if( p_trak->i_type != ATOM_trak || !p_tkhd || !BOXDATA(p_tkhd) ||
+            !p_mdhd || !BOXDATA(p_mdhd) || !BOXDATA(p_mdhd)->i_timescale )
+            continue;
+
+        mp4_fragindex_track_t *p_track = &p_index->p_tracks[p_index->i_tracks];
+        p_track->i_track_ID = BOXDATA(p_tkhd)->i_track_ID;
+        p_track->i_timescale = BOXDATA(p_mdhd)->i_timescale;
+
+        for( const MP4_Box_t *p_trex = MP4_BoxGet( p_moov, "mvex/trex" ); p_trex;
+             p_trex = p_trex->p_next )
+        {
+            if( p_trex->i_type == ATOM_trex && BOXDATA(p_trex) &&
+                BOXDATA(p_trex)->i_track_ID == p_track->i_track_ID )
+            {
+                p_track->i_default_duration = BOXDATA(p_trex)->i_default_sample_duration;
+                break;
+            }
+        }
+
+        int i_rank = 2;
+        if( p_hdlr && BOXDATA(p_hdlr) )
+        {
+            if( BOXDATA(p_hdlr)->i_handler_type == ATOM_vide )
+                i_rank = 0;
+            else if( BOXDATA(p_hdlr)->i_handler_type == ATOM_soun )
+                i_rank = 1;
+        }
+        if( i_rank < i_ref_rank )
+        {
+            p_index->i_ref_track = p_index->i_tracks;
+            i_ref_rank = i_rank;
+        }
+        p_index->i_tracks++;
+    }
+    if( p_index->i_tracks == 0 )
+        return VLC_EGENERIC;
+
+    /* read with our own stream, not to move the one of the demuxer */
+    char *psz_url = vlc_path2uri( p_index->psz_path, NULL );
+    if( psz_url == NULL )
+        return VLC_ENOMEM;
+    /* strip the index extension */
+    psz_url[strlen( psz_url ) - strlen( MP4_FRAGINDEX_EXT )] = '\0';
+    p_index->s = stream_UrlNew( p_demux, psz_url );
+    free( psz_url );
+    if( p_index->s == NULL )
+        return VLC_EGENERIC;
+
+    if( stream_Seek( p_index->s, i_pos ) ||
+        vlc_clone( &p_index->thread, Run, p_index, VLC_THREAD_PRIORITY_LOW ) )
+    {
+        stream_Delete( p_index->s );
+        p_index->s = NULL;
+        return VLC_EGENERIC;
+    }
+    p_index->b_thread = true;
+
+    msg_Dbg( p_demux, "indexing fragments from %"PRIu64" in background", i_pos );
+    return VLC_SUCCESS;
+}
+
+bool MP4_FragIndex_GetDuration( mp4_fragindex_t *p_index, mtime_t *pi_duration )
+{
+    vlc_mutex_lock( &p_index->lock );
+    bool b_complete = p_index->b_complete;
+    *pi_duration = p_index->i_duration;
+    vlc_mutex_unlock( &p_index->lock );
+    return b_complete;
+}
+
+static void FindInterrupt( void *data )
+{
+    mp4_fragindex_t *p_index = data;
+
+    vlc_mutex_lock( &p_index->lock );
+    p_index->b_interrupted = true;
+    vlc_cond_broadcast( &p_index->wait );
+    vlc_mutex_unlock( &p_index->lock );
+}
+
+int MP4_FragIndex_Find( mp4_fragindex_t *p_index, mtime_t i_time,
+                        uint64_t *pi_pos, mtime_t *pi_time )
+{
+    const mtime_t i_deadline = mdate() + MP4_FRAGINDEX_WAIT;
+    int i_ret = VLC_EGENERIC;
+
+    vlc_mutex_lock( &p_index->lock );
+    p_index->b_interrupted = false;
+    vlc_mutex_unlock( &p_index->lock );
+
+    vlc_interrupt_register( FindInterrupt, p_index );
+    vlc_mutex_lock( &p_index->lock );
+    while( !p_index->b_done && i_time >= p_index->i_end )
+    {
+        if( p_index->b_interrupted ||
+            vlc_cond_timedwait( &p_index->wait, &p_index->lock, i_deadline ) )
+        {
+            msg_Dbg( p_index->p_demux, "fragments not indexed up to %"PRId64
+                     " yet", i_time );
+            i_ret = VLC_ETIMEOUT;
+            break;
+        }
+    }
+
+    if( i_ret != VLC_ETIMEOUT && p_index->i_entries > 0 &&
+        ( i_time < p_index->i_end || p_index->b_complete ) )
+    {
+        /* last moof starting before i_time */
+        size_t i_low = 0, i_high = p_index->i_entries;
+        while( i_high - i_low > 1 )
+        {
+            size_t i_mid = i_low + (i_high - i_low) / 2;
+            if( p_index->p_entries[i_mid].i_time <= i_time )
+                i_low = i_mid;
+            else
+                i_high = i_mid;
+        }
+
+        *pi_pos = p_index->p_entries[i_low].i_pos;
+        *pi_time = p_index->p_entries[i_low].i_time;
+        i_ret = VLC_SUCCESS;
+    }
+    vlc_mutex_unlock( &p_index->lock );
+    vlc_interrupt_unregister();
+
+    return i_ret;
+}
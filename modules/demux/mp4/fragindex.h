@@ -0,0 +1,58 @@
+/*****************************************************************************
+ * fragindex.h : MP4 fragments time/position index
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_MP4_FRAGINDEX_H_
+#define VLC_MP4_FRAGINDEX_H_
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include "libmp4.h"
+
+/*
+ * Index of the start times of the moof boxes of a fragmented file, built by
+ * a background thread reading the moof boxes with its own stream, while the
+ * file is played. Times are the ones the demuxer computes by summing the
+ * fragments durations from the first one, in microseconds.
+ * The complete index can be stored next to the file to be reused the next
+ * time it is opened.
+ */
+typedef struct mp4_fragindex_t mp4_fragindex_t;
+
+#define MP4_FRAGINDEX_EXT ".mp4idx"
+
+/* loads the index of that file, or creates an empty one */
+mp4_fragindex_t * MP4_FragIndex_New( demux_t *, const char *psz_file,
+                                     uint64_t i_size, bool b_store );
+/* stops indexing, and writes the index if it was completed */
+void MP4_FragIndex_Delete( mp4_fragindex_t * );
+
+/* starts indexing the moof boxes from i_pos, unless the index was loaded */
+int MP4_FragIndex_Start( mp4_fragindex_t *, const MP4_Box_t *p_moov,
+                         uint64_t i_pos );
+
+/* total duration of the fragments, once all were indexed */
+bool MP4_FragIndex_GetDuration( mp4_fragindex_t *, mtime_t *pi_duration );
+
+/* moof box to read from to reach i_time, and its start time. Waits for the
+ * index to get past i_time if needed, for a while: returns VLC_ETIMEOUT if
+ * the index did not get there in time or the wait was interrupted */
+int MP4_FragIndex_Find( mp4_fragindex_t *, mtime_t i_time,
+                        uint64_t *pi_pos, mtime_t *pi_time );
+
+#endif
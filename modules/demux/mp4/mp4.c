@@ -27,12 +27,14 @@
  * Preamble
  *****************************************************************************/
 #include "mp4.h"
+#include "fragindex.h"
 
 #include <vlc_demux.h>
 #include <vlc_charset.h>                           /* EnsureUTF8 */
 #include <vlc_input.h>
 #include <vlc_aout.h>
 #include <vlc_plugin.h>
+#include <vlc_interrupt.h>
 #include <assert.h>
 #include <limits.h>
 #include "../codec/cc.h"
@@ -43,6 +45,18 @@
 static int  Open ( vlc_object_t * );
 static void Close( vlc_object_t * );
 
+#define LAZY_INDEX_TEXT N_("Build the sample index on demand")
+#define LAZY_INDEX_LONGTEXT N_( \
+    "Only build the index of the samples around the playback position, " \
+    "instead of indexing the whole file when opening it. This reduces " \
+    "the opening time and the memory used by long files." )
+
+#define FRAG_INDEX_TEXT N_("Keep a fragment index")
+#define FRAG_INDEX_LONGTEXT N_( \
+    "Store the positions of the fragments of a fragmented MP4 file in a " \
+    "file next to it (with the .mp4idx extension), so that seeking and " \
+    "finding the duration do not need to scan the file the next time." )
+
 vlc_module_begin ()
     set_category( CAT_INPUT )
     set_subcategory( SUBCAT_INPUT_DEMUX )
@@ -50,6 +64,9 @@ vlc_module_begin ()
     set_shortname( N_("MP4") )
     set_capability( "demux", 240 )
     set_callbacks( Open, Close )
+
+    add_bool( "mp4-lazy-index", true, LAZY_INDEX_TEXT, LAZY_INDEX_LONGTEXT, true )
+    add_bool( "mp4-index", false, FRAG_INDEX_TEXT, FRAG_INDEX_LONGTEXT, true )
 vlc_module_end ()
 
 /*****************************************************************************
@@ -85,6 +102,7 @@ struct demux_sys_t
     bool            b_fragments_probed;
 
     mp4_fragments_t fragments;
+    mp4_fragindex_t *p_fragindex;  /* background moof index */
 
     struct
     {
@@ -120,8 +138,8 @@ static void MP4_TrackUnselect(demux_t *, mp4_track_t * );
 
 static int  MP4_TrackSeek   ( demux_t *, mp4_track_t *, mtime_t );
 
-static uint64_t MP4_TrackGetPos    ( mp4_track_t * );
-static uint32_t MP4_TrackGetReadSize( mp4_track_t *, uint32_t * );
+static uint64_t MP4_TrackGetPos    ( demux_t *, mp4_track_t * );
+static uint32_t MP4_TrackGetReadSize( demux_t *, mp4_track_t *, uint32_t * );
 static int      MP4_TrackNextSample( demux_t *, mp4_track_t *, uint32_t );
 static void     MP4_TrackSetELST( demux_t *, mp4_track_t *, int64_t );
 static bool     MP4_TrackIsInterleaved( const mp4_track_t * );
@@ -138,8 +156,11 @@ static bool AddFragment( demux_t *p_demux, MP4_Box_t *p_moox );
 static int  ProbeFragments( demux_t *p_demux, bool b_force );
 static int  ProbeIndex( demux_t *p_demux );
 
+static mp4_chunk_t * TrackLoadChunkPage( demux_t *, mp4_track_t *, uint32_t );
+
 static int LeafIndexGetMoofPosByTime( demux_t *p_demux, const mtime_t i_target_time,
                                       uint64_t *pi_pos, mtime_t *pi_mooftime );
+static void LeafUpdateDuration( demux_t *p_demux );
 static int LeafGetTrackAndChunkByMOOVPos( demux_t *p_demux, uint64_t *pi_pos,
                                       mp4_track_t **pp_tk, unsigned int *pi_chunk );
 static int LeafMapTrafTrunContextes( demux_t *p_demux, MP4_Box_t *p_moof );
@@ -212,6 +233,27 @@ static es_out_id_t * MP4_AddTrackES( es_out_t *out, mp4_track_t *p_track )
     return p_es;
 }
 
+/* Return a chunk of a track read from moov, building its page first
+ * if the track is lazily indexed */
+static inline mp4_chunk_t * MP4_TrackGetChunk( demux_t *p_demux, mp4_track_t *p_track,
+                                               uint32_t i_chunk )
+{
+    if( !p_track->b_lazy )
+        return &p_track->chunk[i_chunk];
+
+    const uint32_t i_page = i_chunk / MP4_CHUNK_PAGE_SIZE;
+    for( unsigned i = 0; i < MP4_CHUNK_PAGES; i++ )
+    {
+        if( p_track->pagecache[i].i_page == i_page )
+        {
+            p_track->pagecache[i].i_use = ++p_track->i_pagecache_use;
+            return &p_track->pagecache[i].p_chunks[i_chunk % MP4_CHUNK_PAGE_SIZE];
+        }
+    }
+
+    return &TrackLoadChunkPage( p_demux, p_track, i_page )[i_chunk % MP4_CHUNK_PAGE_SIZE];
+}
+
 /* Return time in microsecond of a track */
 static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
 {
@@ -220,7 +262,7 @@ static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
     if( p_sys->b_fragmented )
         p_chunk = p_track->cchunk;
     else
-        p_chunk = &p_track->chunk[p_track->i_chunk];
+        p_chunk = MP4_TrackGetChunk( p_demux, p_track, p_track->i_chunk );
 
     unsigned int i_index = 0;
     unsigned int i_sample = p_track->i_sample - p_chunk->i_sample_first;
@@ -274,7 +316,7 @@ static inline bool MP4_TrackGetPTSDelta( demux_t *p_demux, mp4_track_t *p_track,
     if( p_sys->b_fragmented )
         ck = p_track->cchunk;
     else
-        ck = &p_track->chunk[p_track->i_chunk];
+        ck = MP4_TrackGetChunk( p_demux, p_track, p_track->i_chunk );
 
     unsigned int i_index = 0;
     unsigned int i_sample = p_track->i_sample - ck->i_sample_first;
@@ -342,6 +384,24 @@ static int AllocateTracks( demux_t *p_demux, unsigned i_tracks )
     return VLC_SUCCESS;
 }
 
+/* Whether the moov tracks have samples of their own, before the fragments */
+static bool MoovHasSamples( const MP4_Box_t *p_moov )
+{
+    const MP4_Box_t *p_trak = p_moov ? MP4_BoxGet( p_moov, "trak" ) : NULL;
+    for( ; p_trak; p_trak = p_trak->p_next )
+    {
+        if( p_trak->i_type != ATOM_trak )
+            continue;
+
+        const MP4_Box_t *p_stsz = MP4_BoxGet( p_trak, "mdia/minf/stbl/stsz" );
+        const MP4_Box_t *p_stz2 = MP4_BoxGet( p_trak, "mdia/minf/stbl/stz2" );
+        if( ( p_stsz && BOXDATA(p_stsz) && BOXDATA(p_stsz)->i_sample_count ) ||
+            ( p_stz2 && BOXDATA(p_stz2) && BOXDATA(p_stz2)->i_sample_count ) )
+            return true;
+    }
+    return false;
+}
+
 static block_t * MP4_EIA608_Convert( block_t * p_block )
 {
     /* Rebuild codec data from encap */
@@ -585,12 +645,34 @@ static int Open( vlc_object_t * p_this )
     {
         if ( p_sys->b_seekable )
         {
+            /* Index local fragmented files in background instead of
+               reading all their moof boxes before starting */
+            if ( p_sys->b_fastseekable && p_demux->psz_file != NULL &&
+                 !MoovHasSamples( MP4_BoxGet( p_sys->p_root, "/moov" ) ) )
+            {
+                int64_t i_size = stream_Size( p_demux->s );
+                if( i_size > 0 )
+                    p_sys->p_fragindex = MP4_FragIndex_New( p_demux, p_demux->psz_file, i_size,
+                                                            var_InheritBool( p_demux, "mp4-index" ) );
+            }
+
             /* Probe remaining to check if there's really fragments
                or if that file is just ready to append fragments */
             ProbeFragments( p_demux, false );
             p_sys->b_fragmented = !!MP4_BoxCount( p_sys->p_root, "/moof" );
 
-            if ( p_sys->b_fragmented && !p_sys->i_overall_duration )
+            if ( p_sys->p_fragindex &&
+                 ( !p_sys->b_fragmented ||
+                   MP4_FragIndex_Start( p_sys->p_fragindex, MP4_BoxGet( p_sys->p_root, "/moov" ),
+                                        MP4_BoxGet( p_sys->p_root, "moof" )->i_pos ) != VLC_SUCCESS ) )
+            {
+                MP4_FragIndex_Delete( p_sys->p_fragindex );
+                p_sys->p_fragindex = NULL;
+                /* read all the fragments instead */
+                if ( p_sys->b_fragmented )
+                    ProbeFragments( p_demux, true );
+            }
+            else if ( p_sys->b_fragmented && !p_sys->i_overall_duration && !p_sys->p_fragindex )
                 ProbeFragments( p_demux, true );
 
             MP4_Box_t *p_mdat = MP4_BoxGet( p_sys->p_root, "mdat" );
@@ -822,6 +904,8 @@ static int Open( vlc_object_t * p_this )
         MP4_Box_t *p_mehd = MP4_BoxGet( p_demux->p_sys->p_root, "moov/mvex/mehd");
         if ( p_mehd && p_mehd->data.p_mehd )
             p_sys->i_overall_duration = p_mehd->data.p_mehd->i_fragment_duration;
+        else if ( p_sys->p_fragindex )
+            LeafUpdateDuration( p_demux ); /* or once indexed */
         else
         {
             for( i = 0; i < p_sys->i_tracks; i++ )
@@ -865,6 +949,9 @@ static int Open( vlc_object_t * p_this )
     return VLC_SUCCESS;
 
 error:
+    if( p_sys->p_fragindex )
+        MP4_FragIndex_Delete( p_sys->p_fragindex );
+
     if( stream_Tell( p_demux->s ) > 0 )
         stream_Seek( p_demux->s, 0 );
 
@@ -1092,13 +1179,13 @@ static int Demux( demux_t *p_demux )
             {
                 tk = tk_tmp;
                 i_candidate_dts = i_dts;
-                i_candidate_pos = MP4_TrackGetPos( tk_tmp );
+                i_candidate_pos = MP4_TrackGetPos( p_demux, tk_tmp );
             }
         }
         else
         {
             /* Try to avoid seeking on non fastseekable. Will fail with non interleaved content */
-            uint64_t i_pos = MP4_TrackGetPos( tk_tmp );
+            uint64_t i_pos = MP4_TrackGetPos( p_demux, tk_tmp );
             if ( i_pos <= i_candidate_pos )
             {
                 i_candidate_pos = i_pos;
@@ -1132,7 +1219,7 @@ static int Demux( demux_t *p_demux )
              MP4_GetMoviePTS( p_sys ), i_candidate_pos );
 #endif
 
-    i_samplessize = MP4_TrackGetReadSize( tk, &i_nb_samples );
+    i_samplessize = MP4_TrackGetReadSize( p_demux, tk, &i_nb_samples );
     if( i_samplessize > 0 )
     {
         block_t *p_block;
@@ -1303,12 +1390,67 @@ static int LeafSeekIntoFragment( demux_t *p_demux, mp4_fragment_t *p_fragment )
     return VLC_SUCCESS;
 }
 
+static mp4_fragment_t * LeafGetFragmentByTime( demux_t *p_demux, mtime_t i_nztime )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    mp4_fragment_t *p_fragment = NULL;
+
+    /* Fill out temp track ID list */
+    unsigned *pi_tracksid = (unsigned *) malloc( sizeof(unsigned) * p_sys->i_tracks );
+    if(pi_tracksid)
+    {
+        for( unsigned i=0; i<p_sys->i_tracks; i++ )
+            pi_tracksid[i] = p_sys->track[i].i_track_ID;
+
+        p_fragment = GetFragmentByTime( &p_sys->fragments, i_nztime,
+                                    p_sys->i_tracks, pi_tracksid,
+                                    p_sys->i_timescale );
+        free( pi_tracksid );
+    }
+    return p_fragment;
+}
+
+/* Adds all the moof boxes of the file to the fragments, reading them from the
+ * first one. The ones already known are skipped */
+static void LeafProbeRemainingFragments( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const MP4_Box_t *p_moof = MP4_BoxGet( p_sys->p_root, "moof" );
+
+    if ( !p_moof || stream_Seek( p_demux->s, p_moof->i_pos ) )
+        return;
+
+    for ( ;; )
+    {
+        /* reads up to the next moof, skipping the mdat */
+        MP4_Box_t *p_vroot = MP4_BoxGetNextChunk( p_demux->s );
+        if ( !p_vroot )
+            break;
+
+        MP4_Box_t *p_mooxbox = MP4_BoxExtract( &p_vroot->p_first, ATOM_moof );
+        MP4_BoxFree( p_vroot );
+        if ( !p_mooxbox )
+            break;
+
+        if ( AddFragment( p_demux, p_mooxbox ) )
+        {
+            p_mooxbox->p_father = p_sys->p_root;
+            p_sys->p_root->p_last->p_next = p_mooxbox;
+            p_sys->p_root->p_last = p_mooxbox;
+        }
+        else
+            MP4_BoxFree( p_mooxbox );
+    }
+    p_sys->b_fragments_probed = true;
+}
+
 static int LeafSeekToTime( demux_t *p_demux, mtime_t i_nztime )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
     mp4_fragment_t *p_fragment = NULL;
     uint64_t i64 = 0;
-    if ( !p_sys->i_timescale || !p_sys->i_overall_duration || !p_sys->b_seekable )
+    if ( !p_sys->i_timescale || !p_sys->b_seekable ||
+         ( !p_sys->i_overall_duration && !p_sys->p_fragindex ) )
          return VLC_EGENERIC;
 
     if ( !p_sys->b_fragments_probed && !p_sys->b_index_probed && p_sys->b_seekable )
@@ -1318,26 +1460,22 @@ static int LeafSeekToTime( demux_t *p_demux, mtime_t i_nztime )
     }
 
     if ( p_demux->p_sys->b_fragments_probed )
-    {
-        /* Fill out temp track ID list */
-        unsigned *pi_tracksid = (unsigned *) malloc( sizeof(unsigned) * p_sys->i_tracks );
-        if(pi_tracksid)
-        {
-            for( unsigned i=0; i<p_sys->i_tracks; i++ )
-                pi_tracksid[i] = p_sys->track[i].i_track_ID;
-
-            p_fragment = GetFragmentByTime( &p_sys->fragments, i_nztime,
-                                        p_sys->i_tracks, pi_tracksid,
-                                        p_sys->i_timescale );
-            free( pi_tracksid );
-        }
-    }
+        p_fragment = LeafGetFragmentByTime( p_demux, i_nztime );
 
     if ( !p_fragment )
     {
         mtime_t i_mooftime;
         msg_Dbg( p_demux, "seek can't find matching fragment for %"PRId64", trying index", i_nztime );
-        if ( LeafIndexGetMoofPosByTime( p_demux, i_nztime, &i64, &i_mooftime ) == VLC_SUCCESS )
+        int i_ret = LeafIndexGetMoofPosByTime( p_demux, i_nztime, &i64, &i_mooftime );
+        if ( i_ret == VLC_ETIMEOUT && !vlc_killed() )
+        {
+            /* The background index is late: read the remaining fragments
+               with the demuxer stream, as without an index */
+            msg_Dbg( p_demux, "seek is probing the remaining fragments" );
+            LeafProbeRemainingFragments( p_demux );
+            p_fragment = LeafGetFragmentByTime( p_demux, i_nztime );
+        }
+        else if ( i_ret == VLC_SUCCESS )
         {
             msg_Dbg( p_demux, "seek trying to go to unknown but indexed fragment at %"PRId64, i64 );
             if( stream_Seek( p_demux->s, i64 ) )
@@ -1350,18 +1488,20 @@ static int LeafSeekToTime( demux_t *p_demux, mtime_t i_nztime )
             p_sys->context.p_fragment = NULL;
             for( unsigned int i_track = 0; i_track < p_sys->i_tracks; i_track++ )
             {
-                p_sys->track[i_track].i_time = i_mooftime / CLOCK_FREQ * p_sys->track[i_track].i_timescale;
+                p_sys->track[i_track].i_time = i_mooftime * p_sys->track[i_track].i_timescale / CLOCK_FREQ;
             }
-            p_sys->i_time = i_mooftime / CLOCK_FREQ * p_sys->i_timescale;
+            p_sys->i_time = i_mooftime * p_sys->i_timescale / CLOCK_FREQ;
             p_sys->i_pcr  = VLC_TS_INVALID;
         }
-        else
+
+        if ( i_ret != VLC_SUCCESS && !p_fragment )
         {
             msg_Warn( p_demux, "seek by index failed" );
             return VLC_EGENERIC;
         }
     }
-    else
+
+    if ( p_fragment )
     {
         msg_Dbg( p_demux, "seeking to fragment data starting at %"PRIu64" for time %"PRId64,
                            p_fragment->i_chunk_range_min_offset, i_nztime );
@@ -1773,6 +1913,9 @@ static void Close ( vlc_object_t * p_this )
 
     msg_Dbg( p_demux, "freeing all memory" );
 
+    if( p_sys->p_fragindex )
+        MP4_FragIndex_Delete( p_sys->p_fragindex );
+
     MP4_BoxFree( p_sys->p_root );
     for( i_track = 0; i_track < p_sys->i_tracks; i_track++ )
     {
@@ -1850,9 +1993,9 @@ static void LoadChapterApple( demux_t  *p_demux, mp4_track_t *tk )
         if ( !MP4_TrackGetPTSDelta( p_demux, tk, &i_pts_delta ) )
             i_pts_delta = 0;
         uint32_t i_nb_samples = 0;
-        const uint32_t i_size = MP4_TrackGetReadSize( tk, &i_nb_samples );
+        const uint32_t i_size = MP4_TrackGetReadSize( p_demux, tk, &i_nb_samples );
 
-        if( i_size > 0 && !stream_Seek( p_demux->s, MP4_TrackGetPos( tk ) ) )
+        if( i_size > 0 && !stream_Seek( p_demux->s, MP4_TrackGetPos( p_demux, tk ) ) )
         {
             char p_buffer[256];
             const uint32_t i_read = stream_ReadU32( p_demux->s, p_buffer,
@@ -1884,8 +2027,8 @@ static void LoadChapterApple( demux_t  *p_demux, mp4_track_t *tk )
                 TAB_APPEND( p_sys->p_title->i_seekpoint, p_sys->p_title->seekpoint, s );
             }
         }
-        if( tk->i_sample+1 >= tk->chunk[tk->i_chunk].i_sample_first +
-                              tk->chunk[tk->i_chunk].i_sample_count )
+        const mp4_chunk_t *ck = MP4_TrackGetChunk( p_demux, tk, tk->i_chunk );
+        if( tk->i_sample+1 >= ck->i_sample_first + ck->i_sample_count )
             tk->i_chunk++;
     }
 }
@@ -1951,6 +2094,45 @@ static bool MP4_TrackIsInterleaved( const mp4_track_t *p_track )
     return true;
 }
 
+/* The chunks of any page can only be built from the saved state of the
+ * sample tables if the stsc runs are in order, starting at the first chunk */
+static bool TrackCanIndexLazily( demux_t *p_demux, const mp4_track_t *p_track,
+                                 const MP4_Box_data_stsc_t *p_stsc )
+{
+    if( p_demux->p_sys->b_fragmented || p_track->i_chunk_count == 0 ||
+        p_stsc->i_entry_count == 0 || p_stsc->i_first_chunk[0] != 1 ||
+        !var_InheritBool( p_demux, "mp4-lazy-index" ) )
+        return false;
+
+    for( uint32_t i = 1; i < p_stsc->i_entry_count; i++ )
+    {
+        if( p_stsc->i_first_chunk[i] <= p_stsc->i_first_chunk[i - 1] )
+            return false;
+    }
+    return true;
+}
+
+static int TrackAllocChunkPages( mp4_track_t *p_track )
+{
+    const uint32_t i_pages = ( p_track->i_chunk_count - 1 ) / MP4_CHUNK_PAGE_SIZE + 1;
+
+    p_track->b_lazy = true;
+    p_track->p_pages = calloc( i_pages, sizeof( mp4_chunk_page_t ) );
+    if( p_track->p_pages == NULL )
+        return VLC_ENOMEM;
+
+    for( unsigned i = 0; i < MP4_CHUNK_PAGES; i++ )
+    {
+        p_track->pagecache[i].i_page = UINT32_MAX;
+        p_track->pagecache[i].p_chunks =
+            calloc( __MIN( p_track->i_chunk_count, MP4_CHUNK_PAGE_SIZE ),
+                    sizeof( mp4_chunk_t ) );
+        if( p_track->pagecache[i].p_chunks == NULL )
+            return VLC_ENOMEM;
+    }
+    return VLC_SUCCESS;
+}
+
 /* now create basic chunk data, the rest will be filled by MP4_CreateSamplesIndex */
 static int TrackCreateChunksIndex( demux_t *p_demux,
                                    mp4_track_t *p_demux_track )
@@ -1975,6 +2157,22 @@ static int TrackCreateChunksIndex( demux_t *p_demux,
     {
         msg_Warn( p_demux, "no chunk defined" );
     }
+
+    mp4_fragment_t *p_moovfragment = MP4_Fragment_Moov( &p_sys->fragments );
+    if ( p_demux_track->i_chunk_count && (
+             p_moovfragment->i_chunk_range_min_offset == 0 ||
+             p_moovfragment->i_chunk_range_min_offset > BOXDATA(p_co64)->i_chunk_offset[0]
+             ) )
+        p_moovfragment->i_chunk_range_min_offset = BOXDATA(p_co64)->i_chunk_offset[0];
+
+    /* chunks will only be built by pages when accessed */
+    if( TrackCanIndexLazily( p_demux, p_demux_track, BOXDATA(p_stsc) ) )
+    {
+        msg_Dbg( p_demux, "track[Id 0x%x] has %d chunk, indexed on demand",
+                 p_demux_track->i_track_ID, p_demux_track->i_chunk_count );
+        return TrackAllocChunkPages( p_demux_track );
+    }
+
     p_demux_track->chunk = calloc( p_demux_track->i_chunk_count,
                                    sizeof( mp4_chunk_t ) );
     if( p_demux_track->chunk == NULL )
@@ -2037,13 +2235,6 @@ static int TrackCreateChunksIndex( demux_t *p_demux,
     msg_Dbg( p_demux, "track[Id 0x%x] read %d chunk",
              p_demux_track->i_track_ID, p_demux_track->i_chunk_count );
 
-    mp4_fragment_t *p_moovfragment = MP4_Fragment_Moov( &p_sys->fragments );
-    if ( p_demux_track->i_chunk_count && (
-             p_moovfragment->i_chunk_range_min_offset == 0 ||
-             p_moovfragment->i_chunk_range_min_offset > p_demux_track->chunk[0].i_offset
-             ) )
-        p_moovfragment->i_chunk_range_min_offset = p_demux_track->chunk[0].i_offset;
-
     return VLC_SUCCESS;
 }
 
@@ -2095,6 +2286,250 @@ static int xTTS_CountEntries( demux_t *p_demux, uint32_t *pi_entry /* out */,
     return VLC_SUCCESS;
 }
 
+/* Fills the dts table of a chunk from the stts table, starting at the stts
+ * position and dts of p_state which are then moved to the next chunk.
+ * The table is only walked through, not stored, if b_alloc is false */
+static int TrackFillChunkDTS( demux_t *p_demux, const MP4_Box_data_stts_t *stts,
+                              mp4_chunk_t *ck, bool b_alloc,
+                              mp4_chunk_page_t *p_state )
+{
+    uint32_t i_entries = 0;
+    uint32_t *p_count = NULL;
+    uint32_t *p_delta = NULL;
+    int i_ret = VLC_SUCCESS;
+
+    /* save first dts */
+    ck->i_first_dts = p_state->i_first_dts;
+    ck->i_last_dts  = p_state->i_first_dts;
+
+    /* count how many entries are needed for this chunk
+     * for p_sample_delta_dts and p_sample_count_dts */
+    if( xTTS_CountEntries( p_demux, &i_entries, p_state->i_stts_index,
+                           p_state->i_stts_left, ck->i_sample_count,
+                           stts->pi_sample_count,
+                           stts->i_entry_count ) == VLC_EGENERIC )
+        return VLC_EGENERIC;
+
+    /* allocate them */
+    if( b_alloc )
+    {
+        p_count = calloc( i_entries, sizeof( uint32_t ) );
+        p_delta = calloc( i_entries, sizeof( uint32_t ) );
+        if( !p_count || !p_delta )
+        {
+            free( p_count );
+            free( p_delta );
+            p_count = p_delta = NULL;
+            msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, i_entries );
+            i_ret = VLC_ENOMEM;
+        }
+    }
+
+    /* now copy */
+    uint32_t i_sample_count = ck->i_sample_count;
+
+    for( uint32_t i = 0; i < i_entries; i++ )
+    {
+        const uint32_t i_delta = stts->pi_sample_delta[p_state->i_stts_index];
+        uint32_t i_run;
+
+        if( p_state->i_stts_left )
+        {
+            if( p_state->i_stts_left > i_sample_count )
+            {
+                i_run = i_sample_count;
+                p_state->i_stts_left -= i_sample_count;
+            }
+            else
+            {
+                i_run = p_state->i_stts_left;
+                p_state->i_stts_left = 0;
+                p_state->i_stts_index++;
+            }
+        }
+        else
+        {
+            if( stts->pi_sample_count[p_state->i_stts_index] > i_sample_count )
+            {
+                i_run = i_sample_count;
+                // keep building from same index
+                p_state->i_stts_left = stts->pi_sample_count[p_state->i_stts_index] - i_sample_count;
+            }
+            else
+            {
+                i_run = stts->pi_sample_count[p_state->i_stts_index];
+                p_state->i_stts_index++;
+            }
+        }
+
+        if( i_run ) ck->i_last_dts = p_state->i_first_dts;
+        if( p_count )
+        {
+            p_count[i] = i_run;
+            p_delta[i] = i_delta;
+        }
+        p_state->i_first_dts += i_run * i_delta;
+        i_sample_count -= i_run;
+
+        /* stopped within an stts entry, no samples left */
+        if( p_state->i_stts_left )
+        {
+            assert( i == i_entries - 1 );
+            break;
+        }
+    }
+
+    ck->i_entries_dts = p_count ? i_entries : 0;
+    ck->p_sample_count_dts = p_count;
+    ck->p_sample_delta_dts = p_delta;
+
+    return i_ret;
+}
+
+/* Same as TrackFillChunkDTS, for the pts-dts table from the ctts table */
+static int TrackFillChunkPTS( demux_t *p_demux, const MP4_Box_data_ctts_t *ctts,
+                              mp4_chunk_t *ck, bool b_alloc,
+                              mp4_chunk_page_t *p_state )
+{
+    uint32_t i_entries = 0;
+    uint32_t *p_count = NULL;
+    int32_t *p_offset = NULL;
+    int i_ret = VLC_SUCCESS;
+
+    /* count how many entries are needed for this chunk
+     * for p_sample_offset_pts and p_sample_count_pts */
+    if( xTTS_CountEntries( p_demux, &i_entries, p_state->i_ctts_index,
+                           p_state->i_ctts_left, ck->i_sample_count,
+                           ctts->pi_sample_count,
+                           ctts->i_entry_count ) == VLC_EGENERIC )
+        return VLC_EGENERIC;
+
+    /* allocate them */
+    if( b_alloc )
+    {
+        p_count = calloc( i_entries, sizeof( uint32_t ) );
+        p_offset = calloc( i_entries, sizeof( int32_t ) );
+        if( !p_count || !p_offset )
+        {
+            free( p_count );
+            free( p_offset );
+            p_count = NULL;
+            p_offset = NULL;
+            msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, i_entries );
+            i_ret = VLC_ENOMEM;
+        }
+    }
+
+    /* now copy */
+    uint32_t i_sample_count = ck->i_sample_count;
+
+    for( uint32_t i = 0; i < i_entries; i++ )
+    {
+        const int32_t i_offset = ctts->pi_sample_offset[p_state->i_ctts_index];
+        uint32_t i_run;
+
+        if( p_state->i_ctts_left )
+        {
+            if( p_state->i_ctts_left > i_sample_count )
+            {
+                i_run = i_sample_count;
+                p_state->i_ctts_left -= i_sample_count;
+            }
+            else
+            {
+                i_run = p_state->i_ctts_left;
+                p_state->i_ctts_left = 0;
+                p_state->i_ctts_index++;
+            }
+        }
+        else
+        {
+            if( ctts->pi_sample_count[p_state->i_ctts_index] > i_sample_count )
+            {
+                i_run = i_sample_count;
+                // keep building from same index
+                p_state->i_ctts_left = ctts->pi_sample_count[p_state->i_ctts_index] - i_sample_count;
+            }
+            else
+            {
+                i_run = ctts->pi_sample_count[p_state->i_ctts_index];
+                p_state->i_ctts_index++;
+            }
+        }
+
+        if( p_count )
+        {
+            p_count[i] = i_run;
+            p_offset[i] = i_offset;
+        }
+        i_sample_count -= i_run;
+
+        if( p_state->i_ctts_left )
+        {
+            assert( i == i_entries - 1 );
+            break;
+        }
+    }
+
+    ck->i_entries_pts = p_count ? i_entries : 0;
+    ck->p_sample_count_pts = p_count;
+    ck->p_sample_offset_pts = p_offset;
+
+    return i_ret;
+}
+
+/* Walks through the chunks of a page of a lazily indexed track, from the
+ * state of the sample tables at its start, and builds them into p_chunks
+ * unless it is NULL */
+static int TrackWalkChunks( demux_t *p_demux, mp4_track_t *p_track,
+                            uint32_t i_page, mp4_chunk_page_t *p_state,
+                            mp4_chunk_t *p_chunks )
+{
+    MP4_Box_t *p_co64 = MP4_BoxGet( p_track->p_stbl, "stco" );
+    if( !p_co64 )
+        p_co64 = MP4_BoxGet( p_track->p_stbl, "co64" );
+    MP4_Box_t *p_stsc = MP4_BoxGet( p_track->p_stbl, "stsc" );
+    MP4_Box_t *p_stts = MP4_BoxGet( p_track->p_stbl, "stts" );
+    MP4_Box_t *p_ctts = MP4_BoxGet( p_track->p_stbl, "ctts" );
+    if( !p_co64 || !p_stsc || !p_stts )
+        return VLC_EGENERIC;
+
+    const uint32_t i_first = i_page * MP4_CHUNK_PAGE_SIZE;
+    const uint32_t i_count = __MIN( MP4_CHUNK_PAGE_SIZE,
+                                    p_track->i_chunk_count - i_first );
+
+    for( uint32_t i = 0; i < i_count; i++ )
+    {
+        const uint32_t i_chunk = i_first + i;
+        mp4_chunk_t skipped;
+        mp4_chunk_t *ck = p_chunks ? &p_chunks[i] : &skipped;
+
+        while( p_state->i_stsc_index + 1 < BOXDATA(p_stsc)->i_entry_count &&
+               BOXDATA(p_stsc)->i_first_chunk[p_state->i_stsc_index + 1] - 1 <= i_chunk )
+            p_state->i_stsc_index++;
+
+        ck->i_offset = BOXDATA(p_co64)->i_chunk_offset[i_chunk];
+        ck->i_sample_description_index =
+                BOXDATA(p_stsc)->i_sample_description_index[p_state->i_stsc_index];
+        ck->i_sample_count =
+                BOXDATA(p_stsc)->i_samples_per_chunk[p_state->i_stsc_index];
+        ck->i_sample_first = p_state->i_sample_first;
+        p_state->i_sample_first += ck->i_sample_count;
+
+        /* allocation failures only leave the chunk without dts/pts table */
+        if( TrackFillChunkDTS( p_demux, BOXDATA(p_stts), ck,
+                               p_chunks != NULL, p_state ) == VLC_EGENERIC )
+            return VLC_EGENERIC;
+
+        if( p_ctts && p_ctts->data.p_ctts &&
+            TrackFillChunkPTS( p_demux, BOXDATA(p_ctts), ck,
+                               p_chunks != NULL, p_state ) == VLC_EGENERIC )
+            return VLC_EGENERIC;
+    }
+
+    return VLC_SUCCESS;
+}
+
 static int TrackCreateSamplesIndex( demux_t *p_demux,
                                     mp4_track_t *p_demux_track )
 {
@@ -2125,9 +2560,15 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
         p_demux_track->i_sample_size = stsz->i_sample_size;
         p_demux_track->p_sample_size = NULL;
     }
+    else if( p_demux_track->b_lazy )
+    {
+        /* 2: each sample can have a different size, use the box table */
+        p_demux_track->i_sample_size = 0;
+        p_demux_track->p_sample_size = stsz->i_entry_size;
+    }
     else
     {
-        /* 2: each sample can have a different size */
+        /* 3: each sample can have a different size */
         p_demux_track->i_sample_size = 0;
         p_demux_track->p_sample_size =
             calloc( p_demux_track->i_sample_count, sizeof( uint32_t ) );
@@ -2141,44 +2582,12 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
         }
     }
 
-    if ( p_demux_track->i_chunk_count )
-    {
-        mp4_chunk_t *lastchunk = &p_demux_track->chunk[p_demux_track->i_chunk_count - 1];
-        uint64_t i_total_size = lastchunk->i_offset;
-
-        if ( p_demux_track->i_sample_size != 0 ) /* all samples have same size */
-        {
-            i_total_size += (uint64_t)p_demux_track->i_sample_size * lastchunk->i_sample_count;
-        }
-        else
-        {
-            if( (uint64_t)lastchunk->i_sample_count + p_demux_track->i_chunk_count - 1 > stsz->i_sample_count )
-            {
-                msg_Err( p_demux, "invalid samples table: stsz table is too small" );
-                return VLC_EGENERIC;
-            }
-
-            for( uint32_t i=stsz->i_sample_count - lastchunk->i_sample_count;
-                 i<stsz->i_sample_count; i++)
-            {
-                i_total_size += stsz->i_entry_size[i];
-            }
-        }
-
-        if ( i_total_size > MP4_Fragment_Moov( &p_sys->fragments )->i_chunk_range_max_offset )
-            MP4_Fragment_Moov( &p_sys->fragments )->i_chunk_range_max_offset = i_total_size;
-    }
-
     /* Use stts table to create a sample number -> dts table.
      * XXX: if we don't want to waste too much memory, we can't expand
      *  the box! so each chunk will contain an "extract" of this table
      *  for fast research (problem with raw stream where a sample is sometime
      *  just channels*bits_per_sample/8 */
 
-     /* FIXME: refactor STTS & CTTS, STTS having now only few extra lines and
-      *        differing in 2/2 fields and 1 signedness */
-
-    mtime_t i_next_dts = 0;
     /* Find stts
      *  Gives mapping between sample and decoding time
      */
@@ -2188,214 +2597,92 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
         msg_Warn( p_demux, "cannot find STTS box" );
         return VLC_EGENERIC;
     }
-    else
-    {
-        MP4_Box_data_stts_t *stts = p_box->data.p_stts;
-
-        msg_Warn( p_demux, "STTS table of %"PRIu32" entries", stts->i_entry_count );
-
-        /* Create sample -> dts table per chunk */
-        uint32_t i_index = 0;
-        uint32_t i_current_index_samples_left = 0;
-
-        for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
-        {
-            mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            uint32_t i_sample_count;
-
-            /* save first dts */
-            ck->i_first_dts = i_next_dts;
-            ck->i_last_dts  = i_next_dts;
-
-            /* count how many entries are needed for this chunk
-             * for p_sample_delta_dts and p_sample_count_dts */
-            ck->i_entries_dts = 0;
-
-            int i_ret = xTTS_CountEntries( p_demux, &ck->i_entries_dts, i_index,
-                                           i_current_index_samples_left,
-                                           ck->i_sample_count,
-                                           stts->pi_sample_count,
-                                           stts->i_entry_count );
-            if ( i_ret == VLC_EGENERIC )
-                return i_ret;
-
-            /* allocate them */
-            ck->p_sample_count_dts = calloc( ck->i_entries_dts, sizeof( uint32_t ) );
-            ck->p_sample_delta_dts = calloc( ck->i_entries_dts, sizeof( uint32_t ) );
-            if( !ck->p_sample_count_dts || !ck->p_sample_delta_dts )
-            {
-                free( ck->p_sample_count_dts );
-                free( ck->p_sample_delta_dts );
-                msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_dts );
-                ck->i_entries_dts = 0;
-                return VLC_ENOMEM;
-            }
-
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
-
-            for( uint32_t i = 0; i < ck->i_entries_dts; i++ )
-            {
-                if ( i_current_index_samples_left )
-                {
-                    if ( i_current_index_samples_left > i_sample_count )
-                    {
-                        if ( i_sample_count ) ck->i_last_dts = i_next_dts;
-                        ck->p_sample_count_dts[i] = i_sample_count;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        i_current_index_samples_left -= i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_dts - 1 );
-                        break;
-                    }
-                    else
-                    {
-                        if ( i_current_index_samples_left ) ck->i_last_dts = i_next_dts;
-                        ck->p_sample_count_dts[i] = i_current_index_samples_left;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        i_sample_count -= i_current_index_samples_left;
-                        i_current_index_samples_left = 0;
-                        i_index++;
-                    }
-                }
-                else
-                {
-                    if ( stts->pi_sample_count[i_index] > i_sample_count )
-                    {
-                        if ( i_sample_count ) ck->i_last_dts = i_next_dts;
-                        ck->p_sample_count_dts[i] = i_sample_count;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        i_current_index_samples_left = stts->pi_sample_count[i_index] - i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_dts - 1 );
-                        // keep building from same index
-                    }
-                    else
-                    {
-                        if ( stts->pi_sample_count[i_index] ) ck->i_last_dts = i_next_dts;
-                        ck->p_sample_count_dts[i] = stts->pi_sample_count[i_index];
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        i_sample_count -= stts->pi_sample_count[i_index];
-                        i_index++;
-                    }
-                }
-
-            }
-        }
-    }
-
+    MP4_Box_data_stts_t *stts = p_box->data.p_stts;
+    msg_Warn( p_demux, "STTS table of %"PRIu32" entries", stts->i_entry_count );
 
     /* Find ctts
      *  Gives the delta between decoding time (dts) and composition table (pts)
      */
+    MP4_Box_data_ctts_t *ctts = NULL;
     p_box = MP4_BoxGet( p_demux_track->p_stbl, "ctts" );
     if( p_box && p_box->data.p_ctts )
     {
-        MP4_Box_data_ctts_t *ctts = p_box->data.p_ctts;
-
+        ctts = p_box->data.p_ctts;
         msg_Warn( p_demux, "CTTS table of %"PRIu32" entries", ctts->i_entry_count );
+    }
 
-        /* Create pts-dts table per chunk */
-        uint32_t i_index = 0;
-        uint32_t i_current_index_samples_left = 0;
-
+    /* Create sample -> dts and pts-dts tables per chunk */
+    mp4_chunk_page_t state = { 0 };
+    if( p_demux_track->b_lazy )
+    {
+        /* only keep the state of the tables at the start of each page */
+        for( uint32_t i_page = 0;
+             i_page <= ( p_demux_track->i_chunk_count - 1 ) / MP4_CHUNK_PAGE_SIZE;
+             i_page++ )
+        {
+            p_demux_track->p_pages[i_page] = state;
+            int i_ret = TrackWalkChunks( p_demux, p_demux_track, i_page, &state, NULL );
+            if( i_ret != VLC_SUCCESS )
+                return i_ret;
+        }
+    }
+    else
+    {
         for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
         {
             mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            uint32_t i_sample_count;
-
-            /* count how many entries are needed for this chunk
-             * for p_sample_offset_pts and p_sample_count_pts */
-            ck->i_entries_pts = 0;
-            int i_ret = xTTS_CountEntries( p_demux, &ck->i_entries_pts, i_index,
-                                           i_current_index_samples_left,
-                                           ck->i_sample_count,
-                                           ctts->pi_sample_count,
-                                           ctts->i_entry_count );
-            if ( i_ret == VLC_EGENERIC )
+
+            int i_ret = TrackFillChunkDTS( p_demux, stts, ck, true, &state );
+            if( i_ret == VLC_SUCCESS && ctts )
+                i_ret = TrackFillChunkPTS( p_demux, ctts, ck, true, &state );
+            if( i_ret != VLC_SUCCESS )
                 return i_ret;
+        }
+    }
+
+    if ( p_demux_track->i_chunk_count )
+    {
+        const mp4_chunk_t *lastchunk =
+            MP4_TrackGetChunk( p_demux, p_demux_track, p_demux_track->i_chunk_count - 1 );
+        uint64_t i_total_size = lastchunk->i_offset;
 
-            /* allocate them */
-            ck->p_sample_count_pts = calloc( ck->i_entries_pts, sizeof( uint32_t ) );
-            ck->p_sample_offset_pts = calloc( ck->i_entries_pts, sizeof( int32_t ) );
-            if( !ck->p_sample_count_pts || !ck->p_sample_offset_pts )
+        if ( p_demux_track->i_sample_size != 0 ) /* all samples have same size */
+        {
+            i_total_size += (uint64_t)p_demux_track->i_sample_size * lastchunk->i_sample_count;
+        }
+        else
+        {
+            if( (uint64_t)lastchunk->i_sample_count + p_demux_track->i_chunk_count - 1 > stsz->i_sample_count )
             {
-                free( ck->p_sample_count_pts );
-                free( ck->p_sample_offset_pts );
-                msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_pts );
-                ck->i_entries_pts = 0;
-                return VLC_ENOMEM;
+                msg_Err( p_demux, "invalid samples table: stsz table is too small" );
+                return VLC_EGENERIC;
             }
 
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
-
-            for( uint32_t i = 0; i < ck->i_entries_pts; i++ )
+            for( uint32_t i=stsz->i_sample_count - lastchunk->i_sample_count;
+                 i<stsz->i_sample_count; i++)
             {
-                if ( i_current_index_samples_left )
-                {
-                    if ( i_current_index_samples_left > i_sample_count )
-                    {
-                        ck->p_sample_count_pts[i] = i_sample_count;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_current_index_samples_left -= i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_pts - 1 );
-                        break;
-                    }
-                    else
-                    {
-                        ck->p_sample_count_pts[i] = i_current_index_samples_left;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_sample_count -= i_current_index_samples_left;
-                        i_current_index_samples_left = 0;
-                        i_index++;
-                    }
-                }
-                else
-                {
-                    if ( ctts->pi_sample_count[i_index] > i_sample_count )
-                    {
-                        ck->p_sample_count_pts[i] = i_sample_count;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_current_index_samples_left = ctts->pi_sample_count[i_index] - i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_pts - 1 );
-                        // keep building from same index
-                    }
-                    else
-                    {
-                        ck->p_sample_count_pts[i] = ctts->pi_sample_count[i_index];
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_sample_count -= ctts->pi_sample_count[i_index];
-                        i_index++;
-                    }
-                }
-
-
+                i_total_size += stsz->i_entry_size[i];
             }
         }
+
+        if ( i_total_size > MP4_Fragment_Moov( &p_sys->fragments )->i_chunk_range_max_offset )
+            MP4_Fragment_Moov( &p_sys->fragments )->i_chunk_range_max_offset = i_total_size;
     }
 
     msg_Dbg( p_demux, "track[Id 0x%x] read %"PRIu32" samples length:%"PRId64"s",
              p_demux_track->i_track_ID, p_demux_track->i_sample_count,
-             i_next_dts / p_demux_track->i_timescale );
+             (int64_t) state.i_first_dts / p_demux_track->i_timescale );
 
     return VLC_SUCCESS;
 }
 
-
 /**
  * It computes the sample rate for a video track using the given sample
  * description index
  */
 static void TrackGetESSampleRate( demux_t *p_demux,
                                   unsigned *pi_num, unsigned *pi_den,
-                                  const mp4_track_t *p_track,
+                                  mp4_track_t *p_track,
                                   unsigned i_sd_index,
                                   unsigned i_chunk )
 {
@@ -2418,24 +2705,24 @@ static void TrackGetESSampleRate( demux_t *p_demux,
         return;
 
     /* */
-    const mp4_chunk_t *p_chunk = &p_track->chunk[i_chunk];
-    while( p_chunk > &p_track->chunk[0] &&
-           p_chunk[-1].i_sample_description_index == i_sd_index )
+    while( i_chunk > 0 &&
+           MP4_TrackGetChunk( p_demux, p_track, i_chunk - 1 )->i_sample_description_index == i_sd_index )
     {
-        p_chunk--;
+        i_chunk--;
     }
 
     uint64_t i_sample = 0;
-    uint64_t i_first_dts = p_chunk->i_first_dts;
+    uint64_t i_first_dts = MP4_TrackGetChunk( p_demux, p_track, i_chunk )->i_first_dts;
     uint64_t i_last_dts;
     do
     {
+        const mp4_chunk_t *p_chunk = MP4_TrackGetChunk( p_demux, p_track, i_chunk );
         i_sample += p_chunk->i_sample_count;
         i_last_dts = p_chunk->i_last_dts;
-        p_chunk++;
+        i_chunk++;
     }
-    while( p_chunk < &p_track->chunk[p_track->i_chunk_count] &&
-           p_chunk->i_sample_description_index == i_sd_index );
+    while( i_chunk < p_track->i_chunk_count &&
+           MP4_TrackGetChunk( p_demux, p_track, i_chunk )->i_sample_description_index == i_sd_index );
 
     if( i_sample > 1 && i_first_dts < i_last_dts )
         vlc_ureduce( pi_num, pi_den,
@@ -2458,7 +2745,7 @@ static int TrackCreateES( demux_t *p_demux, mp4_track_t *p_track,
         i_sample_description_index = 1; /* XXX */
     else
         i_sample_description_index =
-                p_track->chunk[i_chunk].i_sample_description_index;
+                MP4_TrackGetChunk( p_demux, p_track, i_chunk )->i_sample_description_index;
 
     if( pp_es )
         *pp_es = NULL;
@@ -2662,8 +2949,25 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
     }
 
     /* we start from sample 0/chunk 0, hope it won't take too much time */
+    i_chunk = 0;
+    if( p_track->b_lazy )
+    {
+        /* or from the last page starting before i_start */
+        uint32_t i_low = 0;
+        uint32_t i_high = ( p_track->i_chunk_count - 1 ) / MP4_CHUNK_PAGE_SIZE;
+        while( i_low < i_high )
+        {
+            uint32_t i_mid = i_low + ( i_high - i_low + 1 ) / 2;
+            if( (uint64_t)i_start >= p_track->p_pages[i_mid].i_first_dts )
+                i_low = i_mid;
+            else
+                i_high = i_mid - 1;
+        }
+        i_chunk = i_low * MP4_CHUNK_PAGE_SIZE;
+    }
+
     /* *** find good chunk *** */
-    for( i_chunk = 0; ; i_chunk++ )
+    for( ; ; i_chunk++ )
     {
         if( i_chunk + 1 >= p_track->i_chunk_count )
         {
@@ -2673,37 +2977,41 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
             break;
         }
 
-        if( (uint64_t)i_start >= p_track->chunk[i_chunk].i_first_dts &&
-            (uint64_t)i_start <  p_track->chunk[i_chunk + 1].i_first_dts )
+        const uint64_t i_next_dts =
+            MP4_TrackGetChunk( p_demux, p_track, i_chunk + 1 )->i_first_dts;
+        if( (uint64_t)i_start >= MP4_TrackGetChunk( p_demux, p_track, i_chunk )->i_first_dts &&
+            (uint64_t)i_start <  i_next_dts )
         {
             break;
         }
     }
 
     /* *** find sample in the chunk *** */
-    i_sample = p_track->chunk[i_chunk].i_sample_first;
-    i_dts    = p_track->chunk[i_chunk].i_first_dts;
-    for( i_index = 0; i_sample < p_track->chunk[i_chunk].i_sample_count; )
+    const mp4_chunk_t *ck = MP4_TrackGetChunk( p_demux, p_track, i_chunk );
+    i_sample = ck->i_sample_first;
+    i_dts    = ck->i_first_dts;
+    for( i_index = 0; i_sample < ck->i_sample_count &&
+                      (uint32_t)i_index < ck->i_entries_dts; )
     {
         if( i_dts +
-            p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
-            p_track->chunk[i_chunk].p_sample_delta_dts[i_index] < (uint64_t)i_start )
+            ck->p_sample_count_dts[i_index] *
+            ck->p_sample_delta_dts[i_index] < (uint64_t)i_start )
         {
             i_dts    +=
-                p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
-                p_track->chunk[i_chunk].p_sample_delta_dts[i_index];
+                ck->p_sample_count_dts[i_index] *
+                ck->p_sample_delta_dts[i_index];
 
-            i_sample += p_track->chunk[i_chunk].p_sample_count_dts[i_index];
+            i_sample += ck->p_sample_count_dts[i_index];
             i_index++;
         }
         else
         {
-            if( p_track->chunk[i_chunk].p_sample_delta_dts[i_index] <= 0 )
+            if( ck->p_sample_delta_dts[i_index] <= 0 )
             {
                 break;
             }
             i_sample += ( i_start - i_dts ) /
-                p_track->chunk[i_chunk].p_sample_delta_dts[i_index];
+                ck->p_sample_delta_dts[i_index];
             break;
         }
     }
@@ -2726,15 +3034,18 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
         if( i_sync_sample <= i_sample )
         {
             while( i_chunk > 0 &&
-                   i_sync_sample < p_track->chunk[i_chunk].i_sample_first )
+                   i_sync_sample < MP4_TrackGetChunk( p_demux, p_track, i_chunk )->i_sample_first )
                 i_chunk--;
         }
         else
         {
-            while( i_chunk < p_track->i_chunk_count - 1 &&
-                   i_sync_sample >= p_track->chunk[i_chunk].i_sample_first +
-                                    p_track->chunk[i_chunk].i_sample_count )
+            while( i_chunk < p_track->i_chunk_count - 1 )
+            {
+                ck = MP4_TrackGetChunk( p_demux, p_track, i_chunk );
+                if( i_sync_sample < ck->i_sample_first + ck->i_sample_count )
+                    break;
                 i_chunk++;
+            }
         }
         i_sample = i_sync_sample;
     }
@@ -2752,8 +3063,8 @@ static int TrackGotoChunkSample( demux_t *p_demux, mp4_track_t *p_track,
 
     /* now see if actual es is ok */
     if( p_track->i_chunk >= p_track->i_chunk_count ||
-        p_track->chunk[p_track->i_chunk].i_sample_description_index !=
-            p_track->chunk[i_chunk].i_sample_description_index )
+        MP4_TrackGetChunk( p_demux, p_track, p_track->i_chunk )->i_sample_description_index !=
+            MP4_TrackGetChunk( p_demux, p_track, i_chunk )->i_sample_description_index )
     {
         msg_Warn( p_demux, "recreate ES for track[Id 0x%x]",
                   p_track->i_track_ID );
@@ -2783,7 +3094,8 @@ static int TrackGotoChunkSample( demux_t *p_demux, mp4_track_t *p_track,
     }
 
     p_track->i_chunk    = i_chunk;
-    p_track->chunk[i_chunk].i_sample = i_sample - p_track->chunk[i_chunk].i_sample_first;
+    mp4_chunk_t *ck = MP4_TrackGetChunk( p_demux, p_track, i_chunk );
+    ck->i_sample        = i_sample - ck->i_sample_first;
     p_track->i_sample   = i_sample;
 
     return p_track->b_selected ? VLC_SUCCESS : VLC_EGENERIC;
@@ -3147,6 +3459,44 @@ static void DestroyChunk( mp4_chunk_t *ck )
     free( ck->p_sample_size );
 }
 
+/* Builds the chunks of a page of a lazily indexed track, in place of the
+ * least recently used page, which is never the one of the current chunk */
+static mp4_chunk_t * TrackLoadChunkPage( demux_t *p_demux, mp4_track_t *p_track,
+                                         uint32_t i_page )
+{
+    const uint32_t i_current = p_track->i_chunk / MP4_CHUNK_PAGE_SIZE;
+    unsigned i_slot = MP4_CHUNK_PAGES;
+
+    for( unsigned i = 0; i < MP4_CHUNK_PAGES; i++ )
+    {
+        if( p_track->pagecache[i].i_page == UINT32_MAX )
+        {
+            i_slot = i;
+            break;
+        }
+        if( p_track->pagecache[i].i_page != i_current &&
+            ( i_slot == MP4_CHUNK_PAGES ||
+              p_track->pagecache[i].i_use < p_track->pagecache[i_slot].i_use ) )
+            i_slot = i;
+    }
+    assert( i_slot < MP4_CHUNK_PAGES );
+
+    mp4_chunk_t *p_chunks = p_track->pagecache[i_slot].p_chunks;
+    const uint32_t i_chunks = __MIN( p_track->i_chunk_count, MP4_CHUNK_PAGE_SIZE );
+    for( uint32_t i = 0; i < i_chunks; i++ )
+        DestroyChunk( &p_chunks[i] );
+    memset( p_chunks, 0, i_chunks * sizeof( mp4_chunk_t ) );
+
+    /* tables were checked while opening, only allocations can fail */
+    mp4_chunk_page_t state = p_track->p_pages[i_page];
+    TrackWalkChunks( p_demux, p_track, i_page, &state, p_chunks );
+
+    p_track->pagecache[i_slot].i_page = i_page;
+    p_track->pagecache[i_slot].i_use = ++p_track->i_pagecache_use;
+
+    return p_chunks;
+}
+
 /****************************************************************************
  * MP4_TrackDestroy:
  ****************************************************************************
@@ -3166,6 +3516,17 @@ static void MP4_TrackDestroy( demux_t *p_demux, mp4_track_t *p_track )
     }
     free( p_track->chunk );
 
+    for( unsigned i = 0; i < MP4_CHUNK_PAGES; i++ )
+    {
+        if( p_track->pagecache[i].p_chunks == NULL )
+            continue;
+        for( uint32_t i_chunk = 0; i_chunk < MP4_CHUNK_PAGE_SIZE &&
+                                   i_chunk < p_track->i_chunk_count; i_chunk++ )
+            DestroyChunk( &p_track->pagecache[i].p_chunks[i_chunk] );
+        free( p_track->pagecache[i].p_chunks );
+    }
+    free( p_track->p_pages );
+
     if( p_track->cchunk )
     {
         assert( p_demux->p_sys->b_fragmented );
@@ -3173,7 +3534,7 @@ static void MP4_TrackDestroy( demux_t *p_demux, mp4_track_t *p_track )
         free( p_track->cchunk );
     }
 
-    if( !p_track->i_sample_size )
+    if( !p_track->i_sample_size && !p_track->b_lazy ) /* else points to stsz */
         free( p_track->p_sample_size );
 
     if ( p_track->asfinfo.p_frame )
@@ -3285,7 +3646,8 @@ static inline uint32_t MP4_GetFixedSampleSize( const mp4_track_t *p_track,
     return i_size;
 }
 
-static uint32_t MP4_TrackGetReadSize( mp4_track_t *p_track, uint32_t *pi_nb_samples )
+static uint32_t MP4_TrackGetReadSize( demux_t *p_demux, mp4_track_t *p_track,
+                                      uint32_t *pi_nb_samples )
 {
     uint32_t i_size = 0;
     *pi_nb_samples = 0;
@@ -3305,7 +3667,7 @@ static uint32_t MP4_TrackGetReadSize( mp4_track_t *p_track, uint32_t *pi_nb_samp
     else
     {
         const MP4_Box_data_sample_soun_t *p_soun = p_track->p_sample->data.p_sample_soun;
-        const mp4_chunk_t *p_chunk = &p_track->chunk[p_track->i_chunk];
+        const mp4_chunk_t *p_chunk = MP4_TrackGetChunk( p_demux, p_track, p_track->i_chunk );
         uint32_t i_max_samples = p_chunk->i_sample_count - p_chunk->i_sample;
 
         /* Group audio packets so we don't call demux for single sample unit */
@@ -3433,12 +3795,13 @@ static uint32_t MP4_TrackGetReadSize( mp4_track_t *p_track, uint32_t *pi_nb_samp
     return i_size;
 }
 
-static uint64_t MP4_TrackGetPos( mp4_track_t *p_track )
+static uint64_t MP4_TrackGetPos( demux_t *p_demux, mp4_track_t *p_track )
 {
+    const mp4_chunk_t *ck = MP4_TrackGetChunk( p_demux, p_track, p_track->i_chunk );
     unsigned int i_sample;
     uint64_t i_pos;
 
-    i_pos = p_track->chunk[p_track->i_chunk].i_offset;
+    i_pos = ck->i_offset;
 
     if( p_track->i_sample_size )
     {
@@ -3453,7 +3816,7 @@ static uint64_t MP4_TrackGetPos( mp4_track_t *p_track )
             {
             case VLC_CODEC_GSM: /* # Samples > data size */
                 i_pos += ( p_track->i_sample -
-                           p_track->chunk[p_track->i_chunk].i_sample_first ) / 160 * 33;
+                           ck->i_sample_first ) / 160 * 33;
                 return i_pos;
             default:
                 break;
@@ -3465,19 +3828,19 @@ static uint64_t MP4_TrackGetPos( mp4_track_t *p_track )
             p_soun->i_sample_per_packet * p_soun->i_bytes_per_frame == 0 )
         {
             i_pos += ( p_track->i_sample -
-                       p_track->chunk[p_track->i_chunk].i_sample_first ) *
+                       ck->i_sample_first ) *
                      MP4_GetFixedSampleSize( p_track, p_soun );
         }
         else
         {
             /* we read chunk by chunk unless a blockalign is requested */
-            i_pos += ( p_track->i_sample - p_track->chunk[p_track->i_chunk].i_sample_first ) /
+            i_pos += ( p_track->i_sample - ck->i_sample_first ) /
                         p_soun->i_sample_per_packet * p_soun->i_bytes_per_frame;
         }
     }
     else
     {
-        for( i_sample = p_track->chunk[p_track->i_chunk].i_sample_first;
+        for( i_sample = ck->i_sample_first;
              i_sample < p_track->i_sample; i_sample++ )
         {
             i_pos += p_track->p_sample_size[i_sample];
@@ -3501,9 +3864,10 @@ static int MP4_TrackNextSample( demux_t *p_demux, mp4_track_t *p_track, uint32_t
         return VLC_EGENERIC;
 
     /* Have we changed chunk ? */
+    const mp4_chunk_t *ck = MP4_TrackGetChunk( p_demux, p_track, p_track->i_chunk );
     if( p_track->i_sample >=
-            p_track->chunk[p_track->i_chunk].i_sample_first +
-            p_track->chunk[p_track->i_chunk].i_sample_count )
+            ck->i_sample_first +
+            ck->i_sample_count )
     {
         if( TrackGotoChunkSample( p_demux, p_track, p_track->i_chunk + 1,
                                   p_track->i_sample ) )
@@ -4357,7 +4721,7 @@ static int ProbeFragments( demux_t *p_demux, bool b_force )
 
     assert( p_sys->p_root );
 
-    if ( p_sys->b_fastseekable || b_force )
+    if ( ( p_sys->b_fastseekable && !p_sys->p_fragindex ) || b_force )
     {
         MP4_ReadBoxContainerChildren( p_demux->s, p_sys->p_root, NULL ); /* Get the rest of the file */
         p_sys->b_fragments_probed = true;
@@ -4502,14 +4866,16 @@ static int LeafGetTrackAndChunkByMOOVPos( demux_t *p_demux, uint64_t *pi_pos,
     {
         for( unsigned int i_chunk = 0; i_chunk < p_sys->track[i_track].i_chunk_count; i_chunk++ )
         {
-            if ( p_sys->track[i_track].chunk[i_chunk].i_offset > *pi_pos )
+            const uint64_t i_offset =
+                MP4_TrackGetChunk( p_demux, &p_sys->track[i_track], i_chunk )->i_offset;
+            if ( i_offset > *pi_pos )
             {
-                i_closest = __MIN( i_closest, p_sys->track[i_track].chunk[i_chunk].i_offset );
+                i_closest = __MIN( i_closest, i_offset );
                 p_tk_closest = &p_sys->track[i_track];
                 i_chunk_closest = i_chunk;
             }
 
-            if ( *pi_pos == p_sys->track[i_track].chunk[i_chunk].i_offset )
+            if ( *pi_pos == i_offset )
             {
                 *pp_tk = &p_sys->track[i_track];
                 *pi_chunk = i_chunk;
@@ -4650,7 +5016,7 @@ static int LeafParseMDATwithMOOV( demux_t *p_demux )
         }
         /**/
 
-        mp4_chunk_t *p_chunk = &p_track->chunk[i_chunk];
+        mp4_chunk_t *p_chunk = MP4_TrackGetChunk( p_demux, p_track, i_chunk );
 
         uint32_t i_nb_samples_at_chunk_start = p_chunk->i_sample_first;
         uint32_t i_nb_samples_in_chunk = p_chunk->i_sample_count;
@@ -4882,9 +5248,27 @@ static int LeafIndexGetMoofPosByTime( demux_t *p_demux, const mtime_t i_target_t
         }
         p_tfra = p_tfra->p_next;
     }
+
+    if ( p_demux->p_sys->p_fragindex )
+        return MP4_FragIndex_Find( p_demux->p_sys->p_fragindex, i_target_time,
+                                   pi_pos, pi_mooftime );
     return VLC_EGENERIC;
 }
 
+/* Takes the duration from the fragment index, once it was completed */
+static void LeafUpdateDuration( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    mtime_t i_duration;
+
+    if ( p_sys->i_overall_duration || !p_sys->p_fragindex ||
+         !MP4_FragIndex_GetDuration( p_sys->p_fragindex, &i_duration ) )
+        return;
+
+    p_sys->i_overall_duration = i_duration * p_sys->i_timescale / CLOCK_FREQ;
+    msg_Dbg( p_demux, "indexed fragments duration %"PRId64, i_duration );
+}
+
 static void MP4_GetDefaultSizeAndDuration( demux_t *p_demux,
                                            const MP4_Box_data_tfhd_t *p_tfhd_data,
                                            uint32_t *pi_default_size,
@@ -5152,6 +5536,8 @@ static int DemuxAsLeaf( demux_t *p_demux )
     p_sys->i_pcr = i_lowest_dts;
     es_out_Control( p_demux->out, ES_OUT_SET_PCR, VLC_TS_0 + p_sys->i_pcr );
 
+    LeafUpdateDuration( p_demux );
+
     return VLC_DEMUXER_SUCCESS;
 }
 
@@ -61,6 +61,20 @@ typedef struct
 
 } mp4_chunk_t;
 
+/* Chunks of a lazily indexed track are built by pages, from the state of
+ * the sample tables saved at the start of each page when opening */
+#define MP4_CHUNK_PAGE_SIZE 256 /* chunks per page */
+#define MP4_CHUNK_PAGES     4   /* pages kept in memory per track */
+
+typedef struct
+{
+    uint64_t     i_first_dts;
+    uint32_t     i_sample_first;
+    uint32_t     i_stsc_index;
+    uint32_t     i_stts_index, i_stts_left; /* stts entry, samples left in it */
+    uint32_t     i_ctts_index, i_ctts_left;
+} mp4_chunk_page_t;
+
 typedef enum RTP_timstamp_synchronization_s
 {
     UNKNOWN_SYNC = 0, UNSYNCHRONIZED = 1, SYNCHRONIZED = 2, RESERVED = 3
@@ -107,9 +121,20 @@ typedef struct
     uint32_t         i_chunk_count;
     uint32_t         i_sample_count;
 
-    mp4_chunk_t    *chunk; /* always defined  for each chunk */
+    mp4_chunk_t    *chunk; /* always defined  for each chunk, unless b_lazy */
     mp4_chunk_t    *cchunk; /* current chunk if b_fragmented is true */
 
+    /* lazy index: chunks are only built when accessed (MP4_TrackGetChunk) */
+    bool             b_lazy;
+    mp4_chunk_page_t *p_pages; /* one per MP4_CHUNK_PAGE_SIZE chunks */
+    struct
+    {
+        uint32_t     i_page;
+        unsigned     i_use;
+        mp4_chunk_t  *p_chunks;
+    } pagecache[MP4_CHUNK_PAGES];
+    unsigned         i_pagecache_use;
+
     /* sample size, p_sample_size defined only if i_sample_size == 0
         else i_sample_size is size for all sample */
     uint32_t         i_sample_size;
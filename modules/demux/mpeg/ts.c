@@ -34,6 +34,7 @@
 #include <vlc_plugin.h>
 #include <vlc_access.h>    /* DVB-specific things */
 #include <vlc_demux.h>
+#include <vlc_atomic.h>
 
 #include "ts_pid.h"
 #include "ts_streams.h"
@@ -43,6 +44,7 @@
 #include "ts_psip.h"
 
 #include "ts_hotfixes.h"
+#include "ts_index.h"
 #include "ts_sl.h"
 #include "sections.h"
 #include "pes.h"
@@ -109,6 +111,12 @@ static void Close ( vlc_object_t * );
     "Seek and position based on a percent byte position, not a PCR generated " \
     "time position. If seeking doesn't work property, turn on this option." )
 
+#define INDEX_TEXT N_("Keep a seek index")
+#define INDEX_LONGTEXT N_( \
+    "Store the positions of the timestamps of a file in a file next to it " \
+    "(with the .tsidx extension), so that seeking and finding " \
+    "the duration do not need to search the file the next time." )
+
 #define PCR_TEXT N_("Trust in-stream PCR")
 #define PCR_LONGTEXT N_("Use the stream PCR as a reference.")
 
@@ -146,6 +154,7 @@ vlc_module_begin ()
 
     add_bool( "ts-split-es", true, SPLIT_ES_TEXT, SPLIT_ES_LONGTEXT, false )
     add_bool( "ts-seek-percent", false, SEEK_PERCENT_TEXT, SEEK_PERCENT_LONGTEXT, true )
+    add_bool( "ts-index", false, INDEX_TEXT, INDEX_LONGTEXT, true )
 
     add_obsolete_bool( "ts-silent" );
 
@@ -178,9 +187,14 @@ static bool GatherPESData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk, size_
 static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_prg, mtime_t i_pcr );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
+static void FlushTSPackets( demux_sys_t *p_sys );
+static uint64_t TellTS( demux_sys_t *p_sys );
+static int SeekTS( demux_sys_t *p_sys, uint64_t i_pos );
+static block_t *DetachTSPacket( block_t *p_block );
 static int SeekToTime( demux_t *p_demux, const ts_pmt_t *, int64_t time );
 static void ReadyQueuesPostSeek( demux_t *p_demux );
 static void PCRHandle( demux_t *p_demux, ts_pid_t *, mtime_t );
+static void PCRIndex( demux_t *p_demux, ts_pid_t *, mtime_t, const block_t * );
 static void PCRFixHandle( demux_t *, ts_pmt_t *, block_t * );
 
 #define TS_PACKET_SIZE_188 188
@@ -189,6 +203,10 @@ static void PCRFixHandle( demux_t *, ts_pmt_t *, block_t * );
 #define TS_PACKET_SIZE_MAX 204
 #define TS_HEADER_SIZE 4
 
+/* Number of packets read from the stream at once */
+#define TS_READ_BATCH_FILE 256
+#define TS_READ_BATCH_LIVE 7    /* as many as an UDP datagram */
+
 static int DetectPacketSize( demux_t *p_demux, unsigned *pi_header_size, int i_offset )
 {
     const uint8_t *p_peek;
@@ -383,6 +401,11 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_packet_size = i_packet_size;
     p_sys->i_packet_header_size = i_packet_header_size;
     p_sys->i_ts_read = 50;
+    p_sys->i_read_batch = TS_READ_BATCH_LIVE;
+    p_sys->p_chunk = NULL;
+    p_sys->i_chunk_pos = 0;
+    p_sys->i_lost_sync = -1;
+    p_sys->p_index = NULL;
     p_sys->csa = NULL;
     p_sys->b_start_record = false;
 
@@ -504,6 +527,20 @@ static int Open( vlc_object_t *p_this )
     stream_Control( p_sys->stream, STREAM_CAN_SEEK, &p_sys->b_canseek );
     stream_Control( p_sys->stream, STREAM_CAN_FASTSEEK, &p_sys->b_canfastseek );
 
+    /* Reading ahead is cheap on local files, but a live input would wait for
+     * the whole batch before the first packet could be demuxed */
+    if( p_sys->b_canfastseek )
+        p_sys->i_read_batch = TS_READ_BATCH_FILE;
+
+    if( p_sys->b_canfastseek && p_demux->psz_file != NULL &&
+        var_InheritBool( p_demux, "ts-index" ) )
+    {
+        int64_t i_size = stream_Size( p_sys->stream );
+        if( i_size > 0 )
+            p_sys->p_index = ts_index_New( p_demux, p_demux->psz_file, i_size,
+                                           p_sys->i_packet_size, TellTS( p_sys ) );
+    }
+
     /* Preparse time */
     if( p_sys->b_canseek )
     {
@@ -556,6 +593,11 @@ static void Close( vlc_object_t *p_this )
     /* Release all non default pids */
     ts_pid_list_Release( p_demux, &p_sys->pids );
 
+    FlushTSPackets( p_sys );
+
+    if( p_sys->p_index )
+        ts_index_Delete( p_demux, p_sys->p_index );
+
     free( p_sys );
 }
 
@@ -632,7 +674,11 @@ static int Demux( demux_t *p_demux )
         /* Adaptation field cannot be scrambled */
         mtime_t i_pcr = GetPCR( p_pkt );
         if( i_pcr > VLC_TS_INVALID )
+        {
             PCRHandle( p_demux, p_pid, i_pcr );
+            if( p_sys->p_index )
+                PCRIndex( p_demux, p_pid, i_pcr, p_pkt );
+        }
 
         if ( SCRAMBLED(*p_pid) && !p_demux->p_sys->csa )
         {
@@ -875,7 +921,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         if( (i64 = stream_Size( p_sys->stream) ) > 0 )
         {
-            int64_t offset = stream_Tell( p_sys->stream );
+            int64_t offset = TellTS( p_sys );
             *pf = (double)offset / (double)i64;
             return VLC_SUCCESS;
         }
@@ -921,7 +967,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         i64 = stream_Size( p_sys->stream );
         if( i64 > 0 &&
-            stream_Seek( p_sys->stream, (int64_t)(i64 * f) ) == VLC_SUCCESS )
+            SeekTS( p_sys, (int64_t)(i64 * f) ) == VLC_SUCCESS )
         {
             ReadyQueuesPostSeek( p_demux );
             return VLC_SUCCESS;
@@ -1051,10 +1097,17 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
     }
 
     case DEMUX_SET_TITLE:
-        return stream_vaControl( p_sys->stream, STREAM_SET_TITLE, args );
+        if( stream_vaControl( p_sys->stream, STREAM_SET_TITLE, args ) )
+            return VLC_EGENERIC;
+        /* the packets read ahead are from the old position */
+        FlushTSPackets( p_sys );
+        return VLC_SUCCESS;
 
     case DEMUX_SET_SEEKPOINT:
-        return stream_vaControl( p_sys->stream, STREAM_SET_SEEKPOINT, args );
+        if( stream_vaControl( p_sys->stream, STREAM_SET_SEEKPOINT, args ) )
+            return VLC_EGENERIC;
+        FlushTSPackets( p_sys );
+        return VLC_SUCCESS;
 
     case DEMUX_GET_META:
         return stream_vaControl( p_sys->stream, STREAM_GET_META, args );
@@ -1331,7 +1384,9 @@ static void ParsePES( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
 
         p_pes->i_length = i_length * 100 / 9;
 
-        p_block = block_ChainGather( p_pes );
+        p_block = DetachTSPacket( block_ChainGather( p_pes ) );
+        if( p_block == NULL )
+            return;
         if( p_es->fmt.i_codec == VLC_CODEC_SUBT )
         {
             if( i_pes_size > 0 && p_block->i_buffer > i_pes_size )
@@ -1476,7 +1531,7 @@ static void ParsePES( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
                         p_block = NULL;
                         if( header.b_au_end )
                         {
-                            p_block = block_ChainGather( pid->u.p_pes->sl.p_data );
+                            p_block = DetachTSPacket( block_ChainGather( pid->u.p_pes->sl.p_data ) );
                             pid->u.p_pes->sl.p_data = NULL;
                             pid->u.p_pes->sl.pp_last = &pid->u.p_pes->sl.p_data;
                         }
@@ -1561,79 +1616,236 @@ static void ParsePESDataChain( demux_t *p_demux, ts_pid_t *pid )
     ParsePES( p_demux, pid, p_datachain );
 }
 
-static block_t* ReadTSPacket( demux_t *p_demux )
+/*
+ * Packets are read from the stream in batches into one buffer (chunk), and
+ * handed out as blocks pointing into it, so that there is neither a stream
+ * read nor an allocation per packet. The chunk is freed once the demuxer
+ * and all the packets are done with it.
+ */
+typedef struct
+{
+    block_t     self;
+    ts_chunk_t *p_chunk;
+} ts_slice_t;
+
+struct ts_chunk_t
+{
+    atomic_uint i_refs;
+    unsigned    i_slices;   /* packets handed out */
+    size_t      i_data;     /* bytes read */
+    uint8_t    *p_data;
+    ts_slice_t  slices[];
+};
+
+static void ReleaseTSChunk( ts_chunk_t *p_chunk )
+{
+    if( atomic_fetch_sub( &p_chunk->i_refs, 1 ) == 1 )
+        free( p_chunk );
+}
+
+static void ReleaseTSPacket( block_t *p_block )
+{
+    ts_slice_t *p_slice = (ts_slice_t *)p_block;
+
+    ReleaseTSChunk( p_slice->p_chunk );
+}
+
+/* Copies a packet out of its chunk, for data that is kept around (PES sent
+ * to the decoders) not to hold a whole chunk */
+static block_t *DetachTSPacket( block_t *p_block )
+{
+    if( p_block == NULL || p_block->pf_release != ReleaseTSPacket )
+        return p_block;
+
+    block_t *p_copy = block_Duplicate( p_block );
+    block_Release( p_block );
+    return p_copy;
+}
+
+static void FlushTSPackets( demux_sys_t *p_sys )
+{
+    if( p_sys->p_chunk )
+        ReleaseTSChunk( p_sys->p_chunk );
+    p_sys->p_chunk = NULL;
+    p_sys->i_chunk_pos = 0;
+}
+
+/* Position of the next packet in the stream */
+static uint64_t TellTS( demux_sys_t *p_sys )
+{
+    uint64_t i_pos = stream_Tell( p_sys->stream );
+
+    if( p_sys->p_chunk )
+        i_pos -= p_sys->p_chunk->i_data - p_sys->i_chunk_pos;
+    return i_pos;
+}
+
+static int SeekTS( demux_sys_t *p_sys, uint64_t i_pos )
+{
+    FlushTSPackets( p_sys );
+    p_sys->i_lost_sync = -1;
+    if( p_sys->p_index )
+        ts_index_Seek( p_sys->p_index, i_pos );
+    return stream_Seek( p_sys->stream, i_pos );
+}
+
+/* Descrambles the scrambled packets of the chunk all at once: ParsePacket()
+ * will find them in clear. This stops at the first packet out of sync. */
+static void DescrambleTSChunk( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    ts_chunk_t *p_chunk = p_sys->p_chunk;
+    const size_t i_size = p_sys->i_packet_size;
+    uint8_t *pp_pkts[TS_READ_BATCH_FILE];
+    int i_pkts = 0;
+
+    assert( p_sys->i_read_batch <= TS_READ_BATCH_FILE );
+
+    for( size_t i_pos = p_sys->i_chunk_pos; i_pos + i_size <= p_chunk->i_data;
+         i_pos += i_size )
+    {
+        uint8_t *p = &p_chunk->p_data[i_pos + p_sys->i_packet_header_size];
+        if( p[0] != 0x47 )
+            break;
+
+        const ts_pid_t *pid = p_sys->pids.pp_index[((p[1] & 0x1f) << 8) | p[2]];
+        if( pid != NULL && SCRAMBLED(*pid) && (p[3] & 0x80) )
+            pp_pkts[i_pkts++] = p;
+    }
+
+    if( i_pkts > 0 )
+    {
+        vlc_mutex_lock( &p_sys->csa_lock );
+        if( p_sys->csa )
+            csa_DecryptBatch( p_sys->csa, pp_pkts, i_pkts, p_sys->i_csa_pkt_size );
+        vlc_mutex_unlock( &p_sys->csa_lock );
+    }
+}
+
+/* Reads the next batch of packets, keeping the unread bytes of the current
+ * one (the beginning of a packet that is not complete yet) */
+static int FillTSChunk( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
+    const size_t i_max = (size_t)p_sys->i_read_batch * p_sys->i_packet_size;
+    ts_chunk_t *p_chunk;
 
-    block_t     *p_pkt;
+    p_chunk = malloc( sizeof( *p_chunk )
+                    + p_sys->i_read_batch * sizeof( p_chunk->slices[0] )
+                    + i_max + 16 );
+    if( unlikely(p_chunk == NULL) )
+        return VLC_ENOMEM;
 
-    /* Get a new TS packet */
-    if( !( p_pkt = stream_Block( p_sys->stream, p_sys->i_packet_size ) ) )
+    atomic_init( &p_chunk->i_refs, 1 );
+    p_chunk->i_slices = 0;
+    p_chunk->i_data = 0;
+    p_chunk->p_data = (uint8_t *)
+        (((uintptr_t)&p_chunk->slices[p_sys->i_read_batch] + 15) & ~(uintptr_t)15);
+
+    if( p_sys->p_chunk )
+    {
+        p_chunk->i_data = p_sys->p_chunk->i_data - p_sys->i_chunk_pos;
+        memcpy( p_chunk->p_data, p_sys->p_chunk->p_data + p_sys->i_chunk_pos,
+                p_chunk->i_data );
+        ReleaseTSChunk( p_sys->p_chunk );
+    }
+    p_sys->p_chunk = p_chunk;
+    p_sys->i_chunk_pos = 0;
+
+    ssize_t i_read = stream_Read( p_sys->stream, p_chunk->p_data + p_chunk->i_data,
+                                  i_max - p_chunk->i_data );
+    if( i_read > 0 )
+        p_chunk->i_data += i_read;
+
+    if( i_read <= 0 || p_chunk->i_data < p_sys->i_packet_size )
     {
         int64_t size = stream_Size( p_sys->stream );
         if( size >= 0 && (uint64_t)size == stream_Tell( p_sys->stream ) )
+        {
             msg_Dbg( p_demux, "EOF at %"PRId64, stream_Tell( p_sys->stream ) );
+            if( p_sys->p_index )
+                ts_index_EOF( p_sys->p_index, size );
+        }
         else
             msg_Dbg( p_demux, "Can't read TS packet at %"PRId64, stream_Tell(p_sys->stream) );
-        return NULL;
+        return VLC_EGENERIC;
     }
 
-    if( p_pkt->i_buffer < TS_HEADER_SIZE + p_sys->i_packet_header_size )
-    {
-        block_Release( p_pkt );
-        return NULL;
-    }
+    if( p_sys->csa )
+        DescrambleTSChunk( p_demux );
+    return VLC_SUCCESS;
+}
 
-    /* Skip header (BluRay streams).
-     * re-sync logic would do this (by adjusting packet start), but this would result in losing first and last ts packets.
-     * First packet is usually PAT, and losing it means losing whole first GOP. This is fatal with still-image based menus.
-     */
-    p_pkt->p_buffer += p_sys->i_packet_header_size;
-    p_pkt->i_buffer -= p_sys->i_packet_header_size;
+static block_t* ReadTSPacket( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const size_t i_size = p_sys->i_packet_size;
+    const size_t i_header = p_sys->i_packet_header_size;
+    ts_chunk_t *p_chunk;
 
-    /* Check sync byte and re-sync if needed */
-    if( p_pkt->p_buffer[0] != 0x47 )
+    for( ;; )
     {
-        msg_Warn( p_demux, "lost synchro" );
-        block_Release( p_pkt );
-        for( ;; )
+        p_chunk = p_sys->p_chunk;
+        if( p_chunk == NULL || p_sys->i_chunk_pos + i_size > p_chunk->i_data )
         {
-            const uint8_t *p_peek;
-            int i_peek = 0;
-            unsigned i_skip = 0;
-
-            i_peek = stream_Peek( p_sys->stream, &p_peek,
-                    p_sys->i_packet_size * 10 );
-            if( i_peek < 0 || (unsigned)i_peek < p_sys->i_packet_size + 1 )
+            if( FillTSChunk( p_demux ) )
             {
-                msg_Dbg( p_demux, "eof ?" );
+                FlushTSPackets( p_sys );
                 return NULL;
             }
+            continue;
+        }
 
-            while( i_skip < i_peek - p_sys->i_packet_size )
-            {
-                if( p_peek[i_skip + p_sys->i_packet_header_size] == 0x47 &&
-                        p_peek[i_skip + p_sys->i_packet_header_size + p_sys->i_packet_size] == 0x47 )
-                {
-                    break;
-                }
-                i_skip++;
-            }
-            msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
-            if (stream_Read( p_sys->stream, NULL, i_skip ) != i_skip)
-                return NULL;
+        /* Skip header (BluRay streams).
+         * re-sync logic would do this (by adjusting packet start), but this would result in losing first and last ts packets.
+         * First packet is usually PAT, and losing it means losing whole first GOP. This is fatal with still-image based menus.
+         */
+        const uint8_t *p = p_chunk->p_data + p_sys->i_chunk_pos + i_header;
 
-            if( i_skip < i_peek - p_sys->i_packet_size )
-            {
+        /* Check sync byte and re-sync if needed */
+        if( p_sys->i_lost_sync < 0 )
+        {
+            if( likely(p[0] == 0x47) )
                 break;
-            }
+
+            msg_Warn( p_demux, "lost synchro" );
+            p_sys->i_lost_sync = TellTS( p_sys );
         }
-        if( !( p_pkt = stream_Block( p_sys->stream, p_sys->i_packet_size ) ) )
+
+        /* Look for two consecutive sync bytes */
+        const uint8_t *p_end = p_chunk->p_data + p_chunk->i_data - i_size;
+
+        while( p < p_end && ( p[0] != 0x47 || p[i_size] != 0x47 ) )
+            p++;
+        p_sys->i_chunk_pos = p - i_header - p_chunk->p_data;
+        if( p < p_end )
+        {
+            msg_Dbg( p_demux, "skipping %"PRId64" bytes of garbage",
+                     TellTS( p_sys ) - p_sys->i_lost_sync );
+            p_sys->i_lost_sync = -1;
+            break;
+        }
+
+        /* not found yet, keep the remaining bytes and read some more */
+        if( FillTSChunk( p_demux ) )
         {
-            msg_Dbg( p_demux, "eof ?" );
+            FlushTSPackets( p_sys );
             return NULL;
         }
     }
+
+    ts_slice_t *p_slice = &p_chunk->slices[p_chunk->i_slices++];
+    block_t *p_pkt = &p_slice->self;
+
+    assert( p_chunk->i_slices <= p_sys->i_read_batch );
+    block_Init( p_pkt, p_chunk->p_data + p_sys->i_chunk_pos, i_size );
+    p_pkt->pf_release = ReleaseTSPacket;
+    p_slice->p_chunk = p_chunk;
+    atomic_fetch_add( &p_chunk->i_refs, 1 );
+    p_sys->i_chunk_pos += i_size;
+
+    p_pkt->p_buffer += i_header;
+    p_pkt->i_buffer -= i_header;
     return p_pkt;
 }
 
@@ -1755,12 +1967,20 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
 
     /* Deal with common but worst binary search case */
     if( p_pmt->pcr.i_first == i_scaledtime && p_sys->b_canseek )
-        return stream_Seek( p_sys->stream, 0 );
+        return SeekTS( p_sys, 0 );
 
     if( !p_sys->b_canfastseek )
         return VLC_EGENERIC;
 
-    int64_t i_initial_pos = stream_Tell( p_sys->stream );
+    /* Use the index if it covers that time */
+    uint64_t i_indexed_pos;
+    if( p_sys->p_index &&
+        ts_index_GetPID( p_sys->p_index ) == p_pmt->i_pid_pcr &&
+        ts_index_Find( p_sys->p_index, p_pmt->pcr.i_first, i_scaledtime,
+                       &i_indexed_pos ) == VLC_SUCCESS )
+        return SeekTS( p_sys, i_indexed_pos );
+
+    int64_t i_initial_pos = TellTS( p_sys );
 
     /* Find the time position by using binary search algorithm. */
     int64_t i_head_pos = 0;
@@ -1776,7 +1996,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
         int64_t i_div = i_splitpos % p_sys->i_packet_size;
         i_splitpos -= i_div;
 
-        if ( stream_Seek( p_sys->stream, i_splitpos ) != VLC_SUCCESS )
+        if ( SeekTS( p_sys, i_splitpos ) != VLC_SUCCESS )
             break;
 
         int64_t i_pos = i_splitpos;
@@ -1790,7 +2010,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
                 break;
             }
             else
-                i_pos = stream_Tell( p_sys->stream );
+                i_pos = TellTS( p_sys );
 
             int i_pid = PIDGet( p_pkt );
             ts_pid_t *p_pid = GetPID(p_sys, i_pid);
@@ -1845,7 +2065,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
     if( !b_found )
     {
         msg_Dbg( p_demux, "Seek():cannot find a time position." );
-        stream_Seek( p_sys->stream, i_initial_pos );
+        SeekTS( p_sys, i_initial_pos );
         return VLC_EGENERIC;
     }
     return VLC_SUCCESS;
@@ -1948,7 +2168,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
 int ProbeStart( demux_t *p_demux, int i_program )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    const int64_t i_initial_pos = stream_Tell( p_sys->stream );
+    const int64_t i_initial_pos = TellTS( p_sys );
     int64_t i_stream_size = stream_Size( p_sys->stream );
 
     int i_probe_count = 0;
@@ -1961,7 +2181,7 @@ int ProbeStart( demux_t *p_demux, int i_program )
         i_pos = p_sys->i_packet_size * i_probe_count;
         i_pos = __MIN( i_pos, i_stream_size );
 
-        if( stream_Seek( p_sys->stream, i_pos ) )
+        if( SeekTS( p_sys, i_pos ) )
             return VLC_EGENERIC;
 
         ProbeChunk( p_demux, i_program, false, &i_pcr, &b_found );
@@ -1970,7 +2190,7 @@ int ProbeStart( demux_t *p_demux, int i_program )
         i_probe_count += PROBE_CHUNK_COUNT;
     } while( i_pos > 0 && (i_pcr == -1 || !b_found) && i_probe_count < (2 * PROBE_CHUNK_COUNT) );
 
-    if( stream_Seek( p_sys->stream, i_initial_pos ) )
+    if( SeekTS( p_sys, i_initial_pos ) )
         return VLC_EGENERIC;
 
     return (b_found) ? VLC_SUCCESS : VLC_EGENERIC;
@@ -1979,7 +2199,7 @@ int ProbeStart( demux_t *p_demux, int i_program )
 int ProbeEnd( demux_t *p_demux, int i_program )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    const int64_t i_initial_pos = stream_Tell( p_sys->stream );
+    const int64_t i_initial_pos = TellTS( p_sys );
     int64_t i_stream_size = stream_Size( p_sys->stream );
 
     int i_probe_count = PROBE_CHUNK_COUNT;
@@ -1992,7 +2212,7 @@ int ProbeEnd( demux_t *p_demux, int i_program )
         i_pos = i_stream_size - (p_sys->i_packet_size * i_probe_count);
         i_pos = __MAX( i_pos, 0 );
 
-        if( stream_Seek( p_sys->stream, i_pos ) )
+        if( SeekTS( p_sys, i_pos ) )
             return VLC_EGENERIC;
 
         ProbeChunk( p_demux, i_program, true, &i_pcr, &b_found );
@@ -2001,7 +2221,7 @@ int ProbeEnd( demux_t *p_demux, int i_program )
         i_probe_count += PROBE_CHUNK_COUNT;
     } while( i_pos > 0 && (i_pcr == -1 || !b_found) && i_probe_count < (6 * PROBE_CHUNK_COUNT) );
 
-    if( stream_Seek( p_sys->stream, i_initial_pos ) )
+    if( SeekTS( p_sys, i_initial_pos ) )
         return VLC_EGENERIC;
 
     return (b_found) ? VLC_SUCCESS : VLC_EGENERIC;
@@ -2177,6 +2397,40 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, mtime_t i_pcr )
     }
 }
 
+/* Feeds the index with the PCR of the (first) selected program */
+static void PCRIndex( demux_t *p_demux, ts_pid_t *pid, mtime_t i_pcr,
+                      const block_t *p_pkt )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    ts_index_t *p_index = p_sys->p_index;
+
+    if( ts_index_GetPID( p_index ) == 0x1FFF )
+    {
+        if( GetPID(p_sys, 0)->type != TYPE_PAT )
+            return;
+
+        ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
+        for( int i = 0; i < p_pat->programs.i_size; i++ )
+        {
+            ts_pmt_t *p_pmt = p_pat->programs.p_elems[i]->u.p_pmt;
+            if( p_pmt->i_pid_pcr == pid->i_pid && p_pmt->b_selected )
+            {
+                ts_index_SetPID( p_index, pid->i_pid );
+                break;
+            }
+        }
+    }
+
+    if( ts_index_GetPID( p_index ) != pid->i_pid )
+        return;
+
+    /* random_access_indicator */
+    const uint8_t *p = p_pkt->p_buffer;
+    const bool b_random_access = p[4] > 0 && (p[5] & 0x40);
+    ts_index_AddPCR( p_index, i_pcr, TellTS( p_sys ) - p_sys->i_packet_size,
+                     b_random_access );
+}
+
 int FindPCRCandidate( ts_pmt_t *p_pmt )
 {
     ts_pid_t *p_cand = NULL;
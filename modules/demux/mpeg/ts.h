@@ -24,6 +24,8 @@
     typedef struct arib_instance_t arib_instance_t;
 #endif
 typedef struct csa_t csa_t;
+typedef struct ts_chunk_t ts_chunk_t;
+typedef struct ts_index_t ts_index_t;
 
 #define TS_USER_PMT_NUMBER (0)
 
@@ -60,6 +62,16 @@ struct demux_sys_t
     /* how many TS packet we read at once */
     unsigned    i_ts_read;
 
+    /* how many TS packet we fetch from the stream at once */
+    unsigned    i_read_batch;
+    /* last bulk read, packets are handed out as slices of it */
+    ts_chunk_t *p_chunk;
+    size_t      i_chunk_pos;    /* next packet offset in the chunk */
+    int64_t     i_lost_sync;    /* where the sync was lost, or -1 */
+
+    /* time/position index kept next to the file, if any */
+    ts_index_t *p_index;
+
     bool        b_force_seek_per_percent;
 
     ts_standards_e standard;
@@ -0,0 +1,320 @@
+/*****************************************************************************
+ * ts_index.c : TS demuxer time/position index file
+ *****************************************************************************
+ * Copyright (C) 2016 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+
+#include "ts_index.h"
+#include "timestamps.h"
+#include "../index_file.h"
+
+#include <assert.h>
+
+/* Index file (see index_file.h), all values big endian:
+ *  header: packet size (4), pcr pid (2), flags (2), indexed up to (8),
+ *          last pcr (8)
+ *  entries: pcr (8), position (8, top bit set on random access points)
+ */
+#define TS_INDEX_HEADER     24
+#define TS_INDEX_ENTRY      16
+#define TS_INDEX_COMPLETE   0x1
+#define TS_INDEX_RAP        (UINT64_C(1) << 63)
+
+/* Minimum distance between entries, in 90 kHz units */
+#define TS_INDEX_INTERVAL   90000   /* 1 s */
+#define TS_INDEX_RAP_INTERVAL 45000 /* 500 ms, for random access points */
+/* How far back a random access point is looked for when seeking */
+#define TS_INDEX_RAP_LOOKBACK (5 * 90000)
+
+typedef struct
+{
+    int64_t  i_pcr;
+    uint64_t i_pos; /* with TS_INDEX_RAP */
+} ts_index_entry_t;
+
+struct ts_index_t
+{
+    char       *psz_path;
+    uint64_t    i_size;         /* size of the indexed file */
+    int64_t     i_mtime;        /* modification time of the indexed file */
+    unsigned    i_packet_size;
+    uint16_t    i_pid;
+
+    ts_index_entry_t *p_entries;
+    size_t      i_entries;
+    size_t      i_alloc;
+    bool        b_has_rap;
+
+    uint64_t    i_end;          /* everything before that was indexed */
+    int64_t     i_last_pcr;     /* last PCR before i_end */
+    bool        b_complete;     /* indexed up to the end of the file */
+    bool        b_contiguous;   /* reading follows the indexed part */
+    bool        b_dirty;
+};
+
+static const index_file_format_t ts_index_format =
+{
+    .psz_magic = "VLCTSIDX",
+    .i_version = 3,
+    .i_header = TS_INDEX_HEADER,
+    .i_entry = TS_INDEX_ENTRY,
+};
+
+static int64_t EntryTime( const ts_index_t *p_index, size_t i )
+{
+    return TimeStampWrapAround( p_index->p_entries[0].i_pcr,
+                                p_index->p_entries[i].i_pcr );
+}
+
+static int Load( demux_t *p_demux, ts_index_t *p_index )
+{
+    uint8_t header[TS_INDEX_HEADER], *p_data;
+    size_t i_entries;
+
+    if( index_file_Load( p_demux, &ts_index_format, p_index->psz_path,
+                         p_index->i_size, p_index->i_mtime, header,
+                         &p_data, &i_entries ) )
+        return VLC_EGENERIC;
+
+    ts_index_entry_t *p_entries = NULL;
+    if( GetDWBE( &header[0] ) != p_index->i_packet_size ||
+        ( i_entries > 0 && ( i_entries > SIZE_MAX / sizeof(*p_entries) ||
+          (p_entries = malloc( i_entries * sizeof(*p_entries) )) == NULL ) ) )
+    {
+        free( p_data );
+        return VLC_EGENERIC;
+    }
+
+    for( size_t i = 0; i < i_entries; i++ )
+    {
+        const uint8_t *p_entry = &p_data[i * TS_INDEX_ENTRY];
+        p_entries[i].i_pcr = GetQWBE( &p_entry[0] );
+        p_entries[i].i_pos = GetQWBE( &p_entry[8] );
+        if( p_entries[i].i_pos & TS_INDEX_RAP )
+            p_index->b_has_rap = true;
+    }
+    free( p_data );
+
+    p_index->i_pid = GetWBE( &header[4] );
+    p_index->b_complete = GetWBE( &header[6] ) & TS_INDEX_COMPLETE;
+    p_index->i_end = GetQWBE( &header[8] );
+    p_index->i_last_pcr = GetQWBE( &header[16] );
+    p_index->p_entries = p_entries;
+    p_index->i_entries = p_index->i_alloc = i_entries;
+
+    msg_Dbg( p_demux, "loaded index %s: %zu entries up to %"PRIu64"%s",
+             p_index->psz_path, i_entries, p_index->i_end,
+             p_index->b_complete ? " (complete)" : "" );
+    return VLC_SUCCESS;
+}
+
+static void Save( demux_t *p_demux, const ts_index_t *p_index )
+{
+    uint8_t header[TS_INDEX_HEADER];
+    SetDWBE( &header[0], p_index->i_packet_size );
+    SetWBE( &header[4], p_index->i_pid );
+    SetWBE( &header[6], p_index->b_complete ? TS_INDEX_COMPLETE : 0 );
+    SetQWBE( &header[8], p_index->i_end );
+    SetQWBE( &header[16], p_index->i_last_pcr );
+
+    if( p_index->i_entries > SIZE_MAX / TS_INDEX_ENTRY )
+        return;
+    uint8_t *p_data = malloc( p_index->i_entries * TS_INDEX_ENTRY );
+    if( unlikely(p_data == NULL) )
+        return;
+    for( size_t i = 0; i < p_index->i_entries; i++ )
+    {
+        uint8_t *p_entry = &p_data[i * TS_INDEX_ENTRY];
+        SetQWBE( &p_entry[0], p_index->p_entries[i].i_pcr );
+        SetQWBE( &p_entry[8], p_index->p_entries[i].i_pos );
+    }
+
+    index_file_Save( p_demux, &ts_index_format, p_index->psz_path,
+                     p_index->i_size, p_index->i_mtime, header,
+                     p_data, p_index->i_entries );
+    free( p_data );
+}
+
+ts_index_t * ts_index_New( demux_t *p_demux, const char *psz_file, uint64_t i_size,
+                           unsigned i_packet_size, uint64_t i_start )
+{
+    ts_index_t *p_index = calloc( 1, sizeof(*p_index) );
+    if( unlikely(p_index == NULL) )
+        return NULL;
+
+    if( asprintf( &p_index->psz_path, "%s"TS_INDEX_EXT, psz_file ) == -1 )
+    {
+        free( p_index );
+        return NULL;
+    }
+    p_index->i_size = i_size;
+    p_index->i_packet_size = i_packet_size;
+
+    p_index->i_mtime = index_file_GetMTime( psz_file );
+
+    if( Load( p_demux, p_index ) != VLC_SUCCESS )
+    {
+        p_index->b_has_rap = false;
+        p_index->i_pid = 0x1FFF;
+        p_index->i_end = i_start;
+        p_index->i_last_pcr = -1;
+    }
+    p_index->b_contiguous = i_start <= p_index->i_end;
+    return p_index;
+}
+
+void ts_index_Delete( demux_t *p_demux, ts_index_t *p_index )
+{
+    if( p_index->b_dirty && p_index->i_entries > 0 )
+        Save( p_demux, p_index );
+    free( p_index->p_entries );
+    free( p_index->psz_path );
+    free( p_index );
+}
+
+uint16_t ts_index_GetPID( const ts_index_t *p_index )
+{
+    return p_index->i_pid;
+}
+
+void ts_index_SetPID( ts_index_t *p_index, uint16_t i_pid )
+{
+    assert( p_index->i_entries == 0 );
+    p_index->i_pid = i_pid;
+}
+
+void ts_index_AddPCR( ts_index_t *p_index, int64_t i_pcr, uint64_t i_pos,
+                      bool b_random_access )
+{
+    if( !p_index->b_contiguous || i_pos < p_index->i_end )
+        return; /* not reading the part following the indexed one */
+
+    if( p_index->i_entries > 0 )
+    {
+        const int64_t i_last = EntryTime( p_index, p_index->i_entries - 1 );
+        const int64_t i_time = TimeStampWrapAround( p_index->p_entries[0].i_pcr,
+                                                    i_pcr );
+        if( i_time < TimeStampWrapAround( p_index->p_entries[0].i_pcr,
+                                          p_index->i_last_pcr ) )
+        {
+            /* PCR discontinuity: times after it can't be looked up */
+            p_index->b_contiguous = false;
+            return;
+        }
+
+        if( i_time - i_last < (b_random_access ? TS_INDEX_RAP_INTERVAL
+                                               : TS_INDEX_INTERVAL) )
+            goto out;
+    }
+
+    if( p_index->i_entries == p_index->i_alloc )
+    {
+        size_t i_alloc = p_index->i_alloc ? p_index->i_alloc * 2 : 1024;
+        ts_index_entry_t *p_realloc = realloc( p_index->p_entries,
+                                               i_alloc * sizeof(*p_realloc) );
+        if( unlikely(p_realloc == NULL) )
+            goto out;
+        p_index->p_entries = p_realloc;
+        p_index->i_alloc = i_alloc;
+    }
+
+    p_index->p_entries[p_index->i_entries].i_pcr = i_pcr;
+    p_index->p_entries[p_index->i_entries].i_pos =
+            i_pos | (b_random_access ? TS_INDEX_RAP : 0);
+    p_index->i_entries++;
+    if( b_random_access )
+        p_index->b_has_rap = true;
+
+out:
+    p_index->i_end = i_pos;
+    p_index->i_last_pcr = i_pcr;
+    p_index->b_complete = false;
+    p_index->b_dirty = true;
+}
+
+void ts_index_Seek( ts_index_t *p_index, uint64_t i_pos )
+{
+    /* Reading from within the indexed part will get back to its end */
+    p_index->b_contiguous = i_pos <= p_index->i_end;
+}
+
+void ts_index_EOF( ts_index_t *p_index, uint64_t i_pos )
+{
+    if( !p_index->b_contiguous || p_index->b_complete ||
+        p_index->i_entries == 0 )
+        return;
+
+    p_index->i_end = i_pos;
+    p_index->b_complete = true;
+    p_index->b_dirty = true;
+}
+
+int ts_index_Find( const ts_index_t *p_index, int64_t i_first_pcr,
+                   int64_t i_time, uint64_t *pi_pos )
+{
+    if( p_index->i_entries == 0 ||
+        i_time < TimeStampWrapAround( i_first_pcr, p_index->p_entries[0].i_pcr ) )
+        return VLC_EGENERIC;
+    if( i_time > TimeStampWrapAround( i_first_pcr, p_index->i_last_pcr ) &&
+        !p_index->b_complete )
+        return VLC_EGENERIC; /* not indexed yet */
+
+    /* last entry not after i_time */
+    size_t i_low = 0, i_high = p_index->i_entries;
+    while( i_high - i_low > 1 )
+    {
+        size_t i_mid = i_low + (i_high - i_low) / 2;
+        if( TimeStampWrapAround( i_first_pcr, p_index->p_entries[i_mid].i_pcr ) <= i_time )
+            i_low = i_mid;
+        else
+            i_high = i_mid;
+    }
+
+    /* rather start from a random access point, if not too far */
+    if( p_index->b_has_rap )
+    {
+        const int64_t i_found = EntryTime( p_index, i_low );
+        for( size_t i = i_low + 1; i-- > 0; )
+        {
+            if( i_found - EntryTime( p_index, i ) > TS_INDEX_RAP_LOOKBACK )
+                break;
+            if( p_index->p_entries[i].i_pos & TS_INDEX_RAP )
+            {
+                i_low = i;
+                break;
+            }
+        }
+    }
+
+    *pi_pos = p_index->p_entries[i_low].i_pos & ~TS_INDEX_RAP;
+    return VLC_SUCCESS;
+}
+
+bool ts_index_GetBounds( const ts_index_t *p_index, int64_t *pi_first,
+                         int64_t *pi_last )
+{
+    if( !p_index->b_complete || p_index->i_entries == 0 )
+        return false;
+    *pi_first = p_index->p_entries[0].i_pcr;
+    *pi_last = p_index->i_last_pcr;
+    return true;
+}
@@ -0,0 +1,55 @@
+/*****************************************************************************
+ * ts_index.h : TS demuxer time/position index file
+ *****************************************************************************
+ * Copyright (C) 2016 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifndef VLC_TS_INDEX_H
+#define VLC_TS_INDEX_H
+
+/*
+ * Index of PCR values to byte positions of a TS file, for one PCR pid.
+ * It is built while the file is read linearly from its start, and stored
+ * next to the file to be reused the next time it is opened.
+ */
+typedef struct ts_index_t ts_index_t;
+
+#define TS_INDEX_EXT ".tsidx"
+
+/* loads the index of that file, or creates an empty one */
+ts_index_t * ts_index_New( demux_t *, const char *psz_file, uint64_t i_size,
+                           unsigned i_packet_size, uint64_t i_start );
+/* writes the index back if it changed */
+void ts_index_Delete( demux_t *, ts_index_t * );
+
+/* PCR pid the index is about, 0x1FFF while not known yet */
+uint16_t ts_index_GetPID( const ts_index_t * );
+void ts_index_SetPID( ts_index_t *, uint16_t i_pid );
+
+/* notifies the index of a PCR packet read at i_pos */
+void ts_index_AddPCR( ts_index_t *, int64_t i_pcr, uint64_t i_pos, bool b_random_access );
+/* notifies the index of a read position change */
+void ts_index_Seek( ts_index_t *, uint64_t i_pos );
+/* notifies the index of the end of the file */
+void ts_index_EOF( ts_index_t *, uint64_t i_pos );
+
+/* position to read from to reach i_time (in the i_first_pcr wrap around
+ * time base), if that time is covered by the index */
+int ts_index_Find( const ts_index_t *, int64_t i_first_pcr, int64_t i_time,
+                   uint64_t *pi_pos );
+/* first and last PCR of the file, if the whole file was indexed */
+bool ts_index_GetBounds( const ts_index_t *, int64_t *pi_first, int64_t *pi_last );
+
+#endif
@@ -40,8 +40,10 @@ void ts_pid_list_Init( ts_pid_list_t *p_list )
     p_list->pp_all = NULL;
     p_list->i_all = 0;
     p_list->i_all_alloc = 0;
-    p_list->i_last_pid = 0;
-    p_list->p_last = NULL;
+    memset( p_list->pp_index, 0, sizeof(p_list->pp_index) );
+    p_list->pp_index[0] = &p_list->pat;
+    p_list->pp_index[0x1FFB] = &p_list->base_si;
+    p_list->pp_index[0x1FFF] = &p_list->dummy;
 }
 
 void ts_pid_list_Release( demux_t *p_demux, ts_pid_list_t *p_list )
@@ -58,31 +60,10 @@ void ts_pid_list_Release( demux_t *p_demux, ts_pid_list_t *p_list )
     free( p_list->pp_all );
 }
 
-ts_pid_t * ts_pid_Get( ts_pid_list_t *p_list, uint16_t i_pid )
+ts_pid_t * ts_pid_New( ts_pid_list_t *p_list, uint16_t i_pid )
 {
-    switch( i_pid )
-    {
-        case 0:
-            return &p_list->pat;
-        case 0x1FFB:
-            return &p_list->base_si;
-        case 0x1FFF:
-            return &p_list->dummy;
-        default:
-            if( p_list->i_last_pid == i_pid )
-                return p_list->p_last;
-        break;
-    }
-
-    for( int i=0; i < p_list->i_all; i++ )
-    {
-        if( p_list->pp_all[i]->i_pid == i_pid )
-        {
-            p_list->p_last = p_list->pp_all[i];
-            p_list->i_last_pid = i_pid;
-            return p_list->p_last;
-        }
-    }
+    i_pid &= TS_PID_COUNT - 1;
+    assert( p_list->pp_index[i_pid] == NULL );
 
     if( p_list->i_all >= p_list->i_all_alloc )
     {
@@ -106,9 +87,7 @@ ts_pid_t * ts_pid_Get( ts_pid_list_t *p_list, uint16_t i_pid )
 
     p_pid->i_pid = i_pid;
     p_list->pp_all[p_list->i_all++] = p_pid;
-
-    p_list->p_last = p_pid;
-    p_list->i_last_pid = i_pid;
+    p_list->pp_index[i_pid] = p_pid;
 
     return p_pid;
 }
@@ -23,6 +23,7 @@
 
 #define MIN_ES_PID 4    /* Should be 32.. broken muxers */
 #define MAX_ES_PID 8190
+#define TS_PID_COUNT 8192
 
 #include "ts_streams.h"
 
@@ -85,18 +86,25 @@ struct ts_pid_list_t
     ts_pid_t **pp_all;
     int        i_all;
     int        i_all_alloc;
-    /* last recently used */
-    uint16_t   i_last_pid;
-    ts_pid_t  *p_last;
-
+    /* all the pids seen so far, indexed by pid number */
+    ts_pid_t  *pp_index[TS_PID_COUNT];
 };
 
 /* opacified pid list */
 void ts_pid_list_Init( ts_pid_list_t * );
 void ts_pid_list_Release( demux_t *, ts_pid_list_t * );
 
+/* creates missing pid */
+ts_pid_t * ts_pid_New( ts_pid_list_t *, uint16_t i_pid );
+
 /* creates missing pid on the fly */
-ts_pid_t * ts_pid_Get( ts_pid_list_t *, uint16_t i_pid );
+static inline ts_pid_t * ts_pid_Get( ts_pid_list_t *p_list, uint16_t i_pid )
+{
+    ts_pid_t *p_pid = p_list->pp_index[i_pid & (TS_PID_COUNT - 1)];
+    if( likely(p_pid != NULL) )
+        return p_pid;
+    return ts_pid_New( p_list, i_pid );
+}
 
 /* returns NULL on end. requires context */
 typedef struct
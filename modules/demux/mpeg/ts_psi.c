@@ -48,6 +48,7 @@
 
 #include "sections.h"
 #include "ts_sl.h"
+#include "ts_index.h"
 #include "ts_scte.h"
 #include "ts_psip.h"
 #include "ts_psi_eit.h"
@@ -1763,8 +1764,15 @@ static void PMTCallBack( void *data, dvbpsi_pmt_t *p_dvbpsipmt )
     if( p_sys->b_canfastseek && p_pmt->i_last_dts == -1 )
     {
         p_pmt->i_last_dts = 0;
-        ProbeStart( p_demux, p_pmt->i_number );
-        ProbeEnd( p_demux, p_pmt->i_number );
+        /* a complete index knows them already */
+        if( p_sys->p_index == NULL ||
+            ts_index_GetPID( p_sys->p_index ) != p_pmt->i_pid_pcr ||
+            !ts_index_GetBounds( p_sys->p_index, &p_pmt->pcr.i_first,
+                                 &p_pmt->i_last_dts ) )
+        {
+            ProbeStart( p_demux, p_pmt->i_number );
+            ProbeEnd( p_demux, p_pmt->i_number );
+        }
     }
 
     dvbpsi_pmt_delete( p_dvbpsipmt );
@@ -26,10 +26,34 @@
 # include "config.h"
 #endif
 
+#include <assert.h>
+
 #include <vlc_common.h>
+#include <vlc_cpu.h>
 
 #include "csa.h"
 
+/* Largest scrambled payload */
+#define CSA_STREAM_MAX  184
+/* Packets (de)scrambled together, at most */
+#define CSA_BATCH       256
+/* Below that many packets (blocks), the byte oriented stream (block) cypher
+ * is faster */
+#define CSA_BATCH_MIN   2
+#define CSA_BLOCK_MIN   8
+
+/* (De)scrambling parameters of one packet */
+typedef struct
+{
+    uint8_t       *pkt;
+    uint8_t       *ck;
+    uint8_t       *kk;
+    int            i_hdr;
+    int            n;           /* 8 bytes blocks */
+    int            i_residue;
+    int            i_stream;    /* stream cypher outputs needed */
+} csa_lane_t;
+
 struct csa_t
 {
     /* odd and even keys */
@@ -47,6 +71,10 @@ struct csa_t
     int     p, q, r;
 
     bool    use_odd;
+
+    /* batch state */
+    csa_lane_t lanes[CSA_BATCH];
+    uint8_t    stream[CSA_BATCH][CSA_STREAM_MAX];
 };
 
 static void csa_ComputeKey( uint8_t kk[57], uint8_t ck[8] );
@@ -56,6 +84,9 @@ static void csa_StreamCypher( csa_t *c, int b_init, uint8_t *ck, uint8_t *sb, ui
 static void csa_BlockDecypher( uint8_t kk[57], uint8_t ib[8], uint8_t bd[8] );
 static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] );
 
+static void csa_DecryptLanes( csa_t *, unsigned i_lanes );
+static void csa_EncryptLanes( csa_t *, unsigned i_lanes );
+
 /*****************************************************************************
  * csa_New:
  *****************************************************************************/
@@ -136,175 +167,147 @@ int csa_UseKey( vlc_object_t *p_caller, csa_t *c, bool use_odd )
 }
 
 /*****************************************************************************
- * csa_Decrypt:
+ * csa_DecryptBatch:
  *****************************************************************************/
-void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
+void csa_DecryptBatch( csa_t *c, uint8_t **pp_pkts, int i_pkts, int i_pkt_size )
 {
-    uint8_t *ck;
-    uint8_t *kk;
-
-    uint8_t  ib[8], stream[8], block[8];
-
-    int     i_hdr, i_residue;
-    int     i, j, n;
-
-    /* transport scrambling control */
-    if( (pkt[3]&0x80) == 0 )
-    {
-        /* not scrambled */
-        return;
-    }
-    if( pkt[3]&0x40 )
-    {
-        ck = c->o_ck;
-        kk = c->o_kk;
-    }
-    else
-    {
-        ck = c->e_ck;
-        kk = c->e_kk;
-    }
+    unsigned i_lanes = 0;
 
-    /* clear transport scrambling control */
-    pkt[3] &= 0x3f;
+    assert( i_pkt_size <= 188 );
 
-    i_hdr = 4;
-    if( pkt[3]&0x20 )
+    for( int i_pkt = 0; i_pkt < i_pkts; i_pkt++ )
     {
-        /* skip adaption field */
-        i_hdr += pkt[4] + 1;
-    }
-
-    if( 188 - i_hdr < 8 )
-        return;
-
-    /* init csa state */
-    csa_StreamCypher( c, 1, ck, &pkt[i_hdr], ib );
+        uint8_t *pkt = pp_pkts[i_pkt];
+        csa_lane_t *lane = &c->lanes[i_lanes];
+        int i_hdr, n;
 
-    /* */
-    n = (i_pkt_size - i_hdr) / 8;
-    if( n < 0 )
-        return;
- 
-    i_residue = (i_pkt_size - i_hdr) % 8;
-    for( i = 1; i < n + 1; i++ )
-    {
-        csa_BlockDecypher( kk, ib, block );
-        if( i != n )
+        /* transport scrambling control */
+        if( (pkt[3]&0x80) == 0 )
         {
-            csa_StreamCypher( c, 0, ck, NULL, stream );
-            for( j = 0; j < 8; j++ )
-            {
-                /* xor ib with stream */
-                ib[j] = pkt[i_hdr+8*i+j] ^ stream[j];
-            }
+            /* not scrambled */
+            continue;
+        }
+        if( pkt[3]&0x40 )
+        {
+            lane->ck = c->o_ck;
+            lane->kk = c->o_kk;
         }
         else
         {
-            /* last block */
-            for( j = 0; j < 8; j++ )
-            {
-                ib[j] = 0;
-            }
+            lane->ck = c->e_ck;
+            lane->kk = c->e_kk;
         }
-        /* xor ib with block */
-        for( j = 0; j < 8; j++ )
+
+        /* clear transport scrambling control */
+        pkt[3] &= 0x3f;
+
+        i_hdr = 4;
+        if( pkt[3]&0x20 )
         {
-            pkt[i_hdr+8*(i-1)+j] = ib[j] ^ block[j];
+            /* skip adaption field */
+            i_hdr += pkt[4] + 1;
         }
-    }
 
-    if( i_residue > 0 )
-    {
-        csa_StreamCypher( c, 0, ck, NULL, stream );
-        for( j = 0; j < i_residue; j++ )
+        if( 188 - i_hdr < 8 )
+            continue;
+
+        n = (i_pkt_size - i_hdr) / 8;
+        if( n < 0 )
+            continue;
+
+        lane->pkt = pkt;
+        lane->i_hdr = i_hdr;
+        lane->n = n;
+        lane->i_residue = (i_pkt_size - i_hdr) % 8;
+        lane->i_stream = ( n > 0 ? n - 1 : 0 ) + ( lane->i_residue > 0 );
+
+        if( ++i_lanes == CSA_BATCH )
         {
-            pkt[i_pkt_size - i_residue + j] ^= stream[j];
+            csa_DecryptLanes( c, i_lanes );
+            i_lanes = 0;
         }
     }
+
+    if( i_lanes > 0 )
+        csa_DecryptLanes( c, i_lanes );
 }
 
 /*****************************************************************************
- * csa_Encrypt:
+ * csa_EncryptBatch:
  *****************************************************************************/
-void csa_Encrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
+void csa_EncryptBatch( csa_t *c, uint8_t **pp_pkts, int i_pkts, int i_pkt_size )
 {
-    uint8_t *ck;
-    uint8_t *kk;
-
-    int i, j;
-    int i_hdr = 4; /* hdr len */
-    uint8_t  ib[184/8+2][8], stream[8], block[8];
-    int n, i_residue;
+    unsigned i_lanes = 0;
 
-    /* set transport scrambling control */
-    pkt[3] |= 0x80;
+    assert( i_pkt_size <= 188 );
 
-    if( c->use_odd )
-    {
-        pkt[3] |= 0x40;
-        ck = c->o_ck;
-        kk = c->o_kk;
-    }
-    else
+    for( int i_pkt = 0; i_pkt < i_pkts; i_pkt++ )
     {
-        ck = c->e_ck;
-        kk = c->e_kk;
-    }
+        uint8_t *pkt = pp_pkts[i_pkt];
+        csa_lane_t *lane = &c->lanes[i_lanes];
+        int i_hdr, n;
 
-    /* hdr len */
-    i_hdr = 4;
-    if( pkt[3]&0x20 )
-    {
-        /* skip adaption field */
-        i_hdr += pkt[4] + 1;
-    }
-    n = (i_pkt_size - i_hdr) / 8;
-    i_residue = (i_pkt_size - i_hdr) % 8;
-
-    if( n <= 0 )
-    {
-        pkt[3] &= 0x3f;
-        return;
-    }
+        /* set transport scrambling control */
+        pkt[3] |= 0x80;
 
-    /* */
-    for( i = 0; i < 8; i++ )
-    {
-        ib[n+1][i] = 0;
-    }
-    for( i = n; i  > 0; i-- )
-    {
-        for( j = 0; j < 8; j++ )
+        if( c->use_odd )
         {
-            block[j] = pkt[i_hdr+8*(i-1)+j] ^ib[i+1][j];
+            pkt[3] |= 0x40;
+            lane->ck = c->o_ck;
+            lane->kk = c->o_kk;
+        }
+        else
+        {
+            lane->ck = c->e_ck;
+            lane->kk = c->e_kk;
         }
-        csa_BlockCypher( kk, block, ib[i] );
-    }
 
-    /* init csa state */
-    csa_StreamCypher( c, 1, ck, ib[1], stream );
+        /* hdr len */
+        i_hdr = 4;
+        if( pkt[3]&0x20 )
+        {
+            /* skip adaption field */
+            i_hdr += pkt[4] + 1;
+        }
+        n = (i_pkt_size - i_hdr) / 8;
 
-    for( i = 0; i < 8; i++ )
-    {
-        pkt[i_hdr+i] = ib[1][i];
-    }
-    for( i = 2; i < n+1; i++ )
-    {
-        csa_StreamCypher( c, 0, ck, NULL, stream );
-        for( j = 0; j < 8; j++ )
+        if( n <= 0 )
         {
-            pkt[i_hdr+8*(i-1)+j] = ib[i][j] ^ stream[j];
+            pkt[3] &= 0x3f;
+            continue;
         }
-    }
-    if( i_residue > 0 )
-    {
-        csa_StreamCypher( c, 0, ck, NULL, stream );
-        for( j = 0; j < i_residue; j++ )
+
+        lane->pkt = pkt;
+        lane->i_hdr = i_hdr;
+        lane->n = n;
+        lane->i_residue = (i_pkt_size - i_hdr) % 8;
+        lane->i_stream = n - 1 + ( lane->i_residue > 0 );
+
+        if( ++i_lanes == CSA_BATCH )
         {
-            pkt[i_pkt_size - i_residue + j] ^= stream[j];
+            csa_EncryptLanes( c, i_lanes );
+            i_lanes = 0;
         }
     }
+
+    if( i_lanes > 0 )
+        csa_EncryptLanes( c, i_lanes );
+}
+
+/*****************************************************************************
+ * csa_Decrypt:
+ *****************************************************************************/
+void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
+{
+    csa_DecryptBatch( c, &pkt, 1, i_pkt_size );
+}
+
+/*****************************************************************************
+ * csa_Encrypt:
+ *****************************************************************************/
+void csa_Encrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
+{
+    csa_EncryptBatch( c, &pkt, 1, i_pkt_size );
 }
 
 /*****************************************************************************
@@ -610,3 +613,259 @@ static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] )
     }
 }
 
+/*****************************************************************************
+ * Bitsliced stream cypher, for each available word size
+ *****************************************************************************/
+#define CSA_BS_WORD     uint64_t
+#define CSA_BS_LANES    64
+#define CSA_BS_FUNC(n)  n##_64
+#define CSA_BS_TARGET
+#include "csa_bitslice.h"
+#undef CSA_BS_WORD
+#undef CSA_BS_LANES
+#undef CSA_BS_FUNC
+#undef CSA_BS_TARGET
+
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (VLC_GCC_VERSION(4, 9) || defined(__clang__))
+# define CSA_BS_X86 1
+typedef uint64_t csa_bs128_t __attribute__ ((vector_size (16)));
+typedef uint64_t csa_bs256_t __attribute__ ((vector_size (32)));
+
+# define CSA_BS_WORD    csa_bs128_t
+# define CSA_BS_LANES   128
+# define CSA_BS_FUNC(n) n##_sse2
+# define CSA_BS_TARGET  __attribute__ ((__target__ ("sse2")))
+# include "csa_bitslice.h"
+# undef CSA_BS_WORD
+# undef CSA_BS_LANES
+# undef CSA_BS_FUNC
+# undef CSA_BS_TARGET
+
+# define CSA_BS_WORD    csa_bs256_t
+# define CSA_BS_LANES   256
+# define CSA_BS_FUNC(n) n##_avx2
+# define CSA_BS_TARGET  __attribute__ ((__target__ ("avx2")))
+# include "csa_bitslice.h"
+# undef CSA_BS_WORD
+# undef CSA_BS_LANES
+# undef CSA_BS_FUNC
+# undef CSA_BS_TARGET
+#endif
+
+/*****************************************************************************
+ * csa_StreamLanes: computes the stream cypher outputs of the lanes
+ *****************************************************************************/
+static void csa_StreamLanes( csa_t *c, unsigned i_lanes )
+{
+    unsigned i_done = 0;
+
+    while( i_lanes - i_done >= CSA_BATCH_MIN )
+    {
+        const csa_lane_t *lanes = &c->lanes[i_done];
+        unsigned i_count = i_lanes - i_done;
+        unsigned i_blocks = 0;
+        void (*pf_batch)( const csa_lane_t *, unsigned, unsigned,
+                          uint8_t [][CSA_STREAM_MAX] ) = csa_StreamBatch_64;
+        unsigned i_max = 64;
+
+#ifdef CSA_BS_X86
+        if( i_count > 128 && vlc_CPU_AVX2() )
+        {
+            pf_batch = csa_StreamBatch_avx2;
+            i_max = 256;
+        }
+        else if( i_count > 64 && vlc_CPU_SSE2() )
+        {
+            pf_batch = csa_StreamBatch_sse2;
+            i_max = 128;
+        }
+#endif
+        if( i_count > i_max )
+            i_count = i_max;
+
+        for( unsigned i = 0; i < i_count; i++ )
+            if( i_blocks < (unsigned)lanes[i].i_stream )
+                i_blocks = lanes[i].i_stream;
+
+        pf_batch( lanes, i_count, i_blocks, &c->stream[i_done] );
+        i_done += i_count;
+    }
+
+    for( ; i_done < i_lanes; i_done++ )
+    {
+        csa_lane_t *lane = &c->lanes[i_done];
+        uint8_t ib[8];
+
+        csa_StreamCypher( c, 1, lane->ck, &lane->pkt[lane->i_hdr], ib );
+        for( int i = 0; i < lane->i_stream; i++ )
+            csa_StreamCypher( c, 0, lane->ck, NULL, &c->stream[i_done][8*i] );
+    }
+}
+
+/*****************************************************************************
+ * csa_BlockLanes: runs the block (de)cypher on several blocks at once
+ *****************************************************************************/
+static void csa_BlockLanes( uint8_t *const *pp_kk, uint8_t blocks[][8],
+                            unsigned i_blocks, bool b_decypher )
+{
+    void (*pf_batch)( uint8_t *const *, uint8_t [][8], unsigned, bool )
+        = csa_BlockBatch_64;
+    unsigned i_max = 8;
+
+    if( i_blocks < CSA_BLOCK_MIN )
+    {
+        for( unsigned i = 0; i < i_blocks; i++ )
+        {
+            uint8_t block[8];
+
+            if( b_decypher )
+                csa_BlockDecypher( pp_kk[i], blocks[i], block );
+            else
+                csa_BlockCypher( pp_kk[i], blocks[i], block );
+            memcpy( blocks[i], block, 8 );
+        }
+        return;
+    }
+
+#ifdef CSA_BS_X86
+    if( vlc_CPU_AVX2() )
+    {
+        pf_batch = csa_BlockBatch_avx2;
+        i_max = 32;
+    }
+    else if( vlc_CPU_SSE2() )
+    {
+        pf_batch = csa_BlockBatch_sse2;
+        i_max = 16;
+    }
+#endif
+    for( unsigned i = 0; i < i_blocks; i += i_max )
+        pf_batch( &pp_kk[i], &blocks[i], __MIN(i_max, i_blocks - i),
+                  b_decypher );
+}
+
+/*****************************************************************************
+ * csa_DecryptLanes:
+ *****************************************************************************/
+static void csa_DecryptLanes( csa_t *c, unsigned i_lanes )
+{
+    /* all the blocks can be decyphered at once, as their inputs only depend
+     * on the scrambled data */
+    uint8_t        blocks[CSA_BATCH][8];
+    uint8_t       *kk[CSA_BATCH];
+    uint8_t       *dst[CSA_BATCH];
+    const uint8_t *next[CSA_BATCH];
+    unsigned       i_blocks = 0;
+
+    /* the stream cypher is initialized with the still scrambled first block */
+    csa_StreamLanes( c, i_lanes );
+
+    for( unsigned l = 0; l < i_lanes; l++ )
+    {
+        const csa_lane_t *lane = &c->lanes[l];
+        uint8_t *stream = c->stream[l];
+        uint8_t *pkt = &lane->pkt[lane->i_hdr];
+        const int n = lane->n;
+        int i, j;
+
+        /* ib of the blocks after the first one: xor with stream,
+         * stored in place of the stream */
+        for( i = 1; i < n; i++ )
+        {
+            for( j = 0; j < 8; j++ )
+            {
+                stream[8*(i-1)+j] ^= pkt[8*i+j];
+            }
+        }
+
+        for( i = 1; i < n + 1; i++ )
+        {
+            memcpy( blocks[i_blocks], i == 1 ? pkt : &stream[8*(i-2)], 8 );
+            kk[i_blocks] = lane->kk;
+            dst[i_blocks] = &pkt[8*(i-1)];
+            /* xored with the ib of the next block, none for the last one */
+            next[i_blocks] = i != n ? &stream[8*(i-1)] : NULL;
+
+            if( ++i_blocks == CSA_BATCH )
+            {
+                csa_BlockLanes( kk, blocks, i_blocks, true );
+                for( unsigned b = 0; b < i_blocks; b++ )
+                    for( j = 0; j < 8; j++ )
+                        dst[b][j] = blocks[b][j] ^ ( next[b] ? next[b][j] : 0 );
+                i_blocks = 0;
+            }
+        }
+
+        if( lane->i_residue > 0 )
+        {
+            stream += 8 * ( n > 0 ? n - 1 : 0 );
+            for( j = 0; j < lane->i_residue; j++ )
+            {
+                pkt[8*n+j] ^= stream[j];
+            }
+        }
+    }
+
+    csa_BlockLanes( kk, blocks, i_blocks, true );
+    for( unsigned b = 0; b < i_blocks; b++ )
+        for( int j = 0; j < 8; j++ )
+            dst[b][j] = blocks[b][j] ^ ( next[b] ? next[b][j] : 0 );
+}
+
+/*****************************************************************************
+ * csa_EncryptLanes:
+ *****************************************************************************/
+static void csa_EncryptLanes( csa_t *c, unsigned i_lanes )
+{
+    /* the blocks of a packet are chained from the last one, so only one
+     * block per packet is cyphered at a time */
+    uint8_t  blocks[CSA_BATCH][8];
+    uint8_t *kk[CSA_BATCH];
+    uint8_t *dst[CSA_BATCH];
+    int      i_max = 0;
+
+    for( unsigned l = 0; l < i_lanes; l++ )
+        if( i_max < c->lanes[l].n )
+            i_max = c->lanes[l].n;
+
+    for( int s = 0; s < i_max; s++ )
+    {
+        unsigned i_blocks = 0;
+
+        for( unsigned l = 0; l < i_lanes; l++ )
+        {
+            const csa_lane_t *lane = &c->lanes[l];
+            const int i = lane->n - s;
+            if( i <= 0 )
+                continue;
+
+            /* xor with ib of the next block, already in place */
+            uint8_t *pkt = &lane->pkt[lane->i_hdr + 8*(i-1)];
+            for( int j = 0; j < 8; j++ )
+                blocks[i_blocks][j] = pkt[j] ^ ( i < lane->n ? pkt[8+j] : 0 );
+            kk[i_blocks] = lane->kk;
+            dst[i_blocks] = pkt;
+            i_blocks++;
+        }
+
+        csa_BlockLanes( kk, blocks, i_blocks, false );
+        for( unsigned b = 0; b < i_blocks; b++ )
+            memcpy( dst[b], blocks[b], 8 );
+    }
+
+    /* the stream cypher is initialized with the first scrambled block */
+    csa_StreamLanes( c, i_lanes );
+
+    for( unsigned l = 0; l < i_lanes; l++ )
+    {
+        const csa_lane_t *lane = &c->lanes[l];
+        const uint8_t *stream = c->stream[l];
+        uint8_t *pkt = &lane->pkt[lane->i_hdr + 8];
+
+        /* the first block is left as is, the others and the residue
+         * are xored with the stream */
+        for( int i = 0; i < 8 * (lane->n - 1) + lane->i_residue; i++ )
+            pkt[i] ^= stream[i];
+    }
+}
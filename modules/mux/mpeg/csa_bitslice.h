@@ -0,0 +1,464 @@
+/*****************************************************************************
+ * csa_bitslice.h: bitsliced CSA stream cypher
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * This file is included by csa.c once per word size, with:
+ *  CSA_BS_WORD     the word type, supporting the C bitwise operators
+ *  CSA_BS_LANES    the number of bits of a word
+ *  CSA_BS_FUNC(n)  the name of the functions for that word size
+ *  CSA_BS_TARGET   the attributes of the functions for that word size
+ *
+ * Each lane (bit of a word) runs the stream cypher of one packet: every bit
+ * of the cypher state (see csa_StreamCypher) is a word, and the s-boxes are
+ * evaluated as xors of ands of their inputs.
+ */
+
+#define CSA_BS_U64 (CSA_BS_LANES / 64)
+
+/* Shift registers: the state of step t is at t, A[1] being the newest */
+#define A(k,b) a[t + 10 - (k)][b]
+#define B(k,b) bb[t + 10 - (k)][b]
+
+/* Broadcasts bit i of each lane value to the lanes of a word */
+CSA_BS_TARGET
+static CSA_BS_WORD CSA_BS_FUNC(csa_BsLoad)( const uint64_t *p_values,
+                                            unsigned i_lanes, unsigned i )
+{
+    uint64_t w[CSA_BS_U64] = { 0 };
+    CSA_BS_WORD word;
+
+    for( unsigned l = 0; l < i_lanes; l++ )
+        w[l / 64] |= ((p_values[l] >> i) & 1) << (l % 64);
+    memcpy( &word, w, sizeof(word) );
+    return word;
+}
+
+/*****************************************************************************
+ * csa_StreamBatch: runs the stream cypher of up to CSA_BS_LANES lanes,
+ * initialized with their control word and first 8 bytes of payload, and
+ * writes i_blocks stream cypher outputs (8 bytes each) of each lane
+ *****************************************************************************/
+CSA_BS_TARGET
+static void CSA_BS_FUNC(csa_StreamBatch)( const csa_lane_t *lanes,
+                                          unsigned i_lanes, unsigned i_blocks,
+                                          uint8_t stream[][CSA_STREAM_MAX] )
+{
+    const CSA_BS_WORD zero = (CSA_BS_WORD){ 0 };
+    /* 32 steps (8 bytes) are run between shift register moves */
+    CSA_BS_WORD a[10 + 32][4], bb[10 + 32][4];
+    CSA_BS_WORD X[4], Y[4], Z[4], D[4], E[4], F[4], p, q, r;
+    CSA_BS_WORD in[16][4];
+    CSA_BS_WORD out[8][8];
+    uint64_t values[CSA_BS_LANES];
+
+    assert( i_lanes <= CSA_BS_LANES );
+
+    /* load first 32 bits of CK into A[1]..A[8]
+     * load last  32 bits of CK into B[1]..B[8]
+     * all other regs = 0 */
+    for( unsigned l = 0; l < i_lanes; l++ )
+        values[l] = GetQWBE( lanes[l].ck );
+    for( unsigned b = 0; b < 4; b++ )
+    {
+        for( unsigned k = 1; k <= 8; k++ )
+        {
+            a[10 - k][b] = CSA_BS_FUNC(csa_BsLoad)( values, i_lanes, 64 - 4 * k + b );
+            bb[10 - k][b] = CSA_BS_FUNC(csa_BsLoad)( values, i_lanes, 32 - 4 * k + b );
+        }
+        a[0][b] = a[1][b] = bb[0][b] = bb[1][b] = zero;
+        X[b] = Y[b] = Z[b] = D[b] = E[b] = F[b] = zero;
+    }
+    p = q = r = zero;
+
+    /* the first 8 bytes of payload, as nibbles, feed the initialization */
+    for( unsigned l = 0; l < i_lanes; l++ )
+        values[l] = GetQWBE( &lanes[l].pkt[lanes[l].i_hdr] );
+    for( unsigned i = 0; i < 16; i++ )
+        for( unsigned b = 0; b < 4; b++ )
+            in[i][b] = CSA_BS_FUNC(csa_BsLoad)( values, i_lanes, 60 - 4 * i + b );
+
+    for( unsigned i_block = 0; i_block <= i_blocks; i_block++ )
+    {
+        const bool b_init = i_block == 0;
+
+        for( unsigned t = 0; t < 32; t++ )
+        {
+            CSA_BS_WORD m3, m5, m6, m7, m9, m10, m11, m12, m13, m14, m17, m18,
+                        m19, m20, m21, m22, m23, m24, m25, m26, m27, m28, m29,
+                        m30;
+            CSA_BS_WORD s1_0, s1_1, s2_0, s2_1, s3_0, s3_1, s4_0, s4_1,
+                        s5_0, s5_1, s6_0, s6_1, s7_0, s7_1;
+            CSA_BS_WORD extra_B[4], next_A1[4], next_B1[4], c;
+
+            // from A[1]..A[10], 35 bits are selected as inputs to 7 s-boxes
+            // 5 bits input per s-box, 2 bits output per s-box
+            /* s1 */
+            m3 = A(9,0) & A(7,3);
+            m5 = A(9,0) & A(6,1);
+            m6 = A(7,3) & A(6,1);
+            m9 = A(9,0) & A(1,2);
+            m10 = A(7,3) & A(1,2);
+            m12 = A(6,1) & A(1,2);
+            m17 = A(9,0) & A(4,0);
+            m20 = A(6,1) & A(4,0);
+            m24 = A(1,2) & A(4,0);
+            m11 = m3 & A(1,2);
+            m13 = m5 & A(1,2);
+            m14 = m6 & A(1,2);
+            m19 = m3 & A(4,0);
+            m22 = m6 & A(4,0);
+            m26 = m10 & A(4,0);
+            m28 = m12 & A(4,0);
+            m27 = m11 & A(4,0);
+            m29 = m13 & A(4,0);
+            m30 = m14 & A(4,0);
+            s1_0 = A(7,3) ^ m5 ^ A(1,2) ^ m9 ^ m11 ^ m17 ^ m24 ^ m26 ^ m28 ^ m29;
+            s1_1 = ~(A(9,0) ^ A(7,3) ^ m3 ^ m5 ^ m6 ^ m9 ^ m10 ^ m12 ^ m13 ^ m14 ^ A(4,0) ^ m19 ^ m20 ^ m22 ^ m24 ^ m26 ^ m27 ^ m28 ^ m30);
+            /* s2 */
+            m3 = A(9,1) & A(7,0);
+            m5 = A(9,1) & A(6,3);
+            m6 = A(7,0) & A(6,3);
+            m9 = A(9,1) & A(3,2);
+            m10 = A(7,0) & A(3,2);
+            m12 = A(6,3) & A(3,2);
+            m20 = A(6,3) & A(2,1);
+            m24 = A(3,2) & A(2,1);
+            m7 = m3 & A(6,3);
+            m11 = m3 & A(3,2);
+            m13 = m5 & A(3,2);
+            m19 = m3 & A(2,1);
+            m22 = m6 & A(2,1);
+            m25 = m9 & A(2,1);
+            m26 = m10 & A(2,1);
+            m28 = m12 & A(2,1);
+            m27 = m11 & A(2,1);
+            m29 = m13 & A(2,1);
+            s2_0 = ~(A(7,0) ^ A(6,3) ^ m5 ^ m11 ^ m13 ^ m19 ^ m20 ^ m24 ^ m27 ^ m29);
+            s2_1 = ~(A(9,1) ^ A(7,0) ^ m5 ^ m6 ^ m7 ^ A(3,2) ^ m22 ^ m25 ^ m26 ^ m27 ^ m28);
+            /* s3 */
+            m3 = A(6,2) & A(5,3);
+            m5 = A(6,2) & A(5,1);
+            m6 = A(5,3) & A(5,1);
+            m9 = A(6,2) & A(2,0);
+            m10 = A(5,3) & A(2,0);
+            m12 = A(5,1) & A(2,0);
+            m18 = A(5,3) & A(1,3);
+            m20 = A(5,1) & A(1,3);
+            m7 = m3 & A(5,1);
+            m11 = m3 & A(2,0);
+            m14 = m6 & A(2,0);
+            m19 = m3 & A(1,3);
+            m21 = m5 & A(1,3);
+            m22 = m6 & A(1,3);
+            m25 = m9 & A(1,3);
+            m28 = m12 & A(1,3);
+            m23 = m7 & A(1,3);
+            m30 = m14 & A(1,3);
+            s3_0 = A(5,3) ^ m3 ^ m5 ^ A(2,0) ^ A(1,3);
+            s3_1 = ~(A(6,2) ^ A(5,3) ^ m5 ^ m6 ^ m7 ^ A(2,0) ^ m9 ^ m10 ^ m11 ^ m12 ^ m14 ^ A(1,3) ^ m18 ^ m19 ^ m20 ^ m21 ^ m22 ^ m23 ^ m25 ^ m28 ^ m30);
+            /* s4 */
+            m3 = A(8,0) & A(4,2);
+            m6 = A(4,2) & A(2,3);
+            m9 = A(8,0) & A(1,1);
+            m12 = A(2,3) & A(1,1);
+            m17 = A(8,0) & A(3,3);
+            m18 = A(4,2) & A(3,3);
+            m24 = A(1,1) & A(3,3);
+            m7 = m3 & A(2,3);
+            m11 = m3 & A(1,1);
+            m14 = m6 & A(1,1);
+            m25 = m9 & A(3,3);
+            m28 = m12 & A(3,3);
+            m23 = m7 & A(3,3);
+            m27 = m11 & A(3,3);
+            m30 = m14 & A(3,3);
+            s4_0 = ~(A(4,2) ^ m3 ^ A(2,3) ^ m9 ^ m11 ^ m12 ^ m17 ^ m18 ^ m23 ^ m24 ^ m25 ^ m27 ^ m28 ^ m30);
+            s4_1 = ~(A(8,0) ^ m3 ^ A(2,3) ^ m7 ^ A(1,1) ^ m14 ^ A(3,3) ^ m17 ^ m18 ^ m23 ^ m24 ^ m25 ^ m27 ^ m28 ^ m30);
+            /* s5 */
+            m3 = A(9,2) & A(8,1);
+            m5 = A(9,2) & A(6,0);
+            m6 = A(8,1) & A(6,0);
+            m9 = A(9,2) & A(4,3);
+            m10 = A(8,1) & A(4,3);
+            m17 = A(9,2) & A(5,2);
+            m18 = A(8,1) & A(5,2);
+            m20 = A(6,0) & A(5,2);
+            m24 = A(4,3) & A(5,2);
+            m7 = m3 & A(6,0);
+            m11 = m3 & A(4,3);
+            m13 = m5 & A(4,3);
+            m14 = m6 & A(4,3);
+            m21 = m5 & A(5,2);
+            m22 = m6 & A(5,2);
+            m25 = m9 & A(5,2);
+            m26 = m10 & A(5,2);
+            m23 = m7 & A(5,2);
+            m27 = m11 & A(5,2);
+            m29 = m13 & A(5,2);
+            m30 = m14 & A(5,2);
+            s5_0 = m3 ^ A(6,0) ^ m5 ^ m7 ^ m9 ^ m10 ^ m13 ^ m17 ^ m20 ^ m21 ^ m22 ^ m23 ^ m24 ^ m25 ^ m26 ^ m27;
+            s5_1 = ~(A(9,2) ^ A(8,1) ^ m3 ^ m5 ^ m6 ^ m7 ^ A(4,3) ^ m9 ^ m11 ^ m13 ^ m14 ^ m17 ^ m18 ^ m20 ^ m22 ^ m23 ^ m25 ^ m26 ^ m29 ^ m30);
+            /* s6 */
+            m3 = A(9,3) & A(7,2);
+            m5 = A(9,3) & A(5,0);
+            m6 = A(7,2) & A(5,0);
+            m9 = A(9,3) & A(4,1);
+            m10 = A(7,2) & A(4,1);
+            m12 = A(5,0) & A(4,1);
+            m7 = m3 & A(5,0);
+            m11 = m3 & A(4,1);
+            m13 = m5 & A(4,1);
+            m14 = m6 & A(4,1);
+            m19 = m3 & A(3,1);
+            m22 = m6 & A(3,1);
+            m25 = m9 & A(3,1);
+            m23 = m7 & A(3,1);
+            m27 = m11 & A(3,1);
+            m30 = m14 & A(3,1);
+            s6_0 = A(9,3) ^ A(5,0) ^ m6 ^ m7 ^ m10 ^ m12 ^ m14 ^ m19 ^ m22 ^ m23 ^ m27 ^ m30;
+            s6_1 = A(7,2) ^ m5 ^ m11 ^ m12 ^ m13 ^ A(3,1) ^ m19 ^ m25;
+            /* s7 */
+            m3 = A(8,3) & A(8,2);
+            m6 = A(8,2) & A(7,1);
+            m10 = A(8,2) & A(3,0);
+            m12 = A(7,1) & A(3,0);
+            m17 = A(8,3) & A(2,2);
+            m20 = A(7,1) & A(2,2);
+            m7 = m3 & A(7,1);
+            m11 = m3 & A(3,0);
+            m14 = m6 & A(3,0);
+            m19 = m3 & A(2,2);
+            m22 = m6 & A(2,2);
+            m26 = m10 & A(2,2);
+            m23 = m7 & A(2,2);
+            m27 = m11 & A(2,2);
+            m30 = m14 & A(2,2);
+            s7_0 = A(8,3) ^ m3 ^ A(7,1) ^ m6 ^ m7 ^ A(3,0) ^ m12 ^ A(2,2) ^ m26 ^ m27;
+            s7_1 = A(8,3) ^ A(8,2) ^ m3 ^ A(7,1) ^ A(3,0) ^ m11 ^ m17 ^ m19 ^ m20 ^ m22 ^ m23 ^ m27 ^ m30;
+
+            /* use 4x4 xor to produce extra nibble for T3 */
+            extra_B[3] = B(3,0) ^ B(6,1) ^ B(7,2) ^ B(9,3);
+            extra_B[2] = B(6,0) ^ B(8,1) ^ B(3,3) ^ B(4,2);
+            extra_B[1] = B(5,3) ^ B(8,2) ^ B(4,0) ^ B(5,1);
+            extra_B[0] = B(9,2) ^ B(6,3) ^ B(3,1) ^ B(8,0);
+
+            for( unsigned b = 0; b < 4; b++ )
+            {
+                // T1 = xor all inputs
+                next_A1[b] = A(10,b) ^ X[b];
+                // T2 = xor all inputs
+                next_B1[b] = B(7,b) ^ B(10,b) ^ Y[b];
+            }
+            if( b_init )
+            {
+                // in1,in2, D are only used during initialisation
+                const CSA_BS_WORD *in1 = in[2 * (t / 4) + 0];
+                const CSA_BS_WORD *in2 = in[2 * (t / 4) + 1];
+                for( unsigned b = 0; b < 4; b++ )
+                {
+                    next_A1[b] ^= D[b] ^ ((t % 2) ? in2[b] : in1[b]);
+                    next_B1[b] ^= (t % 2) ? in1[b] : in2[b];
+                }
+            }
+
+            // if p=1, rotate left
+            const CSA_BS_WORD b3 = next_B1[3];
+            next_B1[3] ^= (next_B1[3] ^ next_B1[2]) & p;
+            next_B1[2] ^= (next_B1[2] ^ next_B1[1]) & p;
+            next_B1[1] ^= (next_B1[1] ^ next_B1[0]) & p;
+            next_B1[0] ^= (next_B1[0] ^ b3) & p;
+
+            // T4 = sum, carry of Z + E + r if q=1, E otherwise
+            // (T3 is computed along, as D uses the previous E)
+            c = r;
+            for( unsigned b = 0; b < 4; b++ )
+            {
+                const CSA_BS_WORD ze = Z[b] ^ E[b];
+                const CSA_BS_WORD sum = ze ^ c;
+                const CSA_BS_WORD next_E = F[b];
+
+                c = (Z[b] & E[b]) | (c & ze);
+                F[b] = E[b] ^ ((sum ^ E[b]) & q);
+                D[b] = ze ^ extra_B[b];
+                E[b] = next_E;
+            }
+            r ^= (c ^ r) & q;
+
+            for( unsigned b = 0; b < 4; b++ )
+            {
+                a[t + 10][b] = next_A1[b];
+                bb[t + 10][b] = next_B1[b];
+            }
+
+            X[3] = s4_0; X[2] = s3_0; X[1] = s2_1; X[0] = s1_1;
+            Y[3] = s6_0; Y[2] = s5_0; Y[1] = s4_1; Y[0] = s3_1;
+            Z[3] = s2_0; Z[2] = s1_0; Z[1] = s6_1; Z[0] = s5_1;
+            p = s7_1;
+            q = s7_0;
+
+            // 2 output bits are a function of the 4 bits of D
+            out[t / 4][7 - 2 * (t % 4)] = D[2] ^ D[3];
+            out[t / 4][6 - 2 * (t % 4)] = D[0] ^ D[1];
+        }
+        memmove( a, a[32], sizeof(a[0]) * 10 );
+        memmove( bb, bb[32], sizeof(bb[0]) * 10 );
+
+        if( b_init )
+            continue;
+
+        /* transpose the output bits to bytes, 8 lanes at a time */
+        const unsigned i_offset = 8 * (i_block - 1);
+        for( unsigned i = 0; i < 8; i++ )
+        {
+            uint64_t w[8][CSA_BS_U64];
+
+            memcpy( w, out[i], sizeof(w) );
+            for( unsigned l = 0; l < i_lanes; l += 8 )
+            {
+                uint64_t x = 0, y;
+
+                for( unsigned k = 0; k < 8; k++ )
+                    x |= ((w[k][l / 64] >> (l % 64)) & 0xff) << (8 * k);
+                y = (x ^ (x >> 7)) & UINT64_C(0x00AA00AA00AA00AA);
+                x ^= y ^ (y << 7);
+                y = (x ^ (x >> 14)) & UINT64_C(0x0000CCCC0000CCCC);
+                x ^= y ^ (y << 14);
+                y = (x ^ (x >> 28)) & UINT64_C(0x00000000F0F0F0F0);
+                x ^= y ^ (y << 28);
+
+                for( unsigned k = 0; k < 8 && l + k < i_lanes; k++ )
+                    stream[l + k][i_offset + i] = x >> (8 * k);
+            }
+        }
+    }
+}
+
+/* block_perm, on each byte of a word */
+CSA_BS_TARGET
+static inline CSA_BS_WORD CSA_BS_FUNC(csa_BsPerm)( CSA_BS_WORD x )
+{
+    return ((x & UINT64_C(0x2929292929292929)) << 1) |
+           ((x & UINT64_C(0x0202020202020202)) << 6) |
+           ((x & UINT64_C(0x0404040404040404)) << 3) |
+           ((x & UINT64_C(0x1010101010101010)) >> 2) |
+           ((x & UINT64_C(0x4040404040404040)) >> 6) |
+           ((x & UINT64_C(0x8080808080808080)) >> 4);
+}
+
+/* block_sbox, on each byte of a word */
+CSA_BS_TARGET
+static inline CSA_BS_WORD CSA_BS_FUNC(csa_BsSbox)( CSA_BS_WORD x )
+{
+    uint8_t bytes[sizeof(x)];
+
+    memcpy( bytes, &x, sizeof(x) );
+    for( unsigned l = 0; l < sizeof(x); l++ )
+        bytes[l] = block_sbox[bytes[l]];
+    memcpy( &x, bytes, sizeof(x) );
+    return x;
+}
+
+/*****************************************************************************
+ * csa_BlockBatch: runs the block cypher (or decypher) on up to
+ * CSA_BS_LANES / 8 blocks at once, each byte of the words being one block
+ *****************************************************************************/
+CSA_BS_TARGET
+static void CSA_BS_FUNC(csa_BlockBatch)( uint8_t *const *pp_kk,
+                                         uint8_t blocks[][8], unsigned i_blocks,
+                                         bool b_decypher )
+{
+    enum { LANES = CSA_BS_LANES / 8 };
+    uint8_t kk[57][LANES], bytes[8][LANES];
+    CSA_BS_WORD K[57], R[9];
+    unsigned l;
+
+    assert( i_blocks <= LANES );
+
+    /* transpose the keys, usually the same for all the blocks */
+    for( l = 1; l < i_blocks && pp_kk[l] == pp_kk[0]; l++ );
+    if( l == i_blocks )
+    {
+        for( unsigned i = 1; i <= 56; i++ )
+            memset( kk[i], pp_kk[0][i], LANES );
+    }
+    else
+    {
+        memset( kk, 0, sizeof(kk) );
+        for( l = 0; l < i_blocks; l++ )
+            for( unsigned i = 1; i <= 56; i++ )
+                kk[i][l] = pp_kk[l][i];
+    }
+    memcpy( &K[1], kk[1], sizeof(K[1]) * 56 );
+
+    /* transpose the blocks */
+    memset( bytes, 0, sizeof(bytes) );
+    for( l = 0; l < i_blocks; l++ )
+        for( unsigned i = 0; i < 8; i++ )
+            bytes[i][l] = blocks[l][i];
+    memcpy( &R[1], bytes, sizeof(R[1]) * 8 );
+
+    if( b_decypher )
+    {
+        // loop over kk[56]..kk[1]
+        for( unsigned i = 56; i > 0; i-- )
+        {
+            const CSA_BS_WORD sbox_out = CSA_BS_FUNC(csa_BsSbox)( K[i] ^ R[7] );
+            const CSA_BS_WORD perm_out = CSA_BS_FUNC(csa_BsPerm)( sbox_out );
+            const CSA_BS_WORD next_R8 = R[7];
+
+            R[7] = R[6] ^ perm_out;
+            R[6] = R[5];
+            R[5] = R[4] ^ R[8] ^ sbox_out;
+            R[4] = R[3] ^ R[8] ^ sbox_out;
+            R[3] = R[2] ^ R[8] ^ sbox_out;
+            R[2] = R[1];
+            R[1] = R[8] ^ sbox_out;
+            R[8] = next_R8;
+        }
+    }
+    else
+    {
+        // loop over kk[1]..kk[56]
+        for( unsigned i = 1; i <= 56; i++ )
+        {
+            const CSA_BS_WORD sbox_out = CSA_BS_FUNC(csa_BsSbox)( K[i] ^ R[8] );
+            const CSA_BS_WORD perm_out = CSA_BS_FUNC(csa_BsPerm)( sbox_out );
+            const CSA_BS_WORD next_R1 = R[2];
+
+            R[2] = R[3] ^ R[1];
+            R[3] = R[4] ^ R[1];
+            R[4] = R[5] ^ R[1];
+            R[5] = R[6];
+            R[6] = R[7] ^ perm_out;
+            R[7] = R[8];
+            R[8] = R[1] ^ sbox_out;
+            R[1] = next_R1;
+        }
+    }
+
+    memcpy( bytes, &R[1], sizeof(R[1]) * 8 );
+    for( l = 0; l < i_blocks; l++ )
+        for( unsigned i = 0; i < 8; i++ )
+            blocks[l][i] = bytes[i][l];
+}
+
+#undef A
+#undef B
+#undef CSA_BS_U64
@@ -173,6 +173,11 @@ static void    Close  ( vlc_object_t * );
 #define CU_LONGTEXT N_("CSA encryption key used. It can be the odd/first/1 " \
   "(default) or the even/second/2 one.")
 
+#define THREADS_TEXT N_("Threads")
+#define THREADS_LONGTEXT N_("Number of threads converting the elementary " \
+  "streams to PES packets (0 = one per CPU, 1 = muxer thread only). " \
+  "They are only started once several streams are converted at once.")
+
 #define CPKT_TEXT N_("Packet size in bytes to encrypt")
 #define CPKT_LONGTEXT N_("Size of the TS packet to encrypt. " \
     "The encryption routines subtract the TS-header from the value before " \
@@ -181,6 +186,8 @@ static void    Close  ( vlc_object_t * );
 #define SOUT_CFG_PREFIX "sout-ts-"
 #define MAX_PMT 64       /* Maximum number of programs. FIXME: I just chose an arbitrary number. Where is the maximum in the spec? */
 #define MAX_PMT_PID 64       /* Maximum pids in each pmt.  FIXME: I just chose an arbitrary number. Where is the maximum in the spec? */
+#define TS_CSA_BATCH 256 /* Packets scrambled at once */
+#define TS_MAX_THREADS 16 /* PES conversion threads, muxer thread included */
 #if MAX_SDT_DESC < MAX_PMT
   #error "MAX_SDT_DESC < MAX_PMT"
 #endif
@@ -216,6 +223,8 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "bmin", 0, BMIN_TEXT, BMIN_LONGTEXT, true)
     add_integer( SOUT_CFG_PREFIX "bmax", 0, BMAX_TEXT, BMAX_LONGTEXT, true)
     add_integer( SOUT_CFG_PREFIX "dts-delay", 400, DTS_TEXT, DTS_LONGTEXT, true)
+    add_integer( SOUT_CFG_PREFIX "threads", 0, THREADS_TEXT, THREADS_LONGTEXT, true)
+        change_integer_range( 0, TS_MAX_THREADS )
 
     add_bool( SOUT_CFG_PREFIX "crypt-audio", true, ACRYPT_TEXT, ACRYPT_LONGTEXT, true)
     add_bool( SOUT_CFG_PREFIX "crypt-video", true, VCRYPT_TEXT, VCRYPT_LONGTEXT, true)
@@ -235,7 +244,7 @@ static const char *const ppsz_sout_options[] = {
     "netid", "sdtdesc",
     "es-id-pid", "shaping", "pcr", "bmin", "bmax", "use-key-frames",
     "dts-delay", "csa-ck", "csa2-ck", "csa-use", "csa-pkt", "crypt-audio", "crypt-video",
-    "muxpmt", "program-pmt", "alignment",
+    "muxpmt", "program-pmt", "alignment", "threads",
     NULL
 };
 
@@ -311,6 +320,7 @@ static inline void BufferChainClean( sout_buffer_chain_t *c )
 
 typedef struct
 {
+    sout_buffer_chain_t chain_es;   /* waiting for PES conversion */
     sout_buffer_chain_t chain_pes;
     mtime_t             i_pes_dts;
     mtime_t             i_pes_length;
@@ -353,6 +363,24 @@ struct sout_mux_sys_t
 
     sdt_psi_t       sdt;
 
+    /* PAT, PMT and SDT packets, built again only when the programs change */
+    block_t         *p_psi_pat;
+    block_t         *p_psi_pmt;
+
+    /* PES conversion threads (besides the muxer thread), started when
+     * several streams need converting at once */
+    int             i_threads;
+    int             i_threads_max;
+    vlc_thread_t    threads[TS_MAX_THREADS - 1];
+    vlc_mutex_t     jobs_lock;
+    vlc_cond_t      jobs_wait;
+    vlc_cond_t      jobs_done;
+    sout_input_t    **pp_jobs;
+    int             i_jobs;
+    int             i_jobs_next;
+    int             i_jobs_done;
+    bool            b_jobs_exit;
+
     /* for TS building */
     int64_t         i_bitrate_min;
     int64_t         i_bitrate_max;
@@ -465,6 +493,9 @@ static void TSDate      ( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
                           mtime_t i_pcr_length, mtime_t i_pcr_dts );
 static void GetPAT( sout_mux_t *p_mux, sout_buffer_chain_t *c );
 static void GetPMT( sout_mux_t *p_mux, sout_buffer_chain_t *c );
+static void PSIInvalidate( sout_mux_sys_t *p_sys );
+
+static void *PESThread( void * );
 
 static block_t *TSNew( sout_mux_t *p_mux, sout_input_sys_t *p_stream, bool b_pcr );
 static void TSSetPCR( block_t *p_ts, mtime_t i_dts );
@@ -722,6 +753,18 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->csa = csaSetup(p_this);
 
+    int i_threads = var_GetInteger( p_mux, SOUT_CFG_PREFIX "threads" );
+    if( i_threads <= 0 )
+        i_threads = vlc_GetCPUCount();
+    if( i_threads > TS_MAX_THREADS )
+        i_threads = TS_MAX_THREADS;
+
+    p_sys->i_threads_max = i_threads - 1;
+
+    vlc_mutex_init( &p_sys->jobs_lock );
+    vlc_cond_init( &p_sys->jobs_wait );
+    vlc_cond_init( &p_sys->jobs_done );
+
     p_mux->pf_control   = Control;
     p_mux->pf_addstream = AddStream;
     p_mux->pf_delstream = DelStream;
@@ -738,6 +781,18 @@ static void Close( vlc_object_t * p_this )
     sout_mux_t          *p_mux = (sout_mux_t*)p_this;
     sout_mux_sys_t      *p_sys = p_mux->p_sys;
 
+    vlc_mutex_lock( &p_sys->jobs_lock );
+    p_sys->b_jobs_exit = true;
+    vlc_cond_broadcast( &p_sys->jobs_wait );
+    vlc_mutex_unlock( &p_sys->jobs_lock );
+    for( int i = 0; i < p_sys->i_threads; i++ )
+        vlc_join( p_sys->threads[i], NULL );
+    vlc_cond_destroy( &p_sys->jobs_done );
+    vlc_cond_destroy( &p_sys->jobs_wait );
+    vlc_mutex_destroy( &p_sys->jobs_lock );
+
+    PSIInvalidate( p_sys );
+
     if( p_sys->p_dvbpsi )
         dvbpsi_delete( p_sys->p_dvbpsi );
 
@@ -1086,10 +1141,12 @@ static int AddStream( sout_mux_t *p_mux, sout_input_t *p_input )
     }
 
     /* Init pes chain */
+    BufferChainInit( &p_stream->state.chain_es );
     BufferChainInit( &p_stream->state.chain_pes );
 
     /* We only change PMT version (PAT isn't changed) */
     p_sys->i_pmt_version_number = ( p_sys->i_pmt_version_number + 1 )%32;
+    PSIInvalidate( p_sys );
 
     /* Update pcr_pid */
     if( p_input->p_fmt->i_cat != SPU_ES &&
@@ -1164,6 +1221,7 @@ static void DelStream( sout_mux_t *p_mux, sout_input_t *p_input )
     }
 
     /* Empty all data in chain_pes */
+    BufferChainClean( &p_stream->state.chain_es );
     BufferChainClean( &p_stream->state.chain_pes );
 
     free(p_stream->pes.lang);
@@ -1193,6 +1251,7 @@ static void DelStream( sout_mux_t *p_mux, sout_input_t *p_input )
     /* We only change PMT version (PAT isn't changed) */
     p_sys->i_pmt_version_number++;
     p_sys->i_pmt_version_number %= 32;
+    PSIInvalidate( p_sys );
 }
 
 static void SetHeader( sout_buffer_chain_t *c,
@@ -1221,6 +1280,126 @@ static block_t *Pack_Opus(block_t *p_data)
     return p_data;
 }
 
+/*****************************************************************************
+ * PES conversion: the audio and video blocks gathered by MuxStreams() are
+ * converted stream by stream, on the muxer thread and the PES threads.
+ *****************************************************************************/
+static void PESConvert( sout_mux_t *p_mux, sout_input_t *p_input )
+{
+    sout_mux_sys_t   *p_sys = p_mux->p_sys;
+    sout_input_sys_t *p_stream = (sout_input_sys_t*)p_input->p_sys;
+    int i_max_pes_size = 0;
+    int b_data_alignment = 0;
+
+    if( p_input->p_fmt->i_codec == VLC_CODEC_DIRAC )
+    {
+        b_data_alignment = 1;
+        /* dirac pes packets should be unbounded in
+         * length, specify a suitibly large max size */
+        i_max_pes_size = INT_MAX;
+    }
+
+    block_t *p_data;
+    while( ( p_data = BufferChainGet( &p_stream->state.chain_es ) ) )
+    {
+        EStoPES ( &p_data, p_input->p_fmt, p_stream->pes.i_stream_id,
+                       1, b_data_alignment, 0,
+                       i_max_pes_size, p_sys->first_dts );
+
+        BufferChainAppend( &p_stream->state.chain_pes, p_data );
+    }
+}
+
+static void *PESThread( void *data )
+{
+    sout_mux_t     *p_mux = data;
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    vlc_mutex_lock( &p_sys->jobs_lock );
+    for( ;; )
+    {
+        while( !p_sys->b_jobs_exit && p_sys->i_jobs_next >= p_sys->i_jobs )
+            vlc_cond_wait( &p_sys->jobs_wait, &p_sys->jobs_lock );
+        if( p_sys->b_jobs_exit )
+            break;
+
+        sout_input_t *p_input = p_sys->pp_jobs[p_sys->i_jobs_next++];
+        vlc_mutex_unlock( &p_sys->jobs_lock );
+
+        PESConvert( p_mux, p_input );
+
+        vlc_mutex_lock( &p_sys->jobs_lock );
+        if( ++p_sys->i_jobs_done == p_sys->i_jobs )
+            vlc_cond_signal( &p_sys->jobs_done );
+    }
+    vlc_mutex_unlock( &p_sys->jobs_lock );
+    return NULL;
+}
+
+static void PESConvertAll( sout_mux_t *p_mux )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    if( p_mux->i_nb_inputs == 0 )
+        return;
+
+    sout_input_t   *jobs[p_mux->i_nb_inputs];
+    int i_jobs = 0;
+
+    for( int i = 0; i < p_mux->i_nb_inputs; i++ )
+    {
+        sout_input_sys_t *p_stream = (sout_input_sys_t*)p_mux->pp_inputs[i]->p_sys;
+
+        if( p_stream->state.chain_es.p_first != NULL )
+            jobs[i_jobs++] = p_mux->pp_inputs[i];
+    }
+
+    /* no more threads than streams to convert besides this one */
+    while( p_sys->i_threads < __MIN( p_sys->i_threads_max, i_jobs - 1 ) )
+    {
+        if( vlc_clone( &p_sys->threads[p_sys->i_threads], PESThread, p_mux,
+                       VLC_THREAD_PRIORITY_OUTPUT ) )
+        {
+            p_sys->i_threads_max = p_sys->i_threads;
+            break;
+        }
+        p_sys->i_threads++;
+    }
+
+    if( p_sys->i_threads == 0 || i_jobs <= 1 )
+    {
+        for( int i = 0; i < i_jobs; i++ )
+            PESConvert( p_mux, jobs[i] );
+        return;
+    }
+
+    vlc_mutex_lock( &p_sys->jobs_lock );
+    p_sys->pp_jobs = jobs;
+    p_sys->i_jobs = i_jobs;
+    p_sys->i_jobs_next = 0;
+    p_sys->i_jobs_done = 0;
+    vlc_cond_broadcast( &p_sys->jobs_wait );
+
+    /* convert streams here too, rather than just waiting */
+    while( p_sys->i_jobs_next < p_sys->i_jobs )
+    {
+        sout_input_t *p_input = p_sys->pp_jobs[p_sys->i_jobs_next++];
+        vlc_mutex_unlock( &p_sys->jobs_lock );
+
+        PESConvert( p_mux, p_input );
+
+        vlc_mutex_lock( &p_sys->jobs_lock );
+        p_sys->i_jobs_done++;
+    }
+    while( p_sys->i_jobs_done < p_sys->i_jobs )
+        vlc_cond_wait( &p_sys->jobs_done, &p_sys->jobs_lock );
+
+    p_sys->pp_jobs = NULL;
+    p_sys->i_jobs = 0;
+    p_sys->i_jobs_next = 0;
+    vlc_mutex_unlock( &p_sys->jobs_lock );
+}
+
 /* returns true if needs more data */
 static bool MuxStreams(sout_mux_t *p_mux )
 {
@@ -1287,6 +1466,7 @@ static bool MuxStreams(sout_mux_t *p_mux )
                 if ( ( i_spu_delay >= 100 * CLOCK_FREQ ) ||
                      ( i_spu_delay < CLOCK_FREQ / 100 ) )
                 {
+                    BufferChainClean( &p_stream->state.chain_es );
                     BufferChainClean( &p_stream->state.chain_pes );
                     p_stream->state.i_pes_dts = 0;
                     p_stream->state.i_pes_used = 0;
@@ -1342,6 +1522,7 @@ static bool MuxStreams(sout_mux_t *p_mux )
                       p_pcr_stream->state.i_pes_dts );
             block_Release( p_data );
 
+            BufferChainClean( &p_stream->state.chain_es );
             BufferChainClean( &p_stream->state.chain_pes );
             p_stream->state.i_pes_dts = 0;
             p_stream->state.i_pes_used = 0;
@@ -1349,6 +1530,7 @@ static bool MuxStreams(sout_mux_t *p_mux )
 
             if( p_input->p_fmt->i_cat != SPU_ES )
             {
+                BufferChainClean( &p_pcr_stream->state.chain_es );
                 BufferChainClean( &p_pcr_stream->state.chain_pes );
                 p_pcr_stream->state.i_pes_dts = 0;
                 p_pcr_stream->state.i_pes_used = 0;
@@ -1359,7 +1541,6 @@ static bool MuxStreams(sout_mux_t *p_mux )
         }
 
         int i_header_size = 0;
-        int i_max_pes_size = 0;
         int b_data_alignment = 0;
         if( p_input->p_fmt->i_cat == SPU_ES ) switch (p_input->p_fmt->i_codec)
         {
@@ -1425,19 +1606,20 @@ static bool MuxStreams(sout_mux_t *p_mux )
             p_data->i_pts = p_data->i_dts;
         }
 
-        if( p_input->p_fmt->i_codec == VLC_CODEC_DIRAC )
+        if( p_input->p_fmt->i_cat == AUDIO_ES ||
+            p_input->p_fmt->i_cat == VIDEO_ES )
         {
-            b_data_alignment = 1;
-            /* dirac pes packets should be unbounded in
-             * length, specify a suitibly large max size */
-            i_max_pes_size = INT_MAX;
+            /* converted with the other streams once enough data is there */
+            BufferChainAppend( &p_stream->state.chain_es, p_data );
         }
+        else
+        {
+            EStoPES ( &p_data, p_input->p_fmt, p_stream->pes.i_stream_id,
+                               1, b_data_alignment, i_header_size,
+                           0, p_sys->first_dts );
 
-        EStoPES ( &p_data, p_input->p_fmt, p_stream->pes.i_stream_id,
-                       1, b_data_alignment, i_header_size,
-                       i_max_pes_size, p_sys->first_dts );
-
-        BufferChainAppend( &p_stream->state.chain_pes, p_data );
+            BufferChainAppend( &p_stream->state.chain_pes, p_data );
+        }
 
         if( p_sys->b_use_key_frames && p_stream == p_pcr_stream
             && (p_data->i_flags & BLOCK_FLAG_TYPE_I)
@@ -1449,6 +1631,8 @@ static bool MuxStreams(sout_mux_t *p_mux )
         }
     }
 
+    PESConvertAll( p_mux );
+
     /* save */
     const mtime_t i_pcr_length = p_pcr_stream->state.i_pes_length;
     p_pcr_stream->state.b_key_frame = 0;
@@ -1781,31 +1965,47 @@ static void TSDate( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
     }
 
     /* msg_Dbg( p_mux, "real pck=%d", i_packet_count ); */
-    for (int i = 0; i < i_packet_count; i++ )
+    block_t *p_ts = p_chain_ts->p_first;
+    for (int i = 0; i < i_packet_count; )
     {
-        block_t *p_ts = BufferChainGet( p_chain_ts );
-        mtime_t i_new_dts = i_pcr_dts + i_pcr_length * i / i_packet_count;
+        /* packets are scrambled by batches, much faster than one by one */
+        uint8_t *pp_scrambled[TS_CSA_BATCH];
+        int i_scrambled = 0;
 
-        p_ts->i_dts    = i_new_dts;
-        p_ts->i_length = i_pcr_length / i_packet_count;
-
-        if( p_ts->i_flags & BLOCK_FLAG_CLOCK )
+        for( ; i < i_packet_count && i_scrambled < TS_CSA_BATCH;
+             i++, p_ts = p_ts->p_next )
         {
-            /* msg_Dbg( p_mux, "pcr=%lld ms", p_ts->i_dts / 1000 ); */
-            TSSetPCR( p_ts, p_ts->i_dts - p_sys->i_dts_delay - p_sys->first_dts );
+            mtime_t i_new_dts = i_pcr_dts + i_pcr_length * i / i_packet_count;
+
+            p_ts->i_dts    = i_new_dts;
+            p_ts->i_length = i_pcr_length / i_packet_count;
+
+            if( p_ts->i_flags & BLOCK_FLAG_CLOCK )
+            {
+                /* msg_Dbg( p_mux, "pcr=%lld ms", p_ts->i_dts / 1000 ); */
+                TSSetPCR( p_ts, p_ts->i_dts - p_sys->i_dts_delay - p_sys->first_dts );
+            }
+            if( p_ts->i_flags & BLOCK_FLAG_SCRAMBLED )
+                pp_scrambled[i_scrambled++] = p_ts->p_buffer;
+
+            /* latency */
+            p_ts->i_dts += p_sys->i_shaping_delay * 3 / 2;
         }
-        if( p_ts->i_flags & BLOCK_FLAG_SCRAMBLED )
+
+        if( i_scrambled > 0 )
         {
             vlc_mutex_lock( &p_sys->csa_lock );
-            csa_Encrypt( p_sys->csa, p_ts->p_buffer, p_sys->i_csa_pkt_size );
+            csa_EncryptBatch( p_sys->csa, pp_scrambled, i_scrambled,
+                              p_sys->i_csa_pkt_size );
             vlc_mutex_unlock( &p_sys->csa_lock );
         }
-
-        /* latency */
-        p_ts->i_dts += p_sys->i_shaping_delay * 3 / 2;
-
-        sout_AccessOutWrite( p_mux->p_access, p_ts );
     }
+
+    /* send the whole slice at once, so that the access can write in bulk */
+    block_t *p_chain = p_chain_ts->p_first;
+    BufferChainInit( p_chain_ts );
+    if( p_chain != NULL )
+        sout_AccessOutWrite( p_mux->p_access, p_chain );
 }
 
 static block_t *TSNew( sout_mux_t *p_mux, sout_input_sys_t *p_stream,
@@ -1924,20 +2124,90 @@ static void TSSetPCR( block_t *p_ts, mtime_t i_dts )
     p_ts->p_buffer[11] = 0; /* we don't set PCR extension */
 }
 
+/*****************************************************************************
+ * PSI: the tables only change with the programs (AddStream/DelStream), so
+ * their packets are kept, and only their continuity counters are updated
+ * each time they are sent.
+ *****************************************************************************/
+static void PSIInvalidate( sout_mux_sys_t *p_sys )
+{
+    if( p_sys->p_psi_pat )
+        block_ChainRelease( p_sys->p_psi_pat );
+    if( p_sys->p_psi_pmt )
+        block_ChainRelease( p_sys->p_psi_pmt );
+    p_sys->p_psi_pat = NULL;
+    p_sys->p_psi_pmt = NULL;
+}
+
+static ts_stream_t *PSIStream( sout_mux_sys_t *p_sys, int i_pid )
+{
+    if( i_pid == p_sys->pat.i_pid )
+        return &p_sys->pat;
+    if( i_pid == p_sys->sdt.ts.i_pid )
+        return &p_sys->sdt.ts;
+    for( unsigned i = 0; i < p_sys->i_num_pmt; i++ )
+        if( i_pid == p_sys->pmt[i].i_pid )
+            return &p_sys->pmt[i];
+    return NULL;
+}
+
+static void PSISend( sout_mux_sys_t *p_sys, sout_buffer_chain_t *c,
+                     block_t *p_psi )
+{
+    for( ; p_psi != NULL; p_psi = p_psi->p_next )
+    {
+        ts_stream_t *p_ts_stream = PSIStream( p_sys,
+                        ( ( p_psi->p_buffer[1] & 0x1f ) << 8 ) | p_psi->p_buffer[2] );
+        block_t *p_ts = block_Alloc( 188 );
+        if( unlikely(p_ts == NULL || p_ts_stream == NULL) )
+        {
+            if( p_ts )
+                block_Release( p_ts );
+            continue;
+        }
+
+        memcpy( p_ts->p_buffer, p_psi->p_buffer, 188 );
+        p_ts->p_buffer[3] = ( p_ts->p_buffer[3] & 0xf0 ) |
+                            p_ts_stream->i_continuity_counter;
+        p_ts_stream->i_continuity_counter =
+            ( p_ts_stream->i_continuity_counter + 1 ) % 16;
+
+        BufferChainAppend( c, p_ts );
+    }
+}
+
 void GetPAT( sout_mux_t *p_mux, sout_buffer_chain_t *c )
 {
     sout_mux_sys_t       *p_sys = p_mux->p_sys;
 
-    BuildPAT( p_sys->p_dvbpsi,
-              c, (PEStoTSCallback)BufferChainAppend,
-              p_sys->i_tsid, p_sys->i_pat_version_number,
-              &p_sys->pat,
-              p_sys->i_num_pmt, p_sys->pmt, p_sys->i_pmt_program_number );
+    if( p_sys->p_psi_pat == NULL )
+    {
+        sout_buffer_chain_t psi;
+        int i_cc = p_sys->pat.i_continuity_counter;
+
+        BufferChainInit( &psi );
+        BuildPAT( p_sys->p_dvbpsi,
+                  &psi, (PEStoTSCallback)BufferChainAppend,
+                  p_sys->i_tsid, p_sys->i_pat_version_number,
+                  &p_sys->pat,
+                  p_sys->i_num_pmt, p_sys->pmt, p_sys->i_pmt_program_number );
+        p_sys->pat.i_continuity_counter = i_cc;
+        p_sys->p_psi_pat = psi.p_first;
+    }
+
+    PSISend( p_sys, c, p_sys->p_psi_pat );
 }
 
 static void GetPMT( sout_mux_t *p_mux, sout_buffer_chain_t *c )
 {
     sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    if( p_sys->p_psi_pmt != NULL )
+    {
+        PSISend( p_sys, c, p_sys->p_psi_pmt );
+        return;
+    }
+
     pes_mapped_stream_t mappeds[p_mux->i_nb_inputs];
 
     for (int i_stream = 0; i_stream < p_mux->i_nb_inputs; i_stream++ )
@@ -1956,11 +2226,26 @@ static void GetPMT( sout_mux_t *p_mux, sout_buffer_chain_t *c )
         mappeds[i_stream].ts = &p_stream->ts;
     }
 
+    sout_buffer_chain_t psi;
+    int pi_cc[MAX_PMT];
+    int i_sdt_cc = p_sys->sdt.ts.i_continuity_counter;
+
+    for( unsigned i = 0; i < p_sys->i_num_pmt; i++ )
+        pi_cc[i] = p_sys->pmt[i].i_continuity_counter;
+
+    BufferChainInit( &psi );
     BuildPMT( p_sys->p_dvbpsi, VLC_OBJECT(p_mux),
-              c, (PEStoTSCallback)BufferChainAppend,
+              &psi, (PEStoTSCallback)BufferChainAppend,
               p_sys->i_tsid, p_sys->i_pmt_version_number,
               p_sys->i_pcr_pid,
               &p_sys->sdt,
               p_sys->i_num_pmt, p_sys->pmt, p_sys->i_pmt_program_number,
               p_mux->i_nb_inputs, mappeds );
+
+    for( unsigned i = 0; i < p_sys->i_num_pmt; i++ )
+        p_sys->pmt[i].i_continuity_counter = pi_cc[i];
+    p_sys->sdt.ts.i_continuity_counter = i_sdt_cc;
+    p_sys->p_psi_pmt = psi.p_first;
+
+    PSISend( p_sys, c, p_sys->p_psi_pmt );
 }
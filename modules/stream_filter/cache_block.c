@@ -416,6 +416,25 @@ static ssize_t AStreamReadBlock(stream_t *s, void *buf, size_t len)
     return i_copy;
 }
 
+static ssize_t AStreamPeekBlock(stream_t *s, const uint8_t **restrict bufp,
+                                size_t len)
+{
+    stream_sys_t *sys = s->p_sys;
+    block_t *b = sys->p_current;
+
+    /* It means EOF */
+    if (b == NULL)
+        return 0;
+
+    /* Lend the data from the current block, the caller copies if it needs
+     * more than what is left in it. */
+    assert(sys->i_offset <= b->i_buffer);
+    size_t i_current = b->i_buffer - sys->i_offset;
+
+    *bufp = &b->p_buffer[sys->i_offset];
+    return (i_current < len) ? i_current : len;
+}
+
 /****************************************************************************
  * AStreamControl:
  ****************************************************************************/
@@ -497,6 +516,7 @@ static int Open(vlc_object_t *obj)
     }
 
     s->pf_read = AStreamReadBlock;
+    s->pf_peek = AStreamPeekBlock;
     s->pf_seek = AStreamSeekBlock;
     s->pf_control = AStreamControl;
     return VLC_SUCCESS;
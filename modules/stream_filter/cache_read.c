@@ -462,6 +462,25 @@ static ssize_t AStreamReadStream(stream_t *s, void *p_read, size_t i_read)
     return AStreamReadNoSeekStream(s, p_read, i_read);
 }
 
+static ssize_t AStreamPeekStream(stream_t *s, const uint8_t **restrict bufp,
+                                 size_t len)
+{
+    stream_sys_t *sys = s->p_sys;
+    stream_track_t *tk = &sys->tk[sys->i_tk];
+
+    if (tk->i_start >= tk->i_end)
+        return 0; /* EOF */
+
+    /* Lend the contiguous part of the ring, the caller copies if it needs
+     * more than that. */
+    unsigned i_off = (tk->i_start + sys->i_offset) % STREAM_CACHE_TRACK_SIZE;
+    size_t i_current = __MIN(tk->i_end - tk->i_start - sys->i_offset,
+                             STREAM_CACHE_TRACK_SIZE - i_off);
+
+    *bufp = &tk->p_buffer[i_off];
+    return __MIN(i_current, len);
+}
+
 /****************************************************************************
  * AStreamControl:
  ****************************************************************************/
@@ -561,6 +580,7 @@ static int Open(vlc_object_t *obj)
     }
 
     s->pf_read = AStreamReadStream;
+    s->pf_peek = AStreamPeekStream;
     s->pf_seek = AStreamSeekStream;
     s->pf_control = AStreamControl;
     return VLC_SUCCESS;
@@ -348,6 +348,50 @@ static ssize_t Read(stream_t *stream, void *buf, size_t buflen)
     return copy;
 }
 
+static ssize_t Peek(stream_t *stream, const uint8_t **restrict bufp,
+                    size_t buflen)
+{
+    stream_sys_t *sys = stream->p_sys;
+    size_t avail;
+    bool eof;
+
+    vlc_mutex_lock(&sys->lock);
+    if (sys->paused)
+    {
+        msg_Err(stream, "peeking while paused (buggy demux?)");
+        sys->paused = false;
+        vlc_cond_signal(&sys->wait_space);
+    }
+
+    /* Wait for the whole range if the buffer can ever hold it. Otherwise,
+     * the caller falls back to copying. */
+    while ((avail = BufferLevel(stream, &eof)) < buflen && !eof)
+    {
+        void *data[2];
+
+        if (sys->error)
+        {
+            vlc_mutex_unlock(&sys->lock);
+            return -1;
+        }
+        if (sys->eof || buflen > sys->buffer_size)
+        {
+            if (avail > 0)
+                break;
+        }
+
+        vlc_interrupt_forward_start(sys->interrupt, data);
+        vlc_cond_wait(&sys->wait_data, &sys->lock);
+        vlc_interrupt_forward_stop(data);
+    }
+
+    /* The buffer is mapped twice back-to-back, so buffered data is always
+     * contiguous. The thread only overwrites data once it has been read. */
+    *bufp = (uint8_t *)sys->buffer + (sys->stream_offset % sys->buffer_size);
+    vlc_mutex_unlock(&sys->lock);
+    return (avail < buflen) ? avail : buflen;
+}
+
 static int ReadDir(stream_t *stream, input_item_node_t *node)
 {
     (void) stream; (void) node;
@@ -443,6 +487,7 @@ static int Open(vlc_object_t *obj)
         return VLC_ENOMEM;
 
     stream->pf_read = Read;
+    stream->pf_peek = Peek;
     stream->pf_seek = Seek;
     stream->pf_control = Control;
 
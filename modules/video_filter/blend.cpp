@@ -31,18 +31,37 @@
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
 #include "filter_picture.h"
 
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (VLC_GCC_VERSION(4, 9) || defined(__clang__))
+# define HAVE_BLEND_SIMD
+# include <immintrin.h>
+#endif
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
 static int  Open (vlc_object_t *);
 static void Close(vlc_object_t *);
+#ifdef HAVE_BLEND_SIMD
+static int  OpenSimd(vlc_object_t *);
+#endif
 
 vlc_module_begin()
     set_description(N_("Video pictures blending"))
     set_capability("video blending", 100)
+    add_shortcut("blend_c")
     set_callbacks(Open, Close)
+#ifdef HAVE_BLEND_SIMD
+    /* The most common cases only, the generic module handles the others */
+    add_submodule()
+        set_description(N_("SIMD video pictures blending"))
+        set_capability("video blending", 110)
+        add_shortcut("blend_simd")
+        set_callbacks(OpenSimd, Close)
+#endif
 vlc_module_end()
 
 static inline unsigned div255(unsigned v)
@@ -78,6 +97,18 @@ public:
     {
         return fmt;
     }
+    const picture_t *getPicture() const
+    {
+        return picture;
+    }
+    unsigned getX() const
+    {
+        return x;
+    }
+    unsigned getY() const
+    {
+        return y;
+    }
     bool isFull(unsigned) const
     {
         return true;
@@ -550,7 +581,206 @@ void Blend(const CPicture &dst_data, const CPicture &src_data,
 typedef void (*blend_function_t)(const CPicture &dst_data, const CPicture &src_data,
                                  unsigned width, unsigned height, int alpha);
 
-static const struct {
+#ifdef HAVE_BLEND_SIMD
+/* One line of a YUVA or RGBA picture blended onto a 4:2:0 one */
+struct CBlendLine {
+    uint8_t       *dst[3]; /* Y, then U and V or UV, from an even pixel */
+    const uint8_t *src[4]; /* Y, U, V and A, or RGBA */
+    unsigned      alpha;
+    bool          chroma;  /* the line has chroma */
+    bool          swap_uv; /* YV12 or NV21 */
+};
+
+/* Same as the generic Blend<> for one pixel */
+template <bool rgba, bool nv12>
+static void BlendPixel(const CBlendLine &line, unsigned dx, bool full)
+{
+    CPixel spx;
+
+    if (rgba) {
+        const uint8_t *src = &line.src[0][4 * dx];
+        uint8_t y, u, v;
+        rgb_to_yuv(&y, &u, &v, src[0], src[1], src[2]);
+        spx.i = y;
+        spx.j = u;
+        spx.k = v;
+        spx.a = src[3];
+    } else {
+        spx.i = line.src[0][dx];
+        spx.j = line.src[1][dx];
+        spx.k = line.src[2][dx];
+        spx.a = line.src[3][dx];
+    }
+
+    unsigned a = div255(line.alpha * spx.a);
+    if (a <= 0)
+        return;
+
+    ::merge(&line.dst[0][dx], spx.i, a);
+    if (!full)
+        return;
+
+    const unsigned c0 = line.swap_uv ? spx.k : spx.j;
+    const unsigned c1 = line.swap_uv ? spx.j : spx.k;
+    if (nv12) {
+        ::merge(&line.dst[1][dx    ], c0, a);
+        ::merge(&line.dst[1][dx + 1], c1, a);
+    } else {
+        ::merge(&line.dst[1][dx / 2], c0, a);
+        ::merge(&line.dst[2][dx / 2], c1, a);
+    }
+}
+
+// ================ SSE4.1 =================
+#define VLC_TARGET __attribute__ ((__target__ ("sse4.1")))
+#define RENAME(a) a ## _sse41
+#define VEC __m128i
+#define W 8
+#define V_SET1(x) _mm_set1_epi16(x)
+#define V_SET1_32(x) _mm_set1_epi32((int)(x))
+#define V_ADD _mm_add_epi16
+#define V_SUB _mm_sub_epi16
+#define V_MUL _mm_mullo_epi16
+#define V_SRLI _mm_srli_epi16
+#define V_SRAI _mm_srai_epi16
+#define V_SLLI _mm_slli_epi16
+#define V_SRLI32 _mm_srli_epi32
+#define V_AND _mm_and_si128
+#define V_OR _mm_or_si128
+#define V_PACK32 _mm_packus_epi32
+#define V_ISZERO(v) _mm_testz_si128(v, v)
+#define V_LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define V_STORE(p, v) _mm_storeu_si128((__m128i *)(p), v)
+#define V_LOAD_U8(p) _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)(p)))
+#define V_STORE_U8(p, v) _mm_storel_epi64((__m128i *)(p), _mm_packus_epi16(v, v))
+#include "blend_simd.h"
+#undef VLC_TARGET
+#undef RENAME
+#undef VEC
+#undef W
+#undef V_SET1
+#undef V_SET1_32
+#undef V_ADD
+#undef V_SUB
+#undef V_MUL
+#undef V_SRLI
+#undef V_SRAI
+#undef V_SLLI
+#undef V_SRLI32
+#undef V_AND
+#undef V_OR
+#undef V_PACK32
+#undef V_ISZERO
+#undef V_LOAD
+#undef V_STORE
+#undef V_LOAD_U8
+#undef V_STORE_U8
+
+// ================= AVX2 ==================
+/* The 256 bits packing works within each 128 bits lane */
+#define VLC_TARGET __attribute__ ((__target__ ("avx2")))
+#define RENAME(a) a ## _avx2
+#define VEC __m256i
+#define W 16
+#define V_SET1(x) _mm256_set1_epi16(x)
+#define V_SET1_32(x) _mm256_set1_epi32((int)(x))
+#define V_ADD _mm256_add_epi16
+#define V_SUB _mm256_sub_epi16
+#define V_MUL _mm256_mullo_epi16
+#define V_SRLI _mm256_srli_epi16
+#define V_SRAI _mm256_srai_epi16
+#define V_SLLI _mm256_slli_epi16
+#define V_SRLI32 _mm256_srli_epi32
+#define V_AND _mm256_and_si256
+#define V_OR _mm256_or_si256
+#define V_PACK32(a, b) _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xd8)
+#define V_ISZERO(v) _mm256_testz_si256(v, v)
+#define V_LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define V_STORE(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+#define V_LOAD_U8(p) _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(p)))
+#define V_STORE_U8(p, v) _mm_storeu_si128((__m128i *)(p), \
+        _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)))
+#include "blend_simd.h"
+#undef VLC_TARGET
+#undef RENAME
+#undef VEC
+#undef W
+#undef V_SET1
+#undef V_SET1_32
+#undef V_ADD
+#undef V_SUB
+#undef V_MUL
+#undef V_SRLI
+#undef V_SRAI
+#undef V_SLLI
+#undef V_SRLI32
+#undef V_AND
+#undef V_OR
+#undef V_PACK32
+#undef V_ISZERO
+#undef V_LOAD
+#undef V_STORE
+#undef V_LOAD_U8
+#undef V_STORE_U8
+
+template <bool rgba, bool nv12>
+void BlendSimd(const CPicture &dst_data, const CPicture &src_data,
+               unsigned width, unsigned height, int alpha)
+{
+    const picture_t *dst = dst_data.getPicture();
+    const picture_t *src = src_data.getPicture();
+    const vlc_fourcc_t chroma = dst_data.getFormat()->i_chroma;
+    const unsigned dst_x = dst_data.getX(), dst_y = dst_data.getY();
+    const unsigned src_x = src_data.getX(), src_y = src_data.getY();
+    unsigned (*blend_line)(const CBlendLine &, unsigned);
+
+    if (vlc_CPU_AVX2())
+        blend_line = BlendLine_avx2<rgba, nv12>;
+    else
+        blend_line = BlendLine_sse41<rgba, nv12>;
+
+    for (unsigned y = 0; y < height; y++) {
+        const unsigned dy = dst_y + y;
+        const unsigned sy = src_y + y;
+        CBlendLine line;
+
+        /* The chroma of the first even pixel, at or after the first one */
+        const unsigned cx = (dst_x + 1) / 2;
+        line.dst[0] = &dst->p[0].p_pixels[dy * dst->p[0].i_pitch + dst_x];
+        if (nv12) {
+            line.dst[1] = &dst->p[1].p_pixels[dy / 2 * dst->p[1].i_pitch + 2 * cx];
+        } else {
+            line.dst[1] = &dst->p[1].p_pixels[dy / 2 * dst->p[1].i_pitch + cx];
+            line.dst[2] = &dst->p[2].p_pixels[dy / 2 * dst->p[2].i_pitch + cx];
+        }
+        if (rgba) {
+            line.src[0] = &src->p[0].p_pixels[sy * src->p[0].i_pitch + 4 * src_x];
+        } else {
+            for (unsigned i = 0; i < 4; i++)
+                line.src[i] = &src->p[i].p_pixels[sy * src->p[i].i_pitch + src_x];
+        }
+        line.alpha   = alpha;
+        line.chroma  = (dy % 2) == 0;
+        line.swap_uv = chroma == VLC_CODEC_YV12 || chroma == VLC_CODEC_NV21;
+
+        /* An odd first pixel has no chroma, the others start from an even
+         * one as expected by the SIMD code */
+        unsigned count = width;
+        if (dst_x % 2) {
+            BlendPixel<rgba, nv12>(line, 0, false);
+            line.dst[0]++;
+            for (unsigned i = 0; i < (rgba ? 1 : 4); i++)
+                line.src[i] += rgba ? 4 : 1;
+            count--;
+        }
+
+        for (unsigned dx = blend_line(line, count); dx < count; dx++)
+            BlendPixel<rgba, nv12>(line, dx, line.chroma && (dx % 2) == 0);
+    }
+}
+#endif
+
+static const struct blend_entry {
     vlc_fourcc_t     dst;
     vlc_fourcc_t     src;
     blend_function_t blend;
@@ -622,6 +852,32 @@ static const struct {
 #undef YUV
 };
 
+#ifdef HAVE_BLEND_SIMD
+static const blend_entry simd_blends[] = {
+#define YUV(csp, nv12) \
+    { csp, VLC_CODEC_YUVA, BlendSimd<false, nv12> }, \
+    { csp, VLC_CODEC_RGBA, BlendSimd<true,  nv12> }
+
+    YUV(VLC_CODEC_YV12, false),
+    YUV(VLC_CODEC_NV12, true),
+    YUV(VLC_CODEC_NV21, true),
+    YUV(VLC_CODEC_J420, false),
+    YUV(VLC_CODEC_I420, false),
+
+#undef YUV
+};
+#endif
+
+static blend_function_t FindBlend(const blend_entry *table, size_t count,
+                                  vlc_fourcc_t dst, vlc_fourcc_t src)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (table[i].src == src && table[i].dst == dst)
+            return table[i].blend;
+    }
+    return NULL;
+}
+
 struct filter_sys_t {
     filter_sys_t() : blend(NULL)
     {
@@ -670,10 +926,7 @@ static int Open(vlc_object_t *object)
     const vlc_fourcc_t dst = filter->fmt_out.video.i_chroma;
 
     filter_sys_t *sys = new filter_sys_t();
-    for (size_t i = 0; i < sizeof(blends) / sizeof(*blends); i++) {
-        if (blends[i].src == src && blends[i].dst == dst)
-            sys->blend = blends[i].blend;
-    }
+    sys->blend = FindBlend(blends, ARRAY_SIZE(blends), dst, src);
 
     if (!sys->blend) {
        msg_Err(filter, "no matching alpha blending routine (chroma: %4.4s -> %4.4s)",
@@ -687,6 +940,30 @@ static int Open(vlc_object_t *object)
     return VLC_SUCCESS;
 }
 
+#ifdef HAVE_BLEND_SIMD
+static int OpenSimd(vlc_object_t *object)
+{
+    filter_t *filter = (filter_t *)object;
+    const vlc_fourcc_t src = filter->fmt_in.video.i_chroma;
+    const vlc_fourcc_t dst = filter->fmt_out.video.i_chroma;
+
+    if (!vlc_CPU_SSE4_1())
+        return VLC_EGENERIC;
+
+    blend_function_t blend = FindBlend(simd_blends, ARRAY_SIZE(simd_blends),
+                                       dst, src);
+    if (!blend)
+        return VLC_EGENERIC;
+
+    filter_sys_t *sys = new filter_sys_t();
+    sys->blend = blend;
+
+    filter->pf_video_blend = Blend;
+    filter->p_sys          = sys;
+    return VLC_SUCCESS;
+}
+#endif
+
 static void Close(vlc_object_t *object)
 {
     filter_t *filter = (filter_t *)object;
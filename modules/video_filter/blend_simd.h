@@ -0,0 +1,163 @@
+/*****************************************************************************
+ * blend_simd.h: SIMD blending of YUVA/RGBA onto 4:2:0 pictures
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* This file is included by blend.cpp once per instruction set, with:
+ *  - VLC_TARGET the function attribute enabling the instruction set,
+ *  - RENAME(a) the suffixing of the function names,
+ *  - VEC the vector type and W its number of 16 bits words,
+ *  - the V_* operations on vectors of 16 bits (or 32 bits for the *32 ones)
+ *    words.
+ *
+ * The computations are done on 16 bits words and are exactly the ones of the
+ * generic Blend<> (div255(), merge() and rgb_to_yuv() all fit in 16 bits),
+ * so both produce the same pictures. */
+
+VLC_TARGET
+static inline VEC RENAME(Div255)(VEC v)
+{
+    return V_SRLI(V_ADD(V_ADD(v, V_SRLI(v, 8)), V_SET1(1)), 8);
+}
+
+VLC_TARGET
+static inline VEC RENAME(Merge)(VEC dst, VEC src, VEC f)
+{
+    return RENAME(Div255)(V_ADD(V_MUL(V_SUB(V_SET1(255), f), dst),
+                                V_MUL(src, f)));
+}
+
+/* Keeps the even words of lo then hi */
+VLC_TARGET
+static inline VEC RENAME(Even)(VEC lo, VEC hi)
+{
+    const VEC mask = V_SET1_32(0xffff);
+    return V_PACK32(V_AND(lo, mask), V_AND(hi, mask));
+}
+
+/* Loads W RGBA pixels */
+VLC_TARGET
+static inline void RENAME(LoadRGBA)(const uint8_t *src,
+                                    VEC *r, VEC *g, VEC *b, VEC *a)
+{
+    const VEC mask = V_SET1_32(0xff);
+    const VEC p0 = V_LOAD(&src[0]);
+    const VEC p1 = V_LOAD(&src[2 * W]);
+
+    *r = V_PACK32(V_AND(p0, mask), V_AND(p1, mask));
+    *g = V_PACK32(V_AND(V_SRLI32(p0, 8), mask), V_AND(V_SRLI32(p1, 8), mask));
+    *b = V_PACK32(V_AND(V_SRLI32(p0, 16), mask), V_AND(V_SRLI32(p1, 16), mask));
+    *a = V_PACK32(V_SRLI32(p0, 24), V_SRLI32(p1, 24));
+}
+
+/* See rgb_to_yuv() */
+VLC_TARGET
+static inline void RENAME(RgbToYuv)(VEC r, VEC g, VEC b,
+                                    VEC *y, VEC *u, VEC *v)
+{
+    *y = V_ADD(V_SRLI(V_ADD(V_ADD(V_ADD(V_MUL(r, V_SET1(66)),
+                                        V_MUL(g, V_SET1(129))),
+                                  V_MUL(b, V_SET1(25))),
+                            V_SET1(128)), 8), V_SET1(16));
+    *u = V_ADD(V_SRAI(V_ADD(V_SUB(V_SUB(V_MUL(b, V_SET1(112)),
+                                        V_MUL(r, V_SET1(38))),
+                                  V_MUL(g, V_SET1(74))),
+                            V_SET1(128)), 8), V_SET1(128));
+    *v = V_ADD(V_SRAI(V_ADD(V_SUB(V_SUB(V_MUL(r, V_SET1(112)),
+                                        V_MUL(g, V_SET1(94))),
+                                  V_MUL(b, V_SET1(18))),
+                            V_SET1(128)), 8), V_SET1(128));
+}
+
+/* Blends a line of 2*W pixels steps, and lets the caller blend the
+ * remaining pixels. It returns the number of pixels blended. */
+template <bool rgba, bool nv12>
+VLC_TARGET
+static unsigned RENAME(BlendLine)(const CBlendLine &line, unsigned width)
+{
+    const VEC alpha = V_SET1(line.alpha);
+    const VEC low = V_SET1(0xff);
+    unsigned dx;
+
+    for (dx = 0; dx + 2 * W <= width; dx += 2 * W) {
+        /* Skip the fully transparent spans, as most of the subtitles */
+        if (rgba) {
+            const VEC mask = V_SET1_32(0xff000000);
+            const uint8_t *src = &line.src[0][4 * dx];
+            VEC any = V_OR(V_OR(V_AND(V_LOAD(&src[0 * W]), mask),
+                                V_AND(V_LOAD(&src[2 * W]), mask)),
+                           V_OR(V_AND(V_LOAD(&src[4 * W]), mask),
+                                V_AND(V_LOAD(&src[6 * W]), mask)));
+            if (V_ISZERO(any))
+                continue;
+        } else {
+            if (V_ISZERO(V_LOAD(&line.src[3][dx])))
+                continue;
+        }
+
+        VEC y[2], u[2], v[2], a[2];
+        for (unsigned h = 0; h < 2; h++) {
+            const unsigned x = dx + h * W;
+
+            if (rgba) {
+                VEC r, g, b;
+                RENAME(LoadRGBA)(&line.src[0][4 * x], &r, &g, &b, &a[h]);
+                RENAME(RgbToYuv)(r, g, b, &y[h], &u[h], &v[h]);
+            } else {
+                y[h] = V_LOAD_U8(&line.src[0][x]);
+                a[h] = V_LOAD_U8(&line.src[3][x]);
+            }
+            a[h] = RENAME(Div255)(V_MUL(a[h], alpha));
+
+            V_STORE_U8(&line.dst[0][x],
+                       RENAME(Merge)(V_LOAD_U8(&line.dst[0][x]), y[h], a[h]));
+        }
+        if (!line.chroma)
+            continue;
+
+        /* The chroma of the even pixels (line.dst starts on one) */
+        VEC ce[2];
+        const VEC ae = RENAME(Even)(a[0], a[1]);
+        if (rgba) {
+            ce[0] = RENAME(Even)(u[0], u[1]);
+            ce[1] = RENAME(Even)(v[0], v[1]);
+        } else {
+            ce[0] = V_AND(V_LOAD(&line.src[1][dx]), low);
+            ce[1] = V_AND(V_LOAD(&line.src[2][dx]), low);
+        }
+        if (line.swap_uv) {
+            VEC tmp = ce[0];
+            ce[0] = ce[1];
+            ce[1] = tmp;
+        }
+
+        if (nv12) {
+            uint8_t *dst = &line.dst[1][dx];
+            const VEC uv = V_LOAD(dst);
+
+            V_STORE(dst, V_OR(RENAME(Merge)(V_AND(uv, low), ce[0], ae),
+                              V_SLLI(RENAME(Merge)(V_SRLI(uv, 8), ce[1], ae), 8)));
+        } else {
+            for (unsigned i = 0; i < 2; i++) {
+                uint8_t *dst = &line.dst[1 + i][dx / 2];
+                V_STORE_U8(dst, RENAME(Merge)(V_LOAD_U8(dst), ce[i], ae));
+            }
+        }
+    }
+    return dx;
+}
@@ -56,13 +56,15 @@ static picture_t *Filter( filter_t *, picture_t * );
 #define ALPHA_LONGTEXT N_("Alpha with which the blend image is blended")
 
 #define BASE_IMAGE_TEXT N_("Image to be blended onto")
-#define BASE_IMAGE_LONGTEXT N_("The image which will be used to blend onto")
+#define BASE_IMAGE_LONGTEXT N_("The image which will be used to blend onto, " \
+                              "a 1920x1080 generated picture by default")
 
 #define BASE_CHROMA_TEXT N_("Chroma for the base image")
 #define BASE_CHROMA_LONGTEXT N_("Chroma which the base image will be loaded in")
 
 #define BLEND_IMAGE_TEXT N_("Image which will be blended")
-#define BLEND_IMAGE_LONGTEXT N_("The image blended onto the base image")
+#define BLEND_IMAGE_LONGTEXT N_("The image blended onto the base image, " \
+                               "generated subtitles by default")
 
 #define BLEND_CHROMA_TEXT N_("Chroma for the blend image")
 #define BLEND_CHROMA_LONGTEXT N_("Chroma which the blend image will be loaded" \
@@ -118,6 +120,60 @@ struct filter_sys_t
     vlc_fourcc_t i_blend_chroma;
 };
 
+/* The blending modules compared, the first one is the reference */
+static const char *const ppsz_blend_modules[] = {
+    "blend_c", "blend_simd",
+};
+
+#define GENERATED_WIDTH  1920
+#define GENERATED_HEIGHT 1080
+
+/* Generates a picture, like subtitles lines (mostly transparent) if
+ * b_overlay is true */
+static picture_t *blendbench_NewPicture( vlc_fourcc_t i_chroma,
+                                         unsigned i_width, unsigned i_height,
+                                         bool b_overlay )
+{
+    video_format_t fmt;
+
+    video_format_Init( &fmt, i_chroma );
+    video_format_Setup( &fmt, i_chroma, i_width, i_height,
+                        i_width, i_height, 1, 1 );
+    picture_t *p_pic = picture_NewFromFormat( &fmt );
+    video_format_Clean( &fmt );
+    if( p_pic == NULL )
+        return NULL;
+
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        plane_t *p = &p_pic->p[i];
+
+        for( int y = 0; y < p->i_visible_lines; y++ )
+            for( int x = 0; x < p->i_visible_pitch; x++ )
+                p->p_pixels[y * p->i_pitch + x] = x + 2 * y + 64 * i;
+    }
+
+    if( b_overlay )
+    {
+        const bool b_rgba = i_chroma == VLC_CODEC_RGBA;
+        plane_t *p = &p_pic->p[b_rgba ? 0 : A_PLANE];
+        const int i_pixel = b_rgba ? 4 : 1;
+
+        for( int y = 0; y < p->i_visible_lines; y++ )
+            for( int x = 0; x < p->i_visible_pitch / i_pixel; x++ )
+            {
+                /* Lines of "glyphs" in the middle of the picture */
+                const bool b_text = y % 60 >= 10 && y % 60 < 50 &&
+                    x >= (int)i_width / 5 && x < (int)i_width * 4 / 5 &&
+                    (x / 4 + y / 8) % 5 < 2;
+
+                p->p_pixels[y * p->i_pitch + x * i_pixel + (b_rgba ? 3 : 0)] =
+                    b_text ? 255 : 0;
+            }
+    }
+    return p_pic;
+}
+
 static int blendbench_LoadImage( vlc_object_t *p_this, picture_t **pp_pic,
                                  vlc_fourcc_t i_chroma, char *psz_file, const char *psz_name )
 {
@@ -179,8 +235,16 @@ static int Create( vlc_object_t *p_this )
     p_sys->i_base_chroma = VLC_FOURCC( psz_temp[0], psz_temp[1],
                                        psz_temp[2], psz_temp[3] );
     psz_cmd = var_CreateGetStringCommand( p_filter, CFG_PREFIX "base-image" );
-    i_ret = blendbench_LoadImage( p_this, &p_sys->p_base_image,
-                                  p_sys->i_base_chroma, psz_cmd, "Base" );
+    if( psz_cmd != NULL && *psz_cmd )
+        i_ret = blendbench_LoadImage( p_this, &p_sys->p_base_image,
+                                      p_sys->i_base_chroma, psz_cmd, "Base" );
+    else
+    {
+        p_sys->p_base_image = blendbench_NewPicture( p_sys->i_base_chroma,
+                                                     GENERATED_WIDTH,
+                                                     GENERATED_HEIGHT, false );
+        i_ret = p_sys->p_base_image != NULL ? VLC_SUCCESS : VLC_ENOMEM;
+    }
     free( psz_temp );
     free( psz_cmd );
     if( i_ret != VLC_SUCCESS )
@@ -194,10 +258,25 @@ static int Create( vlc_object_t *p_this )
     p_sys->i_blend_chroma = VLC_FOURCC( psz_temp[0], psz_temp[1],
                                         psz_temp[2], psz_temp[3] );
     psz_cmd = var_CreateGetStringCommand( p_filter, CFG_PREFIX "blend-image" );
-    blendbench_LoadImage( p_this, &p_sys->p_blend_image, p_sys->i_blend_chroma,
-                          psz_cmd, "Blend" );
+    if( psz_cmd != NULL && *psz_cmd )
+        i_ret = blendbench_LoadImage( p_this, &p_sys->p_blend_image,
+                                      p_sys->i_blend_chroma, psz_cmd, "Blend" );
+    else
+    {
+        /* Subtitles on the lower quarter of the base image */
+        p_sys->p_blend_image = blendbench_NewPicture( p_sys->i_blend_chroma,
+                p_sys->p_base_image->format.i_visible_width,
+                p_sys->p_base_image->format.i_visible_height / 4, true );
+        i_ret = p_sys->p_blend_image != NULL ? VLC_SUCCESS : VLC_ENOMEM;
+    }
     free( psz_temp );
     free( psz_cmd );
+    if( i_ret != VLC_SUCCESS )
+    {
+        picture_Release( p_sys->p_base_image );
+        free( p_sys );
+        return i_ret;
+    }
 
     return VLC_SUCCESS;
 }
@@ -212,55 +291,121 @@ static void Destroy( vlc_object_t *p_this )
 
     picture_Release( p_sys->p_base_image );
     picture_Release( p_sys->p_blend_image );
+    free( p_sys );
 }
 
 /*****************************************************************************
  * Render: displays previously rendered output
  *****************************************************************************/
-static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+/* Blends with the given module on a copy of the base image, and returns
+ * that copy, or NULL if the module is not available */
+static picture_t *blendbench_Run( filter_t *p_filter, const char *psz_module,
+                                  mtime_t *pi_time )
 {
     filter_sys_t *p_sys = p_filter->p_sys;
-    filter_t *p_blend;
+    picture_t *p_base = p_sys->p_base_image;
+    picture_t *p_blend = p_sys->p_blend_image;
+    filter_t *p_blender;
 
-    if( p_sys->b_done )
-        return p_pic;
+    picture_t *p_dst = picture_NewFromFormat( &p_base->format );
+    if( !p_dst )
+        return NULL;
+    picture_Copy( p_dst, p_base );
 
-    p_blend = vlc_object_create( p_filter, sizeof(filter_t) );
-    if( !p_blend )
+    p_blender = vlc_object_create( p_filter, sizeof(filter_t) );
+    if( !p_blender )
     {
-        picture_Release( p_pic );
+        picture_Release( p_dst );
         return NULL;
     }
-    p_blend->fmt_out.video = p_sys->p_base_image->format;
-    p_blend->fmt_in.video = p_sys->p_blend_image->format;
-    p_blend->p_module = module_need( p_blend, "video blending", NULL, false );
-    if( !p_blend->p_module )
+    p_blender->fmt_out.video = p_base->format;
+    p_blender->fmt_in.video = p_blend->format;
+    p_blender->p_module = module_need( p_blender, "video blending",
+                                       psz_module, true );
+    if( !p_blender->p_module )
     {
-        picture_Release( p_pic );
-        vlc_object_release( p_blend );
+        msg_Warn( p_filter, "%s: not available", psz_module );
+        vlc_object_release( p_blender );
+        picture_Release( p_dst );
         return NULL;
     }
 
+    /* At the bottom, as subtitles */
+    const int i_y = __MAX( (int)p_base->format.i_visible_height -
+                           (int)p_blend->format.i_visible_height, 0 );
+
     mtime_t time = mdate();
     for( int i_iter = 0; i_iter < p_sys->i_loops; ++i_iter )
     {
-        p_blend->pf_video_blend( p_blend,
-                                 p_sys->p_base_image, p_sys->p_blend_image,
-                                 0, 0, p_sys->i_alpha );
+        p_blender->pf_video_blend( p_blender, p_dst, p_blend,
+                                   0, i_y, p_sys->i_alpha );
     }
-    time = mdate() - time;
+    *pi_time = mdate() - time;
 
-    msg_Info( p_filter, "Blended %d images in %f sec", p_sys->i_loops,
-              time / 1000000.0f );
-    msg_Info( p_filter, "Speed is: %f images/second, %f pixels/second",
-              (float) p_sys->i_loops / time * 1000000,
-              (float) p_sys->i_loops / time * 1000000 *
-                  p_sys->p_blend_image->p[Y_PLANE].i_visible_pitch *
-                  p_sys->p_blend_image->p[Y_PLANE].i_visible_lines );
+    msg_Info( p_filter, "%s: blended %d images in %f sec", psz_module,
+              p_sys->i_loops, *pi_time / 1000000.0f );
+    msg_Info( p_filter, "%s: speed is %f images/second, %f pixels/second",
+              psz_module,
+              (float) p_sys->i_loops / *pi_time * 1000000,
+              (float) p_sys->i_loops / *pi_time * 1000000 *
+                  p_blend->format.i_visible_width *
+                  p_blend->format.i_visible_height );
 
-    module_unneed( p_blend, p_blend->p_module );
+    module_unneed( p_blender, p_blender->p_module );
+    vlc_object_release( p_blender );
 
-    vlc_object_release( p_blend );
+    return p_dst;
+}
+
+static bool blendbench_Compare( const picture_t *p_a, const picture_t *p_b )
+{
+    for( int i = 0; i < p_a->i_planes; i++ )
+    {
+        const plane_t *p = &p_a->p[i], *q = &p_b->p[i];
+
+        for( int y = 0; y < p->i_visible_lines; y++ )
+            if( memcmp( &p->p_pixels[y * p->i_pitch],
+                        &q->p_pixels[y * q->i_pitch], p->i_visible_pitch ) )
+                return false;
+    }
+    return true;
+}
+
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    picture_t *p_ref = NULL;
+    mtime_t i_ref_time = 0;
+
+    if( p_sys->b_done )
+        return p_pic;
+
+    /* Run every blending module, and check they all blend the same way */
+    for( size_t i = 0; i < ARRAY_SIZE(ppsz_blend_modules); i++ )
+    {
+        mtime_t i_time;
+        picture_t *p_dst = blendbench_Run( p_filter, ppsz_blend_modules[i],
+                                           &i_time );
+        if( !p_dst )
+            continue;
+
+        if( !p_ref )
+        {
+            p_ref = p_dst;
+            i_ref_time = i_time;
+            continue;
+        }
+
+        if( !blendbench_Compare( p_ref, p_dst ) )
+            msg_Err( p_filter, "%s: the blended image differs from %s",
+                     ppsz_blend_modules[i], ppsz_blend_modules[0] );
+        msg_Info( p_filter, "%s: %.2f times as fast as %s",
+                  ppsz_blend_modules[i], (double)i_ref_time / i_time,
+                  ppsz_blend_modules[0] );
+        picture_Release( p_dst );
+    }
+    if( p_ref )
+        picture_Release( p_ref );
 
     p_sys->b_done = true;
     return p_pic;
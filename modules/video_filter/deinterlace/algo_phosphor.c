@@ -268,6 +268,90 @@ static void DarkenFieldMMX( picture_t *p_dst,
 }
 #endif
 
+/* Minimum number of lines of the slices */
+#define SLICE_MIN_LINES 16
+
+/**
+ * Internal helper function: makes p_view a view of the horizontal band
+ * i_slice out of i_slices of each plane of p_pic.
+ *
+ * Unlike filter_SlicePicture(), the bands of all the planes cover the same
+ * part of the frame and start on a top field line, even for subsampled
+ * chroma, as needed by ComposeFrame() and DarkenField().
+ */
+static void SliceFrame( picture_t *p_view, const picture_t *p_pic,
+                        unsigned i_slice, unsigned i_slices )
+{
+    const int i_lines = p_pic->p[0].i_visible_lines;
+    int i_start, i_end;
+
+    filter_SliceLines( i_lines, 8, i_slice, i_slices, &i_start, &i_end );
+
+    *p_view = *p_pic;
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        plane_t *p = &p_view->p[i];
+        const int i_plane_lines = p->i_visible_lines;
+        const int i_plane_start = (i_start * i_plane_lines / i_lines) & ~1;
+        const int i_plane_end = i_end < i_lines
+                              ? (i_end * i_plane_lines / i_lines) & ~1
+                              : i_plane_lines;
+
+        p->p_pixels += i_plane_start * p->i_pitch;
+        p->i_lines = p->i_visible_lines = i_plane_end - i_plane_start;
+    }
+}
+
+typedef struct
+{
+    picture_t *p_dst;
+    picture_t *p_in_top;
+    picture_t *p_in_bottom;
+    compose_chroma_t cc;
+    int i_field;
+} phosphor_slice_t;
+
+/* Composes and dims a band of the output frame */
+static void RenderPhosphorSlice( filter_t *p_filter, void *opaque,
+                                 unsigned i_slice, unsigned i_slices )
+{
+    const phosphor_slice_t *p_slice = opaque;
+    filter_sys_t *p_sys = p_filter->p_sys;
+    picture_t dst, in_top, in_bottom;
+
+    SliceFrame( &dst, p_slice->p_dst, i_slice, i_slices );
+    SliceFrame( &in_top, p_slice->p_in_top, i_slice, i_slices );
+    SliceFrame( &in_bottom, p_slice->p_in_bottom, i_slice, i_slices );
+
+    ComposeFrame( p_filter, &dst, &in_top, &in_bottom, p_slice->cc,
+                  p_filter->fmt_in.video.i_chroma == VLC_CODEC_YV12 );
+
+    /* Simulate phosphor light output decay for the old field.
+
+       The dimmer can also be switched off in the configuration, but that is
+       more of a technical curiosity or an educational toy for advanced users
+       than a useful deinterlacer mode (although it does make telecined
+       material look slightly better than without any filtering).
+
+       In most use cases the dimmer is used.
+    */
+    if( p_sys->phosphor.i_dimmer_strength > 0 )
+    {
+#ifdef CAN_COMPILE_MMXEXT
+        if( vlc_CPU_MMXEXT() )
+            DarkenFieldMMX( &dst, !p_slice->i_field,
+                p_sys->phosphor.i_dimmer_strength,
+                p_sys->chroma->p[1].h.num == p_sys->chroma->p[1].h.den &&
+                p_sys->chroma->p[2].h.num == p_sys->chroma->p[2].h.den );
+        else
+#endif
+            DarkenField( &dst, !p_slice->i_field,
+                p_sys->phosphor.i_dimmer_strength,
+                p_sys->chroma->p[1].h.num == p_sys->chroma->p[1].h.den &&
+                p_sys->chroma->p[2].h.num == p_sys->chroma->p[2].h.den );
+    }
+}
+
 /*****************************************************************************
  * Public functions
  *****************************************************************************/
@@ -340,29 +424,18 @@ int RenderPhosphor( filter_t *p_filter,
             break;
         }
     }
-    ComposeFrame( p_filter, p_dst, p_in_top, p_in_bottom, cc, p_filter->fmt_in.video.i_chroma == VLC_CODEC_YV12 );
-
-    /* Simulate phosphor light output decay for the old field.
 
-       The dimmer can also be switched off in the configuration, but that is
-       more of a technical curiosity or an educational toy for advanced users
-       than a useful deinterlacer mode (although it does make telecined
-       material look slightly better than without any filtering).
-
-       In most use cases the dimmer is used.
-    */
-    if( p_sys->phosphor.i_dimmer_strength > 0 )
-    {
-#ifdef CAN_COMPILE_MMXEXT
-        if( vlc_CPU_MMXEXT() )
-            DarkenFieldMMX( p_dst, !i_field, p_sys->phosphor.i_dimmer_strength,
-                p_sys->chroma->p[1].h.num == p_sys->chroma->p[1].h.den &&
-                p_sys->chroma->p[2].h.num == p_sys->chroma->p[2].h.den );
-        else
-#endif
-            DarkenField( p_dst, !i_field, p_sys->phosphor.i_dimmer_strength,
-                p_sys->chroma->p[1].h.num == p_sys->chroma->p[1].h.den &&
-                p_sys->chroma->p[2].h.num == p_sys->chroma->p[2].h.den );
-    }
+    phosphor_slice_t slice = {
+        .p_dst = p_dst,
+        .p_in_top = p_in_top,
+        .p_in_bottom = p_in_bottom,
+        .cc = cc,
+        .i_field = i_field,
+    };
+    unsigned i_slices = __MIN( filter_GetSliceCount( p_filter ),
+                               (unsigned)p_dst->p[0].i_visible_lines / SLICE_MIN_LINES );
+
+    filter_RunSlices( p_filter, RenderPhosphorSlice, &slice,
+                      __MAX( i_slices, 1 ) );
     return VLC_SUCCESS;
 }
@@ -34,11 +34,15 @@
 #include <vlc_common.h>
 #include <vlc_cpu.h>
 #include <vlc_picture.h>
+#include <vlc_filter.h>
 
 #include "deinterlace.h" /* filter_sys_t */
 
 #include "algo_x.h"
 
+/* Minimum number of lines of the slices */
+#define SLICE_MIN_LINES 16
+
 /*****************************************************************************
  * Internal functions
  *****************************************************************************/
@@ -537,8 +541,20 @@ static inline void XDeintBand8x8MMXEXT( uint8_t *dst, int i_dst,
  * Public functions
  *****************************************************************************/
 
-void RenderX( picture_t *p_outpic, picture_t *p_pic )
+typedef struct
+{
+    picture_t *p_outpic;
+    picture_t *p_pic;
+} x_slice_t;
+
+/* Renders a band of 8 lines block rows of each plane */
+static void RenderXSlice( filter_t *p_filter, void *opaque,
+                          unsigned i_slice, unsigned i_slices )
 {
+    VLC_UNUSED(p_filter);
+    const x_slice_t *p_slice = opaque;
+    picture_t *p_outpic = p_slice->p_outpic;
+    picture_t *p_pic = p_slice->p_pic;
     int i_plane;
 #if defined (CAN_COMPILE_MMXEXT)
     const bool mmxext = vlc_CPU_MMXEXT();
@@ -556,9 +572,12 @@ void RenderX( picture_t *p_outpic, picture_t *p_pic )
         const int i_dst = p_outpic->p[i_plane].i_pitch;
         const int i_src = p_pic->p[i_plane].i_pitch;
 
-        int y, x;
+        int y, x, i_start, i_end;
 
-        for( y = 0; y < i_mby; y++ )
+        /* The last (partial) block row is part of the last slice */
+        filter_SliceLines( i_mby + 1, 1, i_slice, i_slices, &i_start, &i_end );
+
+        for( y = i_start; y < __MIN( i_end, i_mby ); y++ )
         {
             uint8_t *dst = &p_outpic->p[i_plane].p_pixels[8*y*i_dst];
             uint8_t *src = &p_pic->p[i_plane].p_pixels[8*y*i_src];
@@ -572,10 +591,10 @@ void RenderX( picture_t *p_outpic, picture_t *p_pic )
         }
 
         /* Last line (C only)*/
-        if( i_mody )
+        if( i_mody && i_end > i_mby )
         {
-            uint8_t *dst = &p_outpic->p[i_plane].p_pixels[8*y*i_dst];
-            uint8_t *src = &p_pic->p[i_plane].p_pixels[8*y*i_src];
+            uint8_t *dst = &p_outpic->p[i_plane].p_pixels[8*i_mby*i_dst];
+            uint8_t *src = &p_pic->p[i_plane].p_pixels[8*i_mby*i_src];
 
             for( x = 0; x < i_mbx; x++ )
             {
@@ -595,3 +614,15 @@ void RenderX( picture_t *p_outpic, picture_t *p_pic )
         emms();
 #endif
 }
+
+void RenderX( filter_t *p_filter, picture_t *p_outpic, picture_t *p_pic )
+{
+    x_slice_t slice = {
+        .p_outpic = p_outpic,
+        .p_pic = p_pic,
+    };
+    unsigned i_slices = __MIN( filter_GetSliceCount( p_filter ),
+                               (unsigned)p_outpic->p[0].i_visible_lines / SLICE_MIN_LINES );
+
+    filter_RunSlices( p_filter, RenderXSlice, &slice, __MAX( i_slices, 1 ) );
+}
@@ -47,15 +47,102 @@
    Necessary preprocessor macros are defined in common.h. */
 #include "yadif.h"
 
-int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
-                 int i_order, int i_field )
+/* Minimum number of lines of the slices */
+#define SLICE_MIN_LINES 16
+
+/* Maximum number of fields rendered at once, see RenderYadifFields() */
+#define YADIF_MAX_FIELDS 3
+
+typedef struct
 {
-    VLC_UNUSED(p_src);
+    void (*filter)(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next,
+                   int w, int prefs, int mrefs, int parity, int mode);
+    picture_t *pp_dst[YADIF_MAX_FIELDS];
+    picture_t *p_prev;
+    picture_t *p_cur;
+    picture_t *p_next;
+    int pi_field[YADIF_MAX_FIELDS];
+    int pi_parity[YADIF_MAX_FIELDS];
+    unsigned i_bands; /* slices per field */
+} yadif_slice_t;
+
+/* Renders a band of lines of each plane of one of the fields, so that the
+ * fields of a frame are rendered in parallel too */
+static void RenderYadifSlice( filter_t *p_filter, void *opaque,
+                              unsigned i_slice, unsigned i_slices )
+{
+    VLC_UNUSED(p_filter);
+    const yadif_slice_t *p_slice = opaque;
+    const unsigned i_index = i_slice / p_slice->i_bands;
+    picture_t *p_dst  = p_slice->pp_dst[i_index];
+    picture_t *p_prev = p_slice->p_prev;
+    picture_t *p_cur  = p_slice->p_cur;
+    picture_t *p_next = p_slice->p_next;
+    const int i_field = p_slice->pi_field[i_index];
+    const int yadif_parity = p_slice->pi_parity[i_index];
 
+    i_slice %= p_slice->i_bands;
+    i_slices = p_slice->i_bands;
+
+    for( int n = 0; n < p_dst->i_planes; n++ )
+    {
+        const plane_t *prevp = &p_prev->p[n];
+        const plane_t *curp  = &p_cur->p[n];
+        const plane_t *nextp = &p_next->p[n];
+        plane_t *dstp        = &p_dst->p[n];
+        int i_start, i_end;
+
+        filter_SliceLines( dstp->i_visible_lines, 2, i_slice, i_slices,
+                           &i_start, &i_end );
+        i_start = __MAX( i_start, 1 );
+        i_end = __MIN( i_end, dstp->i_visible_lines - 1 );
+
+        for( int y = i_start; y < i_end; y++ )
+        {
+            if( (y % 2) == i_field  ||  yadif_parity == 2 )
+            {
+                memcpy( &dstp->p_pixels[y * dstp->i_pitch],
+                            &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
+            }
+            else
+            {
+                int mode;
+                /* Spatial checks only when enough data */
+                mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
+
+                assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
+                p_slice->filter( &dstp->p_pixels[y * dstp->i_pitch],
+                                 &prevp->p_pixels[y * prevp->i_pitch],
+                                 &curp->p_pixels[y * curp->i_pitch],
+                                 &nextp->p_pixels[y * nextp->i_pitch],
+                                 dstp->i_visible_pitch,
+                                 y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
+                                 y  - 1  ?  -curp->i_pitch : curp->i_pitch,
+                                 yadif_parity,
+                                 mode );
+            }
+
+            /* We duplicate the first and last lines */
+            if( y == 1 )
+                memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
+                           &dstp->p_pixels[ y    * dstp->i_pitch],
+                           dstp->i_pitch);
+            else if( y == dstp->i_visible_lines - 2 )
+                memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
+                           &dstp->p_pixels[ y    * dstp->i_pitch],
+                           dstp->i_pitch);
+        }
+    }
+}
+
+static int RenderFields( filter_t *p_filter, picture_t **pp_dst, int i_count,
+                         int i_first_order, int i_field )
+{
     filter_sys_t *p_sys = p_filter->p_sys;
 
     /* */
-    assert( i_order >= 0 && i_order <= 2 ); /* 2 = soft field repeat */
+    assert( i_count >= 1 && i_count <= YADIF_MAX_FIELDS );
+    assert( i_first_order >= 0 && i_first_order + i_count <= 3 );
     assert( i_field == 0 || i_field == 1 );
 
     /* As the pitches must match, use ONLY pictures coming from picture_New()! */
@@ -63,115 +150,95 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
     picture_t *p_cur  = p_sys->pp_history[1];
     picture_t *p_next = p_sys->pp_history[2];
 
-    /* Account for soft field repeat.
-
-       The "parity" parameter affects the algorithm like this (from yadif.h):
-       uint8_t *prev2= parity ? prev : cur ;
-       uint8_t *next2= parity ? cur  : next;
-
-       The original parity expression that was used here is:
-       (i_field ^ (i_order == i_field)) & 1
-
-       Truth table:
-       i_field = 0, i_order = 0  => 1
-       i_field = 1, i_order = 1  => 0
-       i_field = 1, i_order = 0  => 1
-       i_field = 0, i_order = 1  => 0
-
-       => equivalent with e.g.  (1 - i_order)  or  (i_order + 1) % 2
-
-       Thus, in a normal two-field frame,
-             parity 1 = first field  (i_order == 0)
-             parity 0 = second field (i_order == 1)
-
-       Now, with three fields, where the third is a copy of the first,
-             i_order = 0  =>  parity 1 (as usual)
-             i_order = 1  =>  due to the repeat, prev = cur, but also next = cur.
-                              Because in such a case there is no motion
-                              (otherwise field repeat makes no sense),
-                              we don't actually need to invoke Yadif's filter().
-                              Thus, set "parity" to 2, and use this to bypass
-                              the filter.
-             i_order = 2  =>  parity 0 (as usual)
-    */
-    int yadif_parity;
-    if( p_cur  &&  p_cur->i_nb_fields > 2 )
-        yadif_parity = (i_order + 1) % 3; /* 1, *2*, 0; where 2 is a special
-                                             value meaning "bypass filter". */
-    else
-        yadif_parity = (i_order + 1) % 2; /* 1, 0 */
-
     /* Filter if we have all the pictures we need */
     if( p_prev && p_cur && p_next )
     {
-        /* */
-        void (*filter)(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next,
-                       int w, int prefs, int mrefs, int parity, int mode);
+        yadif_slice_t slice = {
+            .p_prev = p_prev,
+            .p_cur = p_cur,
+            .p_next = p_next,
+        };
 
+#if defined(HAVE_YADIF_AVX2)
+        if( vlc_CPU_AVX2() )
+            slice.filter = yadif_filter_line_avx2;
+        else
+#endif
 #if defined(HAVE_YADIF_SSSE3)
         if( vlc_CPU_SSSE3() )
-            filter = yadif_filter_line_ssse3;
+            slice.filter = yadif_filter_line_ssse3;
         else
 #endif
 #if defined(HAVE_YADIF_SSE2)
         if( vlc_CPU_SSE2() )
-            filter = yadif_filter_line_sse2;
+            slice.filter = yadif_filter_line_sse2;
         else
 #endif
 #if defined(HAVE_YADIF_MMX)
         if( vlc_CPU_MMX() )
-            filter = yadif_filter_line_mmx;
+            slice.filter = yadif_filter_line_mmx;
         else
 #endif
-            filter = yadif_filter_line_c;
+            slice.filter = yadif_filter_line_c;
 
         if( p_sys->chroma->pixel_size == 2 )
-            filter = yadif_filter_line_c_16bit;
+            slice.filter = yadif_filter_line_c_16bit;
 
-        for( int n = 0; n < p_dst->i_planes; n++ )
+        for( int i = 0; i < i_count; i++ )
         {
-            const plane_t *prevp = &p_prev->p[n];
-            const plane_t *curp  = &p_cur->p[n];
-            const plane_t *nextp = &p_next->p[n];
-            plane_t *dstp        = &p_dst->p[n];
+            const int i_order = i_first_order + i;
 
-            for( int y = 1; y < dstp->i_visible_lines - 1; y++ )
-            {
-                if( (y % 2) == i_field  ||  yadif_parity == 2 )
-                {
-                    memcpy( &dstp->p_pixels[y * dstp->i_pitch],
-                                &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
-                }
-                else
-                {
-                    int mode;
-                    /* Spatial checks only when enough data */
-                    mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
-
-                    assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
-                    filter( &dstp->p_pixels[y * dstp->i_pitch],
-                            &prevp->p_pixels[y * prevp->i_pitch],
-                            &curp->p_pixels[y * curp->i_pitch],
-                            &nextp->p_pixels[y * nextp->i_pitch],
-                            dstp->i_visible_pitch,
-                            y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
-                            y  - 1  ?  -curp->i_pitch : curp->i_pitch,
-                            yadif_parity,
-                            mode );
-                }
-
-                /* We duplicate the first and last lines */
-                if( y == 1 )
-                    memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-                else if( y == dstp->i_visible_lines - 2 )
-                    memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-            }
+            /* Account for soft field repeat.
+
+               The "parity" parameter affects the algorithm like this (from yadif.h):
+               uint8_t *prev2= parity ? prev : cur ;
+               uint8_t *next2= parity ? cur  : next;
+
+               The original parity expression that was used here is:
+               (i_field ^ (i_order == i_field)) & 1
+
+               Truth table:
+               i_field = 0, i_order = 0  => 1
+               i_field = 1, i_order = 1  => 0
+               i_field = 1, i_order = 0  => 1
+               i_field = 0, i_order = 1  => 0
+
+               => equivalent with e.g.  (1 - i_order)  or  (i_order + 1) % 2
+
+               Thus, in a normal two-field frame,
+                     parity 1 = first field  (i_order == 0)
+                     parity 0 = second field (i_order == 1)
+
+               Now, with three fields, where the third is a copy of the first,
+                     i_order = 0  =>  parity 1 (as usual)
+                     i_order = 1  =>  due to the repeat, prev = cur, but also next = cur.
+                                      Because in such a case there is no motion
+                                      (otherwise field repeat makes no sense),
+                                      we don't actually need to invoke Yadif's filter().
+                                      Thus, set "parity" to 2, and use this to bypass
+                                      the filter.
+                     i_order = 2  =>  parity 0 (as usual)
+            */
+            if( p_cur->i_nb_fields > 2 )
+                slice.pi_parity[i] = (i_order + 1) % 3; /* 1, *2*, 0; where 2 is
+                                                           a special value meaning
+                                                           "bypass filter". */
+            else
+                slice.pi_parity[i] = (i_order + 1) % 2; /* 1, 0 */
+
+            /* The fields alternate */
+            slice.pp_dst[i] = pp_dst[i];
+            slice.pi_field[i] = i_field ^ (i & 1);
         }
 
+        unsigned i_bands = __MIN( filter_GetSliceCount( p_filter ),
+                                  (unsigned)pp_dst[0]->p[0].i_visible_lines / SLICE_MIN_LINES );
+        slice.i_bands = __MAX( i_bands, 1 );
+
+        /* All the fields are split in bands and queued at once */
+        filter_RunSlices( p_filter, RenderYadifSlice, &slice,
+                          slice.i_bands * i_count );
+
         p_sys->i_frame_offset = 1; /* p_cur will be rendered at next frame, too */
 
         return VLC_SUCCESS;
@@ -182,7 +249,8 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
                  as set by Open() or SetFilterMethod(). It is always 0. */
 
         /* FIXME not good as it does not use i_order/i_field */
-        RenderX( p_dst, p_next );
+        for( int i = 0; i < i_count; i++ )
+            RenderX( p_filter, pp_dst[i], p_next );
         return VLC_SUCCESS;
     }
     else
@@ -192,3 +260,21 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
         return VLC_EGENERIC;
     }
 }
+
+int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
+                 int i_order, int i_field )
+{
+    VLC_UNUSED(p_src);
+
+    assert( i_order >= 0 && i_order <= 2 ); /* 2 = soft field repeat */
+
+    return RenderFields( p_filter, &p_dst, 1, i_order, i_field );
+}
+
+int RenderYadifFields( filter_t *p_filter, picture_t **pp_dst, int i_count,
+                       picture_t *p_src, int i_field )
+{
+    VLC_UNUSED(p_src);
+
+    return RenderFields( p_filter, pp_dst, i_count, 0, i_field );
+}
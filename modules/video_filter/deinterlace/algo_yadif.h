@@ -86,4 +86,27 @@ struct picture_t;
 int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
                  int i_order, int i_field );
 
+/**
+ * Yadif (Yet Another DeInterlacing Filter), all the fields of a frame at once.
+ *
+ * This is the same as calling RenderYadif() for each field, with i_order
+ * going from 0 to i_count-1 and i_field alternating, but the bands of
+ * all the fields are rendered in parallel (see filter_RunSlices()), so
+ * the framerate doubler does not wait for each field in turn.
+ *
+ * @param p_filter The filter instance. Must be non-NULL.
+ * @param pp_dst Output frames, one per field. Must be allocated by caller.
+ * @param i_count Number of output frames, from 1 to 3.
+ * @param p_src Input frame. Must exist.
+ * @param i_field Keep which field in the first output frame?
+ *                0 = top field, 1 = bottom field.
+ * @return VLC error code (int).
+ * @retval VLC_SUCCESS The fields were rendered into pp_dst.
+ * @retval VLC_EGENERIC Frame dropped; only occurs at the second frame after start.
+ * @see RenderYadif()
+ * @see Deinterlace()
+ */
+int RenderYadifFields( filter_t *p_filter, picture_t **pp_dst, int i_count,
+                       picture_t *p_src, int i_field );
+
 #endif
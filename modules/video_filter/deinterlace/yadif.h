@@ -147,3 +147,112 @@ static void yadif_filter_line_c_16bit(uint16_t *dst, uint16_t *prev, uint16_t *c
     prefs /= 2;
     FILTER
 }
+
+#if defined(CAN_COMPILE_SSE2) && \
+    (defined(__AVX2__) || VLC_GCC_VERSION(4, 9) || defined(__clang__))
+// ================ AVX2 =================
+/* Unlike the other variants, this one uses intrinsics. It processes 16 pixels
+ * at once as 16 bits words, and the C version handles the width remainder,
+ * so it matches the C version exactly. */
+#include <immintrin.h>
+
+#define HAVE_YADIF_AVX2
+#ifdef __AVX2__
+# define VLC_TARGET
+#else
+# define VLC_TARGET __attribute__ ((__target__ ("avx2")))
+#endif
+
+#undef CHECK
+#define LOAD(p) _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(p)))
+#define ABSDIFF(a, b) _mm256_abs_epi16(_mm256_sub_epi16(a, b))
+#define AVG(a, b) _mm256_srli_epi16(_mm256_add_epi16(a, b), 1)
+#define SCORE(j) \
+    _mm256_add_epi16(_mm256_add_epi16( \
+        ABSDIFF(LOAD(&cur[mrefs-1+(j)]), LOAD(&cur[prefs-1-(j)])), \
+        ABSDIFF(LOAD(&cur[mrefs  +(j)]), LOAD(&cur[prefs  -(j)]))), \
+        ABSDIFF(LOAD(&cur[mrefs+1+(j)]), LOAD(&cur[prefs+1-(j)])))
+#define PRED(j) AVG(LOAD(&cur[mrefs+(j)]), LOAD(&cur[prefs-(j)]))
+/* if (score < spatial_score) for the lanes still in mask */
+#define CHECK(j) \
+        score = SCORE(j); \
+        mask = _mm256_and_si256(mask, _mm256_cmpgt_epi16(spatial_score, score)); \
+        spatial_score = _mm256_blendv_epi8(spatial_score, score, mask); \
+        spatial_pred = _mm256_blendv_epi8(spatial_pred, PRED(j), mask);
+
+VLC_TARGET
+static void yadif_filter_line_avx2(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next, int w, int prefs, int mrefs, int parity, int mode) {
+    int x;
+    uint8_t *prev2= parity ? prev : cur ;
+    uint8_t *next2= parity ? cur  : next;
+    const __m256i ones = _mm256_set1_epi16(-1);
+
+    for (x = 0; x + 16 <= w; x += 16) {
+        __m256i c = LOAD(&cur[mrefs]);
+        __m256i e = LOAD(&cur[prefs]);
+        __m256i p2 = LOAD(prev2);
+        __m256i n2 = LOAD(next2);
+        __m256i d = AVG(p2, n2);
+        __m256i temporal_diff0 = ABSDIFF(p2, n2);
+        __m256i temporal_diff1 = _mm256_srli_epi16(_mm256_add_epi16(
+            ABSDIFF(LOAD(&prev[mrefs]), c), ABSDIFF(LOAD(&prev[prefs]), e)), 1);
+        __m256i temporal_diff2 = _mm256_srli_epi16(_mm256_add_epi16(
+            ABSDIFF(LOAD(&next[mrefs]), c), ABSDIFF(LOAD(&next[prefs]), e)), 1);
+        __m256i diff = _mm256_max_epi16(_mm256_max_epi16(
+            _mm256_srli_epi16(temporal_diff0, 1), temporal_diff1), temporal_diff2);
+        __m256i spatial_pred = AVG(c, e);
+        __m256i spatial_score = _mm256_add_epi16(_mm256_add_epi16(_mm256_add_epi16(
+            ABSDIFF(LOAD(&cur[mrefs-1]), LOAD(&cur[prefs-1])), ABSDIFF(c, e)),
+            ABSDIFF(LOAD(&cur[mrefs+1]), LOAD(&cur[prefs+1]))), ones);
+        __m256i score, mask;
+
+        /* The second direction is only checked where the first one won */
+        mask = ones;
+        CHECK(-1) CHECK(-2)
+        mask = ones;
+        CHECK( 1) CHECK( 2)
+
+        if (mode < 2) {
+            __m256i b = AVG(LOAD(&prev2[2*mrefs]), LOAD(&next2[2*mrefs]));
+            __m256i f = AVG(LOAD(&prev2[2*prefs]), LOAD(&next2[2*prefs]));
+            __m256i dc = _mm256_sub_epi16(d, c);
+            __m256i de = _mm256_sub_epi16(d, e);
+            __m256i bc = _mm256_sub_epi16(b, c);
+            __m256i fe = _mm256_sub_epi16(f, e);
+            __m256i max = _mm256_max_epi16(_mm256_max_epi16(de, dc),
+                                           _mm256_min_epi16(bc, fe));
+            __m256i min = _mm256_min_epi16(_mm256_min_epi16(de, dc),
+                                           _mm256_max_epi16(bc, fe));
+
+            diff = _mm256_max_epi16(_mm256_max_epi16(diff, min),
+                                    _mm256_sub_epi16(_mm256_setzero_si256(), max));
+        }
+
+        /* diff is never negative */
+        spatial_pred = _mm256_max_epi16(spatial_pred, _mm256_sub_epi16(d, diff));
+        spatial_pred = _mm256_min_epi16(spatial_pred, _mm256_add_epi16(d, diff));
+
+        _mm_storeu_si128((__m128i *)dst,
+                         _mm_packus_epi16(_mm256_castsi256_si128(spatial_pred),
+                                          _mm256_extracti128_si256(spatial_pred, 1)));
+
+        dst += 16;
+        cur += 16;
+        prev += 16;
+        next += 16;
+        prev2 += 16;
+        next2 += 16;
+    }
+
+    if (x < w)
+        yadif_filter_line_c(dst, prev, cur, next, w - x, prefs, mrefs, parity, mode);
+}
+
+#undef CHECK
+#undef PRED
+#undef SCORE
+#undef AVG
+#undef ABSDIFF
+#undef LOAD
+#undef VLC_TARGET
+#endif
@@ -135,6 +135,8 @@ static int Open(vlc_object_t *object)
     cfg->thresh      = 0.0;
     cfg->radius      = 0;
     cfg->buf         = NULL;
+    cfg->buf_size    = 0;
+    cfg->buf_count   = 0;
 
 #if HAVE_SSE2 && HAVE_6REGS
     if (vlc_CPU_SSE2())
@@ -171,6 +173,46 @@ static void Close(vlc_object_t *object)
     free(sys);
 }
 
+typedef struct {
+    picture_t *src;
+    picture_t *dst;
+} gradfun_slice_t;
+
+static void FilterSlice(filter_t *filter, void *opaque,
+                        unsigned slice, unsigned slices)
+{
+    filter_sys_t *sys = filter->p_sys;
+    const gradfun_slice_t *ctx = opaque;
+    const video_format_t *fmt = &filter->fmt_in.video;
+    struct vf_priv_s *cfg = &sys->cfg;
+    uint16_t *buffer = cfg->buf ? cfg->buf + slice * cfg->buf_size : NULL;
+
+    for (int i = 0; i < ctx->dst->i_planes; i++) {
+        const plane_t *srcp = &ctx->src->p[i];
+        plane_t       *dstp = &ctx->dst->p[i];
+
+        const vlc_chroma_description_t *chroma = sys->chroma;
+        int w = fmt->i_width  * chroma->p[i].w.num / chroma->p[i].w.den;
+        int h = fmt->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
+        int r = (cfg->radius  * chroma->p[i].w.num / chroma->p[i].w.den +
+                 cfg->radius  * chroma->p[i].h.num / chroma->p[i].h.den) / 2;
+        r = VLC_CLIP((r + 1) & ~1, RADIUS_MIN, RADIUS_MAX);
+        if (__MIN(w, h) > 2 * r && buffer) {
+            int ystart, yend;
+            filter_SliceLines(h, 2, slice, slices, &ystart, &yend);
+            if (ystart < yend)
+                filter_plane(cfg, buffer, dstp->p_pixels, srcp->p_pixels,
+                             w, h, dstp->i_pitch, srcp->i_pitch, r,
+                             ystart, yend);
+        } else {
+            picture_t src_view, dst_view;
+            filter_SlicePicture(&src_view, ctx->src, slice, slices);
+            filter_SlicePicture(&dst_view, ctx->dst, slice, slices);
+            plane_CopyPixels(&dst_view.p[i], &src_view.p[i]);
+        }
+    }
+}
+
 static picture_t *Filter(filter_t *filter, picture_t *src)
 {
     filter_sys_t *sys = filter->p_sys;
@@ -189,30 +231,24 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
     const video_format_t *fmt = &filter->fmt_in.video;
     struct vf_priv_s *cfg = &sys->cfg;
 
+    /* Each band of lines needs its own work buffer, and starts with
+     * blurring up to radius lines above it */
+    unsigned slices = __MIN(filter_GetSliceCount(filter),
+                            fmt->i_height / (4 * radius));
+    slices = __MAX(slices, 1);
+
     cfg->thresh = (1 << 15) / strength;
-    if (cfg->radius != radius) {
-        cfg->radius = radius;
-        cfg->buf    = vlc_memalign(16,
-                                   (((fmt->i_width + 15) & ~15) * (cfg->radius + 1) / 2 + 32) * sizeof(*cfg->buf));
+    if (cfg->radius != radius || cfg->buf_count < slices) {
+        cfg->radius    = radius;
+        /* keep the buffers 16 bytes aligned */
+        cfg->buf_size  = ((((fmt->i_width + 15) & ~15) * (cfg->radius + 1) / 2 + 32) + 7) & ~7;
+        cfg->buf_count = slices;
+        vlc_free(cfg->buf);
+        cfg->buf       = vlc_memalign(16, slices * cfg->buf_size * sizeof(*cfg->buf));
     }
 
-    for (int i = 0; i < dst->i_planes; i++) {
-        const plane_t *srcp = &src->p[i];
-        plane_t       *dstp = &dst->p[i];
-
-        const vlc_chroma_description_t *chroma = sys->chroma;
-        int w = fmt->i_width  * chroma->p[i].w.num / chroma->p[i].w.den;
-        int h = fmt->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
-        int r = (cfg->radius  * chroma->p[i].w.num / chroma->p[i].w.den +
-                 cfg->radius  * chroma->p[i].h.num / chroma->p[i].h.den) / 2;
-        r = VLC_CLIP((r + 1) & ~1, RADIUS_MIN, RADIUS_MAX);
-        if (__MIN(w, h) > 2 * r && cfg->buf) {
-            filter_plane(cfg, dstp->p_pixels, srcp->p_pixels,
-                         w, h, dstp->i_pitch, srcp->i_pitch, r);
-        } else {
-            plane_CopyPixels(dstp, srcp);
-        }
-    }
+    gradfun_slice_t slice = { .src = src, .dst = dst };
+    filter_RunSlices(filter, FilterSlice, &slice, slices);
 
     picture_CopyProperties(dst, src);
     picture_Release(src);
@@ -31,7 +31,9 @@
 struct vf_priv_s {
     int thresh;
     int radius;
-    uint16_t *buf;
+    uint16_t *buf;       /* buf_count work buffers of buf_size each */
+    size_t buf_size;
+    unsigned buf_count;
     void (*filter_line)(uint8_t *dst, uint8_t *src, uint16_t *dc,
                         int width, int thresh, const uint16_t *dithers);
     void (*blur_line)(uint16_t *dc, uint16_t *buf, uint16_t *buf1,
@@ -222,20 +224,35 @@ static void blur_line_sse2(uint16_t *dc, uint16_t *buf, uint16_t *buf1,
 }
 #endif // HAVE_6REGS && HAVE_SSE2
 
-static void filter_plane(struct vf_priv_s *ctx, uint8_t *dst, uint8_t *src,
-                         int width, int height, int dstride, int sstride, int r)
+/* Filters the lines [ystart, yend[ of a plane, using the work buffer
+ * buffer. The result does not depend on the range. */
+static void filter_plane(struct vf_priv_s *ctx, uint16_t *buffer,
+                         uint8_t *dst, uint8_t *src,
+                         int width, int height, int dstride, int sstride, int r,
+                         int ystart, int yend)
 {
     int bstride = ((width+15)&~15)/2;
     int y;
     uint32_t dc_factor = (1<<21)/(r*r);
-    uint16_t *dc = ctx->buf+16;
-    uint16_t *buf = ctx->buf+bstride+32;
+    uint16_t *dc = buffer+16;
+    uint16_t *buf = buffer+bstride+32;
     int thresh = ctx->thresh;
 
+    /* The blur window moves on the even lines of [r, height-r[, covering
+     * the lines [y-r+2, y+r+1]: start from the one of ystart */
+    int ystep = __MAX(ystart, r) & ~1;
+    if (ystep >= height-r)
+        ystep = (height-r-1) & ~1;
+    int h0 = (ystep-r)/2;
+
     memset(dc, 0, (bstride+16)*sizeof(*buf));
-    for (y=0; y<r; y++)
-        ctx->blur_line(dc, buf+y*bstride, buf+(y-1)*bstride, src+2*y*sstride, sstride, width/2);
-    for (;;) {
+    for (y=h0; y<h0+r; y++) {
+        int mod = y%r;
+        uint16_t *buf1 = y > h0 ? buf+(mod?mod-1:r-1)*bstride : buf-bstride;
+        ctx->blur_line(dc, buf+mod*bstride, buf1, src+2*y*sstride, sstride, width/2);
+    }
+    y = ystep;
+    do {
         if (y < height-r) {
             int mod = ((y+r)/2)%r;
             uint16_t *buf0 = buf+mod*bstride;
@@ -254,13 +271,12 @@ static void filter_plane(struct vf_priv_s *ctx, uint8_t *dst, uint8_t *src,
                 dc[x] = dc[0];
         }
         if (y == r) {
-            for (y=0; y<r; y++)
-                ctx->filter_line(dst+y*dstride, src+y*sstride, dc-r/2, width, thresh, dither[y&7]);
+            for (int i=ystart; i<__MIN(r, yend); i++)
+                ctx->filter_line(dst+i*dstride, src+i*sstride, dc-r/2, width, thresh, dither[i&7]);
         }
-        ctx->filter_line(dst+y*dstride, src+y*sstride, dc-r/2, width, thresh, dither[y&7]);
-        if (++y >= height) break;
-        ctx->filter_line(dst+y*dstride, src+y*sstride, dc-r/2, width, thresh, dither[y&7]);
-        if (++y >= height) break;
-    }
+        for (int i=__MAX(y, ystart); i<__MIN(y+2, yend); i++)
+            ctx->filter_line(dst+i*dstride, src+i*sstride, dc-r/2, width, thresh, dither[i&7]);
+        y += 2;
+    } while (y < yend);
 }
 
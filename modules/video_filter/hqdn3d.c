@@ -109,7 +109,7 @@ static int Open(vlc_object_t *this)
     const video_format_t *fmt_out = &filter->fmt_out.video;
     const vlc_fourcc_t fourcc_in  = fmt_in->i_chroma;
     const vlc_fourcc_t fourcc_out = fmt_out->i_chroma;
-    int wmax = 0;
+    int wsum = 0;
 
     const vlc_chroma_description_t *chroma =
             vlc_fourcc_GetChromaDescription(fourcc_in);
@@ -134,10 +134,11 @@ static int Open(vlc_object_t *this)
 
     for (int i = 0; i < 3; ++i) {
         sys->w[i] = fmt_in->i_width  * chroma->p[i].w.num / chroma->p[i].w.den;
-        if (sys->w[i] > wmax) wmax = sys->w[i];
+        wsum += sys->w[i];
         sys->h[i] = fmt_out->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
     }
-    cfg->Line = malloc(wmax*sizeof(unsigned int));
+    /* one line per plane, as they can be denoised concurrently */
+    cfg->Line = malloc(wsum*sizeof(unsigned int));
     if (!cfg->Line) {
         free(sys);
         return VLC_ENOMEM;
@@ -188,6 +189,41 @@ static void Close(vlc_object_t *this)
     free(sys);
 }
 
+typedef struct
+{
+    picture_t *src;
+    picture_t *dst;
+} hqdn3d_slice_t;
+
+/*****************************************************************************
+ * FilterPlane: denoises the planes of a slice
+ *****************************************************************************/
+static void FilterPlane(filter_t *filter, void *opaque,
+                        unsigned slice, unsigned slices)
+{
+    filter_sys_t *sys = filter->p_sys;
+    struct vf_priv_s *cfg = &sys->cfg;
+    const hqdn3d_slice_t *ctx = opaque;
+    /* the luma plane alone is the first slice, the last one does the
+     * remaining planes */
+    const unsigned end = slice + 1 == slices ? 3 : slice + 1;
+
+    for (unsigned i = slice; i < end; ++i) {
+        int *coefs = i == 0 ? cfg->Coefs[0] : cfg->Coefs[2];
+        unsigned int *line = cfg->Line;
+
+        for (unsigned j = 0; j < i; ++j)
+            line += sys->w[j];
+
+        deNoise(ctx->src->p[i].p_pixels, ctx->dst->p[i].p_pixels,
+                line, &cfg->Frame[i], sys->w[i], sys->h[i],
+                ctx->src->p[i].i_pitch, ctx->dst->p[i].i_pitch,
+                coefs,
+                coefs,
+                i == 0 ? cfg->Coefs[1] : cfg->Coefs[3]);
+    }
+}
+
 /*****************************************************************************
  * Filter
  *****************************************************************************/
@@ -220,24 +256,11 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
     }
     vlc_mutex_unlock( &sys->coefs_mutex );
 
-    deNoise(src->p[0].p_pixels, dst->p[0].p_pixels,
-            cfg->Line, &cfg->Frame[0], sys->w[0], sys->h[0],
-            src->p[0].i_pitch, dst->p[0].i_pitch,
-            cfg->Coefs[0],
-            cfg->Coefs[0],
-            cfg->Coefs[1]);
-    deNoise(src->p[1].p_pixels, dst->p[1].p_pixels,
-            cfg->Line, &cfg->Frame[1], sys->w[1], sys->h[1],
-            src->p[1].i_pitch, dst->p[1].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
-    deNoise(src->p[2].p_pixels, dst->p[2].p_pixels,
-            cfg->Line, &cfg->Frame[2], sys->w[2], sys->h[2],
-            src->p[2].i_pitch, dst->p[2].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
+    /* The recursive vertical low pass runs through whole planes, so the
+     * planes are the slices */
+    hqdn3d_slice_t slice = { .src = src, .dst = dst };
+    filter_RunSlices(filter, FilterPlane, &slice,
+                     __MIN(filter_GetSliceCount(filter), 3));
 
     if(unlikely(!cfg->Frame[0] || !cfg->Frame[1] || !cfg->Frame[2]))
     {
@@ -46,6 +46,13 @@ static /*inline*/ unsigned int LowPassMul(unsigned int PrevMul, unsigned int Cur
     return CurrMul + Coef[d];
 }
 
+/* Rounds to the 8.8 history of the previous frame. The filtered values can
+ * be slightly negative, they must not wrap to 255.99, which would index
+ * past the end of the coefficients the next frame */
+static inline unsigned short LowPassAnt(unsigned int PixelDst){
+    return (int)PixelDst < 0 ? 0 : ((PixelDst+0x7F)>>8);
+}
+
 static void deNoiseTemporal(
                     unsigned char *Frame,        // mpi->planes[x]
                     unsigned char *FrameDest,    // dmpi->planes[x]
@@ -58,7 +65,7 @@ static void deNoiseTemporal(
     for (long Y = 0; Y < H; Y++){
         for (long X = 0; X < W; X++){
             PixelDst = LowPassMul(FrameAnt[X]<<8, Frame[X]<<16, Temporal);
-            FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
+            FrameAnt[X] = LowPassAnt(PixelDst);
             FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
         }
         Frame += sStride;
@@ -143,7 +150,7 @@ static void deNoise(unsigned char *Frame,        // mpi->planes[x]
     /* First pixel has no left nor top neighbor. Only previous frame */
     LineAnt[0] = PixelAnt = Frame[0]<<16;
     PixelDst = LowPassMul(FrameAnt[0]<<8, PixelAnt, Temporal);
-    FrameAnt[0] = ((PixelDst+0x1000007F)>>8);
+    FrameAnt[0] = LowPassAnt(PixelDst);
     FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
 
     /* First line has no top neighbor. Only left one for each pixel and
@@ -151,7 +158,7 @@ static void deNoise(unsigned char *Frame,        // mpi->planes[x]
     for (long X = 1; X < W; X++){
         LineAnt[X] = PixelAnt = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
         PixelDst = LowPassMul(FrameAnt[X]<<8, PixelAnt, Temporal);
-        FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
+        FrameAnt[X] = LowPassAnt(PixelDst);
         FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
     }
 
@@ -163,7 +170,7 @@ static void deNoise(unsigned char *Frame,        // mpi->planes[x]
         PixelAnt = Frame[sLineOffs]<<16;
         LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
         PixelDst = LowPassMul(LinePrev[0]<<8, LineAnt[0], Temporal);
-        LinePrev[0] = ((PixelDst+0x1000007F)>>8);
+        LinePrev[0] = LowPassAnt(PixelDst);
         FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
 
         for (long X = 1; X < W; X++){
@@ -172,7 +179,7 @@ static void deNoise(unsigned char *Frame,        // mpi->planes[x]
             PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
             LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
             PixelDst = LowPassMul(LinePrev[X]<<8, LineAnt[X], Temporal);
-            LinePrev[X] = ((PixelDst+0x1000007F)>>8);
+            LinePrev[X] = LowPassAnt(PixelDst);
             FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
         }
     }
@@ -160,16 +160,26 @@ static void Destroy( vlc_object_t *p_this )
     free( p_sys );
 }
 
+/* Minimum number of lines of the slices */
+#define SLICE_MIN_LINES 16
+
+typedef struct
+{
+    picture_t *p_src;
+    picture_t *p_out;
+    int        sigma;
+} sharpen_slice_t;
+
 /*****************************************************************************
- * Render: displays previously rendered output
- *****************************************************************************
- * This function send the currently rendered image to Invert image, waits
- * until it is displayed and switch the two rendering buffers, preparing next
- * frame.
+ * FilterSlice: sharpens a band of the picture
  *****************************************************************************/
-static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+static void FilterSlice( filter_t *p_filter, void *opaque,
+                         unsigned i_slice, unsigned i_slices )
 {
-    picture_t *p_outpic;
+    VLC_UNUSED(p_filter);
+    const sharpen_slice_t *p_slice = opaque;
+    const picture_t *p_pic = p_slice->p_src;
+    picture_t *p_outpic = p_slice->p_out;
     uint8_t *restrict p_src = NULL;
     uint8_t *restrict p_out = NULL;
     int i_src_pitch;
@@ -179,14 +189,13 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
     const int v2 = 3; /* 2^3 = 8 */
     const unsigned i_visible_lines = p_pic->p[Y_PLANE].i_visible_lines;
     const unsigned i_visible_pitch = p_pic->p[Y_PLANE].i_visible_pitch;
-    const int sigma = var_GetFloat( p_filter, FILTER_PREFIX "sigma" ) * (1 << 20);
+    const int sigma = p_slice->sigma;
+    int i_start, i_end;
 
-    p_outpic = filter_NewPicture( p_filter );
-    if( !p_outpic )
-    {
-        picture_Release( p_pic );
-        return NULL;
-    }
+    filter_SliceLines( i_visible_lines, 1, i_slice, i_slices,
+                       &i_start, &i_end );
+    const unsigned i_first = __MAX( i_start, 1 );
+    const unsigned i_last = __MIN( (unsigned)i_end, i_visible_lines - 1 );
 
     /* process the Y plane */
     p_src = p_pic->p[Y_PLANE].p_pixels;
@@ -195,11 +204,10 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
     i_out_pitch = p_outpic->p[Y_PLANE].i_pitch;
 
     /* perform convolution only on Y plane. Avoid border line. */
-    vlc_mutex_lock( &p_filter->p_sys->lock );
-
-    memcpy(p_out, p_src, i_visible_pitch);
+    if( i_start == 0 )
+        memcpy(p_out, p_src, i_visible_pitch);
 
-    for( unsigned i = 1; i < i_visible_lines - 1; i++ )
+    for( unsigned i = i_first; i < i_last; i++ )
     {
         p_out[i * i_out_pitch] = p_src[i * i_src_pitch];
 
@@ -223,13 +231,48 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
         p_out[i * i_out_pitch + i_visible_pitch - 1] =
             p_src[i * i_src_pitch + i_visible_pitch - 1];
     }
-    memcpy(&p_out[(i_visible_lines - 1) * i_out_pitch],
-           &p_src[(i_visible_lines - 1) * i_src_pitch], i_visible_pitch);
+    if( (unsigned)i_end == i_visible_lines )
+        memcpy(&p_out[(i_visible_lines - 1) * i_out_pitch],
+               &p_src[(i_visible_lines - 1) * i_src_pitch], i_visible_pitch);
+
+    /* copy the same band of the chroma planes */
+    picture_t src_view, out_view;
+    filter_SlicePicture( &src_view, p_pic, i_slice, i_slices );
+    filter_SlicePicture( &out_view, p_outpic, i_slice, i_slices );
+    plane_CopyPixels( &out_view.p[U_PLANE], &src_view.p[U_PLANE] );
+    plane_CopyPixels( &out_view.p[V_PLANE], &src_view.p[V_PLANE] );
+}
 
-    vlc_mutex_unlock( &p_filter->p_sys->lock );
+/*****************************************************************************
+ * Render: displays previously rendered output
+ *****************************************************************************
+ * This function send the currently rendered image to Invert image, waits
+ * until it is displayed and switch the two rendering buffers, preparing next
+ * frame.
+ *****************************************************************************/
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    picture_t *p_outpic;
+    const unsigned i_visible_lines = p_pic->p[Y_PLANE].i_visible_lines;
+    sharpen_slice_t slice = {
+        .p_src = p_pic,
+        .sigma = var_GetFloat( p_filter, FILTER_PREFIX "sigma" ) * (1 << 20),
+    };
 
-    plane_CopyPixels( &p_outpic->p[U_PLANE], &p_pic->p[U_PLANE] );
-    plane_CopyPixels( &p_outpic->p[V_PLANE], &p_pic->p[V_PLANE] );
+    p_outpic = filter_NewPicture( p_filter );
+    if( !p_outpic )
+    {
+        picture_Release( p_pic );
+        return NULL;
+    }
+    slice.p_out = p_outpic;
+
+    unsigned i_slices = __MIN( filter_GetSliceCount( p_filter ),
+                               i_visible_lines / SLICE_MIN_LINES );
+
+    vlc_mutex_lock( &p_filter->p_sys->lock );
+    filter_RunSlices( p_filter, FilterSlice, &slice, __MAX( i_slices, 1 ) );
+    vlc_mutex_unlock( &p_filter->p_sys->lock );
 
     return CopyInfoAndRelease( p_outpic, p_pic );
 }
@@ -248,6 +248,28 @@ static ssize_t AStreamReadBlock(stream_t *s, void *buf, size_t len)
     return copy;
 }
 
+static ssize_t AStreamPeekBlock(stream_t *s, const uint8_t **restrict bufp,
+                                size_t len)
+{
+    stream_sys_t *sys = s->p_sys;
+    block_t *block = sys->block;
+
+    while (block == NULL)
+    {
+        if (vlc_access_Eof(sys->access))
+            return 0;
+        if (vlc_killed())
+            return -1;
+
+        block = vlc_access_Block(sys->access);
+    }
+
+    /* Keep the block: it will be consumed by the next read */
+    sys->block = block;
+    *bufp = block->p_buffer;
+    return (block->i_buffer < len) ? block->i_buffer : len;
+}
+
 /* Read access */
 static ssize_t AStreamReadStream(stream_t *s, void *buf, size_t len)
 {
@@ -364,6 +386,14 @@ static int AStreamControl(stream_t *s, int cmd, va_list args)
             if (access->pf_block == NULL)
                 return VLC_EGENERIC;
 
+            if (sys->block != NULL)
+            {   /* Hand over the partially consumed or peeked block first */
+                *b = sys->block;
+                sys->block = NULL;
+                *eof = false;
+                break;
+            }
+
             *b = vlc_access_Eof(access) ? NULL : vlc_access_Block(access);
             *eof = (*b == NULL) && vlc_access_Eof(access);
             break;
@@ -409,6 +439,7 @@ stream_t *stream_AccessNew(vlc_object_t *parent, input_thread_t *input,
     if (sys->access->pf_block != NULL)
     {
         s->pf_read = AStreamReadBlock;
+        s->pf_peek = AStreamPeekBlock;
         cachename = "cache_block";
     }
     else
@@ -568,6 +568,23 @@ int input_vaControl( input_thread_t *p_input, int i_query, va_list args )
             return es_out_ControlModifyPcrSystem( p_input->p->p_es_out_display, b_absolute, i_system );
         }
 
+        case INPUT_GET_TIMESHIFT:
+        {
+            mtime_t *pi_window = va_arg( args, mtime_t * );
+            mtime_t *pi_delay  = va_arg( args, mtime_t * );
+
+            vlc_mutex_lock( &p_input->p->p_item->lock );
+            *pi_window = p_input->p->i_timeshift_window;
+            *pi_delay  = p_input->p->i_timeshift_delay;
+            vlc_mutex_unlock( &p_input->p->p_item->lock );
+            return VLC_SUCCESS;
+        }
+
+        case INPUT_SET_TIMESHIFT:
+            val.i_int = (mtime_t)va_arg( args, mtime_t );
+            input_ControlPush( p_input, INPUT_CONTROL_SET_TIMESHIFT, &val );
+            return VLC_SUCCESS;
+
         default:
             msg_Err( p_input, "unknown query in input_vaControl" );
             return VLC_EGENERIC;
@@ -939,6 +939,7 @@ static void DecoderUpdateStatVideo( decoder_t *p_dec, unsigned decoded,
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
     input_thread_t *p_input = p_owner->p_input;
     unsigned displayed = 0;
+    unsigned spu_cached = 0, spu_rendered = 0;
 
     /* Update ugly stat */
     if( p_input == NULL )
@@ -949,6 +950,7 @@ static void DecoderUpdateStatVideo( decoder_t *p_dec, unsigned decoded,
         unsigned vout_lost = 0;
 
         vout_GetResetStatistic( p_owner->p_vout, &displayed, &vout_lost );
+        vout_GetResetSpuStatistic( p_owner->p_vout, &spu_cached, &spu_rendered );
         lost += vout_lost;
     }
 
@@ -956,6 +958,8 @@ static void DecoderUpdateStatVideo( decoder_t *p_dec, unsigned decoded,
     stats_Update( p_input->p->counters.p_decoded_video, decoded, NULL );
     stats_Update( p_input->p->counters.p_lost_pictures, lost , NULL);
     stats_Update( p_input->p->counters.p_displayed_pictures, displayed, NULL);
+    stats_Update( p_input->p->counters.p_cached_subpictures, spu_cached, NULL );
+    stats_Update( p_input->p->counters.p_rendered_subpictures, spu_rendered, NULL );
     vlc_mutex_unlock( &p_input->p->counters.counters_lock );
 }
 
@@ -82,6 +82,10 @@ enum es_out_query_private_e
 
     /* Set End Of Stream */
     ES_OUT_SET_EOS,                                 /* res=cannot fail */
+
+    /* Get/Set the timeshift delay behind the live stream */
+    ES_OUT_GET_TIMESHIFT,                           /* arg1=mtime_t *pi_window arg2=mtime_t *pi_delay res=cannot fail */
+    ES_OUT_SET_TIMESHIFT,                           /* arg1=mtime_t i_delay     res=can fail */
 };
 
 static inline void es_out_SetMode( es_out_t *p_out, int i_mode )
@@ -167,6 +171,11 @@ static inline void es_out_Eos( es_out_t *p_out )
     int i_ret = es_out_Control( p_out, ES_OUT_SET_EOS );
     assert( !i_ret );
 }
+static inline void es_out_GetTimeshift( es_out_t *p_out, mtime_t *pi_window, mtime_t *pi_delay )
+{
+    int i_ret = es_out_Control( p_out, ES_OUT_GET_TIMESHIFT, pi_window, pi_delay );
+    assert( !i_ret );
+}
 
 es_out_t  *input_EsOutNew( input_thread_t *, int i_rate );
 
@@ -37,6 +37,12 @@
 #endif
 #include <sys/stat.h>
 #include <unistd.h>
+/* The storages are read back through a mapping of what write() appended,
+ * which requires the page cache to be shared by both, as on Linux */
+#if defined(HAVE_MMAP) && defined(__linux__)
+#   define TS_STORAGE_MMAP 1
+#   include <sys/mman.h>
+#endif
 
 #include <vlc_common.h>
 #include <vlc_fs.h>
@@ -162,12 +168,19 @@ struct ts_storage_t
 #endif
     size_t  i_file_max; /* Max size in bytes */
     int64_t i_file_size;/* Current size in bytes */
+#ifdef TS_STORAGE_MMAP
+    int     fd;         /* Data are appended with write() */
+    uint8_t *p_map;     /* and read back through this mapping, or NULL */
+    size_t  i_map_size;
+#else
     FILE    *p_filew;   /* FILE handle for data writing */
     FILE    *p_filer;   /* FILE handle for data reading */
+#endif
 
     /* */
     int      i_cmd_r;
     int      i_cmd_w;
+    int      i_cmd_done; /* Commands before it were already executed once */
     int      i_cmd_max;
     ts_cmd_t *p_cmd;
 };
@@ -183,6 +196,7 @@ typedef struct
     /* Lock for all following fields */
     vlc_mutex_t    lock;
     vlc_cond_t     wait;
+    vlc_cond_t     wait_seek; /* signaled on seek requests only */
 
     /* */
     bool           b_paused;
@@ -198,16 +212,46 @@ typedef struct
     mtime_t        i_buffering_delay;
 
     /* */
+    ts_storage_t   *p_storage_first;
     ts_storage_t   *p_storage_r;
     ts_storage_t   *p_storage_w;
 
     mtime_t        i_cmd_delay;
 
+    /* Ring of played storages kept to seek back into, 0 if disabled */
+    int64_t        i_ring_size_max;
+
+    /* Pending seek, to the command received at i_seek_date */
+    bool           b_seek;
+    mtime_t        i_seek_date;
+
+    /* Ids of the deleted ES, their blocks may still be replayed */
+    int            i_es_dead;
+    es_out_id_t    **pp_es_dead;
+
 } ts_thread_t;
 
+/* Outcome of a seek, carried out once the timeshift lock is released */
+typedef struct
+{
+    bool     b_done;
+    bool     b_backward;
+    mtime_t  i_date;
+    /* State changes jumped over by a forward seek */
+    int      i_cmd;
+    int      i_cmd_max;
+    ts_cmd_t *p_cmd;
+} ts_seek_t;
+
 struct es_out_id_t
 {
     es_out_id_t *p_es;
+
+    /* Kept while seeking back is possible, to recreate the ES after it
+     * was deleted */
+    es_format_t *p_fmt;
+    mtime_t     i_add_date;
+    mtime_t     i_del_date; /* -1 until deleted */
 };
 
 struct es_out_sys_t
@@ -218,6 +262,7 @@ struct es_out_sys_t
     /* Configuration */
     int64_t        i_tmp_size_max;    /* Maximal temporary file size in byte */
     char           *psz_tmp_path;     /* Path for temporary files */
+    int64_t        i_ring_size_max;   /* Maximal size kept to seek back, in byte */
 
     /* Lock for all following fields */
     vlc_mutex_t    lock;
@@ -253,19 +298,29 @@ static bool         TsHasCmd( ts_thread_t * );
 static bool         TsIsUnused( ts_thread_t * );
 static int          TsChangePause( ts_thread_t *, bool b_source_paused, bool b_paused, mtime_t i_date );
 static int          TsChangeRate( ts_thread_t *, int i_src_rate, int i_rate );
+static void         TsChangeDelay( ts_thread_t *, mtime_t i_delay );
+static void         TsGetWindow( ts_thread_t *, mtime_t *pi_window, mtime_t *pi_delay );
+static void         TsSeekLocked( ts_thread_t *, ts_seek_t * );
+static void         TsSeekExecute( ts_thread_t *, ts_seek_t * );
+static void         TsTrimLocked( ts_thread_t * );
+static void         TsExecuteCmd( ts_thread_t *, ts_cmd_t * );
 
 static void         *TsRun( void * );
 
 static ts_storage_t *TsStorageNew( const char *psz_path, int64_t i_tmp_size_max );
 static void         TsStorageDelete( ts_storage_t * );
 static void         TsStoragePack( ts_storage_t *p_storage );
+static void         TsStorageUnmap( ts_storage_t *p_storage );
 static bool         TsStorageIsFull( ts_storage_t *, const ts_cmd_t *p_cmd );
 static bool         TsStorageIsEmpty( ts_storage_t * );
-static void         TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd, bool b_flush );
-static void         TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush );
+static void         TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd );
+static int          TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush );
+static int          TsStorageWrite( ts_storage_t *, const block_t *p_block );
+static size_t       TsStorageRead( ts_storage_t *, int64_t i_offset, void *p_data, size_t i_size );
 
 static void CmdClean( ts_cmd_t * );
 static void cmd_cleanup_routine( void *p ) { CmdClean( p ); }
+static bool CmdIsReplayable( const ts_cmd_t * );
 
 static int  CmdInitAdd    ( ts_cmd_t *, es_out_id_t *, const es_format_t *, bool b_copy );
 static void CmdInitSend   ( ts_cmd_t *, es_out_id_t *, block_t * );
@@ -284,6 +339,9 @@ static void CmdExecuteDel    ( es_out_t *, ts_cmd_t * );
 static int  CmdExecuteControl( es_out_t *, ts_cmd_t * );
 
 /* File helpers */
+static void EsDelete( es_out_id_t * );
+static void EsSetFormat( es_out_id_t *, const es_format_t * );
+
 static int GetTmpFile( char **ppsz_file, const char *psz_path );
 
 /*****************************************************************************
@@ -334,6 +392,16 @@ es_out_t *input_EsOutTimeshiftNew( input_thread_t *p_input, es_out_t *p_next_out
     msg_Dbg( p_input, "using timeshift granularity of %d MiB",
              (int)p_sys->i_tmp_size_max/(1024*1024) );
 
+    const int i_ring_size_max = var_CreateGetInteger( p_input, "input-timeshift-size" );
+    p_sys->i_ring_size_max = (int64_t)__MAX( i_ring_size_max, 0 ) * 1024*1024;
+    if( p_sys->i_ring_size_max > 0 )
+    {
+        /* At least two storages, the one being written and one to seek into */
+        p_sys->i_ring_size_max = __MAX( p_sys->i_ring_size_max, 2 * p_sys->i_tmp_size_max );
+        msg_Dbg( p_input, "keeping up to %"PRId64" MiB of timeshift",
+                 p_sys->i_ring_size_max/(1024*1024) );
+    }
+
     p_sys->psz_tmp_path = var_InheritString( p_input, "input-timeshift-path" );
 #if defined (_WIN32) && !VLC_WINSTORE_APP
     if( p_sys->psz_tmp_path == NULL )
@@ -422,6 +490,9 @@ static es_out_id_t *Add( es_out_t *p_out, const es_format_t *p_fmt )
     es_out_id_t *p_es = malloc( sizeof( *p_es ) );
     if( !p_es )
         return NULL;
+    p_es->p_fmt = NULL;
+    p_es->i_add_date = -1;
+    p_es->i_del_date = -1;
 
     vlc_mutex_lock( &p_sys->lock );
 
@@ -439,8 +510,19 @@ static es_out_id_t *Add( es_out_t *p_out, const es_format_t *p_fmt )
     if( p_sys->b_delayed )
         TsPushCmd( p_sys->p_ts, &cmd );
     else
+    {
         CmdExecuteAdd( p_sys->p_out, &cmd );
 
+        /* The recording may start later and seek back to this ES once
+         * it is deleted */
+        if( p_sys->i_ring_size_max > 0 )
+        {
+            p_es->p_fmt = malloc( sizeof(*p_es->p_fmt) );
+            if( p_es->p_fmt )
+                es_format_Copy( p_es->p_fmt, p_fmt );
+        }
+    }
+
     vlc_mutex_unlock( &p_sys->lock );
 
     return p_es;
@@ -455,6 +537,11 @@ static int Send( es_out_t *p_out, es_out_id_t *p_es, block_t *p_block )
 
     TsAutoStop( p_out );
 
+    /* Record live streams from their first block when seeking back is enabled */
+    if( !p_sys->b_delayed && p_sys->i_ring_size_max > 0 &&
+        !p_sys->p_input->p->b_can_pace_control )
+        TsStart( p_out );
+
     CmdInitSend( &cmd, p_es, p_block );
     if( p_sys->b_delayed )
         TsPushCmd( p_sys->p_ts, &cmd );
@@ -611,6 +698,30 @@ static int ControlLockedSetFrameNext( es_out_t *p_out )
 
     return es_out_SetFrameNext( p_sys->p_out );
 }
+static int ControlLockedGetTimeshift( es_out_t *p_out, mtime_t *pi_window, mtime_t *pi_delay )
+{
+    es_out_sys_t *p_sys = p_out->p_sys;
+
+    if( !p_sys->b_delayed )
+    {
+        *pi_window = 0;
+        *pi_delay = 0;
+        return VLC_SUCCESS;
+    }
+
+    TsGetWindow( p_sys->p_ts, pi_window, pi_delay );
+    return VLC_SUCCESS;
+}
+static int ControlLockedSetTimeshift( es_out_t *p_out, mtime_t i_delay )
+{
+    es_out_sys_t *p_sys = p_out->p_sys;
+
+    if( !p_sys->b_delayed )
+        return i_delay > 0 ? VLC_EGENERIC : VLC_SUCCESS;
+
+    TsChangeDelay( p_sys->p_ts, __MAX( i_delay, 0 ) );
+    return VLC_SUCCESS;
+}
 
 static int ControlLocked( es_out_t *p_out, int i_query, va_list args )
 {
@@ -647,6 +758,8 @@ static int ControlLocked( es_out_t *p_out, int i_query, va_list args )
             TsPushCmd( p_sys->p_ts, &cmd );
             return VLC_SUCCESS;
         }
+        if( i_query == ES_OUT_SET_ES_FMT )
+            EsSetFormat( cmd.u.control.u.es_fmt.p_es, cmd.u.control.u.es_fmt.p_fmt );
         return CmdExecuteControl( p_sys->p_out, &cmd );
     }
 
@@ -704,6 +817,19 @@ static int ControlLocked( es_out_t *p_out, int i_query, va_list args )
     {
         return ControlLockedSetFrameNext( p_out );
     }
+    case ES_OUT_GET_TIMESHIFT:
+    {
+        mtime_t *pi_window = (mtime_t*)va_arg( args, mtime_t * );
+        mtime_t *pi_delay  = (mtime_t*)va_arg( args, mtime_t * );
+
+        return ControlLockedGetTimeshift( p_out, pi_window, pi_delay );
+    }
+    case ES_OUT_SET_TIMESHIFT:
+    {
+        const mtime_t i_delay = (mtime_t)va_arg( args, mtime_t );
+
+        return ControlLockedSetTimeshift( p_out, i_delay );
+    }
     case ES_OUT_GET_PCR_SYSTEM:
     {
         if( p_sys->b_delayed )
@@ -764,6 +890,7 @@ static int Control( es_out_t *p_out, int i_query, va_list args )
  *****************************************************************************/
 static void TsDestroy( ts_thread_t *p_ts )
 {
+    vlc_cond_destroy( &p_ts->wait_seek );
     vlc_cond_destroy( &p_ts->wait );
     vlc_mutex_destroy( &p_ts->lock );
     free( p_ts );
@@ -785,6 +912,7 @@ static int TsStart( es_out_t *p_out )
     p_ts->p_out = p_sys->p_out;
     vlc_mutex_init( &p_ts->lock );
     vlc_cond_init( &p_ts->wait );
+    vlc_cond_init( &p_ts->wait_seek );
     p_ts->b_paused = p_sys->b_input_paused && !p_sys->b_input_paused_source;
     p_ts->i_pause_date = p_ts->b_paused ? mdate() : -1;
     p_ts->i_rate_source = p_sys->i_input_rate_source;
@@ -793,8 +921,13 @@ static int TsStart( es_out_t *p_out )
     p_ts->i_rate_delay = 0;
     p_ts->i_buffering_delay = 0;
     p_ts->i_cmd_delay = 0;
+    p_ts->p_storage_first = NULL;
     p_ts->p_storage_r = NULL;
     p_ts->p_storage_w = NULL;
+    p_ts->i_ring_size_max = p_sys->i_ring_size_max;
+    p_ts->b_seek = false;
+    p_ts->i_seek_date = -1;
+    TAB_INIT( p_ts->i_es_dead, p_ts->pp_es_dead );
 
     p_sys->b_delayed = true;
     if( vlc_clone( &p_ts->thread, TsRun, p_ts, VLC_THREAD_PRIORITY_INPUT ) )
@@ -827,24 +960,33 @@ static void TsStop( ts_thread_t *p_ts )
     vlc_join( p_ts->thread, NULL );
 
     vlc_mutex_lock( &p_ts->lock );
-    for( ;; )
+    while( p_ts->p_storage_first )
     {
-        ts_cmd_t cmd;
+        ts_storage_t *p_next = p_ts->p_storage_first->p_next;
 
-        if( TsPopCmdLocked( p_ts, &cmd, true ) )
-            break;
-
-        CmdClean( &cmd );
+        TsStorageDelete( p_ts->p_storage_first );
+        p_ts->p_storage_first = p_next;
     }
-    assert( !p_ts->p_storage_r || !p_ts->p_storage_r->p_next );
-    if( p_ts->p_storage_r )
-        TsStorageDelete( p_ts->p_storage_r );
+    p_ts->p_storage_r = p_ts->p_storage_w = NULL;
     vlc_mutex_unlock( &p_ts->lock );
 
+    /* Deleted ES may have been recreated by a seek back */
+    for( int i = 0; i < p_ts->i_es_dead; i++ )
+    {
+        es_out_id_t *p_es = p_ts->pp_es_dead[i];
+
+        if( p_es->p_es )
+            es_out_Del( p_ts->p_out, p_es->p_es );
+        EsDelete( p_es );
+    }
+    TAB_CLEAN( p_ts->i_es_dead, p_ts->pp_es_dead );
+
     TsDestroy( p_ts );
 }
 static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
 {
+    bool b_new_storage = false;
+
     vlc_mutex_lock( &p_ts->lock );
 
     if( !p_ts->p_storage_w || TsStorageIsFull( p_ts->p_storage_w, p_cmd ) )
@@ -861,18 +1003,25 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
 
         if( !p_ts->p_storage_w )
         {
-            p_ts->p_storage_r = p_ts->p_storage_w = p_storage;
+            p_ts->p_storage_first = p_ts->p_storage_r = p_ts->p_storage_w = p_storage;
         }
         else
         {
             TsStoragePack( p_ts->p_storage_w );
+            if( p_ts->p_storage_w != p_ts->p_storage_r )
+                TsStorageUnmap( p_ts->p_storage_w );
             p_ts->p_storage_w->p_next = p_storage;
             p_ts->p_storage_w = p_storage;
         }
+        b_new_storage = true;
     }
 
     /* TODO return error and warn the user (but only once) */
-    TsStoragePushCmd( p_ts->p_storage_w, p_cmd, p_ts->p_storage_r == p_ts->p_storage_w );
+    TsStoragePushCmd( p_ts->p_storage_w, p_cmd );
+
+    /* The ring grows by whole storages */
+    if( b_new_storage )
+        TsTrimLocked( p_ts );
 
     vlc_cond_signal( &p_ts->wait );
 
@@ -882,22 +1031,38 @@ static int TsPopCmdLocked( ts_thread_t *p_ts, ts_cmd_t *p_cmd, bool b_flush )
 {
     vlc_assert_locked( &p_ts->lock );
 
-    if( TsStorageIsEmpty( p_ts->p_storage_r ) )
-        return VLC_EGENERIC;
+    for( ;; )
+    {
+        if( TsStorageIsEmpty( p_ts->p_storage_r ) )
+            return VLC_EGENERIC;
 
-    TsStoragePopCmd( p_ts->p_storage_r, p_cmd, b_flush );
+        /* Only the blocks, the clock and the ES creations and deletions are
+         * replayed after a seek back */
+        const bool b_cmd = !TsStoragePopCmd( p_ts->p_storage_r, p_cmd, b_flush );
 
-    while( p_ts->p_storage_r && TsStorageIsEmpty( p_ts->p_storage_r ) )
-    {
-        ts_storage_t *p_next = p_ts->p_storage_r->p_next;
-        if( !p_next )
-            break;
+        while( p_ts->p_storage_r && TsStorageIsEmpty( p_ts->p_storage_r ) )
+        {
+            ts_storage_t *p_next = p_ts->p_storage_r->p_next;
+            if( !p_next )
+                break;
 
-        TsStorageDelete( p_ts->p_storage_r );
-        p_ts->p_storage_r = p_next;
-    }
+            if( p_ts->i_ring_size_max > 0 )
+            {
+                /* Kept in the ring until TsTrimLocked() drops it */
+                TsStorageUnmap( p_ts->p_storage_r );
+            }
+            else
+            {
+                assert( p_ts->p_storage_first == p_ts->p_storage_r );
+                TsStorageDelete( p_ts->p_storage_r );
+                p_ts->p_storage_first = p_next;
+            }
+            p_ts->p_storage_r = p_next;
+        }
 
-    return VLC_SUCCESS;
+        if( b_cmd )
+            return VLC_SUCCESS;
+    }
 }
 static bool TsHasCmd( ts_thread_t *p_ts )
 {
@@ -914,7 +1079,8 @@ static bool TsIsUnused( ts_thread_t *p_ts )
     bool b_unused;
 
     vlc_mutex_lock( &p_ts->lock );
-    b_unused = !p_ts->b_paused &&
+    b_unused = p_ts->i_ring_size_max <= 0 &&
+               !p_ts->b_paused &&
                p_ts->i_rate == p_ts->i_rate_source &&
                TsStorageIsEmpty( p_ts->p_storage_r );
     vlc_mutex_unlock( &p_ts->lock );
@@ -971,6 +1137,286 @@ static int TsChangeRate( ts_thread_t *p_ts, int i_src_rate, int i_rate )
     return i_ret;
 }
 
+static void TsChangeDelay( ts_thread_t *p_ts, mtime_t i_delay )
+{
+    vlc_mutex_lock( &p_ts->lock );
+
+    /* Done by TsRun() between two commands */
+    p_ts->b_seek = true;
+    p_ts->i_seek_date = mdate() - i_delay;
+
+    vlc_cond_signal( &p_ts->wait );
+    vlc_cond_signal( &p_ts->wait_seek );
+    vlc_mutex_unlock( &p_ts->lock );
+}
+static void TsGetWindow( ts_thread_t *p_ts, mtime_t *pi_window, mtime_t *pi_delay )
+{
+    vlc_mutex_lock( &p_ts->lock );
+
+    const mtime_t i_now = mdate();
+    mtime_t i_window = 0;
+    if( p_ts->p_storage_first && p_ts->p_storage_first->i_cmd_w > 0 )
+        i_window = i_now - p_ts->p_storage_first->p_cmd[0].i_date;
+
+    /* The buffering delay is only the es_out catching up its caching */
+    mtime_t i_delay = p_ts->i_cmd_delay + p_ts->i_rate_delay;
+    if( p_ts->b_paused )
+        i_delay += i_now - p_ts->i_pause_date;
+
+    vlc_mutex_unlock( &p_ts->lock );
+
+    *pi_window = __MAX( i_window, 0 );
+    *pi_delay = VLC_CLIP( i_delay, 0, *pi_window );
+}
+static void TsSeekLocked( ts_thread_t *p_ts, ts_seek_t *p_seek )
+{
+    vlc_assert_locked( &p_ts->lock );
+    assert( p_ts->b_seek );
+
+    p_seek->b_done = false;
+    p_seek->i_cmd = p_seek->i_cmd_max = 0;
+    p_seek->p_cmd = NULL;
+
+    p_ts->b_seek = false;
+    if( !p_ts->p_storage_first )
+        return;
+
+    /* Find the first command received at or after the seek date, the
+     * commands are in reception order */
+    const mtime_t i_date = p_ts->i_seek_date;
+    ts_storage_t *p_storage = p_ts->p_storage_first;
+    while( p_storage->p_next && p_storage->p_next->i_cmd_w > 0 &&
+           p_storage->p_next->p_cmd[0].i_date <= i_date )
+        p_storage = p_storage->p_next;
+
+    int i_low = 0;
+    int i_high = p_storage->i_cmd_w;
+    while( i_low < i_high )
+    {
+        const int i_mid = ( i_low + i_high ) / 2;
+        if( p_storage->p_cmd[i_mid].i_date < i_date )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    int i_cmd = i_low;
+    if( i_cmd >= p_storage->i_cmd_w && p_storage->p_next )
+    {
+        p_storage = p_storage->p_next;
+        i_cmd = 0;
+    }
+
+    bool b_backward;
+    if( p_storage == p_ts->p_storage_r )
+    {
+        b_backward = i_cmd < p_storage->i_cmd_r;
+    }
+    else
+    {
+        b_backward = false;
+        for( ts_storage_t *p = p_storage; p; p = p->p_next )
+        {
+            if( p == p_ts->p_storage_r )
+            {
+                b_backward = true;
+                break;
+            }
+        }
+    }
+
+    if( b_backward )
+    {
+        /* Everything up to the reader position was executed once and will
+         * be replayed (see TsStoragePopCmd) */
+        if( p_storage != p_ts->p_storage_r )
+        {
+            for( ts_storage_t *p = p_storage->p_next; p != p_ts->p_storage_r; p = p->p_next )
+                p->i_cmd_r = 0;
+            p_ts->p_storage_r->i_cmd_r = 0;
+            if( p_ts->p_storage_r != p_ts->p_storage_w )
+                TsStorageUnmap( p_ts->p_storage_r );
+            p_ts->p_storage_r = p_storage;
+        }
+        p_storage->i_cmd_r = i_cmd;
+    }
+    else
+    {
+        /* Skip the blocks but keep the state changes (ES, programs, meta...)
+         * of the part jumped over, they are executed by TsSeekExecute() */
+        ts_cmd_t cmd;
+        while( !( p_ts->p_storage_r == p_storage && p_storage->i_cmd_r >= i_cmd ) &&
+               !TsPopCmdLocked( p_ts, &cmd, true ) )
+        {
+            if( CmdIsReplayable( &cmd ) )
+            {
+                CmdClean( &cmd );
+                continue;
+            }
+
+            if( p_seek->i_cmd >= p_seek->i_cmd_max )
+            {
+                const int i_max = p_seek->i_cmd_max ? 2 * p_seek->i_cmd_max : 16;
+                ts_cmd_t *p_new = realloc( p_seek->p_cmd, i_max * sizeof(*p_new) );
+                if( !p_new )
+                {
+                    /* TODO warn the user */
+                    CmdClean( &cmd );
+                    continue;
+                }
+                p_seek->p_cmd = p_new;
+                p_seek->i_cmd_max = i_max;
+            }
+            p_seek->p_cmd[p_seek->i_cmd++] = cmd;
+        }
+    }
+
+    p_seek->b_done = true;
+    p_seek->b_backward = b_backward;
+    p_seek->i_date = i_date;
+
+    const mtime_t i_now = p_ts->b_paused ? p_ts->i_pause_date : mdate();
+    if( !TsStorageIsEmpty( p_ts->p_storage_r ) )
+        p_ts->i_cmd_delay = i_now - p_ts->p_storage_r->p_cmd[p_ts->p_storage_r->i_cmd_r].i_date;
+    else
+        p_ts->i_cmd_delay = 0;
+    p_ts->i_rate_date = -1;
+    p_ts->i_rate_delay = 0;
+    p_ts->i_buffering_delay = 0;
+}
+static void TsSeekExecute( ts_thread_t *p_ts, ts_seek_t *p_seek )
+{
+    if( !p_seek->b_done )
+        return;
+
+    for( int i = 0; i < p_seek->i_cmd; i++ )
+        TsExecuteCmd( p_ts, &p_seek->p_cmd[i] );
+    free( p_seek->p_cmd );
+
+    if( p_seek->b_backward )
+    {
+        /* Bring back the ES that existed at the new position and were
+         * deleted since; the replayed commands delete them again */
+        for( int i = 0; i < p_ts->i_es_dead; i++ )
+        {
+            es_out_id_t *p_es = p_ts->pp_es_dead[i];
+            const bool b_alive = p_es->i_add_date < p_seek->i_date &&
+                                 p_es->i_del_date >= p_seek->i_date;
+
+            if( b_alive && !p_es->p_es && p_es->p_fmt )
+                p_es->p_es = es_out_Add( p_ts->p_out, p_es->p_fmt );
+            else if( !b_alive && p_es->p_es )
+            {
+                es_out_Del( p_ts->p_out, p_es->p_es );
+                p_es->p_es = NULL;
+            }
+        }
+    }
+
+    msg_Dbg( p_ts->p_input, "timeshift seek %s to %"PRId64" ms from live",
+             p_seek->b_backward ? "backward" : "forward",
+             ( mdate() - p_seek->i_date ) / 1000 );
+
+    /* Restart the clock from the new position */
+    es_out_Control( p_ts->p_out, ES_OUT_RESET_PCR );
+}
+static void TsTrimLocked( ts_thread_t *p_ts )
+{
+    vlc_assert_locked( &p_ts->lock );
+
+    if( p_ts->i_ring_size_max <= 0 )
+        return;
+
+    int64_t i_size = 0;
+    for( ts_storage_t *p = p_ts->p_storage_first; p; p = p->p_next )
+        i_size += p->i_file_size;
+
+    /* Drop the oldest played storages */
+    while( i_size > p_ts->i_ring_size_max && p_ts->p_storage_first != p_ts->p_storage_r )
+    {
+        ts_storage_t *p_storage = p_ts->p_storage_first;
+
+        p_ts->p_storage_first = p_storage->p_next;
+        i_size -= p_storage->i_file_size;
+        TsStorageDelete( p_storage );
+    }
+
+    /* The reader lags behind the whole ring, move it to the next storage */
+    ts_storage_t *p_next = p_ts->p_storage_first->p_next;
+    if( i_size > p_ts->i_ring_size_max && !p_ts->b_seek &&
+        p_next && p_next->i_cmd_w > 0 )
+    {
+        msg_Warn( p_ts->p_input, "es out timeshift: buffer full, skipping %"PRId64" ms",
+                  ( p_next->p_cmd[0].i_date - p_ts->p_storage_first->p_cmd[0].i_date ) / 1000 );
+        p_ts->b_seek = true;
+        p_ts->i_seek_date = p_next->p_cmd[0].i_date;
+        vlc_cond_signal( &p_ts->wait_seek );
+    }
+}
+static void TsExecuteCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
+{
+    switch( p_cmd->i_type )
+    {
+    case C_ADD:
+        if( !p_cmd->u.add.p_fmt )
+        {
+            /* Replayed after a seek back, see TsStoragePopCmd() */
+            es_out_id_t *p_es = p_cmd->u.add.p_es;
+
+            if( !p_es->p_es && p_es->p_fmt )
+                p_es->p_es = es_out_Add( p_ts->p_out, p_es->p_fmt );
+            break;
+        }
+        CmdExecuteAdd( p_ts->p_out, p_cmd );
+        if( p_ts->i_ring_size_max > 0 )
+        {
+            /* The ES id takes the format over */
+            es_out_id_t *p_es = p_cmd->u.add.p_es;
+
+            EsSetFormat( p_es, NULL );
+            p_es->p_fmt = p_cmd->u.add.p_fmt;
+            p_es->i_add_date = p_cmd->i_date;
+        }
+        else
+            CmdCleanAdd( p_cmd );
+        break;
+    case C_SEND:
+        CmdExecuteSend( p_ts->p_out, p_cmd );
+        CmdCleanSend( p_cmd );
+        break;
+    case C_CONTROL:
+        if( p_ts->i_ring_size_max > 0 &&
+            p_cmd->u.control.i_query == ES_OUT_SET_ES_FMT )
+            EsSetFormat( p_cmd->u.control.u.es_fmt.p_es,
+                         p_cmd->u.control.u.es_fmt.p_fmt );
+        CmdExecuteControl( p_ts->p_out, p_cmd );
+        CmdCleanControl( p_cmd );
+        break;
+    case C_DEL:
+        if( p_ts->i_ring_size_max > 0 )
+        {
+            /* Its blocks may be replayed after a seek back, keep the id */
+            es_out_id_t *p_es = p_cmd->u.del.p_es;
+
+            if( p_es->p_es )
+                es_out_Del( p_ts->p_out, p_es->p_es );
+            p_es->p_es = NULL;
+            if( p_es->i_del_date < 0 ) /* not replayed */
+            {
+                p_es->i_del_date = p_cmd->i_date;
+                TAB_APPEND( p_ts->i_es_dead, p_ts->pp_es_dead, p_es );
+            }
+        }
+        else
+        {
+            CmdExecuteDel( p_ts->p_out, p_cmd );
+        }
+        break;
+    default:
+        vlc_assert_unreachable();
+        break;
+    }
+}
+
 static void *TsRun( void *p_data )
 {
     ts_thread_t *p_ts = p_data;
@@ -981,6 +1427,7 @@ static void *TsRun( void *p_data )
         ts_cmd_t cmd;
         mtime_t  i_deadline;
         bool b_buffering;
+        bool b_drop;
 
         /* Pop a command to execute */
         vlc_mutex_lock( &p_ts->lock );
@@ -989,6 +1436,19 @@ static void *TsRun( void *p_data )
         for( ;; )
         {
             const int canc = vlc_savecancel();
+            while( p_ts->b_seek )
+            {
+                ts_seek_t seek;
+
+                /* Like any other command, the ones resulting from the seek
+                 * are executed without the lock */
+                TsSeekLocked( p_ts, &seek );
+                vlc_mutex_unlock( &p_ts->lock );
+                TsSeekExecute( p_ts, &seek );
+                vlc_mutex_lock( &p_ts->lock );
+                i_buffering_date = -1;
+            }
+
             b_buffering = es_out_GetBuffering( p_ts->p_out );
 
             if( ( !p_ts->b_paused || b_buffering ) && !TsPopCmdLocked( p_ts, &cmd, false ) )
@@ -1050,40 +1510,29 @@ static void *TsRun( void *p_data )
         }
         i_deadline = cmd.i_date + p_ts->i_cmd_delay + p_ts->i_rate_delay + p_ts->i_buffering_delay;
 
-        vlc_cleanup_pop();
-        vlc_mutex_unlock( &p_ts->lock );
-
         /* Regulate the speed of command processing to the same one than
-         * reading  */
+         * reading, a seek request interrupts the wait (new commands do not
+         * wake it up) */
         vlc_cleanup_push( cmd_cleanup_routine, &cmd );
 
-        mwait( i_deadline );
+        while( !p_ts->b_seek &&
+               !vlc_cond_timedwait( &p_ts->wait_seek, &p_ts->lock, i_deadline ) )
+            ;
 
         vlc_cleanup_pop();
 
+        /* The blocks and clock of the position left are dropped */
+        b_drop = p_ts->b_seek && CmdIsReplayable( &cmd );
+
+        vlc_cleanup_pop();
+        vlc_mutex_unlock( &p_ts->lock );
+
         /* Execute the command  */
         const int canc = vlc_savecancel();
-        switch( cmd.i_type )
-        {
-        case C_ADD:
-            CmdExecuteAdd( p_ts->p_out, &cmd );
-            CmdCleanAdd( &cmd );
-            break;
-        case C_SEND:
-            CmdExecuteSend( p_ts->p_out, &cmd );
-            CmdCleanSend( &cmd );
-            break;
-        case C_CONTROL:
-            CmdExecuteControl( p_ts->p_out, &cmd );
-            CmdCleanControl( &cmd );
-            break;
-        case C_DEL:
-            CmdExecuteDel( p_ts->p_out, &cmd );
-            break;
-        default:
-            vlc_assert_unreachable();
-            break;
-        }
+        if( b_drop )
+            CmdClean( &cmd );
+        else
+            TsExecuteCmd( p_ts, &cmd );
         vlc_restorecancel( canc );
     }
 
@@ -1107,6 +1556,11 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
         return NULL;
     }
 
+#ifdef TS_STORAGE_MMAP
+    p_storage->fd = fd;
+    p_storage->p_map = NULL;
+    p_storage->i_map_size = 0;
+#else
     p_storage->p_filew = fdopen( fd, "w+b" );
     if( p_storage->p_filew == NULL )
     {
@@ -1122,6 +1576,7 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
         vlc_unlink( psz_file );
         goto error;
     }
+#endif
 
 #ifndef _WIN32
     vlc_unlink( psz_file );
@@ -1138,7 +1593,8 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
     /* */
     p_storage->i_cmd_w = 0;
     p_storage->i_cmd_r = 0;
-    p_storage->i_cmd_max = 30000;
+    p_storage->i_cmd_done = 0;
+    p_storage->i_cmd_max = 4096;
     p_storage->p_cmd = malloc( p_storage->i_cmd_max * sizeof(*p_storage->p_cmd) );
     //fprintf( stderr, "\nSTORAGE name=%s size=%d KiB\n", p_storage->psz_file, p_storage->i_cmd_max * sizeof(*p_storage->p_cmd) /1024 );
 
@@ -1148,26 +1604,28 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
         return NULL;
     }
     return p_storage;
+#ifndef TS_STORAGE_MMAP
 error:
     free( psz_file );
     free( p_storage );
     return NULL;
+#endif
 }
 
 static void TsStorageDelete( ts_storage_t *p_storage )
 {
-    while( p_storage->i_cmd_r < p_storage->i_cmd_w )
-    {
-        ts_cmd_t cmd;
-
-        TsStoragePopCmd( p_storage, &cmd, true );
-
-        CmdClean( &cmd );
-    }
+    /* The commands executed once were cleaned at that time */
+    for( int i = p_storage->i_cmd_done; i < p_storage->i_cmd_w; i++ )
+        CmdClean( &p_storage->p_cmd[i] );
     free( p_storage->p_cmd );
 
+#ifdef TS_STORAGE_MMAP
+    TsStorageUnmap( p_storage );
+    vlc_close( p_storage->fd );
+#else
     fclose( p_storage->p_filer );
     fclose( p_storage->p_filew );
+#endif
 #ifdef _WIN32
     vlc_unlink( p_storage->psz_file );
     free( p_storage->psz_file );
@@ -1187,6 +1645,19 @@ static void TsStoragePack( ts_storage_t *p_storage )
     if( p_new )
         p_storage->p_cmd = p_new;
 }
+static void TsStorageUnmap( ts_storage_t *p_storage )
+{
+#ifdef TS_STORAGE_MMAP
+    if( p_storage->p_map )
+    {
+        munmap( p_storage->p_map, p_storage->i_map_size );
+        p_storage->p_map = NULL;
+        p_storage->i_map_size = 0;
+    }
+#else
+    VLC_UNUSED( p_storage );
+#endif
+}
 static bool TsStorageIsFull( ts_storage_t *p_storage, const ts_cmd_t *p_cmd )
 {
     if( p_cmd && p_cmd->i_type == C_SEND && p_storage->i_cmd_w > 0 )
@@ -1196,59 +1667,142 @@ static bool TsStorageIsFull( ts_storage_t *p_storage, const ts_cmd_t *p_cmd )
         if( p_storage->i_file_size + i_size >= p_storage->i_file_max )
             return true;
     }
-    return p_storage->i_cmd_w >= p_storage->i_cmd_max;
+    return false;
 }
 static bool TsStorageIsEmpty( ts_storage_t *p_storage )
 {
     return !p_storage || p_storage->i_cmd_r >= p_storage->i_cmd_w;
 }
-static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bool b_flush )
+static int TsStorageWriteData( ts_storage_t *p_storage, const void *p_data, size_t i_size )
+{
+#ifdef TS_STORAGE_MMAP
+    /* Written with write() rather than through the mapping, so that a full
+     * disk is an error instead of a SIGBUS */
+    const uint8_t *p = p_data;
+
+    while( i_size > 0 )
+    {
+        ssize_t i_ret = vlc_write( p_storage->fd, p, i_size );
+        if( i_ret < 0 && errno == EINTR )
+            continue;
+        if( i_ret <= 0 )
+            return VLC_EGENERIC;
+        p += i_ret;
+        i_size -= i_ret;
+    }
+    return VLC_SUCCESS;
+#else
+    return fwrite( p_data, i_size, 1, p_storage->p_filew ) == 1 ? VLC_SUCCESS : VLC_EGENERIC;
+#endif
+}
+static int TsStorageWrite( ts_storage_t *p_storage, const block_t *p_block )
+{
+    if( TsStorageWriteData( p_storage, p_block, sizeof(*p_block) ) ||
+        ( p_block->i_buffer > 0 &&
+          TsStorageWriteData( p_storage, p_block->p_buffer, p_block->i_buffer ) ) )
+    {
+        /* Overwrite what was written of it with the next one */
+#ifdef TS_STORAGE_MMAP
+        lseek( p_storage->fd, p_storage->i_file_size, SEEK_SET );
+#else
+        fseek( p_storage->p_filew, p_storage->i_file_size, SEEK_SET );
+#endif
+        return VLC_EGENERIC;
+    }
+
+    p_storage->i_file_size += sizeof(*p_block) + p_block->i_buffer;
+    return VLC_SUCCESS;
+}
+static size_t TsStorageRead( ts_storage_t *p_storage, int64_t i_offset, void *p_data, size_t i_size )
+{
+    if( i_offset >= p_storage->i_file_size )
+        return 0;
+    i_size = __MIN( i_size, (size_t)(p_storage->i_file_size - i_offset) );
+
+#ifdef TS_STORAGE_MMAP
+    /* Mapped on the first read, the storage being written may need to be
+     * mapped again once it went past the first mapping size */
+    if( p_storage->i_map_size < (size_t)p_storage->i_file_size )
+    {
+        TsStorageUnmap( p_storage );
+
+        const size_t i_map_size = __MAX( p_storage->i_file_max, (size_t)p_storage->i_file_size );
+        void *p_map = mmap( NULL, i_map_size, PROT_READ, MAP_SHARED, p_storage->fd, 0 );
+        if( p_map == MAP_FAILED )
+            return 0;
+        p_storage->p_map = p_map;
+        p_storage->i_map_size = i_map_size;
+    }
+    memcpy( p_data, &p_storage->p_map[i_offset], i_size );
+    return i_size;
+#else
+    fflush( p_storage->p_filew );
+    if( fseek( p_storage->p_filer, i_offset, SEEK_SET ) )
+        return 0;
+    return fread( p_data, 1, i_size, p_storage->p_filer );
+#endif
+}
+static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd )
 {
     ts_cmd_t cmd = *p_cmd;
 
     assert( !TsStorageIsFull( p_storage, p_cmd ) );
 
+    if( p_storage->i_cmd_w >= p_storage->i_cmd_max )
+    {
+        ts_cmd_t *p_new = realloc( p_storage->p_cmd, 2 * p_storage->i_cmd_max * sizeof(*p_storage->p_cmd) );
+        if( !p_new )
+        {
+            CmdClean( &cmd );
+            return;
+        }
+        p_storage->p_cmd = p_new;
+        p_storage->i_cmd_max *= 2;
+    }
+
     if( cmd.i_type == C_SEND )
     {
         block_t *p_block = cmd.u.send.p_block;
 
         cmd.u.send.p_block = NULL;
-        cmd.u.send.i_offset = ftell( p_storage->p_filew );
+        cmd.u.send.i_offset = p_storage->i_file_size;
 
-        if( fwrite( p_block, sizeof(*p_block), 1, p_storage->p_filew ) != 1 )
-        {
-            block_Release( p_block );
-            return;
-        }
-        p_storage->i_file_size += sizeof(*p_block);
-        if( p_block->i_buffer > 0 )
-        {
-            if( fwrite( p_block->p_buffer, p_block->i_buffer, 1, p_storage->p_filew ) != 1 )
-            {
-                block_Release( p_block );
-                return;
-            }
-        }
-        p_storage->i_file_size += p_block->i_buffer;
+        const int i_ret = TsStorageWrite( p_storage, p_block );
         block_Release( p_block );
-
-        if( b_flush )
-            fflush( p_storage->p_filew );
+        if( i_ret )
+            return;
     }
     p_storage->p_cmd[p_storage->i_cmd_w++] = cmd;
 }
-static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush )
+static int TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush )
 {
     assert( !TsStorageIsEmpty( p_storage ) );
 
     *p_cmd = p_storage->p_cmd[p_storage->i_cmd_r++];
+
+    /* Replay after a seek back */
+    if( p_storage->i_cmd_r <= p_storage->i_cmd_done )
+    {
+        if( p_cmd->i_type == C_ADD )
+            p_cmd->u.add.p_fmt = NULL; /* owned by the ES id since */
+        else if( p_cmd->i_type != C_DEL && !CmdIsReplayable( p_cmd ) )
+            return VLC_EGENERIC;
+    }
+    else
+    {
+        p_storage->i_cmd_done = p_storage->i_cmd_r;
+    }
+
     if( p_cmd->i_type == C_SEND )
     {
         block_t block;
 
-        if( !b_flush &&
-            !fseek( p_storage->p_filer, p_cmd->u.send.i_offset, SEEK_SET ) &&
-            fread( &block, sizeof(block), 1, p_storage->p_filer ) == 1 )
+        if( b_flush )
+        {
+            p_cmd->u.send.p_block = NULL;
+        }
+        else if( TsStorageRead( p_storage, p_cmd->u.send.i_offset,
+                                &block, sizeof(block) ) == sizeof(block) )
         {
             block_t *p_block = block_Alloc( block.i_buffer );
             if( p_block )
@@ -1258,7 +1812,8 @@ static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_fl
                 p_block->i_flags    = block.i_flags;
                 p_block->i_length   = block.i_length;
                 p_block->i_nb_samples = block.i_nb_samples;
-                p_block->i_buffer = fread( p_block->p_buffer, 1, block.i_buffer, p_storage->p_filer );
+                p_block->i_buffer = TsStorageRead( p_storage, p_cmd->u.send.i_offset + sizeof(block),
+                                                   p_block->p_buffer, block.i_buffer );
             }
             p_cmd->u.send.p_block = p_block;
         }
@@ -1268,6 +1823,7 @@ static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_fl
             p_cmd->u.send.p_block = block_Alloc( 1 );
         }
     }
+    return VLC_SUCCESS;
 }
 
 /*****************************************************************************
@@ -1293,6 +1849,14 @@ static void CmdClean( ts_cmd_t *p_cmd )
         break;
     }
 }
+static bool CmdIsReplayable( const ts_cmd_t *p_cmd )
+{
+    if( p_cmd->i_type == C_SEND )
+        return true;
+    return p_cmd->i_type == C_CONTROL &&
+           ( p_cmd->u.control.i_query == ES_OUT_SET_PCR ||
+             p_cmd->u.control.i_query == ES_OUT_SET_GROUP_PCR );
+}
 
 static int CmdInitAdd( ts_cmd_t *p_cmd, es_out_id_t *p_es, const es_format_t *p_fmt, bool b_copy )
 {
@@ -1318,6 +1882,8 @@ static void CmdExecuteAdd( es_out_t *p_out, ts_cmd_t *p_cmd )
 }
 static void CmdCleanAdd( ts_cmd_t *p_cmd )
 {
+    if( !p_cmd->u.add.p_fmt )
+        return;
     es_format_Clean( p_cmd->u.add.p_fmt );
     free( p_cmd->u.add.p_fmt );
 }
@@ -1360,7 +1926,7 @@ static void CmdExecuteDel( es_out_t *p_out, ts_cmd_t *p_cmd )
 {
     if( p_cmd->u.del.p_es->p_es )
         es_out_Del( p_out, p_cmd->u.del.p_es->p_es );
-    free( p_cmd->u.del.p_es );
+    EsDelete( p_cmd->u.del.p_es );
 }
 
 static int CmdInitControl( ts_cmd_t *p_cmd, int i_query, va_list args, bool b_copy )
@@ -1603,6 +2169,30 @@ static void CmdCleanControl( ts_cmd_t *p_cmd )
     }
 }
 
+/*****************************************************************************
+ *
+ *****************************************************************************/
+static void EsDelete( es_out_id_t *p_es )
+{
+    EsSetFormat( p_es, NULL );
+    free( p_es );
+}
+/* Updates the kept format if any, or drops it if p_fmt is NULL */
+static void EsSetFormat( es_out_id_t *p_es, const es_format_t *p_fmt )
+{
+    if( p_fmt && p_es->p_fmt )
+    {
+        es_format_Clean( p_es->p_fmt );
+        es_format_Copy( p_es->p_fmt, p_fmt );
+    }
+    else if( !p_fmt && p_es->p_fmt )
+    {
+        es_format_Clean( p_es->p_fmt );
+        free( p_es->p_fmt );
+        p_es->p_fmt = NULL;
+    }
+}
+
 static int GetTmpFile( char **filename, const char *dirname )
 {
     if( dirname != NULL
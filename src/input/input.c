@@ -321,6 +321,8 @@ static input_thread_t *Create( vlc_object_t *p_parent, input_item_t *p_item,
     p_input->p->i_rate = INPUT_RATE_DEFAULT;
     memset( &p_input->p->bookmark, 0, sizeof(p_input->p->bookmark) );
     TAB_INIT( p_input->p->i_bookmark, p_input->p->pp_bookmark );
+    p_input->p->i_timeshift_window = 0;
+    p_input->p->i_timeshift_delay = 0;
     TAB_INIT( p_input->p->i_attachment, p_input->p->attachment );
     p_input->p->attachment_demux = NULL;
     p_input->p->p_sout   = NULL;
@@ -657,9 +659,14 @@ static void MainLoopStatistics( input_thread_t *p_input )
 
     es_out_SetTimes( p_input->p->p_es_out, f_position, i_time, i_length );
 
+    mtime_t i_timeshift_window, i_timeshift_delay;
+    es_out_GetTimeshift( p_input->p->p_es_out, &i_timeshift_window, &i_timeshift_delay );
+
     /* update current bookmark */
     vlc_mutex_lock( &p_input->p->p_item->lock );
     p_input->p->bookmark.i_time_offset = i_time;
+    p_input->p->i_timeshift_window = i_timeshift_window;
+    p_input->p->i_timeshift_delay = i_timeshift_delay;
     vlc_mutex_unlock( &p_input->p->p_item->lock );
 
     stats_ComputeInputStats( p_input, p_input->p->p_item->p_stats );
@@ -807,6 +814,8 @@ static void InitStatistics( input_thread_t * p_input )
         INIT_COUNTER( lost_abuffers, COUNTER );
         INIT_COUNTER( displayed_pictures, COUNTER );
         INIT_COUNTER( lost_pictures, COUNTER );
+        INIT_COUNTER( cached_subpictures, COUNTER );
+        INIT_COUNTER( rendered_subpictures, COUNTER );
         INIT_COUNTER( decoded_audio, COUNTER );
         INIT_COUNTER( decoded_video, COUNTER );
         INIT_COUNTER( decoded_sub, COUNTER );
@@ -1388,6 +1397,8 @@ error:
         EXIT_COUNTER( lost_abuffers );
         EXIT_COUNTER( displayed_pictures );
         EXIT_COUNTER( lost_pictures );
+        EXIT_COUNTER( cached_subpictures );
+        EXIT_COUNTER( rendered_subpictures );
         EXIT_COUNTER( decoded_audio );
         EXIT_COUNTER( decoded_video );
         EXIT_COUNTER( decoded_sub );
@@ -2045,6 +2056,12 @@ static bool Control( input_thread_t *p_input,
             }
             break;
 
+        case INPUT_CONTROL_SET_TIMESHIFT:
+            if( es_out_Control( p_input->p->p_es_out, ES_OUT_SET_TIMESHIFT,
+                                (mtime_t)val.i_int ) )
+                msg_Err( p_input, "cannot change the timeshift delay" );
+            break;
+
         case INPUT_CONTROL_SET_FRAME_NEXT:
             if( p_input->p->i_state == PAUSE_S )
             {
@@ -117,6 +117,10 @@ struct input_thread_private_t
     int         i_bookmark;
     seekpoint_t **pp_bookmark;
 
+    /* Timeshift buffered window and delay behind live (item lock) */
+    mtime_t     i_timeshift_window;
+    mtime_t     i_timeshift_delay;
+
     /* Input attachment */
     int i_attachment;
     input_attachment_t **attachment;
@@ -156,6 +160,8 @@ struct input_thread_private_t
         counter_t *p_lost_abuffers;
         counter_t *p_displayed_pictures;
         counter_t *p_lost_pictures;
+        counter_t *p_cached_subpictures;
+        counter_t *p_rendered_subpictures;
         vlc_mutex_t counters_lock;
     } counters;
 
@@ -215,6 +221,8 @@ enum input_control_e
     INPUT_CONTROL_SET_RECORD_STATE,
 
     INPUT_CONTROL_SET_FRAME_NEXT,
+
+    INPUT_CONTROL_SET_TIMESHIFT,
 };
 
 /* Internal helpers */
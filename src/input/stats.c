@@ -114,6 +114,17 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
     /* Vouts */
     st->i_displayed_pictures = stats_GetTotal(input->p->counters.p_displayed_pictures);
     st->i_lost_pictures = stats_GetTotal(input->p->counters.p_lost_pictures);
+    st->i_cached_subpictures = stats_GetTotal(input->p->counters.p_cached_subpictures);
+    st->i_rendered_subpictures = stats_GetTotal(input->p->counters.p_rendered_subpictures);
+
+    /* Block allocator */
+    uint64_t hits, misses;
+    size_t retained;
+
+    block_cache_GetStats(&hits, &misses, &retained);
+    st->i_block_cache_hits = hits;
+    st->i_block_cache_misses = misses;
+    st->i_block_cache_retained = retained;
 
     vlc_mutex_unlock(&st->lock);
     vlc_mutex_unlock(&input->p->counters.counters_lock);
@@ -128,10 +139,12 @@ void stats_ReinitInputStats( input_stats_t *p_stats )
     p_stats->f_demux_bitrate = p_stats->f_average_demux_bitrate =
     p_stats->i_demux_corrupted = p_stats->i_demux_discontinuity =
     p_stats->i_displayed_pictures = p_stats->i_lost_pictures =
+    p_stats->i_cached_subpictures = p_stats->i_rendered_subpictures =
     p_stats->i_played_abuffers = p_stats->i_lost_abuffers =
     p_stats->i_decoded_video = p_stats->i_decoded_audio =
-    p_stats->i_sent_bytes = p_stats->i_sent_packets = p_stats->f_send_bitrate
-     = 0;
+    p_stats->i_sent_bytes = p_stats->i_sent_packets = p_stats->f_send_bitrate =
+    p_stats->i_block_cache_hits = p_stats->i_block_cache_misses =
+    p_stats->i_block_cache_retained = 0;
     vlc_mutex_unlock( &p_stats->lock );
 }
 
@@ -79,6 +79,7 @@ stream_t *stream_CommonNew(vlc_object_t *parent, void (*destroy)(stream_t *))
     s->psz_url = NULL;
     s->p_source = NULL;
     s->pf_read = NULL;
+    s->pf_peek = NULL;
     s->pf_readdir = NULL;
     s->pf_control = NULL;
     s->p_sys = NULL;
@@ -398,6 +399,14 @@ ssize_t stream_Peek(stream_t *s, const uint8_t **restrict bufp, size_t len)
     stream_priv_t *priv = (stream_priv_t *)s;
     block_t *peek = priv->peek;
 
+    if (peek == NULL && s->pf_peek != NULL && len > 0)
+    {   /* Borrow the data from the stream back-end if it already holds it */
+        ssize_t ret = s->pf_peek(s, bufp, len);
+        if (ret >= 0 && (size_t)ret >= len)
+            return len;
+        /* Otherwise, the data spans several buffers: copy it */
+    }
+
     if (peek == NULL)
     {
         peek = block_Alloc(len);
@@ -37,6 +37,7 @@ struct stream_sys_t
 };
 
 static ssize_t Read( stream_t *, void *p_read, size_t i_read );
+static ssize_t Peek( stream_t *, const uint8_t **pp_peek, size_t i_peek );
 static int Seek( stream_t *, uint64_t );
 static int  Control( stream_t *, int i_query, va_list );
 static void Delete ( stream_t * );
@@ -72,6 +73,7 @@ stream_t *stream_MemoryNew( vlc_object_t *p_this, uint8_t *p_buffer,
     p_sys->i_preserve_memory = i_preserve_memory;
 
     s->pf_read    = Read;
+    s->pf_peek    = Peek;
     s->pf_seek    = Seek;
     s->pf_control = Control;
     s->p_input = NULL;
@@ -151,6 +153,16 @@ static ssize_t Read( stream_t *s, void *p_read, size_t i_read )
     return i_read;
 }
 
+static ssize_t Peek( stream_t *s, const uint8_t **pp_peek, size_t i_peek )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( i_peek > p_sys->i_size - p_sys->i_pos )
+        i_peek = p_sys->i_size - p_sys->i_pos;
+    *pp_peek = p_sys->p_buffer + p_sys->i_pos;
+    return i_peek;
+}
+
 static int Seek( stream_t *s, uint64_t offset )
 {
     stream_sys_t *p_sys = s->p_sys;
@@ -368,6 +368,11 @@ dbus_out:
      */
     priv->actions = vlc_InitActions( p_libvlc );
 
+    /*
+     * Video filter slice workers
+     */
+    priv->slices = vlc_InitSlices( p_libvlc );
+
     /*
      * Meta data handling
      */
@@ -541,6 +546,12 @@ void libvlc_InternalCleanup( libvlc_int_t *p_libvlc )
 
     vlc_DeinitActions( p_libvlc, priv->actions );
 
+    if( priv->slices != NULL )
+    {
+        vlc_DeinitSlices( priv->slices );
+        priv->slices = NULL;
+    }
+
     /* Save the configuration */
     if( !var_InheritBool( p_libvlc, "ignore-config" ) )
         config_AutoSaveConfigFile( VLC_OBJECT(p_libvlc) );
@@ -34,6 +34,11 @@ struct vlc_actions;
 struct vlc_actions *vlc_InitActions (libvlc_int_t *);
 extern void vlc_DeinitActions (libvlc_int_t *, struct vlc_actions *);
 
+/* Video filter slice workers */
+struct vlc_slices;
+struct vlc_slices *vlc_InitSlices (libvlc_int_t *);
+void vlc_DeinitSlices (struct vlc_slices *);
+
 /*
  * OS-specific initialization
  */
@@ -151,6 +156,7 @@ typedef struct libvlc_priv_t
     struct playlist_t *playlist; ///< Playlist for interfaces
     struct playlist_preparser_t *parser; ///< Input item meta data handler
     struct vlc_actions *actions; ///< Hotkeys handler
+    struct vlc_slices *slices; ///< Video filter slice workers (or NULL)
 
     /* Exit callback */
     vlc_exit_t       exit;
@@ -226,4 +232,9 @@ void stats_CounterClean (counter_t * );
 void stats_ComputeInputStats(input_thread_t*, input_stats_t*);
 void stats_ReinitInputStats(input_stats_t *);
 
+/*
+ * Block allocator stuff
+ */
+void block_cache_GetStats(uint64_t *hits, uint64_t *misses, size_t *retained);
+
 #endif
@@ -0,0 +1,502 @@
+/*****************************************************************************
+ * linux/uring.c: io_uring back-end for interruptible I/O
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <linux/io_uring.h>
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include "../misc/interrupt.h"
+
+#if defined (__NR_io_uring_setup) && defined (IORING_POLL_ADD_MULTI) \
+ && defined (IORING_FEAT_RW_CUR_POS) && defined (IORING_FEAT_FAST_POLL)
+/*
+ * Each thread performing interruptible I/O gets its own small ring. Calls are
+ * synchronous: one operation is in flight at a time, and the calling thread
+ * waits for it. The gain over poll() then read() is that most operations
+ * complete within the submitting system call (data already available), and
+ * that the wake-up event is armed once per thread rather than per call.
+ *
+ * Interruption is signaled with an eventfd monitored by a multishot poll
+ * request in the ring. When it fires, the pending operation is cancelled.
+ */
+
+#define URING_ENTRIES 4
+
+enum
+{
+    URING_OP = 1, /* the I/O operation */
+    URING_WAKE,   /* the interruption event */
+    URING_CANCEL, /* cancellation request */
+};
+
+struct vlc_uring
+{
+    int fd;
+    int efd;
+    bool armed; /* whether the interruption event is being polled */
+
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+};
+
+static atomic_bool vlc_uring_ready = ATOMIC_VAR_INIT(false);
+static atomic_bool vlc_uring_broken = ATOMIC_VAR_INIT(false);
+static vlc_mutex_t vlc_uring_lock = VLC_STATIC_MUTEX;
+static vlc_threadvar_t vlc_uring_key;
+
+static int vlc_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int vlc_uring_enter(vlc_uring_t *ring, unsigned submit,
+                           unsigned wait)
+{
+    int ret;
+
+    do
+        ret = syscall(__NR_io_uring_enter, ring->fd, submit, wait,
+                      wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
+static void vlc_uring_Destroy(void *data)
+{
+    vlc_uring_t *ring = data;
+
+    if (ring->sqes != NULL)
+        munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != NULL)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring != NULL)
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->efd != -1)
+        close(ring->efd);
+    close(ring->fd);
+    free(ring);
+}
+
+/** Queues a submission (without submitting it to the kernel yet). */
+static void vlc_uring_Push(vlc_uring_t *ring, const struct io_uring_sqe *sqe)
+{
+    unsigned tail = *ring->sq_tail;
+    unsigned idx = tail & *ring->sq_mask;
+
+    assert(tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)
+           < URING_ENTRIES);
+    ring->sqes[idx] = *sqe;
+    ring->sq_array[idx] = idx;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/** Dequeues a completion if any. */
+static bool vlc_uring_Pop(vlc_uring_t *ring, struct io_uring_cqe *cqe)
+{
+    unsigned head = *ring->cq_head;
+
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+        return false;
+
+    *cqe = ring->cqes[head & *ring->cq_mask];
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static void vlc_uring_Arm(vlc_uring_t *ring)
+{
+    struct io_uring_sqe sqe = {
+        .opcode = IORING_OP_POLL_ADD,
+        .fd = ring->efd,
+        .len = IORING_POLL_ADD_MULTI,
+        .poll32_events = POLLIN,
+        .user_data = URING_WAKE,
+    };
+
+    vlc_uring_Push(ring, &sqe);
+    ring->armed = true;
+}
+
+static vlc_uring_t *vlc_uring_Create(void)
+{
+    struct io_uring_params p;
+
+    memset(&p, 0, sizeof (p));
+
+    int fd = vlc_uring_setup(URING_ENTRIES, &p);
+    if (fd == -1)
+        return NULL; /* ENOSYS, EPERM (seccomp, sysctl)... */
+
+    vlc_uring_t *ring = malloc(sizeof (*ring));
+    if (unlikely(ring == NULL))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    ring->fd = fd;
+    ring->efd = -1;
+    ring->sq_ring = ring->cq_ring = NULL;
+    ring->sqes = NULL;
+
+    const unsigned required = IORING_FEAT_RW_CUR_POS | IORING_FEAT_FAST_POLL;
+    if ((p.features & required) != required)
+    {
+        errno = ENOSYS;
+        goto error;
+    }
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ|PROT_WRITE,
+                         MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED)
+    {
+        ring->sq_ring = NULL;
+        goto error;
+    }
+
+    ring->cq_ring_size = p.cq_off.cqes
+                       + p.cq_entries * sizeof (struct io_uring_cqe);
+    ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ|PROT_WRITE,
+                         MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ring == MAP_FAILED)
+    {
+        ring->cq_ring = NULL;
+        goto error;
+    }
+
+    ring->sqes_size = p.sq_entries * sizeof (struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ|PROT_WRITE,
+                      MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        ring->sqes = NULL;
+        goto error;
+    }
+
+    char *sq = ring->sq_ring, *cq = ring->cq_ring;
+
+    ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    ring->efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (ring->efd == -1)
+        goto error;
+
+    /* Old kernels reject multishot poll requests right away. */
+    struct io_uring_cqe cqe;
+
+    vlc_uring_Arm(ring);
+    if (vlc_uring_enter(ring, 1, 0) != 1)
+        goto error;
+    if (vlc_uring_Pop(ring, &cqe) && cqe.res < 0)
+    {
+        errno = ENOSYS;
+        goto error;
+    }
+    return ring;
+
+error:
+    {
+        int err = errno;
+
+        vlc_uring_Destroy(ring);
+        errno = err;
+    }
+    return NULL;
+}
+
+/** Whether io_uring cannot be used by this process at all. */
+static bool vlc_uring_Unsupported(int err)
+{
+    return err == ENOSYS || err == EPERM;
+}
+
+vlc_uring_t *vlc_uring_Get(void)
+{
+    if (atomic_load_explicit(&vlc_uring_broken, memory_order_relaxed))
+        return NULL;
+
+    if (unlikely(!atomic_load_explicit(&vlc_uring_ready,
+                                       memory_order_acquire)))
+    {
+        vlc_mutex_lock(&vlc_uring_lock);
+        if (!atomic_load_explicit(&vlc_uring_ready, memory_order_relaxed)
+         && vlc_threadvar_create(&vlc_uring_key, vlc_uring_Destroy) == 0)
+            atomic_store_explicit(&vlc_uring_ready, true,
+                                  memory_order_release);
+        vlc_mutex_unlock(&vlc_uring_lock);
+
+        if (!atomic_load_explicit(&vlc_uring_ready, memory_order_acquire))
+            return NULL;
+    }
+
+    vlc_uring_t *ring = vlc_threadvar_get(vlc_uring_key);
+    if (ring == NULL)
+    {
+        int canc = vlc_savecancel();
+
+        ring = vlc_uring_Create();
+        if (ring == NULL)
+        {   /* Give up for good only if io_uring is unavailable to the
+             * process. Other errors (e.g. ENOMEM, EMFILE, locked memory
+             * limit) only make this call use the generic code. */
+            if (vlc_uring_Unsupported(errno))
+                atomic_store_explicit(&vlc_uring_broken, true,
+                                      memory_order_relaxed);
+        }
+        else
+        if (vlc_threadvar_set(vlc_uring_key, ring))
+        {
+            vlc_uring_Destroy(ring);
+            ring = NULL;
+        }
+        vlc_restorecancel(canc);
+    }
+    return ring;
+}
+
+void vlc_uring_Wake(vlc_uring_t *ring)
+{
+    uint64_t value = 1;
+    int canc = vlc_savecancel();
+
+    write(ring->efd, &value, sizeof (value));
+    vlc_restorecancel(canc);
+}
+
+static bool vlc_uring_Interrupted(vlc_interrupt_t *ctx)
+{
+    bool ret;
+
+    vlc_mutex_lock(&ctx->lock);
+    ret = ctx->interrupted;
+    vlc_mutex_unlock(&ctx->lock);
+    return ret;
+}
+
+/**
+ * Processes completions.
+ * @return true once the I/O operation has completed
+ */
+static bool vlc_uring_Reap(vlc_uring_t *ring, vlc_interrupt_t *ctx,
+                           bool *cancelling, ssize_t *res)
+{
+    struct io_uring_cqe cqe;
+    bool done = false;
+
+    while (vlc_uring_Pop(ring, &cqe))
+        switch (cqe.user_data)
+        {
+            case URING_OP:
+                *res = cqe.res;
+                done = true;
+                break;
+
+            case URING_WAKE:
+            {
+                uint64_t dummy;
+
+                if (!(cqe.flags & IORING_CQE_F_MORE))
+                    ring->armed = false; /* needs to be re-armed */
+                if (cqe.res < 0)
+                    break;
+
+                /* Not a cancellation point: the operation is still in
+                 * flight and uses the caller's buffers. */
+                int canc = vlc_savecancel();
+                read(ring->efd, &dummy, sizeof (dummy));
+                vlc_restorecancel(canc);
+
+                /* Ignore stale events from a previous call. */
+                if (ctx == NULL || done || *cancelling
+                 || !vlc_uring_Interrupted(ctx))
+                    break;
+
+                struct io_uring_sqe sqe = {
+                    .opcode = IORING_OP_ASYNC_CANCEL,
+                    .fd = -1,
+                    .addr = URING_OP,
+                    .user_data = URING_CANCEL,
+                };
+
+                vlc_uring_Push(ring, &sqe);
+                vlc_uring_enter(ring, 1, 0);
+                *cancelling = true;
+                break;
+            }
+        }
+
+    return done;
+}
+
+static void vlc_uring_Abort(void *data)
+{
+    vlc_uring_t *ring = data;
+    struct io_uring_sqe sqe = {
+        .opcode = IORING_OP_ASYNC_CANCEL,
+        .fd = -1,
+        .addr = URING_OP,
+        .user_data = URING_CANCEL,
+    };
+    bool cancelling = true;
+    ssize_t res = 0;
+
+    /* The kernel must not access the buffers anymore once the thread
+     * unwinds: cancel the operation and wait for it. */
+    vlc_uring_Push(ring, &sqe);
+    vlc_uring_enter(ring, 1, 0);
+
+    while (!vlc_uring_Reap(ring, NULL, &cancelling, &res))
+        vlc_uring_enter(ring, 0, 1);
+}
+
+/** Waits for completions. */
+static void vlc_uring_Wait(vlc_uring_t *ring)
+{
+    struct pollfd ufd = { .fd = ring->fd, .events = POLLIN };
+
+    vlc_cleanup_push(vlc_uring_Abort, ring);
+    poll(&ufd, 1, -1); /* cancellation point */
+    vlc_cleanup_pop();
+}
+
+ssize_t vlc_uring_Run(vlc_uring_t *ring, vlc_interrupt_t *ctx, int op,
+                      int fd, void *ptr, unsigned len, int flags)
+{
+    struct io_uring_sqe sqe = {
+        .fd = fd,
+        .addr = (uintptr_t)ptr,
+        .len = len,
+        .user_data = URING_OP,
+    };
+
+    switch (op)
+    {
+        case VLC_URING_READV:
+            sqe.opcode = IORING_OP_READV;
+            sqe.off = -1; /* current file position */
+            break;
+        case VLC_URING_WRITEV:
+            sqe.opcode = IORING_OP_WRITEV;
+            sqe.off = -1;
+            break;
+        case VLC_URING_RECVMSG:
+            sqe.opcode = IORING_OP_RECVMSG;
+            sqe.msg_flags = flags;
+            break;
+        case VLC_URING_SENDMSG:
+            sqe.opcode = IORING_OP_SENDMSG;
+            sqe.msg_flags = flags;
+            break;
+        default:
+            vlc_assert_unreachable();
+    }
+
+    unsigned submit = 1;
+    unsigned tail = *ring->sq_tail;
+    bool armed = ring->armed;
+
+    vlc_uring_Push(ring, &sqe);
+    if (!ring->armed)
+    {
+        vlc_uring_Arm(ring);
+        submit++;
+    }
+
+    if (vlc_uring_enter(ring, submit, 0) < 0)
+    {   /* Should not happen: nothing was submitted, so withdraw the queued
+         * requests and fall back to the generic code for this call. */
+        __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+        ring->armed = armed;
+        if (vlc_uring_Unsupported(errno))
+            atomic_store_explicit(&vlc_uring_broken, true,
+                                  memory_order_relaxed);
+        return -EAGAIN;
+    }
+
+    bool cancelling = false;
+    ssize_t res = 0;
+
+    while (!vlc_uring_Reap(ring, ctx, &cancelling, &res))
+        vlc_uring_Wait(ring);
+
+    /* The completion of the cancellation request, if any, is discarded by
+     * the next call. */
+    if (res == -ECANCELED)
+        res = -EINTR;
+    return res;
+}
+
+#else /* io_uring features not available at build time */
+vlc_uring_t *vlc_uring_Get(void)
+{
+    return NULL;
+}
+
+void vlc_uring_Wake(vlc_uring_t *ring)
+{
+    (void) ring;
+    vlc_assert_unreachable();
+}
+
+ssize_t vlc_uring_Run(vlc_uring_t *ring, vlc_interrupt_t *ctx, int op,
+                      int fd, void *ptr, unsigned len, int flags)
+{
+    (void) ring; (void) ctx; (void) op; (void) fd; (void) ptr; (void) len;
+    (void) flags;
+    vlc_assert_unreachable();
+}
+#endif
@@ -33,10 +33,13 @@
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <limits.h>
 
 #include <vlc_common.h>
 #include <vlc_block.h>
 #include <vlc_fs.h>
+#include <vlc_atomic.h>
+#include "libvlc.h"
 
 /**
  * @section Block handling functions.
@@ -98,14 +101,6 @@ void block_Init( block_t *restrict b, void *buf, size_t size )
 #endif
 }
 
-static void block_generic_Release (block_t *block)
-{
-    /* That is always true for blocks allocated with block_Alloc(). */
-    assert (block->p_start == (unsigned char *)(block + 1));
-    block_Invalidate (block);
-    free (block);
-}
-
 static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 {
     out->p_next    = in->p_next;
@@ -124,17 +119,287 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /** Initial reserved header and footer size. */
 #define BLOCK_PADDING      32
 
+/**
+ * @section Block recycling
+ *
+ * Blocks of common sizes are recycled instead of being returned to the heap.
+ * Allocations are rounded up to a power-of-two size class. Each thread keeps
+ * a small LIFO cache of free blocks per class, and exchanges batches of blocks
+ * with a global depot whenever its cache runs empty or full. That way, blocks
+ * allocated by one thread (e.g. the demuxer) and released by another (e.g. the
+ * decoder) are still reused, while the depot lock is only taken once per
+ * batch.
+ */
+
+/** Smallest recycled allocation is (1 << BLOCK_CACHE_MIN_SHIFT) bytes */
+#define BLOCK_CACHE_MIN_SHIFT 9
+/** Number of size classes (512 bytes to 64 KiB) */
+#define BLOCK_CACHE_CLASSES   8
+/** Maximum number of free blocks per class in a thread cache */
+#define BLOCK_CACHE_DEPTH     32
+/** Number of blocks moved at once between a thread cache and the depot */
+#define BLOCK_CACHE_BATCH     (BLOCK_CACHE_DEPTH / 2)
+/** Maximum number of bytes retained by the depot */
+#define BLOCK_DEPOT_MAX       (16 << 20)
+/** Number of cache operations between statistics updates */
+#define BLOCK_CACHE_STATS_PERIOD 256
+
+typedef struct
+{
+    block_t *free[BLOCK_CACHE_CLASSES];
+    unsigned count[BLOCK_CACHE_CLASSES];
+
+    /* Statistics not yet accounted in the global counters */
+    unsigned hits;
+    unsigned misses;
+    ssize_t retained;
+    unsigned ops;
+} block_cache_t;
+
+static vlc_mutex_t block_depot_lock = VLC_STATIC_MUTEX;
+static block_t *block_depot[BLOCK_CACHE_CLASSES];
+static size_t block_depot_bytes = 0;
+
+static vlc_threadvar_t block_cache_key;
+static atomic_bool block_cache_ready = ATOMIC_VAR_INIT(false);
+
+static atomic_uintmax_t block_cache_hits = ATOMIC_VAR_INIT(0);
+static atomic_uintmax_t block_cache_misses = ATOMIC_VAR_INIT(0);
+static atomic_intmax_t block_cache_retained = ATOMIC_VAR_INIT(0);
+
+static size_t block_cache_ClassSize (unsigned cls)
+{
+    return ((size_t)1) << (BLOCK_CACHE_MIN_SHIFT + cls);
+}
+
+/**
+ * Finds the size class of an allocation.
+ * @return the class index, or BLOCK_CACHE_CLASSES if the allocation is too
+ * large to be recycled.
+ */
+static unsigned block_cache_Class (size_t alloc)
+{
+    if (alloc > block_cache_ClassSize (BLOCK_CACHE_CLASSES - 1))
+        return BLOCK_CACHE_CLASSES;
+    if (alloc <= block_cache_ClassSize (0))
+        return 0;
+    return (sizeof (unsigned) * CHAR_BIT) - clz (alloc - 1)
+           - BLOCK_CACHE_MIN_SHIFT;
+}
+
+static void block_cache_Publish (block_cache_t *cache)
+{
+    atomic_fetch_add_explicit (&block_cache_hits, cache->hits,
+                               memory_order_relaxed);
+    atomic_fetch_add_explicit (&block_cache_misses, cache->misses,
+                               memory_order_relaxed);
+    atomic_fetch_add_explicit (&block_cache_retained, cache->retained,
+                               memory_order_relaxed);
+    cache->hits = cache->misses = 0;
+    cache->retained = 0;
+    cache->ops = 0;
+}
+
+static void block_cache_Account (block_cache_t *cache)
+{
+    if (++cache->ops >= BLOCK_CACHE_STATS_PERIOD)
+        block_cache_Publish (cache);
+}
+
+/**
+ * Moves up to max blocks of a class from a thread cache to the depot.
+ * Blocks that do not fit in the depot are freed.
+ */
+static void block_cache_Flush (block_cache_t *cache, unsigned cls,
+                               unsigned max)
+{
+    const size_t size = block_cache_ClassSize (cls);
+    block_t *list = NULL;
+
+    vlc_mutex_lock (&block_depot_lock);
+    while (max > 0 && cache->free[cls] != NULL)
+    {
+        block_t *block = cache->free[cls];
+
+        cache->free[cls] = block->p_next;
+        cache->count[cls]--;
+        max--;
+
+        if (block_depot_bytes + size <= BLOCK_DEPOT_MAX)
+        {
+            block->p_next = block_depot[cls];
+            block_depot[cls] = block;
+            block_depot_bytes += size;
+        }
+        else
+        {
+            block->p_next = list;
+            list = block;
+            cache->retained -= size;
+        }
+    }
+    vlc_mutex_unlock (&block_depot_lock);
+
+    while (list != NULL)
+    {
+        block_t *next = list->p_next;
+
+        free (list);
+        list = next;
+    }
+}
+
+/**
+ * Moves up to BLOCK_CACHE_BATCH blocks of a class from the depot to a thread
+ * cache.
+ */
+static void block_cache_Refill (block_cache_t *cache, unsigned cls)
+{
+    const size_t size = block_cache_ClassSize (cls);
+
+    vlc_mutex_lock (&block_depot_lock);
+    for (unsigned i = 0; i < BLOCK_CACHE_BATCH && block_depot[cls]; i++)
+    {
+        block_t *block = block_depot[cls];
+
+        block_depot[cls] = block->p_next;
+        block_depot_bytes -= size;
+        block->p_next = cache->free[cls];
+        cache->free[cls] = block;
+        cache->count[cls]++;
+    }
+    vlc_mutex_unlock (&block_depot_lock);
+}
+
+/**
+ * Returns all blocks of an exiting thread to the depot.
+ */
+static void block_cache_Destroy (void *data)
+{
+    block_cache_t *cache = data;
+
+    for (unsigned cls = 0; cls < BLOCK_CACHE_CLASSES; cls++)
+        block_cache_Flush (cache, cls, UINT_MAX);
+    block_cache_Publish (cache);
+    free (cache);
+}
+
+/**
+ * Gets the block cache of the calling thread, creating it if needed.
+ * @return the cache, or NULL on error (recycling is then bypassed).
+ */
+static block_cache_t *block_cache_Get (void)
+{
+    if (unlikely(!atomic_load_explicit (&block_cache_ready,
+                                        memory_order_acquire)))
+    {
+        /* The thread variable is created once and for all, since blocks
+         * may be allocated regardless of any LibVLC instance. */
+        vlc_mutex_lock (&block_depot_lock);
+        if (!atomic_load_explicit (&block_cache_ready, memory_order_relaxed)
+         && vlc_threadvar_create (&block_cache_key, block_cache_Destroy) == 0)
+            atomic_store_explicit (&block_cache_ready, true,
+                                   memory_order_release);
+        vlc_mutex_unlock (&block_depot_lock);
+
+        if (!atomic_load_explicit (&block_cache_ready, memory_order_acquire))
+            return NULL;
+    }
+
+    block_cache_t *cache = vlc_threadvar_get (block_cache_key);
+    if (unlikely(cache == NULL))
+    {
+        cache = calloc (1, sizeof (*cache));
+        if (unlikely(cache == NULL))
+            return NULL;
+        if (vlc_threadvar_set (block_cache_key, cache))
+        {
+            free (cache);
+            return NULL;
+        }
+    }
+    return cache;
+}
+
+static void block_generic_Release (block_t *block)
+{
+    /* That is always true for blocks allocated with block_Alloc(). */
+    assert (block->p_start == (unsigned char *)(block + 1));
+    block_Invalidate (block);
+    free (block);
+}
+
+static void block_cached_Release (block_t *block)
+{
+    assert (block->p_start == (unsigned char *)(block + 1));
+
+    const size_t alloc = sizeof (*block) + block->i_size;
+    const unsigned cls = block_cache_Class (alloc);
+    assert (cls < BLOCK_CACHE_CLASSES);
+    assert (alloc == block_cache_ClassSize (cls));
+
+    block_Invalidate (block);
+
+    block_cache_t *cache = block_cache_Get ();
+    if (unlikely(cache == NULL))
+    {
+        free (block);
+        return;
+    }
+
+    if (cache->count[cls] >= BLOCK_CACHE_DEPTH)
+        block_cache_Flush (cache, cls, BLOCK_CACHE_BATCH);
+
+    block->p_next = cache->free[cls];
+    cache->free[cls] = block;
+    cache->count[cls]++;
+    cache->retained += alloc;
+    block_cache_Account (cache);
+}
+
 block_t *block_Alloc (size_t size)
 {
     /* 2 * BLOCK_PADDING: pre + post padding */
-    const size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
-                       + size;
+    size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
+                 + size;
     if (unlikely(alloc <= size))
         return NULL;
 
-    block_t *b = malloc (alloc);
-    if (unlikely(b == NULL))
-        return NULL;
+    block_free_t release = block_generic_Release;
+    block_t *b = NULL;
+    const unsigned cls = block_cache_Class (alloc);
+
+    if (cls < BLOCK_CACHE_CLASSES)
+    {
+        block_cache_t *cache = block_cache_Get ();
+
+        alloc = block_cache_ClassSize (cls);
+        if (likely(cache != NULL))
+        {
+            if (cache->free[cls] == NULL)
+                block_cache_Refill (cache, cls);
+
+            b = cache->free[cls];
+            if (b != NULL)
+            {
+                cache->free[cls] = b->p_next;
+                cache->count[cls]--;
+                cache->hits++;
+                cache->retained -= alloc;
+            }
+            else
+                cache->misses++;
+            block_cache_Account (cache);
+        }
+        release = block_cached_Release;
+    }
+
+    if (b == NULL)
+    {
+        b = malloc (alloc);
+        if (unlikely(b == NULL))
+            return NULL;
+    }
 
     block_Init (b, b + 1, alloc - sizeof (*b));
     static_assert ((BLOCK_PADDING % BLOCK_ALIGN) == 0,
@@ -142,10 +407,29 @@ block_t *block_Alloc (size_t size)
     b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
     b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
     b->i_buffer = size;
-    b->pf_release = block_generic_Release;
+    b->pf_release = release;
     return b;
 }
 
+/**
+ * Retrieves the block recycling statistics.
+ * These are process-wide and lag behind by up to BLOCK_CACHE_STATS_PERIOD
+ * operations per thread.
+ *
+ * @param hits number of allocations served from recycled blocks [OUT]
+ * @param misses number of recyclable allocations served from the heap [OUT]
+ * @param retained bytes of free blocks kept for recycling [OUT]
+ */
+void block_cache_GetStats (uint64_t *hits, uint64_t *misses, size_t *retained)
+{
+    intmax_t bytes = atomic_load_explicit (&block_cache_retained,
+                                           memory_order_relaxed);
+
+    *hits = atomic_load_explicit (&block_cache_hits, memory_order_relaxed);
+    *misses = atomic_load_explicit (&block_cache_misses, memory_order_relaxed);
+    *retained = (bytes > 0) ? bytes : 0;
+}
+
 block_t *block_TryRealloc (block_t *p_block, ssize_t i_prebody, size_t i_body)
 {
     block_Check( p_block );
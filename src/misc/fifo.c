@@ -30,10 +30,21 @@
 
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include "libvlc.h"
 
 /**
  * @section Thread-safe block queue functions
+ *
+ * Blocks queued with block_FifoPut() do not go through the FIFO lock.
+ * Instead, they are pushed onto a lock-free inbox (a LIFO stack of blocks)
+ * with a single compare-and-swap, and moved to the ordered queue by whichever
+ * thread next locks the FIFO. Producers only take the lock to wake up a
+ * consumer that is actually waiting on an empty FIFO.
+ *
+ * Any number of threads may produce and consume concurrently. Everything else
+ * (vlc_fifo_*Unlocked(), counters, waiting) still happens with the lock held,
+ * so the locked API behaves as before.
  */
 
 /**
@@ -48,8 +59,54 @@ struct block_fifo_t
     block_t             **pp_last;
     size_t              i_depth;
     size_t              i_size;
+
+    atomic_uintptr_t    inbox;     /**< Lock-free blocks, newest first */
+    atomic_uint         waiters;   /**< Threads waiting for data */
 };
 
+/**
+ * Moves blocks from the lock-free inbox to the tail of a locked FIFO.
+ */
+static void vlc_fifo_Drain(block_fifo_t *fifo)
+{
+    vlc_assert_locked(&fifo->lock);
+
+    if (atomic_load_explicit(&fifo->inbox, memory_order_relaxed) == 0)
+        return;
+
+    block_t *block = (block_t *)atomic_exchange_explicit(&fifo->inbox, 0,
+                                                        memory_order_acquire);
+    block_t *list = NULL;
+
+    /* Restore the queueing order */
+    while (block != NULL)
+    {
+        block_t *next = block->p_next;
+
+        block->p_next = list;
+        list = block;
+        block = next;
+    }
+
+    assert(*(fifo->pp_last) == NULL);
+    *(fifo->pp_last) = list;
+
+    while (list != NULL)
+    {
+        fifo->pp_last = &list->p_next;
+        fifo->i_depth++;
+        fifo->i_size += list->i_buffer;
+        list = list->p_next;
+    }
+}
+
+static void vlc_fifo_WaitCleanup(void *data)
+{
+    block_fifo_t *fifo = data;
+
+    atomic_fetch_sub(&fifo->waiters, 1);
+}
+
 /**
  * Locks a block FIFO. No more than one thread can lock the FIFO at any given
  * time, and no other thread can modify the FIFO while it is locked.
@@ -64,6 +121,7 @@ struct block_fifo_t
 void vlc_fifo_Lock(vlc_fifo_t *fifo)
 {
     vlc_mutex_lock(&fifo->lock);
+    vlc_fifo_Drain(fifo);
 }
 
 /**
@@ -107,7 +165,24 @@ void vlc_fifo_Wait(vlc_fifo_t *fifo)
 
 void vlc_fifo_WaitCond(vlc_fifo_t *fifo, vlc_cond_t *condvar)
 {
-    vlc_cond_wait(condvar, &fifo->lock);
+    if (condvar != &fifo->wait)
+    {
+        vlc_cond_wait(condvar, &fifo->lock);
+        vlc_fifo_Drain(fifo);
+        return;
+    }
+
+    /* Lock-free producers only signal if they see a waiter. Conversely,
+     * do not wait if a block was pushed before the waiter was visible. */
+    atomic_fetch_add(&fifo->waiters, 1);
+    if (atomic_load(&fifo->inbox) == 0)
+    {
+        vlc_cleanup_push(vlc_fifo_WaitCleanup, fifo);
+        vlc_cond_wait(condvar, &fifo->lock);
+        vlc_cleanup_pop();
+    }
+    atomic_fetch_sub(&fifo->waiters, 1);
+    vlc_fifo_Drain(fifo);
 }
 
 /**
@@ -116,7 +191,25 @@ void vlc_fifo_WaitCond(vlc_fifo_t *fifo, vlc_cond_t *condvar)
  */
 int vlc_fifo_TimedWaitCond(vlc_fifo_t *fifo, vlc_cond_t *condvar, mtime_t deadline)
 {
-    return vlc_cond_timedwait(condvar, &fifo->lock, deadline);
+    int ret = 0;
+
+    if (condvar != &fifo->wait)
+    {
+        ret = vlc_cond_timedwait(condvar, &fifo->lock, deadline);
+        vlc_fifo_Drain(fifo);
+        return ret;
+    }
+
+    atomic_fetch_add(&fifo->waiters, 1);
+    if (atomic_load(&fifo->inbox) == 0)
+    {
+        vlc_cleanup_push(vlc_fifo_WaitCleanup, fifo);
+        ret = vlc_cond_timedwait(condvar, &fifo->lock, deadline);
+        vlc_cleanup_pop();
+    }
+    atomic_fetch_sub(&fifo->waiters, 1);
+    vlc_fifo_Drain(fifo);
+    return ret;
 }
 
 /**
@@ -166,7 +259,7 @@ size_t vlc_fifo_GetBytes(const vlc_fifo_t *fifo)
  */
 void vlc_fifo_QueueUnlocked(block_fifo_t *fifo, block_t *block)
 {
-    vlc_assert_locked(&fifo->lock);
+    vlc_fifo_Drain(fifo);
     assert(*(fifo->pp_last) == NULL);
 
     *(fifo->pp_last) = block;
@@ -197,6 +290,9 @@ block_t *vlc_fifo_DequeueUnlocked(block_fifo_t *fifo)
 {
     vlc_assert_locked(&fifo->lock);
 
+    if (fifo->p_first == NULL)
+        vlc_fifo_Drain(fifo);
+
     block_t *block = fifo->p_first;
 
     if (block == NULL)
@@ -229,7 +325,7 @@ block_t *vlc_fifo_DequeueUnlocked(block_fifo_t *fifo)
  */
 block_t *vlc_fifo_DequeueAllUnlocked(block_fifo_t *fifo)
 {
-    vlc_assert_locked(&fifo->lock);
+    vlc_fifo_Drain(fifo);
 
     block_t *block = fifo->p_first;
 
@@ -258,6 +354,8 @@ block_fifo_t *block_FifoNew( void )
     p_fifo->p_first = NULL;
     p_fifo->pp_last = &p_fifo->p_first;
     p_fifo->i_depth = p_fifo->i_size = 0;
+    atomic_init( &p_fifo->inbox, 0 );
+    atomic_init( &p_fifo->waiters, 0 );
 
     return p_fifo;
 }
@@ -269,6 +367,7 @@ block_fifo_t *block_FifoNew( void )
 void block_FifoRelease( block_fifo_t *p_fifo )
 {
     block_ChainRelease( p_fifo->p_first );
+    block_ChainRelease( (block_t *)atomic_load( &p_fifo->inbox ) );
     vlc_cond_destroy( &p_fifo->wait );
     vlc_mutex_destroy( &p_fifo->lock );
     free( p_fifo );
@@ -289,14 +388,39 @@ void block_FifoEmpty(block_fifo_t *fifo)
 
 /**
  * Immediately queue one block at the end of a FIFO.
+ * This function does not lock the FIFO unless a thread is waiting for data.
  * @param fifo queue
  * @param block head of a block list to queue (may be NULL)
  */
 void block_FifoPut(block_fifo_t *fifo, block_t *block)
 {
-    vlc_fifo_Lock(fifo);
-    vlc_fifo_QueueUnlocked(fifo, block);
-    vlc_fifo_Unlock(fifo);
+    if (block == NULL)
+        return;
+
+    /* Reverse the list, so that it can be pushed onto the inbox at once */
+    block_t *last = block, *list = NULL;
+
+    while (block != NULL)
+    {
+        block_t *next = block->p_next;
+
+        block->p_next = list;
+        list = block;
+        block = next;
+    }
+
+    uintptr_t head = atomic_load_explicit(&fifo->inbox, memory_order_relaxed);
+    do
+        last->p_next = (block_t *)head;
+    while (!atomic_compare_exchange_weak(&fifo->inbox, &head,
+                                         (uintptr_t)list));
+
+    if (atomic_load(&fifo->waiters) > 0)
+    {
+        vlc_mutex_lock(&fifo->lock);
+        vlc_fifo_Signal(fifo);
+        vlc_mutex_unlock(&fifo->lock);
+    }
 }
 
 /**
@@ -339,10 +463,10 @@ block_t *block_FifoShow( block_fifo_t *p_fifo )
 {
     block_t *b;
 
-    vlc_mutex_lock( &p_fifo->lock );
+    vlc_fifo_Lock( p_fifo );
     assert(p_fifo->p_first != NULL);
     b = p_fifo->p_first;
-    vlc_mutex_unlock( &p_fifo->lock );
+    vlc_fifo_Unlock( p_fifo );
 
     return b;
 }
@@ -352,9 +476,9 @@ size_t block_FifoSize (block_fifo_t *fifo)
 {
     size_t size;
 
-    vlc_mutex_lock (&fifo->lock);
+    vlc_fifo_Lock (fifo);
     size = fifo->i_size;
-    vlc_mutex_unlock (&fifo->lock);
+    vlc_fifo_Unlock (fifo);
     return size;
 }
 
@@ -363,8 +487,8 @@ size_t block_FifoCount (block_fifo_t *fifo)
 {
     size_t depth;
 
-    vlc_mutex_lock (&fifo->lock);
+    vlc_fifo_Lock (fifo);
     depth = fifo->i_depth;
-    vlc_mutex_unlock (&fifo->lock);
+    vlc_fifo_Unlock (fifo);
     return depth;
 }
@@ -0,0 +1,232 @@
+/*****************************************************************************
+ * filter_slices.c : slice threading of the video filters
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include <libvlc.h>
+
+/* Upper bound of the default number of threads */
+#define SLICES_MAX_THREADS 16
+
+/* One filter_RunSlices() call, on the stack of its caller */
+typedef struct slices_job_t slices_job_t;
+struct slices_job_t
+{
+    filter_t        *p_filter;
+    filter_slice_cb  pf_slice;
+    void            *opaque;
+    unsigned         i_count;
+    unsigned         i_next;   /* next slice to start */
+    unsigned         i_done;   /* finished slices */
+    slices_job_t    *p_next;
+};
+
+/* The workers of a libvlc instance, shared by all its video filters.
+ * The calling thread runs slices of its own job too, so jobs always progress
+ * even when all the workers are busy. */
+struct vlc_slices
+{
+    vlc_mutex_t   lock;
+    vlc_cond_t    wait;   /* jobs are queued or exit is requested */
+    vlc_cond_t    done;   /* a job is finished */
+    slices_job_t *p_first;
+    slices_job_t **pp_last;
+    bool          b_exit;
+
+    unsigned      i_threads;  /* workers to run */
+    unsigned      i_started;  /* workers started (lazily) */
+    vlc_thread_t  threads[];
+};
+
+/* Takes the next slice of the first queued job, with the lock held */
+static slices_job_t *SlicesTake( struct vlc_slices *p_slices, unsigned *pi_slice )
+{
+    slices_job_t *p_job = p_slices->p_first;
+
+    *pi_slice = p_job->i_next++;
+    if( p_job->i_next == p_job->i_count )
+    {
+        p_slices->p_first = p_job->p_next;
+        if( p_slices->p_first == NULL )
+            p_slices->pp_last = &p_slices->p_first;
+    }
+    return p_job;
+}
+
+static void SlicesRun( struct vlc_slices *p_slices, slices_job_t *p_job,
+                       unsigned i_slice )
+{
+    vlc_mutex_unlock( &p_slices->lock );
+    p_job->pf_slice( p_job->p_filter, p_job->opaque, i_slice, p_job->i_count );
+    vlc_mutex_lock( &p_slices->lock );
+
+    if( ++p_job->i_done == p_job->i_count )
+        vlc_cond_broadcast( &p_slices->done );
+}
+
+static void *SlicesThread( void *data )
+{
+    struct vlc_slices *p_slices = data;
+
+    vlc_mutex_lock( &p_slices->lock );
+    for( ;; )
+    {
+        while( !p_slices->b_exit && p_slices->p_first == NULL )
+            vlc_cond_wait( &p_slices->wait, &p_slices->lock );
+        if( p_slices->b_exit )
+            break;
+
+        unsigned i_slice;
+        slices_job_t *p_job = SlicesTake( p_slices, &i_slice );
+        SlicesRun( p_slices, p_job, i_slice );
+    }
+    vlc_mutex_unlock( &p_slices->lock );
+    return NULL;
+}
+
+struct vlc_slices *vlc_InitSlices( libvlc_int_t *p_libvlc )
+{
+    int64_t i_threads = var_InheritInteger( p_libvlc, "video-filter-threads" );
+    if( i_threads <= 0 )
+        i_threads = __MIN( vlc_GetCPUCount(), SLICES_MAX_THREADS );
+
+    /* The calling threads take part in the work */
+    if( i_threads <= 1 )
+        return NULL;
+    i_threads--;
+
+    struct vlc_slices *p_slices =
+        malloc( sizeof(*p_slices) + i_threads * sizeof(vlc_thread_t) );
+    if( unlikely(p_slices == NULL) )
+        return NULL;
+
+    vlc_mutex_init( &p_slices->lock );
+    vlc_cond_init( &p_slices->wait );
+    vlc_cond_init( &p_slices->done );
+    p_slices->p_first = NULL;
+    p_slices->pp_last = &p_slices->p_first;
+    p_slices->b_exit = false;
+    p_slices->i_threads = i_threads;
+    p_slices->i_started = 0;
+    return p_slices;
+}
+
+void vlc_DeinitSlices( struct vlc_slices *p_slices )
+{
+    vlc_mutex_lock( &p_slices->lock );
+    assert( p_slices->p_first == NULL );
+    p_slices->b_exit = true;
+    vlc_cond_broadcast( &p_slices->wait );
+    vlc_mutex_unlock( &p_slices->lock );
+
+    for( unsigned i = 0; i < p_slices->i_started; i++ )
+        vlc_join( p_slices->threads[i], NULL );
+
+    vlc_cond_destroy( &p_slices->done );
+    vlc_cond_destroy( &p_slices->wait );
+    vlc_mutex_destroy( &p_slices->lock );
+    free( p_slices );
+}
+
+static struct vlc_slices *filter_GetSlices( filter_t *p_filter )
+{
+    return libvlc_priv( p_filter->obj.libvlc )->slices;
+}
+
+unsigned filter_GetSliceCount( filter_t *p_filter )
+{
+    struct vlc_slices *p_slices = filter_GetSlices( p_filter );
+    unsigned i_count = 1;
+
+    if( p_slices != NULL )
+    {
+        vlc_mutex_lock( &p_slices->lock );
+        i_count += p_slices->i_threads;
+        vlc_mutex_unlock( &p_slices->lock );
+    }
+    return i_count;
+}
+
+void filter_RunSlices( filter_t *p_filter, filter_slice_cb pf_slice,
+                       void *opaque, unsigned i_slices )
+{
+    struct vlc_slices *p_slices = filter_GetSlices( p_filter );
+
+    if( p_slices != NULL && i_slices > 1 )
+    {
+        vlc_mutex_lock( &p_slices->lock );
+
+        /* Start the workers on first use, as most instances never need them */
+        while( p_slices->i_started < p_slices->i_threads )
+        {
+            if( vlc_clone( &p_slices->threads[p_slices->i_started],
+                           SlicesThread, p_slices,
+                           VLC_THREAD_PRIORITY_VIDEO ) )
+            {
+                msg_Err( p_filter, "cannot start the slice threads" );
+                p_slices->i_threads = p_slices->i_started;
+                break;
+            }
+            p_slices->i_started++;
+        }
+
+        if( p_slices->i_started > 0 )
+        {
+            slices_job_t job = {
+                .p_filter = p_filter,
+                .pf_slice = pf_slice,
+                .opaque   = opaque,
+                .i_count  = i_slices,
+                .i_next   = 0,
+                .i_done   = 0,
+                .p_next   = NULL,
+            };
+
+            *p_slices->pp_last = &job;
+            p_slices->pp_last = &job.p_next;
+            vlc_cond_broadcast( &p_slices->wait );
+
+            /* Work until all our slices are started, this also helps the
+             * older jobs still queued before ours */
+            while( job.i_next < job.i_count )
+            {
+                unsigned i_slice;
+                slices_job_t *p_job = SlicesTake( p_slices, &i_slice );
+                SlicesRun( p_slices, p_job, i_slice );
+            }
+
+            while( job.i_done < job.i_count )
+                vlc_cond_wait( &p_slices->done, &p_slices->lock );
+
+            vlc_mutex_unlock( &p_slices->lock );
+            return;
+        }
+        vlc_mutex_unlock( &p_slices->lock );
+    }
+
+    for( unsigned i = 0; i < i_slices; i++ )
+        pf_slice( p_filter, opaque, i, i_slices );
+}
@@ -464,6 +464,57 @@ int vlc_poll_i11e(struct pollfd *fds, unsigned nfds, int timeout)
 # include <sys/uio.h>
 # include <sys/socket.h>
 
+# ifdef VLC_URING
+static void vlc_uring_i11e_wake(void *opaque)
+{
+    vlc_uring_Wake(opaque);
+}
+
+/**
+ * Performs an I/O operation with io_uring if possible. This saves the
+ * poll() call, and the wake-up event is set up only once per thread.
+ * @return false if the caller shall use poll() and the plain system call.
+ */
+static bool vlc_uring_i11e(int op, int fd, void *ptr, unsigned len,
+                           int flags, ssize_t *restrict retp)
+{
+    vlc_interrupt_t *ctx = vlc_interrupt_get();
+    if (ctx == NULL)
+        return false;
+
+    vlc_uring_t *ring = vlc_uring_Get();
+    if (ring == NULL)
+        return false;
+
+    ssize_t ret;
+
+    vlc_interrupt_prepare(ctx, vlc_uring_i11e_wake, ring);
+    vlc_cleanup_push(vlc_interrupt_cleanup, ctx);
+    ret = vlc_uring_Run(ring, ctx, op, fd, ptr, len, flags);
+    vlc_cleanup_pop();
+
+    if (vlc_interrupt_finish(ctx))
+    {
+        if (ret >= 0) /* Data was transferred: report the interruption later */
+            vlc_interrupt_raise(ctx);
+        else
+            ret = -EINTR;
+    }
+
+    /* Non-blocking file: wait with poll() as usual. */
+    if (ret == -EAGAIN)
+        return false;
+
+    if (ret < 0)
+    {
+        errno = -ret;
+        ret = -1;
+    }
+    *retp = ret;
+    return true;
+}
+# endif
+
 
 /* There are currently no ways to atomically force a non-blocking read or write
  * operations. Even for sockets, the MSG_DONTWAIT flag is non-standard.
@@ -480,6 +531,12 @@ int vlc_poll_i11e(struct pollfd *fds, unsigned nfds, int timeout)
 ssize_t vlc_readv_i11e(int fd, struct iovec *iov, int count)
 {
     struct pollfd ufd;
+#ifdef VLC_URING
+    ssize_t ret;
+
+    if (vlc_uring_i11e(VLC_URING_READV, fd, iov, count, 0, &ret))
+        return ret;
+#endif
 
     ufd.fd = fd;
     ufd.events = POLLIN;
@@ -499,6 +556,13 @@ ssize_t vlc_readv_i11e(int fd, struct iovec *iov, int count)
 ssize_t vlc_writev_i11e(int fd, const struct iovec *iov, int count)
 {
     struct pollfd ufd;
+#ifdef VLC_URING
+    ssize_t ret;
+
+    if (vlc_uring_i11e(VLC_URING_WRITEV, fd, (struct iovec *)iov, count, 0,
+                       &ret))
+        return ret;
+#endif
 
     ufd.fd = fd;
     ufd.events = POLLOUT;
@@ -534,6 +598,12 @@ ssize_t vlc_write_i11e(int fd, const void *buf, size_t count)
 ssize_t vlc_recvmsg_i11e(int fd, struct msghdr *msg, int flags)
 {
     struct pollfd ufd;
+#ifdef VLC_URING
+    ssize_t ret;
+
+    if (vlc_uring_i11e(VLC_URING_RECVMSG, fd, msg, 1, flags, &ret))
+        return ret;
+#endif
 
     ufd.fd = fd;
     ufd.events = POLLIN;
@@ -565,6 +635,13 @@ ssize_t vlc_recvfrom_i11e(int fd, void *buf, size_t len, int flags,
 ssize_t vlc_sendmsg_i11e(int fd, const struct msghdr *msg, int flags)
 {
     struct pollfd ufd;
+#ifdef VLC_URING
+    ssize_t ret;
+
+    if (vlc_uring_i11e(VLC_URING_SENDMSG, fd, (struct msghdr *)msg, 1, flags,
+                       &ret))
+        return ret;
+#endif
 
     ufd.fd = fd;
     ufd.events = POLLOUT;
@@ -39,4 +39,44 @@ struct vlc_interrupt
     void (*callback)(void *);
     void *data;
 };
+
+# if defined (__linux__) && defined (HAVE_LINUX_IO_URING_H)
+#  define VLC_URING 1
+
+typedef struct vlc_uring vlc_uring_t;
+
+enum
+{
+    VLC_URING_READV,
+    VLC_URING_WRITEV,
+    VLC_URING_RECVMSG,
+    VLC_URING_SENDMSG,
+};
+
+/**
+ * Gets the io_uring instance of the calling thread, creating it if needed.
+ * @return the ring, or NULL if io_uring cannot be used.
+ */
+vlc_uring_t *vlc_uring_Get(void);
+
+/**
+ * Wakes up the thread waiting in vlc_uring_Run() (from any thread).
+ */
+void vlc_uring_Wake(vlc_uring_t *);
+
+/**
+ * Performs one I/O operation through the ring of the calling thread.
+ *
+ * The operation is cancelled if the ring is woken up while ctx is
+ * interrupted. This function is a cancellation point.
+ *
+ * @param op VLC_URING_READV or VLC_URING_WRITEV (ptr is an iovec array and
+ *           len its length), VLC_URING_RECVMSG or VLC_URING_SENDMSG (ptr is
+ *           a msghdr and flags the message flags)
+ * @return the number of bytes transferred, or a negative error number
+ * (-EINTR if the operation was cancelled).
+ */
+ssize_t vlc_uring_Run(vlc_uring_t *, vlc_interrupt_t *ctx, int op, int fd,
+                      void *ptr, unsigned len, int flags);
+# endif
 #endif
@@ -36,14 +36,22 @@
 
 static const uintptr_t pool_max = CHAR_BIT * sizeof (unsigned long long);
 
+/*
+ * The set of available pictures is an atomic bitmap. picture_pool_Get()
+ * claims a picture with a compare-and-swap on the bitmap, and releasing a
+ * picture sets its bit back. The lock and condition variable are only used
+ * by picture_pool_Wait() to sleep while the pool is empty: a releasing thread
+ * only takes the lock if it sees a waiter.
+ */
 struct picture_pool_t {
     int       (*pic_lock)(picture_t *);
     void      (*pic_unlock)(picture_t *);
     vlc_mutex_t lock;
     vlc_cond_t  wait;
 
-    bool               canceled;
-    unsigned long long available;
+    atomic_bool        canceled;
+    atomic_ullong      available;
+    atomic_uint        waiters;
     atomic_ushort      refs;
     unsigned short     picture_count;
     picture_t  *picture[];
@@ -66,6 +74,40 @@ void picture_pool_Release(picture_pool_t *pool)
     picture_pool_Destroy(pool);
 }
 
+/** Makes a picture available again, waking up a waiting thread if any. */
+static void picture_pool_Put(picture_pool_t *pool, unsigned offset)
+{
+    unsigned long long prev = atomic_fetch_or(&pool->available, 1ULL << offset);
+
+    assert(!(prev & (1ULL << offset)));
+    (void) prev;
+
+    if (atomic_load(&pool->waiters) > 0) {
+        vlc_mutex_lock(&pool->lock);
+        vlc_cond_signal(&pool->wait);
+        vlc_mutex_unlock(&pool->lock);
+    }
+}
+
+/**
+ * Claims one available picture among a set.
+ * @return the picture offset plus one, or 0 if none of the set was available
+ */
+static unsigned picture_pool_Claim(picture_pool_t *pool,
+                                   unsigned long long mask)
+{
+    unsigned long long avail = atomic_load(&pool->available);
+
+    while (avail & mask) {
+        unsigned i = ffsll(avail & mask);
+
+        if (atomic_compare_exchange_weak(&pool->available, &avail,
+                                         avail & ~(1ULL << (i - 1))))
+            return i;
+    }
+    return 0;
+}
+
 static void picture_pool_ReleasePicture(picture_t *clone)
 {
     picture_priv_t *priv = (picture_priv_t *)clone;
@@ -80,12 +122,7 @@ static void picture_pool_ReleasePicture(picture_t *clone)
         pool->pic_unlock(picture);
     picture_Release(picture);
 
-    vlc_mutex_lock(&pool->lock);
-    assert(!(pool->available & (1ULL << offset)));
-    pool->available |= 1ULL << offset;
-    vlc_cond_signal(&pool->wait);
-    vlc_mutex_unlock(&pool->lock);
-
+    picture_pool_Put(pool, offset);
     picture_pool_Destroy(pool);
 }
 
@@ -127,12 +164,13 @@ picture_pool_t *picture_pool_NewExtended(const picture_pool_configuration_t *cfg
     pool->pic_unlock = cfg->unlock;
     vlc_mutex_init(&pool->lock);
     vlc_cond_init(&pool->wait);
-    pool->available = (1ULL << cfg->picture_count) - 1;
+    atomic_init(&pool->available, (1ULL << cfg->picture_count) - 1);
+    atomic_init(&pool->waiters, 0);
     atomic_init(&pool->refs,  1);
     pool->picture_count = cfg->picture_count;
     memcpy(pool->picture, cfg->picture,
            cfg->picture_count * sizeof (picture_t *));
-    pool->canceled = false;
+    atomic_init(&pool->canceled, false);
     return pool;
 }
 
@@ -193,47 +231,39 @@ error:
     return NULL;
 }
 
-/** Find next (bit) set */
-static int fnsll(unsigned long long x, unsigned i)
+static picture_t *picture_pool_Lease(picture_pool_t *pool, unsigned offset)
 {
-    if (i >= CHAR_BIT * sizeof (x))
-        return 0;
-    return ffsll(x & ~((1ULL << i) - 1));
+    picture_t *clone = picture_pool_ClonePicture(pool, offset);
+    if (clone != NULL) {
+        assert(clone->p_next == NULL);
+        atomic_fetch_add(&pool->refs, 1);
+    }
+    return clone;
 }
 
 picture_t *picture_pool_Get(picture_pool_t *pool)
 {
-    vlc_mutex_lock(&pool->lock);
-    assert(pool->refs > 0);
+    unsigned long long mask = ~0ULL;
+    unsigned i;
 
-    if (pool->canceled)
-    {
-        vlc_mutex_unlock(&pool->lock);
+    assert(atomic_load(&pool->refs) > 0);
+
+    if (atomic_load(&pool->canceled))
         return NULL;
-    }
 
-    for (unsigned i = ffsll(pool->available); i; i = fnsll(pool->available, i))
+    while ((i = picture_pool_Claim(pool, mask)) != 0)
     {
-        pool->available &= ~(1ULL << (i - 1));
-        vlc_mutex_unlock(&pool->lock);
-
         picture_t *picture = pool->picture[i - 1];
 
         if (pool->pic_lock != NULL && pool->pic_lock(picture) != VLC_SUCCESS) {
-            vlc_mutex_lock(&pool->lock);
-            pool->available |= 1ULL << (i - 1);
+            /* Try the next pictures, not this one again */
+            mask &= ~((2ULL << (i - 1)) - 1);
+            picture_pool_Put(pool, i - 1);
             continue;
         }
 
-        picture_t *clone = picture_pool_ClonePicture(pool, i - 1);
-        if (clone != NULL) {
-            assert(clone->p_next == NULL);
-            atomic_fetch_add(&pool->refs, 1);
-        }
-        return clone;
+        return picture_pool_Lease(pool, i - 1);
     }
-
-    vlc_mutex_unlock(&pool->lock);
     return NULL;
 }
 
@@ -241,48 +271,44 @@ picture_t *picture_pool_Wait(picture_pool_t *pool)
 {
     unsigned i;
 
-    vlc_mutex_lock(&pool->lock);
-    assert(pool->refs > 0);
+    assert(atomic_load(&pool->refs) > 0);
 
-    while (pool->available == 0)
+    i = picture_pool_Claim(pool, ~0ULL);
+    if (i == 0)
     {
-        if (pool->canceled)
+        vlc_mutex_lock(&pool->lock);
+        atomic_fetch_add(&pool->waiters, 1);
+
+        while ((i = picture_pool_Claim(pool, ~0ULL)) == 0)
         {
-            vlc_mutex_unlock(&pool->lock);
-            return NULL;
+            if (atomic_load(&pool->canceled))
+                break;
+            vlc_cond_wait(&pool->wait, &pool->lock);
         }
-        vlc_cond_wait(&pool->wait, &pool->lock);
-    }
 
-    i = ffsll(pool->available);
-    assert(i > 0);
-    pool->available &= ~(1ULL << (i - 1));
-    vlc_mutex_unlock(&pool->lock);
+        atomic_fetch_sub(&pool->waiters, 1);
+        vlc_mutex_unlock(&pool->lock);
+
+        if (i == 0)
+            return NULL;
+    }
 
     picture_t *picture = pool->picture[i - 1];
 
     if (pool->pic_lock != NULL && pool->pic_lock(picture) != VLC_SUCCESS) {
-        vlc_mutex_lock(&pool->lock);
-        pool->available |= 1ULL << (i - 1);
-        vlc_cond_signal(&pool->wait);
-        vlc_mutex_unlock(&pool->lock);
+        picture_pool_Put(pool, i - 1);
         return NULL;
     }
 
-    picture_t *clone = picture_pool_ClonePicture(pool, i - 1);
-    if (clone != NULL) {
-        assert(clone->p_next == NULL);
-        atomic_fetch_add(&pool->refs, 1);
-    }
-    return clone;
+    return picture_pool_Lease(pool, i - 1);
 }
 
 void picture_pool_Cancel(picture_pool_t *pool, bool canceled)
 {
     vlc_mutex_lock(&pool->lock);
-    assert(pool->refs > 0);
+    assert(atomic_load(&pool->refs) > 0);
 
-    pool->canceled = canceled;
+    atomic_store(&pool->canceled, canceled);
     if (canceled)
         vlc_cond_broadcast(&pool->wait);
     vlc_mutex_unlock(&pool->lock);
@@ -290,16 +316,17 @@ void picture_pool_Cancel(picture_pool_t *pool, bool canceled)
 
 unsigned picture_pool_Reset(picture_pool_t *pool)
 {
-    unsigned ret;
+    unsigned long long avail;
 
     vlc_mutex_lock(&pool->lock);
-    assert(pool->refs > 0);
-    ret = pool->picture_count - popcountll(pool->available);
-    pool->available = (1ULL << pool->picture_count) - 1;
-    pool->canceled = false;
+    assert(atomic_load(&pool->refs) > 0);
+    avail = atomic_exchange(&pool->available,
+                            (1ULL << pool->picture_count) - 1);
+    atomic_store(&pool->canceled, false);
+    vlc_cond_broadcast(&pool->wait);
     vlc_mutex_unlock(&pool->lock);
 
-    return ret;
+    return pool->picture_count - popcountll(avail);
 }
 
 unsigned picture_pool_GetSize(const picture_pool_t *pool)
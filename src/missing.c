@@ -164,6 +164,13 @@ int httpd_StreamSend (httpd_stream_t *stream, const block_t *p_block)
     vlc_assert_unreachable ();
 }
 
+void httpd_StreamSetBuffer (httpd_stream_t *stream, size_t size,
+                            enum httpd_stream_slow slow)
+{
+    (void) stream; (void) size; (void) slow;
+    vlc_assert_unreachable ();
+}
+
 int httpd_StreamSetHTTPHeaders (httpd_stream_t * stream,
                                 httpd_header * headers,
                                 size_t i_headers)
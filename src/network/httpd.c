@@ -40,6 +40,7 @@
 #include <vlc_url.h>
 #include <vlc_mime.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include "../libvlc.h"
 
 #include <string.h>
@@ -49,6 +50,9 @@
 #ifdef HAVE_POLL
 # include <poll.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 
 #if defined(_WIN32)
 #   include <winsock2.h>
@@ -64,9 +68,27 @@
 #endif
 
 static void httpd_ClientDestroy(httpd_client_t *cl);
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data);
+static ssize_t httpd_NetSendv(httpd_client_t *cl, const struct iovec *iov,
+                              unsigned count);
+
+/* each host is served by one or more worker threads: a client belongs to
+ * the worker which accepted it, and is only ever touched with its lock */
+typedef struct
+{
+    httpd_host_t *host;
+
+    vlc_thread_t thread;
+    vlc_mutex_t  lock;
+
+    int            i_client;
+    httpd_client_t **client;
+
+    mtime_t      i_next_check; /* date of the next check of all clients */
+#ifdef HAVE_SYS_EPOLL_H
+    int          epfd;
+#endif
+} httpd_worker_t;
 
-/* each host run in his own thread */
 struct httpd_host_t
 {
     VLC_COMMON_MEMBERS
@@ -79,7 +101,10 @@ struct httpd_host_t
     unsigned     nfd;
     unsigned     port;
 
-    vlc_thread_t thread;
+    unsigned        i_worker;
+    httpd_worker_t *worker;
+
+    /* protects i_ref and the url table (lock order: worker, then host) */
     vlc_mutex_t lock;
     vlc_cond_t  wait;
 
@@ -90,9 +115,6 @@ struct httpd_host_t
     int         i_url;
     httpd_url_t **url;
 
-    int            i_client;
-    httpd_client_t **client;
-
     /* TLS data */
     vlc_tls_creds_t *p_tls;
 };
@@ -158,9 +180,27 @@ struct httpd_client_t
     int     i_buffer;
     uint8_t *p_buffer;
 
+    /* data received after the current request (pipelining) */
+    uint8_t *p_pending;
+    size_t  i_pending;
+
+    /* events the client is being polled for */
+    short   i_events;
+
+    /* stream being sent straight from its blocks, if any */
+    httpd_stream_t *stream;
+    uint64_t i_stream_seq;      /* stream block being sent */
+    size_t   i_stream_offset;   /* bytes of that block already sent */
+
+    /* stream client statistics */
+    uint64_t i_stream_skipped;  /* bytes lost for being too slow */
+    unsigned i_stream_skips;
+    unsigned i_stream_stalls;   /* sends that could not complete */
+    int64_t  i_stream_lag_max;  /* largest distance behind the stream */
+
     /*
-     * If waiting for a keyframe, this is the position (in bytes) of the
-     * last keyframe the stream saw before this client connected.
+     * If waiting for a keyframe, this is the sequence number of the
+     * last keyframe block the stream saw before this client connected.
      * Otherwise, -1.
      */
     int64_t i_keyframe_wait_to_pass;
@@ -592,6 +632,23 @@ void httpd_RedirectDelete(httpd_redirect_t *rdir)
 /*****************************************************************************
  * High Level Funtions: httpd_stream_t
  *****************************************************************************/
+/* A stream block, shared by the ring and the clients being sent it */
+typedef struct
+{
+    atomic_uint refs;
+    int64_t     i_pos;      /* absolute position of the block in the stream */
+    block_t    *block;
+} httpd_chunk_t;
+
+static void httpd_ChunkRelease(httpd_chunk_t *chunk)
+{
+    if (atomic_fetch_sub_explicit(&chunk->refs, 1, memory_order_acq_rel) == 1)
+    {
+        block_Release(chunk->block);
+        free(chunk);
+    }
+}
+
 struct httpd_stream_t
 {
     vlc_mutex_t lock;
@@ -607,21 +664,32 @@ struct httpd_stream_t
      * as keyframes, to ensure that the stream starts with one.
      * (This is particularly important for WebM streaming to certain
      * browsers.) Store if we've ever seen any such keyframe blocks,
-     * and if so, the byte position of the start of the last one. */
+     * and if so, the sequence number of the last one. */
     bool        b_has_keyframes;
-    int64_t     i_last_keyframe_seen_pos;
-
-    /* circular buffer */
-    int         i_buffer_size;      /* buffer size, can't be reallocated smaller */
-    uint8_t     *p_buffer;          /* buffer */
+    uint64_t    i_last_keyframe_seq;
+
+    /* ring of the latest blocks, indexed by sequence number: clients keep
+     * their own position in it and send straight from the blocks */
+    httpd_chunk_t **ring;
+    size_t      i_ring_size;        /* allocated entries, a power of 2 */
+    uint64_t    i_first_seq;        /* oldest block */
+    uint64_t    i_next_seq;         /* a new block will get that */
+    size_t      i_ring_bytes;       /* data in the ring */
+    size_t      i_ring_depth;       /* maximum data in the ring */
+    int         i_slow;             /* what to do with too slow clients */
     int64_t     i_buffer_pos;       /* absolute position from beginning */
-    int64_t     i_buffer_last_pos;  /* a new connection will start with that */
 
     /* custom headers */
     size_t        i_http_headers;
     httpd_header * p_http_headers;
 };
 
+static httpd_chunk_t *httpd_StreamChunk(httpd_stream_t *stream, uint64_t seq)
+{
+    assert(seq >= stream->i_first_seq && seq < stream->i_next_seq);
+    return stream->ring[seq & (stream->i_ring_size - 1)];
+}
+
 static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
                                  httpd_client_t *cl, httpd_message_t *answer,
                                  const httpd_message_t *query)
@@ -631,117 +699,205 @@ static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
     if (!answer || !query || !cl)
         return VLC_SUCCESS;
 
-    if (answer->i_body_offset > 0) {
-        int     i_pos;
+    assert(answer->i_body_offset == 0);
 
-        if (answer->i_body_offset >= stream->i_buffer_pos)
-            return VLC_EGENERIC;    /* wait, no data available */
+    answer->i_proto  = HTTPD_PROTO_HTTP;
+    answer->i_version= 0;
+    answer->i_type   = HTTPD_MSG_ANSWER;
 
-        if (cl->i_keyframe_wait_to_pass >= 0) {
-            if (stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass)
-                /* still waiting for the next keyframe */
-                return VLC_EGENERIC;
+    answer->i_status = 200;
 
-            /* seek to the new keyframe */
-            answer->i_body_offset = stream->i_last_keyframe_seen_pos;
-            cl->i_keyframe_wait_to_pass = -1;
+    bool b_has_content_type = false;
+    bool b_has_cache_control = false;
+
+    vlc_mutex_lock(&stream->lock);
+    for (size_t i = 0; i < stream->i_http_headers; i++)
+        if (strncasecmp(stream->p_http_headers[i].name, "Content-Length", 14)) {
+            httpd_MsgAdd(answer, stream->p_http_headers[i].name, "%s",
+                          stream->p_http_headers[i].value);
+
+            if (!strncasecmp(stream->p_http_headers[i].name, "Content-Type", 12))
+                b_has_content_type = true;
+            else if (!strncasecmp(stream->p_http_headers[i].name, "Cache-Control", 13))
+                b_has_cache_control = true;
         }
+    vlc_mutex_unlock(&stream->lock);
 
-        if (answer->i_body_offset + stream->i_buffer_size < stream->i_buffer_pos)
-            answer->i_body_offset = stream->i_buffer_last_pos; /* this client isn't fast enough */
+    if (query->i_type != HTTPD_MSG_HEAD) {
+        cl->b_stream_mode = true;
+        vlc_mutex_lock(&stream->lock);
+        /* Send the header */
+        if (stream->i_header > 0) {
+            answer->i_body = stream->i_header;
+            answer->p_body = xmalloc(stream->i_header);
+            memcpy(answer->p_body, stream->p_header, stream->i_header);
+        }
+        /* a new connection starts with the latest block */
+        if (stream->i_next_seq > stream->i_first_seq) {
+            cl->i_stream_seq = stream->i_next_seq - 1;
+            answer->i_body_offset = httpd_StreamChunk(stream,
+                                                      cl->i_stream_seq)->i_pos;
+        } else {
+            cl->i_stream_seq = stream->i_next_seq;
+            answer->i_body_offset = stream->i_buffer_pos;
+        }
+        cl->i_stream_offset = 0;
+        if (stream->b_has_keyframes)
+            cl->i_keyframe_wait_to_pass = stream->i_last_keyframe_seq;
+        else
+            cl->i_keyframe_wait_to_pass = -1;
+        vlc_mutex_unlock(&stream->lock);
+    } else {
+        httpd_MsgAdd(answer, "Content-Length", "0");
+        answer->i_body_offset = 0;
+    }
 
-        i_pos   = answer->i_body_offset % stream->i_buffer_size;
-        int64_t i_write = stream->i_buffer_pos - answer->i_body_offset;
+    /* FIXME: move to http access_output */
+    if (!strcmp(stream->psz_mime, "video/x-ms-asf-stream")) {
+        bool b_xplaystream = false;
 
-        if (i_write > HTTPD_CL_BUFSIZE)
-            i_write = HTTPD_CL_BUFSIZE;
-        else if (i_write <= 0)
-            return VLC_EGENERIC;    /* wait, no data available */
+        httpd_MsgAdd(answer, "Content-type", "application/octet-stream");
+        httpd_MsgAdd(answer, "Server", "Cougar 4.1.0.3921");
+        httpd_MsgAdd(answer, "Pragma", "no-cache");
+        httpd_MsgAdd(answer, "Pragma", "client-id=%lu",
+                      vlc_mrand48()&0x7fff);
+        httpd_MsgAdd(answer, "Pragma", "features=\"broadcast\"");
 
-        /* Don't go past the end of the circular buffer */
-        i_write = __MIN(i_write, stream->i_buffer_size - i_pos);
+        /* Check if there is a xPlayStrm=1 */
+        for (size_t i = 0; i < query->i_headers; i++)
+            if (!strcasecmp(query->p_headers[i].name,  "Pragma") &&
+                strstr(query->p_headers[i].value, "xPlayStrm=1"))
+                b_xplaystream = true;
 
-        /* using HTTPD_MSG_ANSWER -> data available */
-        answer->i_proto  = HTTPD_PROTO_HTTP;
-        answer->i_version= 0;
-        answer->i_type   = HTTPD_MSG_ANSWER;
+        if (!b_xplaystream)
+            answer->i_body_offset = 0;
+    } else if (!b_has_content_type)
+        httpd_MsgAdd(answer, "Content-type", "%s", stream->psz_mime);
 
-        answer->i_body = i_write;
-        answer->p_body = xmalloc(i_write);
-        memcpy(answer->p_body, &stream->p_buffer[i_pos], i_write);
+    if (!b_has_cache_control)
+        httpd_MsgAdd(answer, "Cache-Control", "no-cache");
 
-        answer->i_body_offset += i_write;
+    /* the data will be sent from the stream buffer by httpd_StreamSendData() */
+    cl->stream = (answer->i_body_offset > 0) ? stream : NULL;
+    return VLC_SUCCESS;
+}
 
-        return VLC_SUCCESS;
-    } else {
-        answer->i_proto  = HTTPD_PROTO_HTTP;
-        answer->i_version= 0;
-        answer->i_type   = HTTPD_MSG_ANSWER;
+/* Maximum number of blocks sent at once */
+#define HTTPD_STREAM_IOV 16
 
-        answer->i_status = 200;
+/**
+ * Sends pending stream data to a client, straight from the shared blocks.
+ * The client is set dead on error.
+ * @return the number of bytes sent, 0 if no data is available,
+ *         -1 if the data could not be sent
+ */
+static ssize_t httpd_StreamSendData(httpd_stream_t *stream, httpd_client_t *cl)
+{
+    httpd_message_t *answer = &cl->answer;
+    httpd_chunk_t *chunks[HTTPD_STREAM_IOV];
+    struct iovec iov[HTTPD_STREAM_IOV];
+    unsigned count = 0;
+    size_t i_total = 0;
+    bool b_close = false;
+    int64_t i_lag = 0;
 
-        bool b_has_content_type = false;
-        bool b_has_cache_control = false;
+    vlc_mutex_lock(&stream->lock);
+    if (cl->i_keyframe_wait_to_pass >= 0) {
+        if (stream->i_last_keyframe_seq <= (uint64_t)cl->i_keyframe_wait_to_pass)
+            /* still waiting for the next keyframe */
+            goto out;
+
+        /* seek to the new keyframe */
+        if (stream->i_last_keyframe_seq >= stream->i_first_seq) {
+            cl->i_stream_seq = stream->i_last_keyframe_seq;
+            cl->i_stream_offset = 0;
+            answer->i_body_offset =
+                httpd_StreamChunk(stream, cl->i_stream_seq)->i_pos;
+        }
+        cl->i_keyframe_wait_to_pass = -1;
+    }
 
-        vlc_mutex_lock(&stream->lock);
-        for (size_t i = 0; i < stream->i_http_headers; i++)
-            if (strncasecmp(stream->p_http_headers[i].name, "Content-Length", 14)) {
-                httpd_MsgAdd(answer, stream->p_http_headers[i].name, "%s",
-                              stream->p_http_headers[i].value);
-
-                if (!strncasecmp(stream->p_http_headers[i].name, "Content-Type", 12))
-                    b_has_content_type = true;
-                else if (!strncasecmp(stream->p_http_headers[i].name, "Cache-Control", 13))
-                    b_has_cache_control = true;
-            }
-        vlc_mutex_unlock(&stream->lock);
+    if (stream->i_buffer_pos - answer->i_body_offset > cl->i_stream_lag_max)
+        cl->i_stream_lag_max = stream->i_buffer_pos - answer->i_body_offset;
 
-        if (query->i_type != HTTPD_MSG_HEAD) {
-            cl->b_stream_mode = true;
-            vlc_mutex_lock(&stream->lock);
-            /* Send the header */
-            if (stream->i_header > 0) {
-                answer->i_body = stream->i_header;
-                answer->p_body = xmalloc(stream->i_header);
-                memcpy(answer->p_body, stream->p_header, stream->i_header);
-            }
-            answer->i_body_offset = stream->i_buffer_last_pos;
-            if (stream->b_has_keyframes)
-                cl->i_keyframe_wait_to_pass = stream->i_last_keyframe_seen_pos;
-            else
-                cl->i_keyframe_wait_to_pass = -1;
-            vlc_mutex_unlock(&stream->lock);
-        } else {
-            httpd_MsgAdd(answer, "Content-Length", "0");
-            answer->i_body_offset = 0;
+    if (cl->i_stream_seq < stream->i_first_seq) {
+        /* this client isn't fast enough: its data was dropped already */
+        if (stream->i_slow == HTTPD_STREAM_SLOW_CLOSE) {
+            i_lag = stream->i_buffer_pos - answer->i_body_offset;
+            b_close = true;
+            goto out;
         }
 
-        /* FIXME: move to http access_output */
-        if (!strcmp(stream->psz_mime, "video/x-ms-asf-stream")) {
-            bool b_xplaystream = false;
-
-            httpd_MsgAdd(answer, "Content-type", "application/octet-stream");
-            httpd_MsgAdd(answer, "Server", "Cougar 4.1.0.3921");
-            httpd_MsgAdd(answer, "Pragma", "no-cache");
-            httpd_MsgAdd(answer, "Pragma", "client-id=%lu",
-                          vlc_mrand48()&0x7fff);
-            httpd_MsgAdd(answer, "Pragma", "features=\"broadcast\"");
-
-            /* Check if there is a xPlayStrm=1 */
-            for (size_t i = 0; i < query->i_headers; i++)
-                if (!strcasecmp(query->p_headers[i].name,  "Pragma") &&
-                    strstr(query->p_headers[i].value, "xPlayStrm=1"))
-                    b_xplaystream = true;
-
-            if (!b_xplaystream)
-                answer->i_body_offset = 0;
-        } else if (!b_has_content_type)
-            httpd_MsgAdd(answer, "Content-type", "%s", stream->psz_mime);
-
-        if (!b_has_cache_control)
-            httpd_MsgAdd(answer, "Cache-Control", "no-cache");
-        return VLC_SUCCESS;
+        /* resume from the latest keyframe if any, or the latest block */
+        if (stream->b_has_keyframes
+         && stream->i_last_keyframe_seq >= stream->i_first_seq)
+            cl->i_stream_seq = stream->i_last_keyframe_seq;
+        else
+            cl->i_stream_seq = stream->i_next_seq - 1;
+        cl->i_stream_offset = 0;
+
+        int64_t i_pos = httpd_StreamChunk(stream, cl->i_stream_seq)->i_pos;
+
+        cl->i_stream_skipped += i_pos - answer->i_body_offset;
+        cl->i_stream_skips++;
+        answer->i_body_offset = i_pos;
+    }
+
+    /* hold the blocks to send, so that the lock is not held while sending */
+    for (uint64_t seq = cl->i_stream_seq;
+         seq < stream->i_next_seq && count < HTTPD_STREAM_IOV; seq++) {
+        httpd_chunk_t *chunk = httpd_StreamChunk(stream, seq);
+        size_t i_skip = (count == 0) ? cl->i_stream_offset : 0;
+
+        atomic_fetch_add_explicit(&chunk->refs, 1, memory_order_relaxed);
+        chunks[count] = chunk;
+        iov[count].iov_base = chunk->block->p_buffer + i_skip;
+        iov[count].iov_len = chunk->block->i_buffer - i_skip;
+        i_total += iov[count].iov_len;
+        count++;
+    }
+out:
+    vlc_mutex_unlock(&stream->lock);
+
+    if (b_close) {
+        msg_Warn(stream->url->host, "closing too slow client (%"PRId64
+                 " bytes behind)", i_lag);
+        cl->i_state = HTTPD_CLIENT_DEAD;
+        return -1;
+    }
+    if (count == 0)
+        return 0;    /* wait, no data available */
+
+    ssize_t val = httpd_NetSendv(cl, iov, count);
+
+    if (val >= 0) {
+        size_t i_left = val;
+
+        answer->i_body_offset += val;
+        for (unsigned i = 0; i < count && i_left > 0; i++) {
+            if (i_left < iov[i].iov_len) {
+                cl->i_stream_offset += i_left;
+                break;
+            }
+            i_left -= iov[i].iov_len;
+            cl->i_stream_seq++;
+            cl->i_stream_offset = 0;
+        }
+        if ((size_t)val < i_total)
+            cl->i_stream_stalls++;
     }
+#if defined(_WIN32)
+    else if (WSAGetLastError() == WSAEWOULDBLOCK)
+#else
+    else if (errno == EAGAIN)
+#endif
+        cl->i_stream_stalls++;
+    else
+        cl->i_state = HTTPD_CLIENT_DEAD;
+
+    for (unsigned i = 0; i < count; i++)
+        httpd_ChunkRelease(chunks[i]);
+    return val;
 }
 
 httpd_stream_t *httpd_StreamNew(httpd_host_t *host,
@@ -765,14 +921,18 @@ httpd_stream_t *httpd_StreamNew(httpd_host_t *host,
 
     stream->i_header = 0;
     stream->p_header = NULL;
-    stream->i_buffer_size = 5000000;    /* 5 Mo per stream */
-    stream->p_buffer = xmalloc(stream->i_buffer_size);
+    stream->i_ring_size = 256;
+    stream->ring = xmalloc(stream->i_ring_size * sizeof (*stream->ring));
+    stream->i_first_seq = 0;
+    stream->i_next_seq = 0;
+    stream->i_ring_bytes = 0;
+    stream->i_ring_depth = 5000000;    /* 5 Mo per stream */
+    stream->i_slow = HTTPD_STREAM_SLOW_SKIP;
     /* We set to 1 to make life simpler
      * (this way i_body_offset can never be 0) */
     stream->i_buffer_pos = 1;
-    stream->i_buffer_last_pos = 1;
     stream->b_has_keyframes = false;
-    stream->i_last_keyframe_seen_pos = 0;
+    stream->i_last_keyframe_seq = 0;
     stream->i_http_headers = 0;
     stream->p_http_headers = NULL;
 
@@ -802,45 +962,76 @@ int httpd_StreamHeader(httpd_stream_t *stream, uint8_t *p_data, int i_data)
     return VLC_SUCCESS;
 }
 
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data)
+int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
 {
-    int i_pos = stream->i_buffer_pos % stream->i_buffer_size;
-    int i_count = i_data;
-    while (i_count > 0) {
-        int i_copy = __MIN(i_count, stream->i_buffer_size - i_pos);
+    if (!p_block || !p_block->p_buffer || p_block->i_buffer == 0)
+        return VLC_SUCCESS;
 
-        /* Ok, we can't go past the end of our buffer */
-        memcpy(&stream->p_buffer[i_pos], p_data, i_copy);
+    /* The data is copied once, then shared by all clients */
+    httpd_chunk_t *chunk = malloc(sizeof (*chunk));
+    if (unlikely(chunk == NULL))
+        return VLC_ENOMEM;
 
-        i_pos = (i_pos + i_copy) % stream->i_buffer_size;
-        i_count -= i_copy;
-        p_data  += i_copy;
+    chunk->block = block_Duplicate((block_t *)p_block);
+    if (unlikely(chunk->block == NULL)) {
+        free(chunk);
+        return VLC_ENOMEM;
     }
-
-    stream->i_buffer_pos += i_data;
-}
-
-int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
-{
-    if (!p_block || !p_block->p_buffer)
-        return VLC_SUCCESS;
+    atomic_init(&chunk->refs, 1);
 
     vlc_mutex_lock(&stream->lock);
 
-    /* save this pointer (to be used by new connection) */
-    stream->i_buffer_last_pos = stream->i_buffer_pos;
+    if (stream->i_next_seq - stream->i_first_seq == stream->i_ring_size) {
+        /* the ring is full of (small) blocks: grow it */
+        size_t i_size = 2 * stream->i_ring_size;
+        httpd_chunk_t **ring = malloc(i_size * sizeof (*ring));
+
+        if (unlikely(ring == NULL)) {
+            vlc_mutex_unlock(&stream->lock);
+            httpd_ChunkRelease(chunk);
+            return VLC_ENOMEM;
+        }
+        for (uint64_t seq = stream->i_first_seq; seq < stream->i_next_seq;
+             seq++)
+            ring[seq & (i_size - 1)] = httpd_StreamChunk(stream, seq);
+        free(stream->ring);
+        stream->ring = ring;
+        stream->i_ring_size = i_size;
+    }
 
     if (p_block->i_flags & BLOCK_FLAG_TYPE_I) {
         stream->b_has_keyframes = true;
-        stream->i_last_keyframe_seen_pos = stream->i_buffer_pos;
+        stream->i_last_keyframe_seq = stream->i_next_seq;
     }
 
-    httpd_AppendData(stream, p_block->p_buffer, p_block->i_buffer);
+    chunk->i_pos = stream->i_buffer_pos;
+    stream->ring[stream->i_next_seq & (stream->i_ring_size - 1)] = chunk;
+    stream->i_next_seq++;
+    stream->i_ring_bytes += p_block->i_buffer;
+    stream->i_buffer_pos += p_block->i_buffer;
+
+    /* drop the oldest blocks, clients still sending them hold a reference */
+    while (stream->i_ring_bytes > stream->i_ring_depth
+        && stream->i_next_seq - stream->i_first_seq > 1) {
+        chunk = httpd_StreamChunk(stream, stream->i_first_seq);
+        stream->i_first_seq++;
+        stream->i_ring_bytes -= chunk->block->i_buffer;
+        httpd_ChunkRelease(chunk);
+    }
 
     vlc_mutex_unlock(&stream->lock);
     return VLC_SUCCESS;
 }
 
+void httpd_StreamSetBuffer(httpd_stream_t *stream, size_t i_size,
+                           enum httpd_stream_slow i_slow)
+{
+    vlc_mutex_lock(&stream->lock);
+    stream->i_ring_depth = i_size;
+    stream->i_slow = i_slow;
+    vlc_mutex_unlock(&stream->lock);
+}
+
 void httpd_StreamDelete(httpd_stream_t *stream)
 {
     httpd_UrlDelete(stream->url);
@@ -852,14 +1043,16 @@ void httpd_StreamDelete(httpd_stream_t *stream)
     vlc_mutex_destroy(&stream->lock);
     free(stream->psz_mime);
     free(stream->p_header);
-    free(stream->p_buffer);
+    for (uint64_t seq = stream->i_first_seq; seq < stream->i_next_seq; seq++)
+        httpd_ChunkRelease(httpd_StreamChunk(stream, seq));
+    free(stream->ring);
     free(stream);
 }
 
 /*****************************************************************************
  * Low level
  *****************************************************************************/
-static void* httpd_HostThread(void *);
+static void* httpd_WorkerThread(void *);
 static httpd_host_t *httpd_HostCreate(vlc_object_t *, const char *,
                                        const char *, vlc_tls_creds_t *);
 
@@ -898,6 +1091,68 @@ httpd_host_t *vlc_rtsp_HostNew(vlc_object_t *p_this)
     return httpd_HostCreate(p_this, "rtsp-host", "rtsp-port", NULL);
 }
 
+static int httpd_WorkerStart(httpd_host_t *host, httpd_worker_t *w)
+{
+    w->host = host;
+    w->i_client = 0;
+    w->client = NULL;
+    w->i_next_check = 0;
+
+#ifdef HAVE_SYS_EPOLL_H
+    w->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (w->epfd == -1)
+        return -1;
+
+    for (unsigned i = 0; i < host->nfd; i++) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+# ifdef EPOLLEXCLUSIVE
+        /* wake only one worker up per new connection */
+        ev.events |= EPOLLEXCLUSIVE;
+# endif
+        if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, host->fds[i], &ev)) {
+            close(w->epfd);
+            return -1;
+        }
+    }
+#endif
+
+    vlc_mutex_init(&w->lock);
+    if (vlc_clone(&w->thread, httpd_WorkerThread, w,
+                  VLC_THREAD_PRIORITY_LOW)) {
+        vlc_mutex_destroy(&w->lock);
+#ifdef HAVE_SYS_EPOLL_H
+        close(w->epfd);
+#endif
+        return -1;
+    }
+    return 0;
+}
+
+static void httpd_WorkersStop(httpd_host_t *host)
+{
+    for (unsigned i = 0; i < host->i_worker; i++)
+        vlc_cancel(host->worker[i].thread);
+
+    for (unsigned i = 0; i < host->i_worker; i++) {
+        httpd_worker_t *w = &host->worker[i];
+
+        vlc_join(w->thread, NULL);
+
+        for (int j = 0; j < w->i_client; j++) {
+            msg_Warn(host, "client still connected");
+            httpd_ClientDestroy(w->client[j]);
+        }
+        TAB_CLEAN(w->i_client, w->client);
+#ifdef HAVE_SYS_EPOLL_H
+        close(w->epfd);
+#endif
+        vlc_mutex_destroy(&w->lock);
+    }
+    free(host->worker);
+    host->worker = NULL;
+    host->i_worker = 0;
+}
+
 static struct httpd
 {
     vlc_mutex_t  mutex;
@@ -959,6 +1214,8 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     vlc_mutex_init(&host->lock);
     vlc_cond_init(&host->wait);
     host->i_ref = 1;
+    host->i_worker = 0;
+    host->worker = NULL;
 
     host->fds = net_ListenTCP(p_this, url.psz_host, port);
     if (!host->fds) {
@@ -970,16 +1227,22 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     host->port     = port;
     host->i_url    = 0;
     host->url      = NULL;
-    host->i_client = 0;
-    host->client   = NULL;
     host->p_tls    = p_tls;
 
-    /* create the thread */
-    if (vlc_clone(&host->thread, httpd_HostThread, host,
-                   VLC_THREAD_PRIORITY_LOW)) {
-        msg_Err(p_this, "cannot spawn http host thread");
+    /* create the threads */
+    unsigned threads = var_InheritInteger(p_this, "http-threads");
+
+    host->worker = malloc(__MAX(threads, 1u) * sizeof (*host->worker));
+    if (unlikely(host->worker == NULL))
         goto error;
-    }
+
+    do {
+        if (httpd_WorkerStart(host, &host->worker[host->i_worker])) {
+            msg_Err(p_this, "cannot spawn http host thread");
+            goto error;
+        }
+        host->i_worker++;
+    } while (host->i_worker < threads);
 
     /* now add it to httpd */
     TAB_APPEND(httpd.i_host, httpd.host, host);
@@ -993,6 +1256,7 @@ error:
     vlc_mutex_unlock(&httpd.mutex);
 
     if (host) {
+        httpd_WorkersStop(host);
         net_ListenClose(host->fds);
         vlc_cond_destroy(&host->wait);
         vlc_mutex_destroy(&host->lock);
@@ -1024,20 +1288,13 @@ void httpd_HostDelete(httpd_host_t *host)
     }
     TAB_REMOVE(httpd.i_host, httpd.host, host);
 
-    vlc_cancel(host->thread);
-    vlc_join(host->thread, NULL);
+    httpd_WorkersStop(host);
 
     msg_Dbg(host, "HTTP host removed");
 
     for (int i = 0; i < host->i_url; i++)
         msg_Err(host, "url still registered: %s", host->url[i]->psz_url);
 
-    for (int i = 0; i < host->i_client; i++) {
-        msg_Warn(host, "client still connected");
-        httpd_ClientDestroy(host->client[i]);
-    }
-    TAB_CLEAN(host->i_client, host->client);
-
     vlc_tls_Delete(host->p_tls);
     net_ListenClose(host->fds);
     vlc_cond_destroy(&host->wait);
@@ -1100,26 +1357,34 @@ void httpd_UrlDelete(httpd_url_t *url)
 
     vlc_mutex_lock(&host->lock);
     TAB_REMOVE(host->i_url, host->url, url);
+    vlc_mutex_unlock(&host->lock);
 
-    vlc_mutex_destroy(&url->lock);
-    free(url->psz_url);
-    free(url->psz_user);
-    free(url->psz_password);
+    /* Clients are destroyed by their worker thread, which may be waiting for
+     * events on them. Once marked dead, they do not use the url anymore. */
+    for (unsigned i = 0; i < host->i_worker; i++) {
+        httpd_worker_t *w = &host->worker[i];
 
-    for (int i = 0; i < host->i_client; i++) {
-        httpd_client_t *client = host->client[i];
+        vlc_mutex_lock(&w->lock);
+        for (int j = 0; j < w->i_client; j++) {
+            httpd_client_t *client = w->client[j];
 
-        if (client->url != url)
-            continue;
+            if (client->url != url)
+                continue;
 
-        /* TODO complete it */
-        msg_Warn(host, "force closing connections");
-        TAB_REMOVE(host->i_client, host->client, client);
-        httpd_ClientDestroy(client);
-        i--;
+            /* TODO complete it */
+            msg_Warn(host, "force closing connections");
+            client->url = NULL;
+            client->stream = NULL;
+            client->i_state = HTTPD_CLIENT_DEAD;
+        }
+        vlc_mutex_unlock(&w->lock);
     }
+
+    vlc_mutex_destroy(&url->lock);
+    free(url->psz_url);
+    free(url->psz_user);
+    free(url->psz_password);
     free(url);
-    vlc_mutex_unlock(&host->lock);
 }
 
 static void httpd_MsgInit(httpd_message_t *msg)
@@ -1199,6 +1464,16 @@ static void httpd_ClientInit(httpd_client_t *cl, mtime_t now)
     cl->i_buffer_size = HTTPD_CL_BUFSIZE;
     cl->i_buffer = 0;
     cl->p_buffer = xmalloc(cl->i_buffer_size);
+    cl->p_pending = NULL;
+    cl->i_pending = 0;
+    cl->i_events = 0;
+    cl->stream = NULL;
+    cl->i_stream_seq = 0;
+    cl->i_stream_offset = 0;
+    cl->i_stream_skipped = 0;
+    cl->i_stream_skips = 0;
+    cl->i_stream_stalls = 0;
+    cl->i_stream_lag_max = 0;
     cl->i_keyframe_wait_to_pass = -1;
     cl->b_stream_mode = false;
 
@@ -1226,6 +1501,7 @@ static void httpd_ClientDestroy(httpd_client_t *cl)
     httpd_MsgClean(&cl->answer);
     httpd_MsgClean(&cl->query);
 
+    free(cl->p_pending);
     free(cl->p_buffer);
     free(cl);
 }
@@ -1276,6 +1552,29 @@ ssize_t httpd_NetSend (httpd_client_t *cl, const uint8_t *p, size_t i_len)
     return val;
 }
 
+static
+ssize_t httpd_NetSendv(httpd_client_t *cl, const struct iovec *iov,
+                       unsigned count)
+{
+    vlc_tls_t *p_tls;
+    ssize_t val;
+
+    p_tls = cl->p_tls;
+    do
+        if (p_tls)
+            val = p_tls->writev(p_tls, iov, count);
+        else {
+            struct msghdr msg = {
+                .msg_iov = (struct iovec *)iov,
+                .msg_iovlen = count,
+            };
+
+            val = sendmsg(cl->fd, &msg, MSG_NOSIGNAL);
+        }
+    while (val == -1 && errno == EINTR);
+    return val;
+}
+
 
 static const struct
 {
@@ -1299,263 +1598,311 @@ msg_type[] =
 };
 
 
-static void httpd_ClientRecv(httpd_client_t *cl)
+/* Finds the empty line ending a header, looking from offset "from" on */
+static size_t httpd_HeaderEnd(const uint8_t *buf, size_t len, size_t from)
 {
-    int i_len;
+    const uint8_t *end = buf + len;
 
-    /* ignore leading whites */
-    if (cl->query.i_proto == HTTPD_PROTO_NONE && cl->i_buffer == 0) {
-        unsigned char c;
+    for (const uint8_t *p = buf + from;
+         (p = memchr(p, '\n', end - p)) != NULL; p++) {
+        size_t i = p - buf;
 
-        i_len = httpd_NetRecv(cl, &c, 1);
+        if ((i >= 1 && buf[i - 1] == '\n') ||
+            (i >= 3 && !memcmp(&buf[i - 3], "\r\n\r\n", 4)))
+            return i + 1;
+    }
+    return 0;
+}
 
-        if (i_len > 0 && !strchr("\r\n\t ", c)) {
-            cl->p_buffer[0] = c;
-            cl->i_buffer++;
-        }
-    } else if (cl->query.i_proto == HTTPD_PROTO_NONE) {
-        /* enough to see if it's Interleaved RTP over RTSP or RTSP/HTTP */
-        i_len = httpd_NetRecv(cl, &cl->p_buffer[cl->i_buffer],
-                               7 - cl->i_buffer);
-        if (i_len > 0)
-            cl->i_buffer += i_len;
+/**
+ * Parses the data received so far in the client buffer, from offset "from".
+ * @return 0 if the connection must be dropped, 1 otherwise
+ */
+static int httpd_ClientParse(httpd_client_t *cl, size_t from)
+{
+    if (cl->query.i_proto == HTTPD_PROTO_NONE) {
+        /* ignore leading whites */
+        size_t i_white = 0;
+
+        while (i_white < (size_t)cl->i_buffer
+            && strchr("\r\n\t ", cl->p_buffer[i_white]) != NULL)
+            i_white++;
+        cl->i_buffer -= i_white;
+        memmove(cl->p_buffer, cl->p_buffer + i_white, cl->i_buffer);
 
         /* The smallest legal request is 7 bytes ("GET /\r\n"),
-         * this is the maximum we can ask at this point. */
-        if (cl->i_buffer >= 7) {
-            if (!memcmp(cl->p_buffer, "HTTP/1.", 7)) {
-                cl->query.i_proto = HTTPD_PROTO_HTTP;
-                cl->query.i_type  = HTTPD_MSG_ANSWER;
-            } else if (!memcmp(cl->p_buffer, "RTSP/1.", 7)) {
-                cl->query.i_proto = HTTPD_PROTO_RTSP;
-                cl->query.i_type  = HTTPD_MSG_ANSWER;
-            } else {
-                /* We need the full request line to determine the protocol. */
-                cl->query.i_proto = HTTPD_PROTO_HTTP0;
-                cl->query.i_type  = HTTPD_MSG_NONE;
-            }
+         * this is enough to see if it's Interleaved RTP over RTSP or
+         * RTSP/HTTP. */
+        if (cl->i_buffer < 7)
+            return 1;
+
+        if (!memcmp(cl->p_buffer, "HTTP/1.", 7)) {
+            cl->query.i_proto = HTTPD_PROTO_HTTP;
+            cl->query.i_type  = HTTPD_MSG_ANSWER;
+        } else if (!memcmp(cl->p_buffer, "RTSP/1.", 7)) {
+            cl->query.i_proto = HTTPD_PROTO_RTSP;
+            cl->query.i_type  = HTTPD_MSG_ANSWER;
+        } else {
+            /* We need the full request line to determine the protocol. */
+            cl->query.i_proto = HTTPD_PROTO_HTTP0;
+            cl->query.i_type  = HTTPD_MSG_NONE;
         }
-    } else if (cl->query.i_body > 0) {
-        /* we are reading the body of a request or a channel */
-        assert (cl->query.p_body != NULL);
-        i_len = httpd_NetRecv(cl, &cl->query.p_body[cl->i_buffer],
-                               cl->query.i_body - cl->i_buffer);
-        if (i_len > 0)
-            cl->i_buffer += i_len;
+        from = 0;
+    }
 
-        if (cl->i_buffer >= cl->query.i_body)
-            cl->i_state = HTTPD_CLIENT_RECEIVE_DONE;
-    } else for (;;) { /* we are reading a header -> char by char */
-        if (cl->i_buffer == cl->i_buffer_size) {
-            uint8_t *newbuf = realloc(cl->p_buffer, cl->i_buffer_size + 1024);
-            if (!newbuf) {
-                i_len = 0;
+    if (cl->query.i_proto == HTTPD_PROTO_HTTP0) {
+        const char *eol = memchr(cl->p_buffer, '\n', cl->i_buffer);
+        if (!eol)
+            return 1; /* Request line is not complete yet */
+
+        const char *line_end = eol + 1;
+        const char *p = memchr(cl->p_buffer, ' ',
+                               line_end - (char *)cl->p_buffer);
+        size_t len;
+
+        assert(cl->query.i_type == HTTPD_MSG_NONE);
+
+        if (!p) /* no URI: evil guy */
+            return 0; /* drop connection */
+
+        do
+            p++; /* skips extra spaces */
+        while (*p == ' ');
+
+        p = memchr(p, ' ', line_end - p);
+        if (!p) /* no explicit protocol: HTTP/0.9 */
+            return 0; /* not supported currently -> drop */
+
+        do
+            p++; /* skips extra spaces ever again */
+        while (*p == ' ');
+
+        len = line_end - p;
+        if (len < 7) /* foreign protocol */
+            return 0; /* I don't understand -> drop */
+        else if (!memcmp(p, "HTTP/1.", 7)) {
+            cl->query.i_proto = HTTPD_PROTO_HTTP;
+            cl->query.i_version = atoi(p + 7);
+        } else if (!memcmp(p, "RTSP/1.", 7)) {
+            cl->query.i_proto = HTTPD_PROTO_RTSP;
+            cl->query.i_version = atoi(p + 7);
+        } else if (!memcmp(p, "HTTP/", 5)) {
+            const uint8_t sorry[] =
+                "HTTP/1.1 505 Unknown HTTP version\r\n\r\n";
+            httpd_NetSend(cl, sorry, sizeof(sorry) - 1);
+            return 0; /* drop */
+        } else if (!memcmp(p, "RTSP/", 5)) {
+            const uint8_t sorry[] =
+                "RTSP/1.0 505 Unknown RTSP version\r\n\r\n";
+            httpd_NetSend(cl, sorry, sizeof(sorry) - 1);
+            return 0; /* drop */
+        } else /* yet another foreign protocol */
+            return 0;
+    }
+
+    size_t i_header = httpd_HeaderEnd(cl->p_buffer, cl->i_buffer, from);
+    if (i_header == 0)
+        return 1; /* header is not complete yet */
+
+    /* we have finished the header so parse it and set i_body */
+    uint8_t saved = cl->p_buffer[i_header];
+    char *p;
+
+    cl->p_buffer[i_header] = '\0';
+
+    if (cl->query.i_type == HTTPD_MSG_ANSWER) {
+        /* FIXME:
+         * assume strlen("HTTP/1.x") = 8
+         */
+        cl->query.i_status =
+            strtol((char *)&cl->p_buffer[8],
+                    &p, 0);
+        while (*p == ' ')
+            p++;
+    } else {
+        p = NULL;
+        cl->query.i_type = HTTPD_MSG_NONE;
+
+        for (unsigned i = 0; msg_type[i].name[0]; i++)
+            if (!strncmp((char *)cl->p_buffer, msg_type[i].name,
+                        strlen(msg_type[i].name))) {
+                p = (char *)&cl->p_buffer[strlen(msg_type[i].name) + 1 ];
+                cl->query.i_type = msg_type[i].i_type;
+                if (cl->query.i_proto != msg_type[i].i_proto) {
+                    p = NULL;
+                    cl->query.i_proto = HTTPD_PROTO_NONE;
+                    cl->query.i_type = HTTPD_MSG_NONE;
+                }
                 break;
             }
 
-            cl->p_buffer = newbuf;
-            cl->i_buffer_size += 1024;
+        if (!p) {
+            if (strstr((char *)cl->p_buffer, "HTTP/1."))
+                cl->query.i_proto = HTTPD_PROTO_HTTP;
+            else if (strstr((char *)cl->p_buffer, "RTSP/1."))
+                cl->query.i_proto = HTTPD_PROTO_RTSP;
+        } else {
+            char *p2;
+            char *p3;
+
+            while (*p == ' ')
+                p++;
+
+            p2 = strchr(p, ' ');
+            if (p2)
+                *p2++ = '\0';
+
+            if (!strncasecmp(p, (cl->query.i_proto == HTTPD_PROTO_HTTP) ? "http:" : "rtsp:", 5)) {
+                /* Skip hier-part of URL (if present) */
+                p += 5;
+                if (!strncmp(p, "//", 2)) { /* skip authority */
+                    /* see RFC3986 §3.2 */
+                    p += 2;
+                    p += strcspn(p, "/?#");
+                }
+            }
+            else if (!strncasecmp(p, (cl->query.i_proto == HTTPD_PROTO_HTTP) ? "https:" : "rtsps:", 6)) {
+                /* Skip hier-part of URL (if present) */
+                p += 6;
+                if (!strncmp(p, "//", 2)) { /* skip authority */
+                    /* see RFC3986 §3.2 */
+                    p += 2;
+                    p += strcspn(p, "/?#");
+                }
+            }
+
+            cl->query.psz_url = strdup(p);
+            if ((p3 = strchr(cl->query.psz_url, '?')) ) {
+                *p3++ = '\0';
+                cl->query.psz_args = (uint8_t *)strdup(p3);
+            }
+            p = p2;
         }
+    }
+    if (p)
+        p = strchr(p, '\n');
 
-        i_len = httpd_NetRecv (cl, &cl->p_buffer[cl->i_buffer], 1);
-        if (i_len <= 0)
-            break;
+    if (p) {
+        while (*p == '\n' || *p == '\r')
+            p++;
 
-        cl->i_buffer++;
+        while (p && *p) {
+            char *line = p;
+            char *eol = p = strchr(p, '\n');
+            char *colon;
 
-        if ((cl->query.i_proto == HTTPD_PROTO_HTTP0)
-                && (cl->p_buffer[cl->i_buffer - 1] == '\n'))
-        {
-            /* Request line is now complete */
-            const char *p = memchr(cl->p_buffer, ' ', cl->i_buffer);
-            size_t len;
+            while (eol && eol >= line && (*eol == '\n' || *eol == '\r'))
+                *eol-- = '\0';
 
-            assert(cl->query.i_type == HTTPD_MSG_NONE);
+            if ((colon = strchr(line, ':'))) {
+                *colon++ = '\0';
+                while (*colon == ' ')
+                    colon++;
+                httpd_MsgAdd(&cl->query, line, "%s", colon);
 
-            if (!p) { /* no URI: evil guy */
-                i_len = 0; /* drop connection */
-                break;
+                if (!strcasecmp(line, "Content-Length"))
+                    cl->query.i_body = atol(colon);
             }
 
-            do
-                p++; /* skips extra spaces */
-            while (*p == ' ');
-
-            p = memchr(p, ' ', ((char *)cl->p_buffer) + cl->i_buffer - p);
-            if (!p) { /* no explicit protocol: HTTP/0.9 */
-                i_len = 0; /* not supported currently -> drop */
-                break;
+            if (p) {
+                p++;
+                while (*p == '\n' || *p == '\r')
+                    p++;
             }
-
-            do
-                p++; /* skips extra spaces ever again */
-            while (*p == ' ');
-
-            len = ((char *)cl->p_buffer) + cl->i_buffer - p;
-            if (len < 7) /* foreign protocol */
-                i_len = 0; /* I don't understand -> drop */
-            else if (!memcmp(p, "HTTP/1.", 7)) {
-                cl->query.i_proto = HTTPD_PROTO_HTTP;
-                cl->query.i_version = atoi(p + 7);
-            } else if (!memcmp(p, "RTSP/1.", 7)) {
-                cl->query.i_proto = HTTPD_PROTO_RTSP;
-                cl->query.i_version = atoi(p + 7);
-            } else if (!memcmp(p, "HTTP/", 5)) {
-                const uint8_t sorry[] =
-                    "HTTP/1.1 505 Unknown HTTP version\r\n\r\n";
-                httpd_NetSend(cl, sorry, sizeof(sorry) - 1);
-                i_len = 0; /* drop */
-            } else if (!memcmp(p, "RTSP/", 5)) {
-                const uint8_t sorry[] =
-                    "RTSP/1.0 505 Unknown RTSP version\r\n\r\n";
-                httpd_NetSend(cl, sorry, sizeof(sorry) - 1);
-                i_len = 0; /* drop */
-            } else /* yet another foreign protocol */
-                i_len = 0;
-
-            if (i_len == 0)
-                break;
         }
+    }
 
-        if ((cl->i_buffer >= 2 && !memcmp(&cl->p_buffer[cl->i_buffer-2], "\n\n", 2))||
-                (cl->i_buffer >= 4 && !memcmp(&cl->p_buffer[cl->i_buffer-4], "\r\n\r\n", 4)))
-        {
-            char *p;
-
-            /* we have finished the header so parse it and set i_body */
-            cl->p_buffer[cl->i_buffer] = '\0';
-
-            if (cl->query.i_type == HTTPD_MSG_ANSWER) {
-                /* FIXME:
-                 * assume strlen("HTTP/1.x") = 8
-                 */
-                cl->query.i_status =
-                    strtol((char *)&cl->p_buffer[8],
-                            &p, 0);
-                while (*p == ' ')
-                    p++;
-            } else {
-                p = NULL;
-                cl->query.i_type = HTTPD_MSG_NONE;
-
-                for (unsigned i = 0; msg_type[i].name[0]; i++)
-                    if (!strncmp((char *)cl->p_buffer, msg_type[i].name,
-                                strlen(msg_type[i].name))) {
-                        p = (char *)&cl->p_buffer[strlen(msg_type[i].name) + 1 ];
-                        cl->query.i_type = msg_type[i].i_type;
-                        if (cl->query.i_proto != msg_type[i].i_proto) {
-                            p = NULL;
-                            cl->query.i_proto = HTTPD_PROTO_NONE;
-                            cl->query.i_type = HTTPD_MSG_NONE;
-                        }
-                        break;
-                    }
+    /* Bytes received past the header belong to the body, then to the next
+     * (pipelined) request */
+    cl->p_buffer[i_header] = saved;
 
-                if (!p) {
-                    if (strstr((char *)cl->p_buffer, "HTTP/1."))
-                        cl->query.i_proto = HTTPD_PROTO_HTTP;
-                    else if (strstr((char *)cl->p_buffer, "RTSP/1."))
-                        cl->query.i_proto = HTTPD_PROTO_RTSP;
-                } else {
-                    char *p2;
-                    char *p3;
-
-                    while (*p == ' ')
-                        p++;
-
-                    p2 = strchr(p, ' ');
-                    if (p2)
-                        *p2++ = '\0';
-
-                    if (!strncasecmp(p, (cl->query.i_proto == HTTPD_PROTO_HTTP) ? "http:" : "rtsp:", 5)) {
-                        /* Skip hier-part of URL (if present) */
-                        p += 5;
-                        if (!strncmp(p, "//", 2)) { /* skip authority */
-                            /* see RFC3986 §3.2 */
-                            p += 2;
-                            p += strcspn(p, "/?#");
-                        }
-                    }
-                    else if (!strncasecmp(p, (cl->query.i_proto == HTTPD_PROTO_HTTP) ? "https:" : "rtsps:", 6)) {
-                        /* Skip hier-part of URL (if present) */
-                        p += 6;
-                        if (!strncmp(p, "//", 2)) { /* skip authority */
-                            /* see RFC3986 §3.2 */
-                            p += 2;
-                            p += strcspn(p, "/?#");
-                        }
-                    }
+    const uint8_t *p_extra = &cl->p_buffer[i_header];
+    size_t i_extra = cl->i_buffer - i_header;
 
-                    cl->query.psz_url = strdup(p);
-                    if ((p3 = strchr(cl->query.psz_url, '?')) ) {
-                        *p3++ = '\0';
-                        cl->query.psz_args = (uint8_t *)strdup(p3);
-                    }
-                    p = p2;
+    if (cl->query.i_body > 0) {
+        /* TODO Mhh, handle the case where the client only
+         * sends a request and closes the connection to
+         * mark the end of the body (probably only RTSP) */
+        if (cl->query.i_body >= 65536)
+            cl->query.p_body = malloc(cl->query.i_body);
+        else
+            cl->query.p_body = NULL;
+        cl->i_buffer = 0;
+        if (!cl->query.p_body) {
+            switch (cl->query.i_proto) {
+                case HTTPD_PROTO_HTTP: {
+                    const uint8_t sorry[] = "HTTP/1.1 413 Request Entity Too Large\r\n\r\n";
+                    httpd_NetSend(cl, sorry, sizeof(sorry) - 1);
+                    break;
+                }
+                case HTTPD_PROTO_RTSP: {
+                    const uint8_t sorry[] = "RTSP/1.0 413 Request Entity Too Large\r\n\r\n";
+                    httpd_NetSend(cl, sorry, sizeof(sorry) - 1);
+                    break;
                 }
+                default:
+                    vlc_assert_unreachable();
             }
-            if (p)
-                p = strchr(p, '\n');
-
-            if (p) {
-                while (*p == '\n' || *p == '\r')
-                    p++;
+            return 0; /* drop */
+        }
 
-                while (p && *p) {
-                    char *line = p;
-                    char *eol = p = strchr(p, '\n');
-                    char *colon;
+        size_t i_copy = __MIN(i_extra, (size_t)cl->query.i_body);
 
-                    while (eol && eol >= line && (*eol == '\n' || *eol == '\r'))
-                        *eol-- = '\0';
+        memcpy(cl->query.p_body, p_extra, i_copy);
+        cl->i_buffer = i_copy;
+        p_extra += i_copy;
+        i_extra -= i_copy;
+        if (cl->i_buffer >= cl->query.i_body)
+            cl->i_state = HTTPD_CLIENT_RECEIVE_DONE;
+    } else
+        cl->i_state = HTTPD_CLIENT_RECEIVE_DONE;
+
+    if (i_extra > 0) {
+        cl->p_pending = malloc(i_extra);
+        if (unlikely(cl->p_pending == NULL))
+            return 0;
+        memcpy(cl->p_pending, p_extra, i_extra);
+        cl->i_pending = i_extra;
+    }
+    return 1;
+}
 
-                    if ((colon = strchr(line, ':'))) {
-                        *colon++ = '\0';
-                        while (*colon == ' ')
-                            colon++;
-                        httpd_MsgAdd(&cl->query, line, "%s", colon);
+static void httpd_ClientRecv(httpd_client_t *cl)
+{
+    ssize_t i_len;
 
-                        if (!strcasecmp(line, "Content-Length"))
-                            cl->query.i_body = atol(colon);
-                    }
+    if (cl->query.i_proto != HTTPD_PROTO_NONE && cl->query.i_body > 0) {
+        /* we are reading the body of a request or a channel */
+        assert (cl->query.p_body != NULL);
+        i_len = httpd_NetRecv(cl, &cl->query.p_body[cl->i_buffer],
+                               cl->query.i_body - cl->i_buffer);
+        if (i_len > 0)
+            cl->i_buffer += i_len;
 
-                    if (p) {
-                        p++;
-                        while (*p == '\n' || *p == '\r')
-                            p++;
-                    }
-                }
+        if (cl->i_buffer >= cl->query.i_body)
+            cl->i_state = HTTPD_CLIENT_RECEIVE_DONE;
+    } else { /* we are reading a header -> as much as is available */
+        if (cl->i_buffer + 1 >= cl->i_buffer_size) {
+            /* keep room for the header terminating nul */
+            uint8_t *newbuf = realloc(cl->p_buffer, 2 * cl->i_buffer_size);
+            if (newbuf) {
+                cl->p_buffer = newbuf;
+                cl->i_buffer_size *= 2;
             }
-            if (cl->query.i_body > 0) {
-                /* TODO Mhh, handle the case where the client only
-                 * sends a request and closes the connection to
-                 * mark the end of the body (probably only RTSP) */
-                if (cl->query.i_body >= 65536)
-                    cl->query.p_body = malloc(cl->query.i_body);
-                else
-                    cl->query.p_body = NULL;
-                cl->i_buffer = 0;
-                if (!cl->query.p_body) {
-                    switch (cl->query.i_proto) {
-                        case HTTPD_PROTO_HTTP: {
-                            const uint8_t sorry[] = "HTTP/1.1 413 Request Entity Too Large\r\n\r\n";
-                            httpd_NetSend(cl, sorry, sizeof(sorry) - 1);
-                            break;
-                        }
-                        case HTTPD_PROTO_RTSP: {
-                            const uint8_t sorry[] = "RTSP/1.0 413 Request Entity Too Large\r\n\r\n";
-                            httpd_NetSend(cl, sorry, sizeof(sorry) - 1);
-                            break;
-                        }
-                        default:
-                            vlc_assert_unreachable();
-                    }
-                    i_len = 0; /* drop */
-                }
-                break;
-            } else
-                cl->i_state = HTTPD_CLIENT_RECEIVE_DONE;
         }
+
+        if (cl->i_buffer + 1 < cl->i_buffer_size) {
+            size_t from = cl->i_buffer;
+
+            i_len = httpd_NetRecv(cl, &cl->p_buffer[cl->i_buffer],
+                                  cl->i_buffer_size - cl->i_buffer - 1);
+            if (i_len > 0) {
+                cl->i_buffer += i_len;
+                if (!httpd_ClientParse(cl, from))
+                    i_len = 0; /* drop */
+            }
+        } else
+            i_len = 0;
     }
 
     /* check if the client is to be set to dead */
@@ -1580,7 +1927,7 @@ static void httpd_ClientRecv(httpd_client_t *cl)
         cl->i_activity_timeout = 0;
 }
 
-static void httpd_ClientSend(httpd_client_t *cl)
+static void httpd_ClientSend(httpd_host_t *host, httpd_client_t *cl)
 {
     int i_len;
 
@@ -1615,13 +1962,22 @@ static void httpd_ClientSend(httpd_client_t *cl)
         cl->i_buffer_size = (uint8_t*)p - cl->p_buffer;
     }
 
+    if (cl->stream != NULL && cl->i_buffer >= cl->i_buffer_size) {
+        /* headers are sent, now send the stream data */
+        if (httpd_StreamSendData(cl->stream, cl) == 0
+         && cl->i_state != HTTPD_CLIENT_DEAD)
+            cl->i_state = HTTPD_CLIENT_SEND_DONE; /* no more data for now */
+        return;
+    }
+
     i_len = httpd_NetSend(cl, &cl->p_buffer[cl->i_buffer],
                            cl->i_buffer_size - cl->i_buffer);
     if (i_len >= 0) {
         cl->i_buffer += i_len;
 
         if (cl->i_buffer >= cl->i_buffer_size) {
-            if (cl->answer.i_body == 0  && cl->answer.i_body_offset > 0) {
+            if (cl->answer.i_body == 0  && cl->answer.i_body_offset > 0
+             && cl->stream == NULL) {
                 /* catch more body data */
                 int     i_msg = cl->query.i_type;
                 int64_t i_offset = cl->answer.i_body_offset;
@@ -1629,8 +1985,11 @@ static void httpd_ClientSend(httpd_client_t *cl)
                 httpd_MsgClean(&cl->answer);
                 cl->answer.i_body_offset = i_offset;
 
+                /* the url callbacks are serialized across the workers */
+                vlc_mutex_lock(&host->lock);
                 cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
                                           &cl->answer, &cl->query);
+                vlc_mutex_unlock(&host->lock);
             }
 
             if (cl->answer.i_body > 0) {
@@ -1709,57 +2068,16 @@ auth_failed:
     return false;
 }
 
-static void httpdLoop(httpd_host_t *host)
+/* Runs the state machine of a client until it waits for the network */
+static void httpd_ClientProcess(httpd_host_t *host, httpd_client_t *cl)
 {
-    struct pollfd ufd[host->nfd + host->i_client];
-    unsigned nfd;
-    for (nfd = 0; nfd < host->nfd; nfd++) {
-        ufd[nfd].fd = host->fds[nfd];
-        ufd[nfd].events = POLLIN;
-        ufd[nfd].revents = 0;
-    }
-
-    /* add all socket that should be read/write and close dead connection */
-    while (host->i_url <= 0) {
-        mutex_cleanup_push(&host->lock);
-        vlc_cond_wait(&host->wait, &host->lock);
-        vlc_cleanup_pop();
-    }
-
-    mtime_t now = mdate();
-    bool b_low_delay = false;
-
-    int canc = vlc_savecancel();
-    for (int i_client = 0; i_client < host->i_client; i_client++) {
-        int64_t i_offset;
-        httpd_client_t *cl = host->client[i_client];
-        if (cl->i_ref < 0 || (cl->i_ref == 0 &&
-                    (cl->i_state == HTTPD_CLIENT_DEAD ||
-                      (cl->i_activity_timeout > 0 &&
-                        cl->i_activity_date+cl->i_activity_timeout < now)))) {
-            TAB_REMOVE(host->i_client, host->client, cl);
-            i_client--;
-            httpd_ClientDestroy(cl);
-            continue;
-        }
-
-        struct pollfd *pufd = ufd + nfd;
-        assert (pufd < ufd + (sizeof (ufd) / sizeof (ufd[0])));
-
-        pufd->fd = cl->fd;
-        pufd->events = pufd->revents = 0;
-
-        switch (cl->i_state) {
-            case HTTPD_CLIENT_RECEIVING:
-            case HTTPD_CLIENT_TLS_HS_IN:
-                pufd->events = POLLIN;
-                break;
+    uint8_t i_state;
+    int64_t i_offset;
 
-            case HTTPD_CLIENT_SENDING:
-            case HTTPD_CLIENT_TLS_HS_OUT:
-                pufd->events = POLLOUT;
-                break;
+    do {
+        i_state = cl->i_state;
 
+        switch (i_state) {
             case HTTPD_CLIENT_RECEIVE_DONE: {
                 httpd_message_t *answer = &cl->answer;
                 httpd_message_t *query  = &cl->query;
@@ -1841,6 +2159,7 @@ static void httpdLoop(httpd_host_t *host)
                         bool b_auth_failed = false;
 
                         /* Search the url and trigger callbacks */
+                        vlc_mutex_lock(&host->lock);
                         for (int i = 0; i < host->i_url; i++) {
                             httpd_url_t *url = host->url[i];
 
@@ -1870,6 +2189,7 @@ static void httpdLoop(httpd_host_t *host)
                             if (!cl->url)
                                 cl->url = url;
                         }
+                        vlc_mutex_unlock(&host->lock);
 
                         if (answer) {
                             answer->i_proto  = query->i_proto;
@@ -1924,11 +2244,22 @@ static void httpdLoop(httpd_host_t *host)
                         httpd_MsgClean(&cl->query);
                         httpd_MsgInit(&cl->query);
 
-                        cl->i_buffer = 0;
-                        cl->i_buffer_size = 1000;
+                        cl->stream = NULL;
+                        cl->i_buffer = cl->i_pending;
+                        cl->i_buffer_size = __MAX(1000, cl->i_pending + 1);
                         free(cl->p_buffer);
                         cl->p_buffer = xmalloc(cl->i_buffer_size);
                         cl->i_state = HTTPD_CLIENT_RECEIVING;
+
+                        /* the next request may have been received already */
+                        if (cl->i_pending > 0) {
+                            memcpy(cl->p_buffer, cl->p_pending, cl->i_pending);
+                            free(cl->p_pending);
+                            cl->p_pending = NULL;
+                            cl->i_pending = 0;
+                            if (!httpd_ClientParse(cl, 0))
+                                cl->i_state = HTTPD_CLIENT_DEAD;
+                        }
                     } else
                         cl->i_state = HTTPD_CLIENT_DEAD;
                     httpd_MsgClean(&cl->answer);
@@ -1947,14 +2278,23 @@ static void httpdLoop(httpd_host_t *host)
                 break;
 
             case HTTPD_CLIENT_WAITING:
+                if (cl->stream != NULL) {
+                    if (httpd_StreamSendData(cl->stream, cl) != 0
+                     && cl->i_state != HTTPD_CLIENT_DEAD)
+                        cl->i_state = HTTPD_CLIENT_SENDING;
+                    break;
+                }
+
                 i_offset = cl->answer.i_body_offset;
                 int i_msg = cl->query.i_type;
 
                 httpd_MsgInit(&cl->answer);
                 cl->answer.i_body_offset = i_offset;
 
+                vlc_mutex_lock(&host->lock);
                 cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
                         &cl->answer, &cl->query);
+                vlc_mutex_unlock(&host->lock);
                 if (cl->answer.i_type != HTTPD_MSG_NONE) {
                     /* we have new data, so re-enter send mode */
                     cl->i_buffer      = 0;
@@ -1965,20 +2305,292 @@ static void httpdLoop(httpd_host_t *host)
                     cl->i_state = HTTPD_CLIENT_SENDING;
                 }
         }
+    } while (cl->i_state != i_state);
+}
+
+/* Events to wait for, given the client state */
+static short httpd_ClientEvents(const httpd_client_t *cl)
+{
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVING:
+        case HTTPD_CLIENT_TLS_HS_IN:
+            return POLLIN;
+
+        case HTTPD_CLIENT_SENDING:
+        case HTTPD_CLIENT_TLS_HS_OUT:
+            return POLLOUT;
+    }
+    return 0;
+}
 
-        if (pufd->events != 0)
-            nfd++;
+static bool httpd_ClientIsDead(const httpd_client_t *cl, mtime_t now)
+{
+    return cl->i_ref < 0 || (cl->i_ref == 0 &&
+                (cl->i_state == HTTPD_CLIENT_DEAD ||
+                  (cl->i_activity_timeout > 0 &&
+                    cl->i_activity_date+cl->i_activity_timeout < now)));
+}
+
+/* Handles network events on a client socket */
+static void httpd_ClientEvent(httpd_host_t *host, httpd_client_t *cl,
+                              mtime_t now)
+{
+    cl->i_activity_date = now;
+
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVING: httpd_ClientRecv(cl); break;
+        case HTTPD_CLIENT_SENDING:   httpd_ClientSend(host, cl); break;
+        case HTTPD_CLIENT_TLS_HS_IN:
+        case HTTPD_CLIENT_TLS_HS_OUT:
+            httpd_ClientTlsHandshake(host, cl);
+            break;
+    }
+
+    /* Handle what was received or sent right away */
+    httpd_ClientProcess(host, cl);
+}
+
+static httpd_client_t *httpd_WorkerAccept(httpd_worker_t *w, int fd,
+                                          mtime_t now)
+{
+    httpd_host_t *host = w->host;
+    httpd_client_t *cl;
+
+    /* Listening sockets are non-blocking: another worker may have
+     * accepted the connection already. */
+    fd = vlc_accept (fd, NULL, NULL, true);
+    if (fd == -1)
+        return NULL;
+    setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
+            &(int){ 1 }, sizeof(int));
+
+    vlc_tls_t *p_tls;
+
+    if (host->p_tls != NULL)
+    {
+        const char *alpn[] = { "http/1.1", NULL };
+
+        p_tls = vlc_tls_ServerSessionCreate(host->p_tls, fd, alpn);
+    }
+    else
+        p_tls = NULL;
+
+    cl = httpd_ClientNew(fd, p_tls, now);
+    if (unlikely(cl == NULL)) {
+        if (p_tls != NULL)
+            vlc_tls_Close(p_tls);
         else
+            net_Close(fd);
+        return NULL;
+    }
+
+    TAB_APPEND(w->i_client, w->client, cl);
+    return cl;
+}
+
+static void httpd_WorkerRemove(httpd_worker_t *w, httpd_client_t *cl)
+{
+    if (cl->b_stream_mode)
+        msg_Dbg(w->host, "stream client closed: %"PRId64" bytes behind at "
+                "most, %"PRIu64" bytes skipped %u time(s), %u stall(s)",
+                cl->i_stream_lag_max, cl->i_stream_skipped,
+                cl->i_stream_skips, cl->i_stream_stalls);
+
+    TAB_REMOVE(w->i_client, w->client, cl);
+#ifdef HAVE_SYS_EPOLL_H
+    if (cl->i_events != 0)
+        epoll_ctl(w->epfd, EPOLL_CTL_DEL, cl->fd, NULL);
+#endif
+    httpd_ClientDestroy(cl);
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+/* Updates the events the client socket is registered for */
+static void httpd_WorkerWatch(httpd_worker_t *w, httpd_client_t *cl)
+{
+    short events = httpd_ClientEvents(cl);
+    struct epoll_event ev;
+    int op;
+
+    if (events == cl->i_events)
+        return;
+
+    /* Unregister idle clients, lest hang-ups be reported over and over */
+    if (events == 0)
+        op = EPOLL_CTL_DEL;
+    else if (cl->i_events == 0)
+        op = EPOLL_CTL_ADD;
+    else
+        op = EPOLL_CTL_MOD;
+
+    ev.events = ((events & POLLIN) ? EPOLLIN : 0)
+              | ((events & POLLOUT) ? EPOLLOUT : 0);
+    ev.data.ptr = cl;
+
+    if (epoll_ctl(w->epfd, op, cl->fd, &ev) == 0)
+        cl->i_events = events;
+    else if (op != EPOLL_CTL_DEL) {
+        msg_Err(w->host, "cannot poll client: %s", vlc_strerror_c(errno));
+        cl->i_state = HTTPD_CLIENT_DEAD;
+    }
+}
+#endif
+
+/**
+ * Closes dead and idle clients, and runs the state machine of the others.
+ * @return whether some clients wait without network events
+ * (e.g. for more stream data)
+ */
+static bool httpd_WorkerCheck(httpd_worker_t *w, mtime_t now)
+{
+    bool b_low_delay = false;
+
+    for (int i = 0; i < w->i_client; i++) {
+        httpd_client_t *cl = w->client[i];
+
+        if (httpd_ClientIsDead(cl, now)) {
+            httpd_WorkerRemove(w, cl);
+            i--;
+            continue;
+        }
+
+        httpd_ClientProcess(w->host, cl);
+        if (httpd_ClientEvents(cl) == 0)
             b_low_delay = true;
+#ifdef HAVE_SYS_EPOLL_H
+        httpd_WorkerWatch(w, cl);
+#endif
     }
+    return b_low_delay;
+}
+
+static void httpd_HostWaitUrl(httpd_host_t *host)
+{
+    vlc_mutex_lock(&host->lock);
+    mutex_cleanup_push(&host->lock);
+    while (host->i_url <= 0)
+        vlc_cond_wait(&host->wait, &host->lock);
+    vlc_cleanup_pop();
     vlc_mutex_unlock(&host->lock);
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+static void httpdLoop(httpd_worker_t *w)
+{
+    httpd_host_t *host = w->host;
+    struct epoll_event ev[64];
+
+    /* do not accept connections while no url is registered */
+    httpd_HostWaitUrl(host);
+
+    int canc = vlc_savecancel();
+    vlc_mutex_lock(&w->lock);
+
+    /* Only clients with network events are handled below. All clients are
+     * checked every second for timeouts, and every 20ms (not too big) if
+     * some are HTTPD_CLIENT_WAITING. */
+    mtime_t now = mdate();
+    int timeout = -1;
+
+    if (now >= w->i_next_check)
+        w->i_next_check = now + (httpd_WorkerCheck(w, now) ? 20000
+                                                          : CLOCK_FREQ);
+    if (w->i_client > 0)
+        timeout = (w->i_next_check - now + 999) / 1000;
+
+    vlc_mutex_unlock(&w->lock);
+    vlc_restorecancel(canc);
+
+    int ret = epoll_wait(w->epfd, ev, sizeof (ev) / sizeof (ev[0]), timeout);
+    if (ret == -1) {
+        if (errno != EINTR) {
+            /* Kernel on low memory or a bug: pace */
+            msg_Err(host, "polling error: %s", vlc_strerror_c(errno));
+            msleep(100000);
+        }
+        return;
+    }
+
+    canc = vlc_savecancel();
+    vlc_mutex_lock(&w->lock);
+    now = mdate();
+
+    for (int i = 0; i < ret; i++) {
+        httpd_client_t *cl = ev[i].data.ptr;
+
+        if (cl == NULL) {
+            /* Handle server sockets (accept new connections) */
+            for (unsigned j = 0; j < host->nfd; j++) {
+                cl = httpd_WorkerAccept(w, host->fds[j], now);
+                if (cl != NULL)
+                    httpd_WorkerWatch(w, cl);
+            }
+            continue;
+        }
+
+        httpd_ClientEvent(host, cl, now);
+
+        if (cl->i_ref == 0 && cl->i_state == HTTPD_CLIENT_DEAD) {
+            httpd_WorkerRemove(w, cl);
+            continue;
+        }
+
+        httpd_WorkerWatch(w, cl);
+        if (cl->i_events == 0 && w->i_next_check > now + 20000)
+            w->i_next_check = now + 20000;
+    }
+
+    vlc_mutex_unlock(&w->lock);
+    vlc_restorecancel(canc);
+}
+#else
+static void httpdLoop(httpd_worker_t *w)
+{
+    httpd_host_t *host = w->host;
+
+    /* do not accept connections while no url is registered */
+    httpd_HostWaitUrl(host);
+
+    int canc = vlc_savecancel();
+    vlc_mutex_lock(&w->lock);
+
+    mtime_t now = mdate();
+    bool b_low_delay = httpd_WorkerCheck(w, now);
+
+    struct pollfd ufd[host->nfd + w->i_client];
+    unsigned nfd;
+    for (nfd = 0; nfd < host->nfd; nfd++) {
+        ufd[nfd].fd = host->fds[nfd];
+        ufd[nfd].events = POLLIN;
+        ufd[nfd].revents = 0;
+    }
+
+    /* add all socket that should be read/write */
+    for (int i_client = 0; i_client < w->i_client; i_client++) {
+        httpd_client_t *cl = w->client[i_client];
+        short events = httpd_ClientEvents(cl);
+
+        if (events == 0)
+            continue;
+
+        ufd[nfd].fd = cl->fd;
+        ufd[nfd].events = events;
+        ufd[nfd].revents = 0;
+        nfd++;
+    }
+
+    const unsigned nufd = nfd;
+    /* dead clients are closed by the next check */
+    int timeout = b_low_delay ? 20 : (w->i_client > 0) ? 1000 : -1;
+
+    vlc_mutex_unlock(&w->lock);
     vlc_restorecancel(canc);
 
     /* we will wait 20ms (not too big) if HTTPD_CLIENT_WAITING */
-    int ret = poll(ufd, nfd, b_low_delay ? 20 : -1);
+    int ret = poll(ufd, nufd, timeout);
 
     canc = vlc_savecancel();
-    vlc_mutex_lock(&host->lock);
+    vlc_mutex_lock(&w->lock);
     switch(ret) {
         case -1:
             if (errno != EINTR) {
@@ -1987,82 +2599,48 @@ static void httpdLoop(httpd_host_t *host)
                 msleep(100000);
             }
         case 0:
+            vlc_mutex_unlock(&w->lock);
             vlc_restorecancel(canc);
             return;
     }
 
-    /* Handle client sockets */
+    /* Handle client sockets. Only this thread adds or removes clients, so
+     * they are in the same order as in the poll set. */
     now = mdate();
     nfd = host->nfd;
 
-    for (int i_client = 0; i_client < host->i_client; i_client++) {
-        httpd_client_t *cl = host->client[i_client];
+    for (int i_client = 0; i_client < w->i_client && nfd < nufd; i_client++) {
+        httpd_client_t *cl = w->client[i_client];
         const struct pollfd *pufd = &ufd[nfd];
 
-        assert(pufd < &ufd[sizeof(ufd) / sizeof(ufd[0])]);
-
         if (cl->fd != pufd->fd)
             continue; // we were not waiting for this client
         ++nfd;
         if (pufd->revents == 0)
             continue; // no event received
 
-        cl->i_activity_date = now;
-
-        switch (cl->i_state) {
-            case HTTPD_CLIENT_RECEIVING: httpd_ClientRecv(cl); break;
-            case HTTPD_CLIENT_SENDING:   httpd_ClientSend(cl); break;
-            case HTTPD_CLIENT_TLS_HS_IN:
-            case HTTPD_CLIENT_TLS_HS_OUT:
-                httpd_ClientTlsHandshake(host, cl);
-                break;
-        }
+        httpd_ClientEvent(host, cl, now);
     }
 
     /* Handle server sockets (accept new connections) */
     for (nfd = 0; nfd < host->nfd; nfd++) {
-        httpd_client_t *cl;
-        int fd = ufd[nfd].fd;
-
-        assert (fd == host->fds[nfd]);
-
-        if (ufd[nfd].revents == 0)
-            continue;
-
-        /* */
-        fd = vlc_accept (fd, NULL, NULL, true);
-        if (fd == -1)
-            continue;
-        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
-                &(int){ 1 }, sizeof(int));
-
-        vlc_tls_t *p_tls;
+        assert (ufd[nfd].fd == host->fds[nfd]);
 
-        if (host->p_tls != NULL)
-        {
-            const char *alpn[] = { "http/1.1", NULL };
-
-            p_tls = vlc_tls_ServerSessionCreate(host->p_tls, fd, alpn);
-        }
-        else
-            p_tls = NULL;
-
-        cl = httpd_ClientNew(fd, p_tls, now);
-
-        TAB_APPEND(host->i_client, host->client, cl);
+        if (ufd[nfd].revents != 0)
+            httpd_WorkerAccept(w, ufd[nfd].fd, now);
     }
 
+    vlc_mutex_unlock(&w->lock);
     vlc_restorecancel(canc);
 }
+#endif
 
-static void* httpd_HostThread(void *data)
+static void* httpd_WorkerThread(void *data)
 {
-    httpd_host_t *host = data;
+    httpd_worker_t *w = data;
 
-    vlc_mutex_lock(&host->lock);
-    while (host->i_ref > 0)
-        httpdLoop(host);
-    vlc_mutex_unlock(&host->lock);
+    for (;;)
+        httpdLoop(w);
     return NULL;
 }
 
@@ -23,12 +23,14 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #undef NDEBUG
 #include <assert.h>
 
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 
 static const char text[] =
     "This is a test!\n"
@@ -84,10 +86,145 @@ static void test_block (void)
     //assert (block == NULL);
 }
 
+static void test_block_recycle (void)
+{
+    block_t *block = block_Alloc (1316);
+    assert (block != NULL);
+
+    void *addr = block;
+    block_Release (block);
+
+    /* Same size class: the released block should be reused */
+    block = block_Alloc (1000);
+    assert (block != NULL);
+    assert ((void *)block == addr);
+    assert (block->i_buffer == 1000);
+    assert (block->p_next == NULL);
+    assert (block->i_flags == 0);
+    assert (block->i_pts == VLC_TS_INVALID);
+    assert (((uintptr_t)block->p_buffer % 32) == 0);
+
+    /* Growing within the size class should not move the payload */
+    memset (block->p_buffer, 0x5A, block->i_buffer);
+    block = block_Realloc (block, 0, 1316);
+    assert (block != NULL);
+    assert ((void *)block == addr);
+    for (size_t i = 0; i < 1000; i++)
+        assert (block->p_buffer[i] == 0x5A);
+    block_Release (block);
+}
+
+#define RECYCLE_COUNT 4096
+
+static void *test_block_producer (void *data)
+{
+    block_t **blocks = data;
+
+    for (unsigned i = 0; i < RECYCLE_COUNT; i++)
+    {
+        blocks[i] = block_Alloc (188 + (i % 7) * 1316);
+        assert (blocks[i] != NULL);
+        memset (blocks[i]->p_buffer, i, blocks[i]->i_buffer);
+    }
+    return NULL;
+}
+
+static void test_block_recycle_threads (void)
+{
+    block_t **blocks = malloc (RECYCLE_COUNT * sizeof (*blocks));
+    assert (blocks != NULL);
+
+    /* Blocks allocated by one thread and released by another must flow
+     * back through the global depot. */
+    for (unsigned round = 0; round < 4; round++)
+    {
+        vlc_thread_t th;
+
+        if (vlc_clone (&th, test_block_producer, blocks,
+                       VLC_THREAD_PRIORITY_LOW))
+            abort ();
+        vlc_join (th, NULL);
+
+        for (unsigned i = 0; i < RECYCLE_COUNT; i++)
+        {
+            assert (blocks[i]->i_buffer == 188 + (i % 7) * 1316);
+            assert (blocks[i]->p_buffer[0] == (uint8_t)i);
+            block_Release (blocks[i]);
+        }
+    }
+    free (blocks);
+}
+
+#define FIFO_PRODUCERS 4
+#define FIFO_COUNT 10000
+
+static void *test_fifo_producer (void *data)
+{
+    block_fifo_t *fifo = data;
+    static atomic_uint next_id = ATOMIC_VAR_INIT(0);
+    unsigned id = atomic_fetch_add (&next_id, 1);
+
+    for (unsigned i = 0; i < FIFO_COUNT; i += 2)
+    {   /* Alternate single blocks and chains of two */
+        block_t *a = block_Alloc (8), *b = block_Alloc (8);
+        assert (a != NULL && b != NULL);
+
+        a->i_dts = id;
+        a->i_pts = i;
+        b->i_dts = id;
+        b->i_pts = i + 1;
+        if (i & 2)
+            a->p_next = b;
+        else
+            block_FifoPut (fifo, a), a = b;
+        block_FifoPut (fifo, a);
+    }
+    return NULL;
+}
+
+static void test_block_fifo (void)
+{
+    block_fifo_t *fifo = block_FifoNew ();
+    vlc_thread_t th[FIFO_PRODUCERS];
+    mtime_t next[FIFO_PRODUCERS] = { 0 };
+
+    assert (fifo != NULL);
+    for (unsigned i = 0; i < FIFO_PRODUCERS; i++)
+        if (vlc_clone (&th[i], test_fifo_producer, fifo,
+                       VLC_THREAD_PRIORITY_LOW))
+            abort ();
+
+    /* Blocks from each producer must come out in order */
+    for (unsigned n = 0; n < FIFO_PRODUCERS * FIFO_COUNT; n++)
+    {
+        block_t *block = block_FifoGet (fifo);
+
+        assert (block->p_next == NULL);
+        assert (block->i_dts >= 0 && block->i_dts < FIFO_PRODUCERS);
+        assert (block->i_pts == next[block->i_dts]);
+        next[block->i_dts]++;
+        block_Release (block);
+    }
+
+    for (unsigned i = 0; i < FIFO_PRODUCERS; i++)
+        vlc_join (th[i], NULL);
+
+    assert (block_FifoCount (fifo) == 0);
+    block_FifoPut (fifo, block_Alloc (16));
+    assert (block_FifoCount (fifo) == 1);
+    vlc_fifo_Lock (fifo);
+    assert (vlc_fifo_GetBytes (fifo) == 16);
+    vlc_fifo_Unlock (fifo);
+    block_FifoRelease (fifo);
+}
+
 int main (void)
 {
     test_block_File ();
     test_block ();
+    test_block_recycle ();
+    test_block_recycle_threads ();
+    test_block_fifo ();
     return 0;
 }
 
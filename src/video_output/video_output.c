@@ -326,6 +326,17 @@ void vout_GetResetStatistic(vout_thread_t *vout, unsigned *restrict displayed,
     vout_statistic_GetReset( &vout->p->statistic, displayed, lost );
 }
 
+void vout_GetResetSpuStatistic(vout_thread_t *vout, unsigned *restrict cached,
+                               unsigned *restrict rendered)
+{
+    *cached = *rendered = 0;
+
+    vlc_mutex_lock(&vout->p->spu_lock);
+    if (vout->p->spu)
+        spu_GetResetCacheStatistic(vout->p->spu, cached, rendered);
+    vlc_mutex_unlock(&vout->p->spu_lock);
+}
+
 void vout_Flush(vout_thread_t *vout, mtime_t date)
 {
     vout_control_PushTime(&vout->p->control, VOUT_CONTROL_FLUSH, date);
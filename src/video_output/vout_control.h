@@ -42,6 +42,13 @@ void spu_OffsetSubtitleDate( spu_t *p_spu, mtime_t i_duration );
 void vout_GetResetStatistic( vout_thread_t *p_vout, unsigned *pi_displayed,
                              unsigned *pi_lost );
 
+/**
+ * This function will return and reset the subpicture rendering cache
+ * statistics: the renderings reused and the ones done.
+ */
+void vout_GetResetSpuStatistic( vout_thread_t *p_vout, unsigned *pi_cached,
+                                unsigned *pi_rendered );
+
 /**
  * This function will ensure that all ready/displayed pciture have at most
  * the provided dat
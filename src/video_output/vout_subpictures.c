@@ -61,6 +61,23 @@ typedef struct {
     spu_heap_entry_t entry[VOUT_MAX_SUBPICTURES];
 } spu_heap_t;
 
+/* Maximum length of the chroma list of a cached rendering */
+#define SPU_CACHE_MAX_CHROMAS (16)
+
+/* Last rendering, reused as long as its subpictures, regions and output
+ * are the same */
+typedef struct {
+    subpicture_t   *output;             /**< copy of the rendering, or NULL */
+    subpicture_t   *subpicture[VOUT_MAX_SUBPICTURES];
+    unsigned        subpicture_count;
+    video_format_t  fmt_dst;
+    video_format_t  fmt_src;
+    vlc_fourcc_t    chroma_list[SPU_CACHE_MAX_CHROMAS];
+
+    unsigned        hits;                       /**< renderings reused */
+    unsigned        misses;                     /**< renderings done */
+} spu_cache_t;
+
 struct spu_private_t {
     vlc_mutex_t  lock;            /* lock to protect all followings fields */
     vlc_object_t *input;
@@ -93,6 +110,8 @@ struct spu_private_t {
 
     /* */
     mtime_t last_sort_date;
+
+    spu_cache_t cache;
 };
 
 /*****************************************************************************
@@ -777,7 +796,7 @@ static void SpuRenderRegion(spu_t *spu,
         /* Destroy the cache if unusable */
         if (region->p_private) {
             subpicture_region_private_t *private = region->p_private;
-            bool is_changed = false;
+            bool is_changed = private->p_picture == NULL;
 
             /* Check resize changes */
             if (dst_width  != private->fmt.i_visible_width ||
@@ -869,6 +888,10 @@ static void SpuRenderRegion(spu_t *spu,
             region_fmt     = region->p_private->fmt;
             region_picture = region->p_private->p_picture;
         }
+    } else if (!region->p_private) {
+        /* Nothing to scale, only mark the region as rendered
+         * (see SpuCacheIsRendered()) */
+        region->p_private = subpicture_region_private_New(&region->fmt);
     }
 
     /* Force cropping if requested */
@@ -905,14 +928,12 @@ static void SpuRenderRegion(spu_t *spu,
         }
     }
 
-    subpicture_region_t *dst = *dst_ptr = subpicture_region_New(&region_fmt);
+    subpicture_region_t *dst = *dst_ptr =
+        subpicture_region_NewFromPicture(&region_fmt, region_picture);
     if (dst) {
         dst->i_x       = x_offset;
         dst->i_y       = y_offset;
         dst->i_align   = 0;
-        if (dst->p_picture)
-            picture_Release(dst->p_picture);
-        dst->p_picture = picture_Hold(region_picture);
         int fade_alpha = 255;
         if (subpic->b_fade) {
             mtime_t fade_start = subpic->i_start + 3 * (subpic->i_stop - subpic->i_start) / 4;
@@ -1083,6 +1104,151 @@ static subpicture_t *SpuRenderSubpictures(spu_t *spu,
     return output;
 }
 
+/*****************************************************************************
+ * Rendering cache
+ *****************************************************************************/
+static void SpuCacheInit(spu_cache_t *cache)
+{
+    cache->output = NULL;
+    cache->subpicture_count = 0;
+    video_format_Init(&cache->fmt_dst, 0);
+    video_format_Init(&cache->fmt_src, 0);
+    cache->chroma_list[0] = 0;
+
+    cache->hits   = 0;
+    cache->misses = 0;
+}
+
+/* Drops the cached rendering, needed when a rendering setting changes */
+static void SpuCacheFlush(spu_cache_t *cache)
+{
+    if (cache->output)
+        subpicture_Delete(cache->output);
+    cache->output = NULL;
+}
+
+/**
+ * Tells if all the regions went through SpuRenderRegion() and were not
+ * changed since.
+ *
+ * The regions created later (new or updated subpictures) have no private
+ * data yet, and the text regions rendered again at each date (karaoke) lose
+ * theirs.
+ */
+static bool SpuCacheIsRendered(subpicture_t *const *subpicture_array,
+                               unsigned subpicture_count)
+{
+    for (unsigned i = 0; i < subpicture_count; i++)
+        for (const subpicture_region_t *r = subpicture_array[i]->p_region;
+             r != NULL; r = r->p_next)
+            if (!r->p_private)
+                return false;
+    return true;
+}
+
+/* Copies a rendering, sharing its pictures */
+static subpicture_t *SpuCacheCopy(const subpicture_t *src)
+{
+    subpicture_t *dst = subpicture_New(NULL);
+    if (!dst)
+        return NULL;
+
+    dst->i_order = src->i_order;
+    dst->i_original_picture_width  = src->i_original_picture_width;
+    dst->i_original_picture_height = src->i_original_picture_height;
+
+    subpicture_region_t **last_ptr = &dst->p_region;
+    for (const subpicture_region_t *r = src->p_region; r != NULL; r = r->p_next) {
+        subpicture_region_t *copy =
+            subpicture_region_NewFromPicture(&r->fmt, r->p_picture);
+        if (!copy) {
+            subpicture_Delete(dst);
+            return NULL;
+        }
+        copy->i_x     = r->i_x;
+        copy->i_y     = r->i_y;
+        copy->i_align = r->i_align;
+        copy->i_alpha = r->i_alpha;
+
+        *last_ptr = copy;
+        last_ptr = &copy->p_next;
+    }
+    return dst;
+}
+
+static bool SpuCacheFormatCmp(const video_format_t *f0, const video_format_t *f1)
+{
+    return f0->i_chroma         == f1->i_chroma &&
+           f0->i_visible_width  == f1->i_visible_width &&
+           f0->i_visible_height == f1->i_visible_height &&
+           f0->i_sar_num        == f1->i_sar_num &&
+           f0->i_sar_den        == f1->i_sar_den;
+}
+
+/* Tells if the cached rendering is the one of the given subpictures */
+static bool SpuCacheMatch(const spu_cache_t *cache,
+                          subpicture_t *const *subpicture_array,
+                          unsigned subpicture_count,
+                          const vlc_fourcc_t *chroma_list,
+                          const video_format_t *fmt_dst,
+                          const video_format_t *fmt_src)
+{
+    if (!cache->output || cache->subpicture_count != subpicture_count)
+        return false;
+
+    for (unsigned i = 0; i < subpicture_count; i++)
+        if (cache->subpicture[i] != subpicture_array[i])
+            return false;
+
+    for (unsigned i = 0; ; i++) {
+        if (cache->chroma_list[i] != chroma_list[i])
+            return false;
+        if (!chroma_list[i])
+            break;
+    }
+
+    if (!SpuCacheFormatCmp(&cache->fmt_dst, fmt_dst) ||
+        !SpuCacheFormatCmp(&cache->fmt_src, fmt_src))
+        return false;
+
+    return SpuCacheIsRendered(subpicture_array, subpicture_count);
+}
+
+static void SpuCacheStore(spu_cache_t *cache, const subpicture_t *output,
+                          subpicture_t *const *subpicture_array,
+                          unsigned subpicture_count,
+                          const vlc_fourcc_t *chroma_list,
+                          const video_format_t *fmt_dst,
+                          const video_format_t *fmt_src)
+{
+    SpuCacheFlush(cache);
+
+    unsigned chroma_count = 0;
+    while (chroma_list[chroma_count])
+        chroma_count++;
+    if (chroma_count >= SPU_CACHE_MAX_CHROMAS)
+        return;
+
+    if (!SpuCacheIsRendered(subpicture_array, subpicture_count))
+        return;
+
+    cache->output = SpuCacheCopy(output);
+    if (!cache->output)
+        return;
+
+    memcpy(cache->subpicture, subpicture_array,
+           subpicture_count * sizeof(*subpicture_array));
+    cache->subpicture_count = subpicture_count;
+    memcpy(cache->chroma_list, chroma_list,
+           (chroma_count + 1) * sizeof(*chroma_list));
+
+    /* Only the sizes and chromas are compared, not the palettes */
+    cache->fmt_dst = *fmt_dst;
+    cache->fmt_dst.p_palette = NULL;
+    cache->fmt_src = *fmt_src;
+    cache->fmt_src.p_palette = NULL;
+}
+
 /*****************************************************************************
  * Object variables callbacks
  *****************************************************************************/
@@ -1102,6 +1268,7 @@ static void UpdateSPU(spu_t *spu, vlc_object_t *object)
 
     sys->force_palette = false;
     sys->force_crop = false;
+    SpuCacheFlush(&sys->cache);
 
     if (var_Get(object, "highlight", &val) || !val.b_bool) {
         vlc_mutex_unlock(&sys->lock);
@@ -1231,6 +1398,8 @@ spu_t *spu_Create(vlc_object_t *object)
     /* */
     sys->last_sort_date = -1;
 
+    SpuCacheInit(&sys->cache);
+
     return spu;
 }
 
@@ -1261,6 +1430,7 @@ void spu_Destroy(spu_t *spu)
     free(sys->filter_chain_update);
 
     /* Destroy all remaining subpictures */
+    SpuCacheFlush(&sys->cache);
     SpuHeapClean(&sys->heap);
 
     vlc_mutex_destroy(&sys->lock);
@@ -1287,6 +1457,7 @@ void spu_Attach(spu_t *spu, vlc_object_t *input, bool attach)
         if (spu->p->text)
             FilterRelease(spu->p->text);
         spu->p->text = SpuRenderCreateAndLoadText(spu);
+        SpuCacheFlush(&spu->p->cache);
 
         vlc_mutex_unlock(&spu->p->lock);
     } else {
@@ -1473,14 +1644,41 @@ subpicture_t *spu_Render(spu_t *spu,
      * XXX The order is *really* important for overlap subtitles positionning */
     qsort(subpicture_array, subpicture_count, sizeof(*subpicture_array), SubpictureCmp);
 
+    /* Reuse the last rendering if the subpictures did not change */
+    subpicture_t *render;
+    if (SpuCacheMatch(&sys->cache, subpicture_array, subpicture_count,
+                      chroma_list, fmt_dst, fmt_src)) {
+        render = SpuCacheCopy(sys->cache.output);
+        sys->cache.hits++;
+        vlc_mutex_unlock(&sys->lock);
+        return render;
+    }
+
+    /* The fading subpictures and the first placement of the relative
+     * subtitles depend on more than the subpictures themselves */
+    bool cacheable = true;
+    for (unsigned i = 0; i < subpicture_count; i++) {
+        const subpicture_t *subpic = subpicture_array[i];
+
+        if (subpic->b_fade || (subpic->b_subtitle && !subpic->b_absolute))
+            cacheable = false;
+    }
+
     /* Render the subpictures */
-    subpicture_t *render = SpuRenderSubpictures(spu,
-                                                subpicture_count, subpicture_array,
-                                                chroma_list,
-                                                fmt_dst,
-                                                fmt_src,
-                                                render_subtitle_date,
-                                                render_osd_date);
+    render = SpuRenderSubpictures(spu,
+                                  subpicture_count, subpicture_array,
+                                  chroma_list,
+                                  fmt_dst,
+                                  fmt_src,
+                                  render_subtitle_date,
+                                  render_osd_date);
+    sys->cache.misses++;
+
+    if (render && cacheable)
+        SpuCacheStore(&sys->cache, render, subpicture_array, subpicture_count,
+                      chroma_list, fmt_dst, fmt_src);
+    else
+        SpuCacheFlush(&sys->cache);
     vlc_mutex_unlock(&sys->lock);
 
     return render;
@@ -1568,6 +1766,20 @@ void spu_ChangeMargin(spu_t *spu, int margin)
 
     vlc_mutex_lock(&sys->lock);
     sys->margin = margin;
+    SpuCacheFlush(&sys->cache);
+    vlc_mutex_unlock(&sys->lock);
+}
+
+void spu_GetResetCacheStatistic(spu_t *spu, unsigned *restrict hits,
+                                unsigned *restrict misses)
+{
+    spu_private_t *sys = spu->p;
+
+    vlc_mutex_lock(&sys->lock);
+    *hits   = sys->cache.hits;
+    *misses = sys->cache.misses;
+    sys->cache.hits   = 0;
+    sys->cache.misses = 0;
     vlc_mutex_unlock(&sys->lock);
 }
 
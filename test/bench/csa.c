@@ -0,0 +1,98 @@
+/*****************************************************************************
+ * csa.c: CSA (de)scrambling throughput benchmark
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include "../../lib/libvlc_internal.h"
+
+#include <vlc/vlc.h>
+
+#include "../../modules/mux/mpeg/csa.c"
+
+#define PACKETS 4096
+
+static uint8_t pkts[PACKETS][188];
+static uint8_t *pp_pkts[PACKETS];
+
+static void Bench(csa_t *csa, const char *name, int batch, bool decrypt)
+{
+    for (int i = 0; i < PACKETS; i++)
+    {
+        for (int j = 0; j < 188; j++)
+            pkts[i][j] = rand();
+        pkts[i][0] = 0x47;
+        pkts[i][3] &= 0x1f; /* no adaptation field */
+        pkts[i][3] |= 0x10;
+        if (decrypt)
+            pkts[i][3] |= 0x80;
+        pp_pkts[i] = pkts[i];
+    }
+
+    mtime_t start = mdate();
+    for (int i = 0; i < PACKETS; i += batch)
+    {
+        int n = (PACKETS - i < batch) ? PACKETS - i : batch;
+
+        if (decrypt)
+            csa_DecryptBatch(csa, &pp_pkts[i], n, 188);
+        else
+            csa_EncryptBatch(csa, &pp_pkts[i], n, 188);
+    }
+    mtime_t elapsed = mdate() - start;
+
+    printf("%-10s by %3d: %7.1f Mbit/s\n", name, batch,
+           (PACKETS * 188 * 8.) / (elapsed ? elapsed : 1));
+}
+
+int main(void)
+{
+    char odd_key[] = "0x0123456789abcdef";
+    char even_key[] = "fedcba9876543210";
+
+    setenv("VLC_PLUGIN_PATH", "../modules", 0);
+
+    libvlc_instance_t *vlc = libvlc_new(0, NULL);
+    if (vlc == NULL)
+        return 1;
+    vlc_object_t *parent = VLC_OBJECT(vlc->p_libvlc_int);
+
+    csa_t *csa = csa_New();
+    if (csa == NULL ||
+        csa_SetCW(parent, csa, odd_key, true) != VLC_SUCCESS ||
+        csa_SetCW(parent, csa, even_key, false) != VLC_SUCCESS)
+        abort();
+
+    static const int batches[] = { 1, 7, 64, 256 };
+    for (size_t i = 0; i < ARRAY_SIZE(batches); i++)
+    {
+        Bench(csa, "scramble", batches[i], false);
+        Bench(csa, "descramble", batches[i], true);
+    }
+
+    csa_Delete(csa);
+    libvlc_release(vlc);
+    return 0;
+}
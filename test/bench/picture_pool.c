@@ -0,0 +1,99 @@
+/*****************************************************************************
+ * picture_pool.c: picture pool throughput benchmark
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include <vlc_picture_pool.h>
+
+#define PICTURES   8
+#define ITERATIONS 200000
+
+static picture_pool_t *pool;
+
+/* Decoder-like thread: takes a picture and gives it back at once */
+static void *get_release(void *data)
+{
+    (void) data;
+
+    for (unsigned i = 0; i < ITERATIONS; i++)
+    {
+        picture_t *pic = picture_pool_Get(pool);
+        if (pic == NULL)
+            continue;
+        picture_Release(pic);
+    }
+    return NULL;
+}
+
+static void *wait_release(void *data)
+{
+    (void) data;
+
+    for (unsigned i = 0; i < ITERATIONS; i++)
+    {
+        picture_t *pic = picture_pool_Wait(pool);
+        if (pic != NULL)
+            picture_Release(pic);
+    }
+    return NULL;
+}
+
+static void bench(const char *name, void *(*func)(void *), unsigned threads)
+{
+    vlc_thread_t th[threads];
+    mtime_t start = mdate();
+
+    for (unsigned i = 0; i < threads; i++)
+        if (vlc_clone(&th[i], func, NULL, VLC_THREAD_PRIORITY_LOW))
+            abort();
+    for (unsigned i = 0; i < threads; i++)
+        vlc_join(th[i], NULL);
+
+    mtime_t elapsed = mdate() - start;
+    unsigned long long ops = (unsigned long long)threads * ITERATIONS;
+
+    printf("%-4s %2u thread(s): %8.1f ns/picture\n", name, threads,
+           (elapsed * 1000.) / ops);
+}
+
+int main(void)
+{
+    video_format_t fmt;
+
+    video_format_Setup(&fmt, VLC_CODEC_I420, 64, 64, 64, 64, 1, 1);
+    pool = picture_pool_NewFromFormat(&fmt, PICTURES);
+    if (pool == NULL)
+        return 1;
+
+    bench("Get", get_release, 1);
+    bench("Get", get_release, 4);
+    bench("Wait", wait_release, 1);
+    /* More waiters than pictures: the empty pool slow path */
+    bench("Wait", wait_release, 2 * PICTURES);
+
+    picture_pool_Release(pool);
+    return 0;
+}
@@ -0,0 +1,164 @@
+/*****************************************************************************
+ * slices.c: slice threaded video filters throughput benchmark
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include "../../lib/libvlc_internal.h"
+
+#include <vlc/vlc.h>
+
+#define WIDTH   1920
+#define HEIGHT  1080
+#define INPUTS  3
+#define FRAMES  50
+
+/* The filters converted to slices */
+static const char *const filters[] = {
+    "hqdn3d",
+    "gradfun",
+    "adjust{contrast=1.2,brightness=1.1,saturation=1.4,hue=30}",
+    "sharpen{sigma=0.5}",
+    "deinterlace{mode=yadif}",
+};
+
+static picture_t *inputs[INPUTS];
+
+static picture_t *BufferNew(filter_t *filter)
+{
+    return picture_NewFromFormat(&filter->fmt_out.video);
+}
+
+static void FillPicture(picture_t *pic, unsigned seed)
+{
+    for (int i = 0; i < pic->i_planes; i++)
+    {
+        plane_t *p = &pic->p[i];
+
+        for (int y = 0; y < p->i_visible_lines; y++)
+            for (int x = 0; x < p->i_visible_pitch; x++)
+            {
+                seed = seed * 1103515245 + 12345;
+                p->p_pixels[y * p->i_pitch + x] =
+                    (x + y / 2 + 64 * i + ((seed >> 16) & 7)) & 255;
+            }
+    }
+}
+
+/* Returns the time per frame, or 0 if the filter is not available */
+static mtime_t Bench(vlc_object_t *parent, const char *filter,
+                     const es_format_t *fmt)
+{
+    filter_owner_t owner = {
+        .video = {
+            .buffer_new = BufferNew,
+        },
+    };
+
+    filter_chain_t *chain = filter_chain_NewVideo(parent, false, &owner);
+    if (chain == NULL)
+        return 0;
+    filter_chain_Reset(chain, fmt, fmt);
+    if (filter_chain_AppendFromString(chain, filter) != 1)
+    {
+        filter_chain_Delete(chain);
+        return 0;
+    }
+
+    mtime_t start = mdate();
+    for (unsigned i = 0; i < FRAMES; i++)
+    {
+        picture_t *in = picture_Hold(inputs[i % INPUTS]);
+
+        in->date = VLC_TS_0 + i * 40000;
+        in->b_progressive = false;
+        in->b_top_field_first = true;
+
+        picture_t *out = filter_chain_VideoFilter(chain, in);
+        while (out != NULL)
+        {
+            picture_t *next = out->p_next;
+            picture_Release(out);
+            out = next;
+        }
+    }
+    mtime_t elapsed = mdate() - start;
+
+    filter_chain_Delete(chain);
+    return elapsed / FRAMES;
+}
+
+int main(void)
+{
+    setenv("VLC_PLUGIN_PATH", "../modules", 0);
+
+    static const char *const args_single[] = {
+        "--video-filter-threads=1",
+    };
+    /* default: one thread per CPU */
+    libvlc_instance_t *vlc_single = libvlc_new(1, args_single);
+    libvlc_instance_t *vlc_multi = libvlc_new(0, NULL);
+    if (vlc_single == NULL || vlc_multi == NULL)
+        return 1;
+
+    es_format_t fmt;
+    es_format_Init(&fmt, VIDEO_ES, VLC_CODEC_I420);
+    video_format_Setup(&fmt.video, VLC_CODEC_I420, WIDTH, HEIGHT,
+                       WIDTH, HEIGHT, 1, 1);
+
+    for (unsigned i = 0; i < INPUTS; i++)
+    {
+        inputs[i] = picture_NewFromFormat(&fmt.video);
+        if (inputs[i] == NULL)
+            abort();
+        FillPicture(inputs[i], i);
+    }
+
+    printf("%u CPU(s), %ux%u\n", vlc_GetCPUCount(), WIDTH, HEIGHT);
+    for (size_t i = 0; i < ARRAY_SIZE(filters); i++)
+    {
+        mtime_t single = Bench(VLC_OBJECT(vlc_single->p_libvlc_int),
+                               filters[i], &fmt);
+        mtime_t multi = Bench(VLC_OBJECT(vlc_multi->p_libvlc_int),
+                              filters[i], &fmt);
+        if (single == 0 || multi == 0)
+        {
+            printf("%-24.24s not available\n", filters[i]);
+            continue;
+        }
+        printf("%-24.24s %6.2f ms/frame, sliced %6.2f ms/frame (x%.2f)\n",
+               filters[i], single / 1000., multi / 1000.,
+               (double)single / multi);
+    }
+
+    for (unsigned i = 0; i < INPUTS; i++)
+        picture_Release(inputs[i]);
+    es_format_Clean(&fmt);
+
+    libvlc_release(vlc_multi);
+    libvlc_release(vlc_single);
+    return 0;
+}
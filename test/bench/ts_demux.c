@@ -0,0 +1,151 @@
+/*****************************************************************************
+ * ts_demux.c: TS demuxer pid lookup throughput benchmark
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_stream.h>
+#include "../../lib/libvlc_internal.h"
+
+#include <vlc/vlc.h>
+
+#define PACKETS 100000
+
+/* The packets are only demultiplexed, nothing is decoded */
+static es_out_id_t *EsOutAdd(es_out_t *out, const es_format_t *fmt)
+{
+    (void) out; (void) fmt;
+    return malloc(1);
+}
+
+static int EsOutSend(es_out_t *out, es_out_id_t *id, block_t *block)
+{
+    (void) out; (void) id;
+    block_Release(block);
+    return VLC_SUCCESS;
+}
+
+static void EsOutDel(es_out_t *out, es_out_id_t *id)
+{
+    (void) out;
+    free(id);
+}
+
+static int EsOutControl(es_out_t *out, int query, va_list args)
+{
+    (void) out;
+    if (query == ES_OUT_GET_ES_STATE)
+    {
+        (void) va_arg(args, es_out_id_t *);
+        *va_arg(args, bool *) = true;
+        return VLC_SUCCESS;
+    }
+    return VLC_EGENERIC;
+}
+
+/* Packets on pids in turn, like a transponder carrying many services */
+static uint8_t *Generate(unsigned pids)
+{
+    uint8_t *buf = malloc(PACKETS * 188);
+    if (buf == NULL)
+        abort();
+
+    unsigned seed = pids;
+    for (unsigned i = 0; i < PACKETS; i++)
+    {
+        uint8_t *p = &buf[i * 188];
+        const unsigned pid = 0x100 + (i % pids) * 7;
+
+        p[0] = 0x47;
+        p[1] = pid >> 8;
+        p[2] = pid;
+        p[3] = 0x10 | ((i / pids) & 0xf);
+        for (unsigned j = 4; j < 188; j++)
+        {
+            seed = seed * 1103515245 + 12345;
+            p[j] = seed >> 16;
+        }
+    }
+    return buf;
+}
+
+static int Bench(vlc_object_t *obj, unsigned pids)
+{
+    uint8_t *buf = Generate(pids);
+    stream_t *s = stream_MemoryNew(obj, buf, PACKETS * 188, false);
+    if (s == NULL)
+        abort();
+
+    es_out_t out = {
+        .pf_add = EsOutAdd,
+        .pf_send = EsOutSend,
+        .pf_del = EsOutDel,
+        .pf_control = EsOutControl,
+    };
+    demux_t *demux = demux_New(obj, "ts", "", s, &out);
+    if (demux == NULL)
+    {
+        stream_Delete(s);
+        return -1;
+    }
+
+    mtime_t start = mdate();
+    while (demux_Demux(demux) == VLC_DEMUXER_SUCCESS);
+    mtime_t elapsed = mdate() - start;
+
+    printf("%4u pid(s): %6.1f ns/packet, %7.1f Mbit/s\n", pids,
+           (elapsed * 1000.) / PACKETS,
+           (PACKETS * 188 * 8.) / (elapsed ? elapsed : 1));
+
+    demux_Delete(demux);
+    stream_Delete(s);
+    return 0;
+}
+
+int main(void)
+{
+    static const char *const args[] = { "--ignore-config", "-q" };
+
+    setenv("VLC_PLUGIN_PATH", "../modules", 0);
+
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+    if (vlc == NULL)
+        return 1;
+
+    static const unsigned pids[] = { 1, 16, 128, 512 };
+    int ret = 0;
+    for (size_t i = 0; i < ARRAY_SIZE(pids) && ret == 0; i++)
+        if (Bench(VLC_OBJECT(vlc->p_libvlc_int), pids[i]))
+        {
+            printf("TS demuxer not available\n");
+            ret = 77;
+        }
+
+    libvlc_release(vlc);
+    return ret;
+}
@@ -0,0 +1,221 @@
+/*****************************************************************************
+ * csa.c: CSA (de)scrambling known answers and consistency
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include "../../../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#include <vlc/vlc.h>
+
+#include "../../../modules/mux/mpeg/csa.c"
+
+#undef NDEBUG /* after csa.c, which pulls config.h in again */
+#include <assert.h>
+
+#define PACKETS 600
+
+static vlc_object_t *parent;
+static uint8_t clear[PACKETS][188], pkts[PACKETS][188], ref[PACKETS][188];
+static uint8_t *pp_pkts[PACKETS];
+
+/* Scrambled with odd key 0123456789abcdef and even key fedcba9876543210
+ * by the byte oriented implementation */
+static const uint8_t even_kat[188] =
+{
+    0x47, 0x01, 0x00, 0x90, 0xbd, 0xa5, 0x06, 0x4c, 0x2a, 0x83, 0x74, 0x03,
+    0x15, 0xe1, 0x05, 0xc3, 0x03, 0xaa, 0x29, 0x94, 0x38, 0x2d, 0xe8, 0xe8,
+    0xcb, 0xe8, 0xfd, 0x52, 0x08, 0x9b, 0x08, 0x44, 0xb4, 0xe1, 0xe2, 0x94,
+    0xc4, 0x9a, 0xea, 0x34, 0xff, 0x7c, 0xa9, 0x3c, 0xac, 0xfe, 0x92, 0x30,
+    0xec, 0x60, 0x9a, 0x15, 0x4b, 0x53, 0x74, 0xb8, 0x8b, 0x90, 0xb2, 0xbb,
+    0x53, 0x7d, 0x59, 0xdb, 0x89, 0xfa, 0x08, 0xac, 0xbc, 0x4e, 0xad, 0x2c,
+    0x86, 0xc7, 0x07, 0xaf, 0xae, 0x56, 0x9d, 0x3a, 0xec, 0x3c, 0xd4, 0x47,
+    0xf9, 0xb7, 0x65, 0xda, 0x14, 0xcb, 0xc4, 0xb4, 0xc3, 0x88, 0xf3, 0x55,
+    0xee, 0x42, 0x3c, 0xdf, 0x8c, 0x8c, 0x96, 0xdc, 0x8f, 0x7b, 0x12, 0x3e,
+    0xb5, 0xc0, 0xe1, 0x49, 0xd5, 0x38, 0x32, 0x2b, 0x5f, 0xe7, 0x49, 0x6c,
+    0x21, 0x4a, 0xfb, 0x48, 0xc1, 0xca, 0x73, 0x4c, 0x9e, 0x3e, 0x2f, 0xb9,
+    0x7c, 0xb9, 0x63, 0xb5, 0x2e, 0xa0, 0x4f, 0x38, 0x9a, 0xa1, 0xb9, 0xc9,
+    0xba, 0x08, 0x02, 0x69, 0x6d, 0x00, 0xbc, 0xaa, 0xd2, 0x94, 0x47, 0x14,
+    0x74, 0xd4, 0x47, 0xbc, 0x13, 0x97, 0xea, 0x1d, 0x6d, 0x92, 0x8d, 0xcd,
+    0xaa, 0x6c, 0xa2, 0xbb, 0xba, 0x80, 0xfd, 0xe0, 0x00, 0x4b, 0x90, 0xf4,
+    0xba, 0x58, 0x4c, 0x0a, 0x52, 0x84, 0xeb, 0xbb,
+};
+static const uint8_t odd_kat[188] =
+{
+    0x47, 0x01, 0x00, 0xf0, 0x0c, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+    0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0xf2, 0x2f, 0x0c, 0x77, 0x5a, 0xd0, 0xce,
+    0x28, 0x94, 0x09, 0xe3, 0xe8, 0x69, 0x42, 0x03, 0x25, 0x1e, 0xaa, 0xfc,
+    0x68, 0x14, 0xef, 0x45, 0x6e, 0x10, 0xbc, 0xb8, 0x82, 0x30, 0x9a, 0x53,
+    0x2f, 0xa8, 0x68, 0xcc, 0x79, 0x43, 0x33, 0x42, 0xd3, 0x93, 0xf2, 0x77,
+    0x3f, 0x36, 0x53, 0x97, 0xbf, 0x26, 0x1d, 0xc5, 0x98, 0x64, 0x47, 0xa4,
+    0x9f, 0xed, 0x54, 0xa2, 0x5b, 0xea, 0xc9, 0x00, 0xf1, 0xe2, 0x5c, 0xaa,
+    0x27, 0xc4, 0xa7, 0x5f, 0xcc, 0x0f, 0x5f, 0x0f, 0x6e, 0x77, 0xa7, 0xf6,
+    0xbd, 0xa5, 0x2c, 0x0c, 0x7b, 0x9a, 0xe6, 0xcc, 0x8a, 0x8d, 0xf1, 0x65,
+    0x76, 0xda, 0x01, 0x38, 0x54, 0xc1, 0x73, 0xb7, 0x39, 0x6c, 0x23, 0xe4,
+    0x29, 0x78, 0x0a, 0x40, 0x87, 0xee, 0x13, 0x64, 0x84, 0xce, 0x57, 0x6b,
+    0x7b, 0x8c, 0xe6, 0x21, 0x93, 0x3b, 0xd5, 0x71, 0xdf, 0xfb, 0x6e, 0x1d,
+    0xfb, 0x7f, 0x3e, 0x83, 0x6e, 0x34, 0xc4, 0xda, 0x87, 0xa6, 0xfe, 0x03,
+    0xfa, 0xf6, 0x7b, 0xdb, 0x1b, 0x3b, 0x8e, 0x2e, 0xbc, 0x49, 0xc7, 0xd4,
+    0x77, 0x3b, 0x8e, 0x56, 0x13, 0x33, 0xc0, 0x48, 0xde, 0x93, 0xef, 0x83,
+    0xa6, 0x03, 0x39, 0x26, 0x86, 0x9f, 0xff, 0x92,
+};
+static void Pattern(uint8_t *pkt, bool odd)
+{
+    for (int i = 0; i < 188; i++)
+        pkt[i] = i;
+    pkt[0] = 0x47;
+    pkt[1] = 0x01;
+    pkt[2] = 0x00;
+    if (odd)
+    {   /* with a 13 bytes adaptation field, for a residue */
+        pkt[3] = 0x30;
+        pkt[4] = 12;
+    }
+    else
+        pkt[3] = 0x10;
+}
+
+static void TestKnownAnswers(csa_t *csa)
+{
+    for (int odd = 0; odd < 2; odd++)
+    {
+        const uint8_t *kat = odd ? odd_kat : even_kat;
+
+        csa_UseKey(parent, csa, odd);
+
+        /* one by one */
+        Pattern(pkts[0], odd);
+        csa_Encrypt(csa, pkts[0], 188);
+        assert(!memcmp(pkts[0], kat, 188));
+        csa_Decrypt(csa, pkts[0], 188);
+        Pattern(clear[0], odd);
+        assert(!memcmp(pkts[0], clear[0], 188));
+
+        /* by batches of all sizes */
+        for (int n = 1; n <= 300; n += (n < 20) ? 1 : 37)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                Pattern(pkts[i], odd);
+                pp_pkts[i] = pkts[i];
+            }
+            csa_EncryptBatch(csa, pp_pkts, n, 188);
+            for (int i = 0; i < n; i++)
+                assert(!memcmp(pkts[i], kat, 188));
+            csa_DecryptBatch(csa, pp_pkts, n, 188);
+            for (int i = 0; i < n; i++)
+                assert(!memcmp(pkts[i], clear[0], 188));
+        }
+    }
+}
+
+static void RandomPacket(uint8_t *pkt)
+{
+    for (int i = 0; i < 188; i++)
+        pkt[i] = rand();
+    pkt[0] = 0x47;
+    pkt[3] &= 0x1f;
+    if (rand() % 3 == 0)
+    {
+        pkt[3] |= 0x20;
+        pkt[4] = rand() % 184;
+    }
+}
+
+/* Batches must give the same result as the packets one by one */
+static void TestBatches(csa_t *csa)
+{
+    for (int round = 0; round < 100; round++)
+    {
+        int n = 1 + rand() % 600;
+        int size = (round % 4) ? 188 : 12 + rand() % 177;
+
+        csa_UseKey(parent, csa, rand() & 1);
+        for (int i = 0; i < n; i++)
+        {
+            RandomPacket(clear[i]);
+            memcpy(pkts[i], clear[i], 188);
+            memcpy(ref[i], clear[i], 188);
+            pp_pkts[i] = pkts[i];
+        }
+
+        csa_EncryptBatch(csa, pp_pkts, n, size);
+        for (int i = 0; i < n; i++)
+        {
+            csa_Encrypt(csa, ref[i], size);
+            assert(!memcmp(pkts[i], ref[i], 188));
+        }
+
+        /* mix both keys, and packets in clear */
+        for (int i = 0; i < n; i++)
+        {
+            switch (rand() % 4)
+            {
+                case 0:
+                    memcpy(pkts[i], clear[i], 188);
+                    break;
+                case 1:
+                    csa_UseKey(parent, csa, !(pkts[i][3] & 0x40));
+                    memcpy(pkts[i], clear[i], 188);
+                    csa_Encrypt(csa, pkts[i], size);
+                    break;
+            }
+            memcpy(ref[i], pkts[i], 188);
+        }
+
+        csa_DecryptBatch(csa, pp_pkts, n, size);
+        for (int i = 0; i < n; i++)
+        {
+            csa_Decrypt(csa, ref[i], size);
+            assert(!memcmp(pkts[i], ref[i], 188));
+            assert(!memcmp(pkts[i], clear[i], 188));
+        }
+    }
+}
+
+int main(void)
+{
+    char odd_key[] = "0x0123456789abcdef";
+    char even_key[] = "fedcba9876543210";
+
+    test_init();
+
+    libvlc_instance_t *vlc = libvlc_new(0, NULL);
+    assert(vlc != NULL);
+    parent = VLC_OBJECT(vlc->p_libvlc_int);
+
+    csa_t *csa = csa_New();
+    assert(csa != NULL);
+    assert(csa_SetCW(parent, csa, odd_key, true) == VLC_SUCCESS);
+    assert(csa_SetCW(parent, csa, even_key, false) == VLC_SUCCESS);
+
+    TestKnownAnswers(csa);
+    TestBatches(csa);
+
+    csa_Delete(csa);
+    libvlc_release(vlc);
+    return 0;
+}
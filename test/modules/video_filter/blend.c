@@ -0,0 +1,208 @@
+/*****************************************************************************
+ * blend.c: SIMD and generic video blending consistency
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include <vlc_modules.h>
+#include "../../../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#include <vlc/vlc.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#define RUNS 20
+
+/* The chromas handled by the SIMD blending */
+static const vlc_fourcc_t dst_chromas[] = {
+    VLC_CODEC_I420, VLC_CODEC_J420, VLC_CODEC_YV12,
+    VLC_CODEC_NV12, VLC_CODEC_NV21,
+};
+static const vlc_fourcc_t src_chromas[] = {
+    VLC_CODEC_YUVA, VLC_CODEC_RGBA,
+};
+
+static unsigned seed = 1;
+
+static unsigned Random(unsigned max)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % max;
+}
+
+/* Random pixels, with transparent spans and some fully opaque pixels */
+static void FillPicture(picture_t *pic, bool has_alpha)
+{
+    for (int i = 0; i < pic->i_planes; i++)
+    {
+        plane_t *p = &pic->p[i];
+
+        for (int y = 0; y < p->i_visible_lines; y++)
+            for (int x = 0; x < p->i_visible_pitch; x++)
+                p->p_pixels[y * p->i_pitch + x] = Random(256);
+    }
+    if (!has_alpha)
+        return;
+
+    const bool rgba = pic->format.i_chroma == VLC_CODEC_RGBA;
+    plane_t *p = &pic->p[rgba ? 0 : 3];
+    const int pixel = rgba ? 4 : 1;
+
+    for (int y = 0; y < p->i_visible_lines; y++)
+    {
+        uint8_t *line = &p->p_pixels[y * p->i_pitch + (rgba ? 3 : 0)];
+        int x = 0;
+
+        while (x < p->i_visible_pitch / pixel)
+        {
+            const int span = 1 + Random(80);
+            const unsigned kind = Random(4);
+
+            for (int i = 0; i < span && x < p->i_visible_pitch / pixel; i++, x++)
+            {
+                if (kind == 0)
+                    line[x * pixel] = 0;
+                else if (kind == 1)
+                    line[x * pixel] = 255;
+            }
+        }
+    }
+}
+
+static void ComparePictures(const picture_t *a, const picture_t *b)
+{
+    assert(a->i_planes == b->i_planes);
+    for (int i = 0; i < a->i_planes; i++)
+    {
+        const plane_t *pa = &a->p[i], *pb = &b->p[i];
+
+        for (int y = 0; y < pa->i_visible_lines; y++)
+            assert(!memcmp(&pa->p_pixels[y * pa->i_pitch],
+                           &pb->p_pixels[y * pb->i_pitch],
+                           pa->i_visible_pitch));
+    }
+}
+
+static filter_t *BlendNew(vlc_object_t *parent, const char *name,
+                          const video_format_t *dst, const video_format_t *src)
+{
+    filter_t *blend = vlc_object_create(parent, sizeof (*blend));
+    assert(blend != NULL);
+
+    es_format_Init(&blend->fmt_in, VIDEO_ES, src->i_chroma);
+    blend->fmt_in.video = *src;
+    es_format_Init(&blend->fmt_out, VIDEO_ES, dst->i_chroma);
+    blend->fmt_out.video = *dst;
+
+    blend->p_module = module_need(blend, "video blending", name, true);
+    if (blend->p_module == NULL)
+    {
+        vlc_object_release(blend);
+        return NULL;
+    }
+    return blend;
+}
+
+static void BlendDelete(filter_t *blend)
+{
+    module_unneed(blend, blend->p_module);
+    vlc_object_release(blend);
+}
+
+/* Returns false if the SIMD blending is not available */
+static bool Test(vlc_object_t *obj, vlc_fourcc_t dst_chroma,
+                 vlc_fourcc_t src_chroma)
+{
+    video_format_t dst_fmt, src_fmt;
+    const unsigned dst_width = 64 + Random(400), dst_height = 16 + Random(200);
+    const unsigned src_width = 1 + Random(dst_width), src_height = 1 + Random(dst_height);
+
+    video_format_Init(&dst_fmt, dst_chroma);
+    video_format_Setup(&dst_fmt, dst_chroma, dst_width, dst_height,
+                       dst_width, dst_height, 1, 1);
+    video_format_Init(&src_fmt, src_chroma);
+    video_format_Setup(&src_fmt, src_chroma, src_width, src_height,
+                       src_width, src_height, 1, 1);
+
+    filter_t *generic = BlendNew(obj, "blend_c", &dst_fmt, &src_fmt);
+    assert(generic != NULL);
+    filter_t *simd = BlendNew(obj, "blend_simd", &dst_fmt, &src_fmt);
+    if (simd == NULL)
+    {
+        BlendDelete(generic);
+        return false;
+    }
+
+    picture_t *src = picture_NewFromFormat(&src_fmt);
+    picture_t *dst = picture_NewFromFormat(&dst_fmt);
+    picture_t *ref = picture_NewFromFormat(&dst_fmt);
+    picture_t *out = picture_NewFromFormat(&dst_fmt);
+    assert(src != NULL && dst != NULL && ref != NULL && out != NULL);
+
+    FillPicture(src, true);
+    FillPicture(dst, false);
+    picture_CopyPixels(ref, dst);
+    picture_CopyPixels(out, dst);
+
+    /* Odd and even offsets, partly out of the picture too */
+    const int x = Random(dst_width), y = Random(dst_height);
+    const int alpha = Random(3) ? 255 : 1 + Random(255);
+
+    generic->pf_video_blend(generic, ref, src, x, y, alpha);
+    simd->pf_video_blend(simd, out, src, x, y, alpha);
+    ComparePictures(ref, out);
+
+    picture_Release(out);
+    picture_Release(ref);
+    picture_Release(dst);
+    picture_Release(src);
+    BlendDelete(simd);
+    BlendDelete(generic);
+    return true;
+}
+
+int main(void)
+{
+    test_init();
+
+    libvlc_instance_t *vlc = libvlc_new(0, NULL);
+    assert(vlc != NULL);
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    for (size_t i = 0; i < ARRAY_SIZE(dst_chromas); i++)
+        for (size_t j = 0; j < ARRAY_SIZE(src_chromas); j++)
+            for (unsigned k = 0; k < RUNS; k++)
+                if (!Test(obj, dst_chromas[i], src_chromas[j]))
+                {
+                    libvlc_release(vlc);
+                    return 77; /* no SIMD blending on this machine */
+                }
+
+    libvlc_release(vlc);
+    return 0;
+}
@@ -0,0 +1,211 @@
+/*****************************************************************************
+ * slices.c: slice threaded video filters consistency
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include "../../../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#include <vlc/vlc.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#define WIDTH   720
+#define HEIGHT  576
+#define INPUTS  3
+#define FRAMES  6
+
+/* The filters converted to slices, with settings making them do some work */
+static const char *const filters[] = {
+    "hqdn3d",
+    "gradfun",
+    "adjust{contrast=1.2,brightness=1.1,saturation=1.4,hue=30}",
+    "sharpen{sigma=0.5}",
+    "deinterlace{mode=yadif}",
+    "deinterlace{mode=yadif2x}",
+    "deinterlace{mode=x}",
+    "deinterlace{mode=phosphor}",
+    "deinterlace{mode=phosphor,phosphor-chroma=3}",
+};
+
+static picture_t *inputs[INPUTS];
+
+static picture_t *BufferNew(filter_t *filter)
+{
+    return picture_NewFromFormat(&filter->fmt_out.video);
+}
+
+/* Gradients over the whole 0-255 range, with sharp edges where they wrap
+ * around and some noise, so that every filter has work to do */
+static void FillPicture(picture_t *pic, unsigned seed)
+{
+    for (int i = 0; i < pic->i_planes; i++)
+    {
+        plane_t *p = &pic->p[i];
+
+        for (int y = 0; y < p->i_visible_lines; y++)
+            for (int x = 0; x < p->i_visible_pitch; x++)
+            {
+                seed = seed * 1103515245 + 12345;
+                p->p_pixels[y * p->i_pitch + x] =
+                    (x + y / 2 + 64 * i + ((seed >> 16) & 7)) & 255;
+            }
+    }
+}
+
+static void ComparePictures(const picture_t *a, const picture_t *b)
+{
+    assert(a->i_planes == b->i_planes);
+    for (int i = 0; i < a->i_planes; i++)
+    {
+        const plane_t *pa = &a->p[i], *pb = &b->p[i];
+
+        assert(pa->i_visible_lines == pb->i_visible_lines);
+        for (int y = 0; y < pa->i_visible_lines; y++)
+            assert(!memcmp(&pa->p_pixels[y * pa->i_pitch],
+                           &pb->p_pixels[y * pb->i_pitch],
+                           pa->i_visible_pitch));
+    }
+}
+
+static filter_chain_t *ChainNew(vlc_object_t *parent, const char *filter,
+                                const es_format_t *fmt)
+{
+    filter_owner_t owner = {
+        .video = {
+            .buffer_new = BufferNew,
+        },
+    };
+
+    filter_chain_t *chain = filter_chain_NewVideo(parent, false, &owner);
+    assert(chain != NULL);
+    filter_chain_Reset(chain, fmt, fmt);
+    if (filter_chain_AppendFromString(chain, filter) != 1)
+    {
+        filter_chain_Delete(chain);
+        return NULL;
+    }
+    return chain;
+}
+
+static picture_t *Run(filter_chain_t *chain, unsigned frame)
+{
+    picture_t *in = picture_Hold(inputs[frame % INPUTS]);
+
+    in->date = VLC_TS_0 + frame * 40000;
+    in->b_progressive = false;
+    in->b_top_field_first = true;
+
+    return filter_chain_VideoFilter(chain, in);
+}
+
+static void Test(vlc_object_t *single, vlc_object_t *multi,
+                 const char *filter, const es_format_t *fmt)
+{
+    filter_chain_t *chain_single = ChainNew(single, filter, fmt);
+    filter_chain_t *chain_multi = ChainNew(multi, filter, fmt);
+    if (chain_single == NULL || chain_multi == NULL)
+    {
+        printf("%s not available\n", filter);
+        if (chain_single != NULL)
+            filter_chain_Delete(chain_single);
+        if (chain_multi != NULL)
+            filter_chain_Delete(chain_multi);
+        return;
+    }
+
+    for (unsigned i = 0; i < FRAMES; i++)
+    {
+        picture_t *ref = Run(chain_single, i);
+        picture_t *out = Run(chain_multi, i);
+
+        /* the deinterlacer waits for the next picture at first */
+        assert((ref != NULL) == (out != NULL));
+        if (ref == NULL)
+            continue;
+
+        /* the framerate doublers output several pictures */
+        while (ref != NULL)
+        {
+            assert(out != NULL);
+
+            picture_t *ref_next = ref->p_next, *out_next = out->p_next;
+            ComparePictures(ref, out);
+            picture_Release(out);
+            picture_Release(ref);
+            ref = ref_next;
+            out = out_next;
+        }
+        assert(out == NULL);
+    }
+
+    filter_chain_Delete(chain_multi);
+    filter_chain_Delete(chain_single);
+}
+
+int main(void)
+{
+    test_init();
+
+    static const char *const args_single[] = {
+        "--video-filter-threads=1",
+    };
+    /* Not the CPU count, the slices must be tested on any machine */
+    static const char *const args_multi[] = {
+        "--video-filter-threads=4",
+    };
+
+    libvlc_instance_t *vlc_single = libvlc_new(1, args_single);
+    assert(vlc_single != NULL);
+    libvlc_instance_t *vlc_multi = libvlc_new(1, args_multi);
+    assert(vlc_multi != NULL);
+
+    es_format_t fmt;
+    es_format_Init(&fmt, VIDEO_ES, VLC_CODEC_I420);
+    video_format_Setup(&fmt.video, VLC_CODEC_I420, WIDTH, HEIGHT,
+                       WIDTH, HEIGHT, 1, 1);
+
+    for (unsigned i = 0; i < INPUTS; i++)
+    {
+        inputs[i] = picture_NewFromFormat(&fmt.video);
+        assert(inputs[i] != NULL);
+        FillPicture(inputs[i], i);
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(filters); i++)
+        Test(VLC_OBJECT(vlc_single->p_libvlc_int),
+             VLC_OBJECT(vlc_multi->p_libvlc_int), filters[i], &fmt);
+
+    for (unsigned i = 0; i < INPUTS; i++)
+        picture_Release(inputs[i]);
+    es_format_Clean(&fmt);
+
+    libvlc_release(vlc_multi);
+    libvlc_release(vlc_single);
+    return 0;
+}
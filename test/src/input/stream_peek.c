@@ -0,0 +1,218 @@
+/*****************************************************************************
+ * stream_peek.c: stream peek copy accounting and micro-benchmark
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_stream.h>
+#include "../../../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#include <vlc/vlc.h>
+
+#define TS_PACKET_SIZE 188
+#define BLOCK_SIZE (7 * TS_PACKET_SIZE) /* as received from UDP */
+#define ARENA_SIZE (BLOCK_SIZE * 2048)
+
+static vlc_object_t *parent;
+static uint8_t arena[ARENA_SIZE];
+
+/* Data that is handed out from the arena was not copied by stream_Peek() */
+struct counters
+{
+    uint64_t demuxed;
+    uint64_t copied;
+    unsigned packets;
+};
+
+/*
+ * Test streams reading from the arena: "copy" only has pf_read, so every
+ * peek is copied, while "block" lends its data in UDP-sized blocks
+ * like a pf_block access does through cache_block.
+ */
+struct stream_sys_t
+{
+    size_t offset;
+    size_t block_size;
+};
+
+static ssize_t ArenaRead(stream_t *s, void *buf, size_t len)
+{
+    stream_sys_t *sys = s->p_sys;
+
+    if (len > ARENA_SIZE - sys->offset)
+        len = ARENA_SIZE - sys->offset;
+    if (buf != NULL)
+        memcpy(buf, arena + sys->offset, len);
+    sys->offset += len;
+    return len;
+}
+
+static ssize_t ArenaPeek(stream_t *s, const uint8_t **restrict bufp,
+                         size_t len)
+{
+    stream_sys_t *sys = s->p_sys;
+    size_t avail = sys->block_size - (sys->offset % sys->block_size);
+
+    if (avail > ARENA_SIZE - sys->offset)
+        avail = ARENA_SIZE - sys->offset;
+    *bufp = arena + sys->offset;
+    return (avail < len) ? avail : len;
+}
+
+static int ArenaControl(stream_t *s, int query, va_list args)
+{
+    (void) s; (void) query; (void) args;
+    return VLC_EGENERIC;
+}
+
+static void ArenaDestroy(stream_t *s)
+{
+    free(s->p_sys);
+}
+
+static stream_t *ArenaNew(bool lend)
+{
+    stream_t *s = stream_CustomNew(parent, ArenaDestroy);
+    assert(s != NULL);
+
+    stream_sys_t *sys = malloc(sizeof (*sys));
+    assert(sys != NULL);
+    sys->offset = 0;
+    sys->block_size = BLOCK_SIZE;
+
+    s->p_sys = sys;
+    s->pf_read = ArenaRead;
+    if (lend)
+        s->pf_peek = ArenaPeek;
+    s->pf_control = ArenaControl;
+    return s;
+}
+
+static ssize_t Peek(stream_t *s, const uint8_t **bufp, size_t len,
+                    struct counters *c)
+{
+    ssize_t val = stream_Peek(s, bufp, len);
+
+    if (val > 0 && (*bufp < arena || *bufp >= arena + ARENA_SIZE))
+        c->copied += val;
+    return val;
+}
+
+/* TS-like demux: peek at each packet, then skip it */
+static void DemuxPackets(stream_t *s, struct counters *c)
+{
+    const uint8_t *p;
+
+    while (Peek(s, &p, TS_PACKET_SIZE, c) == TS_PACKET_SIZE)
+    {
+        assert(p[0] == 0x47);
+        assert(!memcmp(p, arena + stream_Tell(s), TS_PACKET_SIZE));
+        assert(stream_Read(s, NULL, TS_PACKET_SIZE) == TS_PACKET_SIZE);
+        c->demuxed += TS_PACKET_SIZE;
+        c->packets++;
+    }
+}
+
+/* ES-like demux: peek at a header, then at the whole variable-size frame */
+static void DemuxFrames(stream_t *s, struct counters *c)
+{
+    const uint8_t *p;
+
+    while (Peek(s, &p, 2, c) == 2)
+    {
+        size_t size = GetWBE(p);
+
+        if (Peek(s, &p, size, c) < (ssize_t)size)
+            break;
+        assert(!memcmp(p, arena + stream_Tell(s), size));
+        assert(stream_Read(s, NULL, size) == (ssize_t)size);
+        c->demuxed += size;
+        c->packets++;
+    }
+}
+
+static void bench(const char *name, stream_t *s, const char *workload,
+                  void (*demux)(stream_t *, struct counters *),
+                  struct counters *c)
+{
+    mtime_t start = mdate();
+
+    memset(c, 0, sizeof (*c));
+    demux(s, c);
+    stream_Delete(s);
+
+    mtime_t elapsed = mdate() - start;
+
+    assert(c->packets > 0);
+    printf("%-6s %-7s: %5.3f copied bytes per demuxed byte, "
+           "%6.1f ns/packet\n", name, workload,
+           (double)c->copied / c->demuxed,
+           (elapsed * 1000.) / c->packets);
+}
+
+int main(void)
+{
+    struct counters c;
+
+    test_init();
+
+    libvlc_instance_t *vlc = libvlc_new(0, NULL);
+    assert(vlc != NULL);
+    parent = VLC_OBJECT(vlc->p_libvlc_int);
+
+    /* Transport stream packets */
+    for (size_t i = 0; i < ARENA_SIZE; i++)
+        arena[i] = (i % TS_PACKET_SIZE) ? rand() : 0x47;
+
+    bench("copy", ArenaNew(false), "packets", DemuxPackets, &c);
+    assert(c.copied == c.demuxed);
+    bench("block", ArenaNew(true), "packets", DemuxPackets, &c);
+    assert(c.copied == 0);
+    bench("memory", stream_MemoryNew(parent, arena, ARENA_SIZE, true),
+          "packets", DemuxPackets, &c);
+    assert(c.copied == 0);
+
+    /* Variable-size frames, crossing block boundaries */
+    for (size_t i = 0, size; i + 2 <= ARENA_SIZE; i += size)
+    {
+        size = 2 + (rand() % 2000);
+        if (size > ARENA_SIZE - i)
+            size = ARENA_SIZE - i;
+        SetWBE(arena + i, size);
+    }
+
+    bench("copy", ArenaNew(false), "frames", DemuxFrames, &c);
+    bench("block", ArenaNew(true), "frames", DemuxFrames, &c);
+    assert(c.copied < c.demuxed);
+    bench("memory", stream_MemoryNew(parent, arena, ARENA_SIZE, true),
+          "frames", DemuxFrames, &c);
+    assert(c.copied == 0);
+
+    libvlc_release(vlc);
+    return 0;
+}
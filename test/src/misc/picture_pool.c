@@ -0,0 +1,103 @@
+/*****************************************************************************
+ * picture_pool.c: picture pool concurrency test
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <vlc_common.h>
+#include <vlc_picture_pool.h>
+#include <assert.h>
+
+#define PICTURES   8
+#define ITERATIONS 20000
+
+static picture_pool_t *pool;
+
+/* Takes and releases pictures concurrently with the other threads */
+static void *get_release(void *data)
+{
+    (void) data;
+
+    for (unsigned i = 0; i < ITERATIONS; i++)
+    {
+        picture_t *pic = picture_pool_Get(pool);
+        if (pic == NULL)
+            continue;
+        picture_Release(pic);
+    }
+    return NULL;
+}
+
+static void *wait_release(void *data)
+{
+    (void) data;
+
+    for (unsigned i = 0; i < ITERATIONS; i++)
+    {
+        picture_t *pic = picture_pool_Wait(pool);
+        assert(pic != NULL);
+        picture_Release(pic);
+    }
+    return NULL;
+}
+
+static void test(void *(*func)(void *), unsigned threads)
+{
+    vlc_thread_t th[threads];
+
+    for (unsigned i = 0; i < threads; i++)
+        if (vlc_clone(&th[i], func, NULL, VLC_THREAD_PRIORITY_LOW))
+            abort();
+    for (unsigned i = 0; i < threads; i++)
+        vlc_join(th[i], NULL);
+
+    /* All pictures must have been returned to the pool */
+    picture_t *pics[PICTURES];
+
+    for (unsigned i = 0; i < PICTURES; i++)
+    {
+        pics[i] = picture_pool_Get(pool);
+        assert(pics[i] != NULL);
+    }
+    assert(picture_pool_Get(pool) == NULL);
+    for (unsigned i = 0; i < PICTURES; i++)
+        picture_Release(pics[i]);
+}
+
+int main(void)
+{
+    video_format_t fmt;
+
+    test_init();
+
+    video_format_Setup(&fmt, VLC_CODEC_I420, 64, 64, 64, 64, 1, 1);
+    pool = picture_pool_NewFromFormat(&fmt, PICTURES);
+    assert(pool != NULL);
+
+    test(get_release, 1);
+    test(get_release, 4);
+    test(wait_release, 1);
+    /* More waiters than pictures: exercises the empty pool slow path */
+    test(wait_release, 2 * PICTURES);
+
+    picture_pool_Release(pool);
+    return 0;
+}
@@ -0,0 +1,287 @@
+/*****************************************************************************
+ * spu.c: subpicture unit rendering cache
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_spu.h>
+#include <vlc_subpicture.h>
+#include "../../../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#include <vlc/vlc.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#define WIDTH  640
+#define HEIGHT 480
+
+static const vlc_fourcc_t chroma_list[] = { VLC_CODEC_YUVA, 0 };
+
+static video_format_t fmt_src;
+
+static subpicture_region_t *RegionNew(unsigned width, unsigned height)
+{
+    video_format_t fmt;
+
+    video_format_Init(&fmt, VLC_CODEC_YUVA);
+    video_format_Setup(&fmt, VLC_CODEC_YUVA, width, height,
+                       width, height, 1, 1);
+
+    subpicture_region_t *region = subpicture_region_New(&fmt);
+    assert(region != NULL);
+    return region;
+}
+
+static subpicture_t *SubpictureNew(spu_t *spu, mtime_t start, mtime_t stop)
+{
+    subpicture_t *subpic = subpicture_New(NULL);
+    assert(subpic != NULL);
+
+    subpic->i_channel = spu_RegisterChannel(spu);
+    subpic->i_start = start;
+    subpic->i_stop  = stop;
+    subpic->i_original_picture_width  = WIDTH;
+    subpic->i_original_picture_height = HEIGHT;
+    return subpic;
+}
+
+static subpicture_t *Render(spu_t *spu, unsigned width, unsigned height,
+                            mtime_t date)
+{
+    video_format_t fmt_dst;
+
+    video_format_Init(&fmt_dst, VLC_CODEC_I420);
+    video_format_Setup(&fmt_dst, VLC_CODEC_I420, width, height,
+                       width, height, 1, 1);
+    return spu_Render(spu, chroma_list, &fmt_dst, &fmt_src, date, date, false);
+}
+
+/* Checks that two renderings show the same regions */
+static void CompareRenders(const subpicture_t *a, const subpicture_t *b)
+{
+    const subpicture_region_t *ra = a->p_region, *rb = b->p_region;
+
+    assert(a->i_original_picture_width  == b->i_original_picture_width);
+    assert(a->i_original_picture_height == b->i_original_picture_height);
+
+    for (; ra != NULL && rb != NULL; ra = ra->p_next, rb = rb->p_next) {
+        assert(ra->i_x == rb->i_x && ra->i_y == rb->i_y);
+        assert(ra->i_alpha == rb->i_alpha);
+        assert(ra->fmt.i_chroma == rb->fmt.i_chroma);
+        assert(ra->fmt.i_visible_width  == rb->fmt.i_visible_width);
+        assert(ra->fmt.i_visible_height == rb->fmt.i_visible_height);
+        assert(ra->p_picture == rb->p_picture);
+    }
+    assert(ra == NULL && rb == NULL);
+}
+
+/* Checks how many renderings were reused and done since the last check */
+static void CheckCache(spu_t *spu, unsigned hits, unsigned misses)
+{
+    unsigned cache_hits, cache_misses;
+
+    spu_GetResetCacheStatistic(spu, &cache_hits, &cache_misses);
+    assert(cache_hits == hits);
+    assert(cache_misses == misses);
+}
+
+static unsigned RegionCount(const subpicture_t *subpic)
+{
+    unsigned count = 0;
+
+    for (const subpicture_region_t *r = subpic->p_region; r != NULL; r = r->p_next)
+        count++;
+    return count;
+}
+
+/* A persistent logo and a relative subtitle, rendered over and over */
+static void TestStatic(spu_t *spu)
+{
+    subpicture_t *logo = SubpictureNew(spu, VLC_TS_0, VLC_TS_0 + CLOCK_FREQ);
+    logo->p_region = RegionNew(64, 32);
+    logo->p_region->i_x = 10;
+    logo->p_region->i_y = 20;
+    const int logo_channel = logo->i_channel;
+    spu_PutSubpicture(spu, logo);
+
+    subpicture_t *sub = SubpictureNew(spu, VLC_TS_0, VLC_TS_0 + CLOCK_FREQ);
+    sub->b_subtitle = true;
+    sub->b_absolute = false;
+    sub->p_region = RegionNew(200, 40);
+    sub->p_region->i_align = SUBPICTURE_ALIGN_BOTTOM;
+    sub->p_region->p_next = RegionNew(120, 40);
+    sub->p_region->p_next->i_align = SUBPICTURE_ALIGN_BOTTOM;
+    const int sub_channel = sub->i_channel;
+    spu_PutSubpicture(spu, sub);
+
+    subpicture_t *first = Render(spu, WIDTH, HEIGHT, VLC_TS_0 + 1000);
+    assert(first != NULL && RegionCount(first) == 3);
+
+    for (unsigned i = 1; i < 10; i++) {
+        subpicture_t *render = Render(spu, WIDTH, HEIGHT, VLC_TS_0 + i * 1000);
+        assert(render != NULL);
+        CompareRenders(first, render);
+        subpicture_Delete(render);
+    }
+    /* The first placement of the subtitles is not reused, the second
+     * rendering is */
+    CheckCache(spu, 8, 2);
+
+    /* The overlapping subtitles are moved apart */
+    const subpicture_region_t *r1 = first->p_region->p_next;
+    const subpicture_region_t *r2 = r1->p_next;
+    assert(r1->i_y != r2->i_y);
+
+    /* A new output size is rendered again (the regions are also resized
+     * when a scaler is available) */
+    subpicture_t *large = Render(spu, 2 * WIDTH, 2 * HEIGHT, VLC_TS_0 + 20000);
+    assert(large != NULL && RegionCount(large) == 3);
+    assert(large->i_original_picture_width == 2 * WIDTH);
+    assert(large->p_region->i_x == 20 && large->p_region->i_y == 40);
+    subpicture_Delete(large);
+    CheckCache(spu, 0, 1);
+
+    subpicture_t *again = Render(spu, WIDTH, HEIGHT, VLC_TS_0 + 30000);
+    assert(again != NULL);
+    assert(again->p_region->fmt.i_visible_width == 64);
+    assert(again->p_region->i_x == 10 && again->p_region->i_y == 20);
+    CheckCache(spu, 0, 1);
+
+    subpicture_t *reused = Render(spu, WIDTH, HEIGHT, VLC_TS_0 + 31000);
+    assert(reused != NULL);
+    CompareRenders(again, reused);
+    CheckCache(spu, 1, 0);
+    subpicture_Delete(reused);
+    subpicture_Delete(again);
+
+    subpicture_Delete(first);
+
+    /* Removed subpictures are not shown anymore */
+    spu_ClearChannel(spu, logo_channel);
+    spu_ClearChannel(spu, sub_channel);
+    assert(Render(spu, WIDTH, HEIGHT, VLC_TS_0 + 40000) == NULL);
+    CheckCache(spu, 0, 0);
+}
+
+/* A fading subpicture is never reused */
+static void TestFade(spu_t *spu)
+{
+    subpicture_t *subpic = SubpictureNew(spu, VLC_TS_0, VLC_TS_0 + CLOCK_FREQ);
+    subpic->b_fade = true;
+    subpic->p_region = RegionNew(32, 32);
+    const int channel = subpic->i_channel;
+    spu_PutSubpicture(spu, subpic);
+
+    int alpha = 256;
+    for (mtime_t date = CLOCK_FREQ * 8 / 10; date < CLOCK_FREQ; date += CLOCK_FREQ / 20) {
+        subpicture_t *render = Render(spu, WIDTH, HEIGHT, VLC_TS_0 + date);
+        assert(render != NULL && render->p_region != NULL);
+        assert(render->p_region->i_alpha < alpha);
+        alpha = render->p_region->i_alpha;
+        subpicture_Delete(render);
+    }
+    CheckCache(spu, 0, 4);
+    spu_ClearChannel(spu, channel);
+}
+
+/* A subpicture updated at some dates */
+struct subpicture_updater_sys_t {
+    unsigned width;
+};
+
+static int UpdaterValidate(subpicture_t *subpic,
+                           bool has_src_changed, const video_format_t *fmt_src,
+                           bool has_dst_changed, const video_format_t *fmt_dst,
+                           mtime_t ts)
+{
+    VLC_UNUSED(has_src_changed); VLC_UNUSED(fmt_src);
+    VLC_UNUSED(has_dst_changed); VLC_UNUSED(fmt_dst);
+
+    /* the width changes every 10 ms */
+    return subpic->updater.p_sys->width != 16 + 16 * ((ts - VLC_TS_0) / 10000);
+}
+
+static void UpdaterUpdate(subpicture_t *subpic,
+                          const video_format_t *fmt_src,
+                          const video_format_t *fmt_dst, mtime_t ts)
+{
+    VLC_UNUSED(fmt_src); VLC_UNUSED(fmt_dst);
+
+    subpic->updater.p_sys->width = 16 + 16 * ((ts - VLC_TS_0) / 10000);
+    subpic->p_region = RegionNew(subpic->updater.p_sys->width, 16);
+}
+
+static void TestUpdater(spu_t *spu)
+{
+    subpicture_updater_sys_t sys = { .width = 0 };
+    subpicture_updater_t updater = {
+        .pf_validate = UpdaterValidate,
+        .pf_update   = UpdaterUpdate,
+        .p_sys       = &sys,
+    };
+
+    subpicture_t *subpic = subpicture_New(&updater);
+    assert(subpic != NULL);
+    subpic->i_channel = spu_RegisterChannel(spu);
+    subpic->i_start = VLC_TS_0;
+    subpic->i_stop  = VLC_TS_0 + CLOCK_FREQ;
+    subpic->i_original_picture_width  = WIDTH;
+    subpic->i_original_picture_height = HEIGHT;
+    const int channel = subpic->i_channel;
+    spu_PutSubpicture(spu, subpic);
+
+    for (mtime_t date = 0; date < 50000; date += 2500) {
+        subpicture_t *render = Render(spu, WIDTH, HEIGHT, VLC_TS_0 + date);
+        assert(render != NULL && render->p_region != NULL);
+        assert(render->p_region->fmt.i_visible_width == 16 + 16 * (date / 10000));
+        subpicture_Delete(render);
+    }
+    /* Rendered again after each of the 5 updates, reused 3 times */
+    CheckCache(spu, 15, 5);
+    spu_ClearChannel(spu, channel);
+    assert(Render(spu, WIDTH, HEIGHT, VLC_TS_0 + 60000) == NULL);
+}
+
+int main(void)
+{
+    test_init();
+
+    libvlc_instance_t *vlc = libvlc_new(0, NULL);
+    assert(vlc != NULL);
+
+    spu_t *spu = spu_Create(vlc->p_libvlc_int);
+    assert(spu != NULL);
+
+    video_format_Init(&fmt_src, VLC_CODEC_I420);
+    video_format_Setup(&fmt_src, VLC_CODEC_I420, WIDTH, HEIGHT,
+                       WIDTH, HEIGHT, 1, 1);
+
+    TestStatic(spu);
+    TestFade(spu);
+    TestUpdater(spu);
+
+    spu_Destroy(spu);
+    libvlc_release(vlc);
+    return 0;
+}